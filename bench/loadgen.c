@@ -0,0 +1,552 @@
+// zu-loadgen: HTTP load generator for the REST server.
+//
+// Each connection is driven by its own thread. In closed loop (no -r) a
+// connection sends its next request as soon as the previous answer arrives.
+// In open loop (-r) requests are scheduled at a fixed total rate, and latency
+// is measured from the time a request was due rather than when it was sent,
+// so a stalled server is charged for the requests it held back
+// (coordinated-omission correction); the uncorrected service time is
+// reported alongside.
+
+#include "bench_report.h"
+#include "config.h"
+#include "timer.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // Not available on macOS; SO_NOSIGPIPE is set on the socket instead
+#endif
+
+#define RESPONSE_BUFFER 65536
+#define PRELOAD_BATCH 100
+
+typedef enum {
+    REQUEST_GET,   // GET /get?key=
+    REQUEST_SET,   // POST /set with one pair
+    REQUEST_BATCH, // POST /set with an array of pairs
+    REQUEST_KIND_COUNT
+} request_kind_t;
+
+static const char *const request_names[REQUEST_KIND_COUNT] = {"get", "set", "batch"};
+
+typedef struct {
+    struct sockaddr_in address;
+    int connections;
+    double seconds;
+    double rate; // Requests per second over all connections; 0 for closed loop
+    int keep_alive;
+    int mix[REQUEST_KIND_COUNT];
+    uint64_t keys;
+    size_t batch_size;
+    size_t value_size;
+    int uniform;
+    int preload;
+} LoadConfig;
+
+typedef struct {
+    const LoadConfig *config;
+    const ZipfianGenerator *zipfian;
+    struct timespec start;
+    struct timespec deadline;
+    uint64_t rng;
+    int fd;
+    char *request;    // Room for the largest request
+    char *response;
+    LatencyHistogram latency[REQUEST_KIND_COUNT]; // From when each request was due
+    LatencyHistogram service;                     // From when each request was sent
+    uint64_t requests[REQUEST_KIND_COUNT];
+    uint64_t errors;   // Transport failures and unexpected statuses
+    uint64_t rejected; // 503s from admission control
+    uint64_t opened;   // Connections established
+} Connection;
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "Usage: zu-loadgen [options]\n"
+            "  -H host        IPv4 address of the server (default 127.0.0.1)\n"
+            "  -p port        REST port (default %d)\n"
+            "  -c n           Connections, one thread each (default 8)\n"
+            "  -d seconds     Length of the run (default 10)\n"
+            "  -r rate        Open loop at this many requests/s in total (default: closed loop)\n"
+            "  -k             Reuse connections (HTTP keep-alive) while the server allows it\n"
+            "  -m mix         Percentages, e.g. get=90,set=9,batch=1 (default get=90,set=10)\n"
+            "  -n keys        Key space (default 10000)\n"
+            "  -b size        Pairs per batch request (default 10)\n"
+            "  -v bytes       Value size (default 100)\n"
+            "  -u             Uniform keys instead of zipfian\n"
+            "  -l             Load every key with batch requests before the run\n"
+            "  -o file        Also write the results as JSON (see zu-bench compare)\n",
+            REST_SERVER_PORT);
+}
+
+static int parse_mix(LoadConfig *config, char *text)
+{
+    memset(config->mix, 0, sizeof(config->mix));
+    char *save;
+    for (char *item = strtok_r(text, ",", &save); item; item = strtok_r(NULL, ",", &save))
+    {
+        char *equals = strchr(item, '=');
+        if (!equals) return 0;
+        *equals = '\0';
+        int kind = 0;
+        while (kind < REQUEST_KIND_COUNT && strcmp(item, request_names[kind]) != 0) kind++;
+        if (kind == REQUEST_KIND_COUNT) return 0;
+        config->mix[kind] = atoi(equals + 1);
+    }
+    int total = 0;
+    for (int kind = 0; kind < REQUEST_KIND_COUNT; kind++) total += config->mix[kind];
+    return total == 100;
+}
+
+// --- Requests ---
+
+static void timespec_add_ns(struct timespec *t, uint64_t ns)
+{
+    t->tv_sec += (time_t)(ns / 1000000000);
+    t->tv_nsec += (long)(ns % 1000000000);
+    if (t->tv_nsec >= 1000000000)
+    {
+        t->tv_sec++;
+        t->tv_nsec -= 1000000000;
+    }
+}
+
+static uint64_t ns_between(const struct timespec *from, const struct timespec *to)
+{
+    int64_t ns = (int64_t)(to->tv_sec - from->tv_sec) * 1000000000 + (to->tv_nsec - from->tv_nsec);
+    return ns > 0 ? (uint64_t)ns : 0;
+}
+
+// Zipfian ranks are mixed over the key space so the hot keys are not neighbours
+static uint64_t choose_key(Connection *c)
+{
+    if (c->config->uniform) return random_next(&c->rng) % c->config->keys;
+    uint64_t h = zipfian_next(c->zipfian, &c->rng);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h % c->config->keys;
+}
+
+static size_t append_pair(Connection *c, char *out, uint64_t key)
+{
+    size_t len = (size_t)sprintf(out, "{\"key\":\"user%012llu\",\"value\":\"", (unsigned long long)key);
+    for (size_t i = 0; i < c->config->value_size; i++) out[len++] = (char)('a' + random_next(&c->rng) % 26);
+    memcpy(out + len, "\"}", 2);
+    return len + 2;
+}
+
+// Format a request into c->request; `first_key` and `count` only apply to batches
+static size_t format_request(Connection *c, request_kind_t kind, uint64_t first_key, size_t count)
+{
+    const char *connection = c->config->keep_alive ? "keep-alive" : "close";
+    if (kind == REQUEST_GET)
+    {
+        return (size_t)sprintf(c->request, "GET /get?key=user%012llu HTTP/1.1\r\nHost: localhost\r\nConnection: %s\r\n\r\n",
+                               (unsigned long long)choose_key(c), connection);
+    }
+
+    // The body goes after room for the headers, which need its length
+    char *body = c->request + 256;
+    size_t len = 0;
+    if (kind == REQUEST_SET)
+    {
+        len = append_pair(c, body, choose_key(c));
+    }
+    else
+    {
+        body[len++] = '[';
+        for (size_t i = 0; i < count; i++)
+        {
+            if (i > 0) body[len++] = ',';
+            len += append_pair(c, body + len, first_key == UINT64_MAX ? choose_key(c) : first_key + i);
+        }
+        body[len++] = ']';
+    }
+    char headers[256];
+    int headers_len = snprintf(headers, sizeof(headers),
+                               "POST /set HTTP/1.1\r\nHost: localhost\r\nConnection: %s\r\n"
+                               "Content-Type: application/json\r\nContent-Length: %zu\r\n\r\n",
+                               connection, len);
+    memmove(c->request + headers_len, body, len);
+    memcpy(c->request, headers, (size_t)headers_len);
+    return (size_t)headers_len + len;
+}
+
+// --- Transport ---
+
+static int open_connection(Connection *c)
+{
+    c->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (c->fd < 0) return 0;
+    int one = 1;
+    setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+#ifdef SO_NOSIGPIPE
+    setsockopt(c->fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+    if (connect(c->fd, (const struct sockaddr *)&c->config->address, sizeof(c->config->address)) != 0)
+    {
+        close(c->fd);
+        c->fd = -1;
+        return 0;
+    }
+    c->opened++;
+    return 1;
+}
+
+static void close_connection(Connection *c)
+{
+    if (c->fd >= 0) close(c->fd);
+    c->fd = -1;
+}
+
+static int send_all(int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        data += n;
+        len -= (size_t)n;
+    }
+    return 1;
+}
+
+// Read one response. Returns its status, 0 if the connection closed before
+// any byte arrived, or -1 on error. *reusable is cleared when the server
+// will close the connection.
+static int read_response(Connection *c, int *reusable)
+{
+    size_t len = 0;
+    char *headers_end = NULL;
+    while (!headers_end)
+    {
+        if (len == RESPONSE_BUFFER - 1) return -1;
+        ssize_t n = recv(c->fd, c->response + len, RESPONSE_BUFFER - 1 - len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return len == 0 && n == 0 ? 0 : -1;
+        len += (size_t)n;
+        c->response[len] = '\0';
+        headers_end = strstr(c->response, "\r\n\r\n");
+    }
+
+    int status;
+    if (sscanf(c->response, "HTTP/1.%*d %d", &status) != 1) return -1;
+    size_t content_length = 0;
+    *reusable = strncmp(c->response, "HTTP/1.1", 8) == 0;
+    for (char *line = strstr(c->response, "\r\n"); line && line < headers_end; line = strstr(line + 2, "\r\n"))
+    {
+        if (strncasecmp(line + 2, "Content-Length:", 15) == 0) content_length = strtoull(line + 17, NULL, 10);
+        if (strncasecmp(line + 2, "Connection:", 11) == 0 && strncasecmp(line + 13, " close", 6) == 0) *reusable = 0;
+    }
+
+    // Drain the body; only its length matters
+    size_t body_read = len - (size_t)(headers_end + 4 - c->response);
+    while (body_read < content_length)
+    {
+        ssize_t n = recv(c->fd, c->response, RESPONSE_BUFFER - 1, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        body_read += (size_t)n;
+    }
+    return status;
+}
+
+// Send a request and wait for its answer, reconnecting as needed. A reused
+// connection the server has closed in the meantime is retried once on a new one.
+static int exchange(Connection *c, size_t request_len)
+{
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        int reused = c->fd >= 0;
+        if (!reused && !open_connection(c)) return -1;
+        int reusable = 0;
+        int status = send_all(c->fd, c->request, request_len) ? read_response(c, &reusable) : 0;
+        if (status <= 0 || !reusable || !c->config->keep_alive) close_connection(c);
+        if (status > 0 || !reused) return status > 0 ? status : -1;
+    }
+    return -1;
+}
+
+// --- Load ---
+
+static void *connection_main(void *arg)
+{
+    Connection *c = arg;
+    const LoadConfig *config = c->config;
+    uint64_t interval = config->rate > 0 ? (uint64_t)(1e9 * config->connections / config->rate) : 0;
+    struct timespec due = c->start, now;
+
+    // Spread the first sends of open-loop connections over one interval
+    if (interval) timespec_add_ns(&due, random_next(&c->rng) % interval);
+
+    for (;;)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        uint64_t wait = interval ? ns_between(&now, &due) : 0;
+        if (wait > 0)
+        {
+            // Relative, since macOS has no clock_nanosleep(); oversleeping is
+            // charged to the request like any other delay
+            struct timespec pause = {(time_t)(wait / 1000000000), (long)(wait % 1000000000)};
+            nanosleep(&pause, NULL);
+            clock_gettime(CLOCK_MONOTONIC, &now);
+        }
+        if (ns_between(&c->deadline, &now) > 0) break;
+
+        int roll = (int)(random_next(&c->rng) % 100);
+        request_kind_t kind = REQUEST_GET;
+        while (kind < REQUEST_BATCH && roll >= config->mix[kind])
+        {
+            roll -= config->mix[kind];
+            kind++;
+        }
+        size_t request_len = format_request(c, kind, UINT64_MAX, config->batch_size);
+
+        struct timespec sent;
+        clock_gettime(CLOCK_MONOTONIC, &sent);
+        int status = exchange(c, request_len);
+        struct timespec done;
+        clock_gettime(CLOCK_MONOTONIC, &done);
+
+        c->requests[kind]++;
+        if (status == 503) c->rejected++;
+        else if (status < 200 || (status >= 300 && status != 404)) c->errors++;
+        histogram_record(&c->latency[kind], ns_between(interval ? &due : &sent, &done));
+        histogram_record(&c->service, ns_between(&sent, &done));
+        if (interval) timespec_add_ns(&due, interval);
+    }
+    close_connection(c);
+    return NULL;
+}
+
+// Write every key once, in batches, from a single connection
+static int preload(Connection *c)
+{
+    uint64_t key = 0;
+    while (key < c->config->keys)
+    {
+        size_t count = c->config->keys - key < PRELOAD_BATCH ? (size_t)(c->config->keys - key) : PRELOAD_BATCH;
+        int status = exchange(c, format_request(c, REQUEST_BATCH, key, count));
+        if (status == 503)
+        {
+            usleep(10000); // Admission control: back off and retry the batch
+            continue;
+        }
+        if (status < 200 || status >= 300) return 0;
+        key += count;
+    }
+    close_connection(c);
+    return 1;
+}
+
+static void print_row(const char *name, uint64_t count, double seconds, const LatencyHistogram *h)
+{
+    printf("  %-8s %10llu %10.0f %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n", name, (unsigned long long)count,
+           count / seconds, h->count ? h->sum_ns / 1000.0 / h->count : 0.0, histogram_percentile(h, 50.0) / 1000.0,
+           histogram_percentile(h, 90.0) / 1000.0, histogram_percentile(h, 99.0) / 1000.0,
+           histogram_percentile(h, 99.9) / 1000.0, h->max_ns / 1000.0);
+}
+
+int main(int argc, char **argv)
+{
+    LoadConfig config = {
+        .connections = 8,
+        .seconds = 10,
+        .mix = {[REQUEST_GET] = 90, [REQUEST_SET] = 10},
+        .keys = 10000,
+        .batch_size = 10,
+        .value_size = 100,
+    };
+    const char *host = "127.0.0.1", *json_path = NULL;
+    int port = REST_SERVER_PORT;
+    int option;
+    while ((option = getopt(argc, argv, "H:p:c:d:r:km:n:b:v:ulo:")) != -1)
+    {
+        switch (option)
+        {
+        case 'H': host = optarg; break;
+        case 'p': port = atoi(optarg); break;
+        case 'c': config.connections = atoi(optarg); break;
+        case 'd': config.seconds = atof(optarg); break;
+        case 'r': config.rate = atof(optarg); break;
+        case 'k': config.keep_alive = 1; break;
+        case 'm':
+            if (!parse_mix(&config, optarg))
+            {
+                fprintf(stderr, "zu-loadgen: the mix must name get, set or batch and add up to 100\n");
+                return 2;
+            }
+            break;
+        case 'n': config.keys = strtoull(optarg, NULL, 10); break;
+        case 'b': config.batch_size = strtoul(optarg, NULL, 10); break;
+        case 'v': config.value_size = strtoul(optarg, NULL, 10); break;
+        case 'u': config.uniform = 1; break;
+        case 'l': config.preload = 1; break;
+        case 'o': json_path = optarg; break;
+        default: usage(); return 2;
+        }
+    }
+    config.address.sin_family = AF_INET;
+    config.address.sin_port = htons((uint16_t)port);
+    if (optind != argc || inet_pton(AF_INET, host, &config.address.sin_addr) != 1 || port <= 0 || port > 65535 ||
+        config.connections < 1 || config.seconds <= 0 || config.rate < 0 || config.keys == 0 ||
+        config.batch_size == 0 || config.batch_size > PRELOAD_BATCH * 10 || config.value_size == 0 ||
+        config.value_size > 4096)
+    {
+        usage();
+        return 2;
+    }
+
+    // Opened up front so a bad path fails before the run rather than after it
+    BenchReport report = {0};
+    if (json_path && !bench_report_open(&report, json_path, "zu-loadgen"))
+    {
+        perror(json_path);
+        return 2;
+    }
+
+    ZipfianGenerator zipfian;
+    zipfian_init(&zipfian, config.keys, ZIPFIAN_THETA);
+    size_t max_pairs = config.batch_size > PRELOAD_BATCH ? config.batch_size : PRELOAD_BATCH;
+    size_t request_size = 512 + max_pairs * (config.value_size + 48);
+
+    Connection *connections = calloc((size_t)config.connections, sizeof(Connection));
+    pthread_t *threads = calloc((size_t)config.connections, sizeof(pthread_t));
+    if (!connections || !threads)
+    {
+        perror("zu-loadgen");
+        return 1;
+    }
+    for (int i = 0; i < config.connections; i++)
+    {
+        Connection *c = &connections[i];
+        c->config = &config;
+        c->zipfian = &zipfian;
+        c->fd = -1;
+        c->rng = ((uint64_t)time(NULL) << 16) ^ (0x9E3779B97F4A7C15ULL * (uint64_t)(i + 1));
+        c->request = malloc(request_size);
+        c->response = malloc(RESPONSE_BUFFER);
+        if (!c->request || !c->response)
+        {
+            perror("zu-loadgen");
+            return 1;
+        }
+    }
+
+    if (config.preload)
+    {
+        printf("Loading %llu keys...\n", (unsigned long long)config.keys);
+        if (!preload(&connections[0]))
+        {
+            fprintf(stderr, "zu-loadgen: could not load the keys into %s:%d\n", host, port);
+            return 1;
+        }
+        connections[0].opened = 0;
+    }
+
+    printf("%d %s connections to %s:%d, %s, %.1f s, %s keys over %llu\n", config.connections,
+           config.keep_alive ? "keep-alive" : "one-shot", host, port,
+           config.rate > 0 ? "open loop" : "closed loop", config.seconds, config.uniform ? "uniform" : "zipfian",
+           (unsigned long long)config.keys);
+    if (config.rate > 0) printf("Target rate: %.0f requests/s\n", config.rate);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    struct timespec deadline = start;
+    timespec_add_ns(&deadline, (uint64_t)(config.seconds * 1e9));
+    int started = 0;
+    for (; started < config.connections; started++)
+    {
+        connections[started].start = start;
+        connections[started].deadline = deadline;
+        if (pthread_create(&threads[started], NULL, connection_main, &connections[started]) != 0) break;
+    }
+    for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = ns_between(&start, &end) / 1e9;
+
+    LatencyHistogram *totals = calloc(REQUEST_KIND_COUNT + 2, sizeof(LatencyHistogram));
+    if (!totals)
+    {
+        perror("zu-loadgen");
+        return 1;
+    }
+    LatencyHistogram *overall = &totals[REQUEST_KIND_COUNT], *service = &totals[REQUEST_KIND_COUNT + 1];
+    uint64_t requests[REQUEST_KIND_COUNT] = {0}, total = 0, errors = 0, rejected = 0, opened = 0;
+    for (int i = 0; i < started; i++)
+    {
+        Connection *c = &connections[i];
+        for (int kind = 0; kind < REQUEST_KIND_COUNT; kind++)
+        {
+            requests[kind] += c->requests[kind];
+            total += c->requests[kind];
+            histogram_merge(&totals[kind], &c->latency[kind]);
+            histogram_merge(overall, &c->latency[kind]);
+        }
+        histogram_merge(service, &c->service);
+        errors += c->errors;
+        rejected += c->rejected;
+        opened += c->opened;
+    }
+
+    printf("\nLatency (µs)%s:\n", config.rate > 0 ? ", corrected for coordinated omission" : "");
+    printf("  %-8s %10s %10s %9s %9s %9s %9s %9s %9s\n", "request", "count", "req/s", "avg", "p50", "p90", "p99",
+           "p99.9", "max");
+    for (int kind = 0; kind < REQUEST_KIND_COUNT; kind++)
+    {
+        if (config.mix[kind] > 0) print_row(request_names[kind], requests[kind], elapsed, &totals[kind]);
+    }
+    print_row("total", total, elapsed, overall);
+    if (config.rate > 0) print_row("service", total, elapsed, service);
+
+    printf("\nThroughput: %.2f requests/s", total / elapsed);
+    if (config.rate > 0) printf(" (%.1f%% of target)", 100.0 * total / elapsed / config.rate);
+    printf("\nErrors: %llu, rejected (503): %llu, connections opened: %llu\n", (unsigned long long)errors,
+           (unsigned long long)rejected, (unsigned long long)opened);
+
+    if (json_path)
+    {
+        char params[160];
+        snprintf(params, sizeof(params), "connections=%d;rate=%.0f;mix=get%d,set%d,batch%d;keys=%llu;dist=%s;value=%zu",
+                 config.connections, config.rate, config.mix[REQUEST_GET], config.mix[REQUEST_SET],
+                 config.mix[REQUEST_BATCH], (unsigned long long)config.keys, config.uniform ? "uniform" : "zipfian",
+                 config.value_size);
+        for (int kind = 0; kind < REQUEST_KIND_COUNT; kind++)
+        {
+            if (config.mix[kind] == 0) continue;
+            bench_report_latency(&report, request_names[kind], params, requests[kind], elapsed, &totals[kind]);
+        }
+        bench_report_latency(&report, "total", params, total, elapsed, overall);
+        if (config.rate > 0) bench_report_latency(&report, "service", params, total, elapsed, service);
+        bench_report_metric(&report, "total", params, "errors", (double)errors, 0, 1);
+        bench_report_metric(&report, "total", params, "rejected", (double)rejected, 0, 1);
+        if (!bench_report_close(&report)) fprintf(stderr, "zu-loadgen: could not write %s\n", json_path);
+    }
+
+    for (int i = 0; i < config.connections; i++)
+    {
+        free(connections[i].request);
+        free(connections[i].response);
+    }
+    free(connections);
+    free(threads);
+    free(totals);
+    return errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,390 @@
+// zu-bench: microbenchmarks for the hash table (ds.c) and the cache (cache.c).
+//
+// Every case is calibrated to run for at least BENCH_TARGET_NS per repetition,
+// warmed up, then repeated; the median time per operation and its median
+// absolute deviation (MAD) are reported as CSV or JSON. `zu-bench compare`
+// checks two JSON result files, of any benchmark tool, for regressions.
+
+#include "bench_report.h"
+#include "cache.h"
+#include "config.h"
+#include "ds.h"
+#include "timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <pthread.h>
+
+#define BENCH_TARGET_NS 20000000ULL // Each repetition runs for at least 20ms
+#define BENCH_KEYS 4096             // Distinct keys the lookups cycle through
+#define BENCH_MAX_THREADS 64
+
+typedef struct Case Case;
+
+// Run `ops` operations of the case and return the nanoseconds they took,
+// leaving out any setup done along the way
+typedef uint64_t (*bench_fn)(Case *c, size_t ops);
+
+struct Case {
+    const char *name;
+    char params[64];
+    bench_fn run;
+    size_t items;   // Items in the table or cache
+    size_t buckets; // Buckets in the table
+    int threads;
+    HashTable *table;
+};
+
+typedef struct {
+    double median_ns; // Per operation
+    double mad_ns;
+    double min_ns;
+    size_t ops;       // Per repetition
+    int reps;
+} CaseResult;
+
+static char keys[BENCH_KEYS][32];
+static volatile unsigned int sink; // Keeps results observable so loops are not optimized away
+
+static void format_key(char *key, size_t size, size_t number)
+{
+    snprintf(key, size, "user%012zu", number);
+}
+
+// --- Hash table ---
+
+static uint64_t bench_hash_function(Case *c, size_t ops)
+{
+    struct timespec start;
+    unsigned int acc = 0;
+    command_timer_start(&start);
+    for (size_t i = 0; i < ops; i++) acc += hash_function(keys[i % BENCH_KEYS], (unsigned int)c->buckets);
+    uint64_t elapsed = timer_elapsed_ns(&start);
+    sink = acc;
+    return elapsed;
+}
+
+static HashTable *filled_table(const Case *c)
+{
+    HashTable *table = create_hash_table((unsigned int)c->buckets);
+    if (!table) return NULL;
+    for (size_t i = 0; i < c->items; i++) hash_table_insert(table, keys[i], "value");
+    return table;
+}
+
+// Fill empty tables, `items` keys each
+static uint64_t bench_insert(Case *c, size_t ops)
+{
+    uint64_t elapsed = 0;
+    for (size_t done = 0; done < ops;)
+    {
+        HashTable *table = create_hash_table((unsigned int)c->buckets);
+        if (!table) return 0;
+        size_t batch = ops - done < c->items ? ops - done : c->items;
+        struct timespec start;
+        command_timer_start(&start);
+        for (size_t i = 0; i < batch; i++) hash_table_insert(table, keys[i], "value");
+        elapsed += timer_elapsed_ns(&start);
+        free_hash_table(table);
+        done += batch;
+    }
+    return elapsed;
+}
+
+// Lookups of present keys in a table of `items`
+static uint64_t bench_search(Case *c, size_t ops)
+{
+    if (!c->table && !(c->table = filled_table(c))) return 0;
+    struct timespec start;
+    unsigned int found = 0;
+    command_timer_start(&start);
+    for (size_t i = 0; i < ops; i++) found += hash_table_search(c->table, keys[i % c->items]) != NULL;
+    uint64_t elapsed = timer_elapsed_ns(&start);
+    sink = found;
+    return elapsed;
+}
+
+// Empty full tables, reinserting between rounds
+static uint64_t bench_remove(Case *c, size_t ops)
+{
+    uint64_t elapsed = 0;
+    for (size_t done = 0; done < ops;)
+    {
+        HashTable *table = filled_table(c);
+        if (!table) return 0;
+        size_t batch = ops - done < c->items ? ops - done : c->items;
+        struct timespec start;
+        command_timer_start(&start);
+        for (size_t i = 0; i < batch; i++) hash_table_remove(table, keys[i]);
+        elapsed += timer_elapsed_ns(&start);
+        free_hash_table(table);
+        done += batch;
+    }
+    return elapsed;
+}
+
+// --- Cache ---
+
+static void fill_cache_keys(size_t items)
+{
+    clear_cache();
+    for (size_t i = 0; i < items; i++) add_to_cache(keys[i], "value");
+}
+
+// Inserts of new keys into a full cache, so every one evicts the LRU entry
+static uint64_t bench_add_evicting(Case *c, size_t ops)
+{
+    static size_t next_key = 0;
+    char key[32];
+    (void)c;
+    fill_cache_keys(CACHE_SIZE);
+    struct timespec start;
+    command_timer_start(&start);
+    for (size_t i = 0; i < ops; i++)
+    {
+        format_key(key, sizeof(key), BENCH_KEYS + next_key++);
+        add_to_cache(key, "value");
+    }
+    return timer_elapsed_ns(&start);
+}
+
+typedef struct {
+    pthread_barrier_t *barrier;
+    size_t ops;
+    size_t first;
+    uint64_t elapsed;
+} CacheReader;
+
+static void *cache_reader(void *arg)
+{
+    CacheReader *r = arg;
+    unsigned int hits = 0;
+    pthread_barrier_wait(r->barrier);
+    struct timespec start;
+    command_timer_start(&start);
+    for (size_t i = 0; i < r->ops; i++) hits += get_from_cache(keys[(r->first + i) % CACHE_SIZE]) != NULL;
+    r->elapsed = timer_elapsed_ns(&start);
+    sink = hits;
+    return NULL;
+}
+
+// Hits on a full cache from `threads` threads at once. The time is the
+// slowest thread's, so the result is wall time per operation overall.
+static uint64_t bench_get_threads(Case *c, size_t ops)
+{
+    if (!c->table)
+    {
+        fill_cache_keys(CACHE_SIZE);
+        c->table = memory_cache; // Marks the cache as filled for this case
+    }
+    pthread_t ids[BENCH_MAX_THREADS];
+    CacheReader readers[BENCH_MAX_THREADS];
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, NULL, (unsigned)c->threads);
+    int started = 0;
+    for (; started < c->threads; started++)
+    {
+        readers[started] = (CacheReader){&barrier, ops / (size_t)c->threads + 1, (size_t)started * 997, 0};
+        if (pthread_create(&ids[started], NULL, cache_reader, &readers[started]) != 0) break;
+    }
+    if (started < c->threads)
+    {
+        fprintf(stderr, "zu-bench: could not start %d threads\n", c->threads);
+        exit(EXIT_FAILURE);
+    }
+    uint64_t elapsed = 0;
+    for (int i = 0; i < started; i++)
+    {
+        pthread_join(ids[i], NULL);
+        if (readers[i].elapsed > elapsed) elapsed = readers[i].elapsed;
+    }
+    pthread_barrier_destroy(&barrier);
+    return elapsed;
+}
+
+// --- Harness ---
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double median(double *values, int count)
+{
+    qsort(values, (size_t)count, sizeof(double), compare_doubles);
+    return count % 2 ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2;
+}
+
+static CaseResult run_case(Case *c, int warmup, int reps)
+{
+    CaseResult result = {.reps = reps};
+
+    // Calibrate: double the operation count until one repetition is long enough
+    size_t ops = 64;
+    while (c->run(c, ops) < BENCH_TARGET_NS / 4 && ops < ((size_t)1 << 34)) ops *= 2;
+    ops *= 4;
+    result.ops = ops;
+
+    for (int i = 0; i < warmup; i++) c->run(c, ops);
+    double *samples = malloc((size_t)reps * sizeof(double));
+    double *deviations = malloc((size_t)reps * sizeof(double));
+    if (!samples || !deviations)
+    {
+        perror("zu-bench");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < reps; i++) samples[i] = (double)c->run(c, ops) / (double)ops;
+
+    result.median_ns = median(samples, reps);
+    result.min_ns = samples[0]; // Sorted by median()
+    for (int i = 0; i < reps; i++)
+    {
+        double d = samples[i] - result.median_ns;
+        deviations[i] = d < 0 ? -d : d;
+    }
+    result.mad_ns = median(deviations, reps);
+    free(samples);
+    free(deviations);
+    return result;
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "Usage: zu-bench [options]\n"
+            "       zu-bench compare [-t percent] [-s sigmas] base.json new.json\n"
+            "  -f format      csv (default) or json\n"
+            "  -o file        Also write the JSON results to a file\n"
+            "  -r reps        Measured repetitions per case (default 11)\n"
+            "  -w warmup      Unmeasured repetitions first (default 2)\n"
+            "  -t threads     Most get_from_cache threads (default 8)\n"
+            "  -b filter      Only cases whose name contains this\n");
+}
+
+// Exit status 0 without regressions, 1 with, 2 if the files are unusable
+static int compare(int argc, char **argv)
+{
+    double threshold = 5.0, sigmas = 3.0;
+    int option;
+    while ((option = getopt(argc, argv, "t:s:")) != -1)
+    {
+        switch (option)
+        {
+        case 't': threshold = atof(optarg); break;
+        case 's': sigmas = atof(optarg); break;
+        default: usage(); return 2;
+        }
+    }
+    if (argc - optind != 2 || threshold < 0 || sigmas < 0)
+    {
+        usage();
+        return 2;
+    }
+    int regressions = bench_report_compare(argv[optind], argv[optind + 1], threshold, sigmas, stdout);
+    return regressions < 0 ? 2 : regressions > 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "compare") == 0) return compare(argc - 1, argv + 1);
+
+    int json = 0, reps = 11, warmup = 2, max_threads = 8;
+    const char *filter = NULL, *json_path = NULL;
+    int option;
+    while ((option = getopt(argc, argv, "f:o:r:w:t:b:")) != -1)
+    {
+        switch (option)
+        {
+        case 'f':
+            if (strcmp(optarg, "json") == 0) json = 1;
+            else if (strcmp(optarg, "csv") != 0)
+            {
+                usage();
+                return 2;
+            }
+            break;
+        case 'o': json_path = optarg; break;
+        case 'r': reps = atoi(optarg); break;
+        case 'w': warmup = atoi(optarg); break;
+        case 't': max_threads = atoi(optarg); break;
+        case 'b': filter = optarg; break;
+        default: usage(); return 2;
+        }
+    }
+    if (optind != argc || reps < 1 || warmup < 0 || max_threads < 1 || max_threads > BENCH_MAX_THREADS)
+    {
+        usage();
+        return 2;
+    }
+
+    for (size_t i = 0; i < BENCH_KEYS; i++) format_key(keys[i], sizeof(keys[i]), i);
+    init_cache();
+
+    // Table sizes stay within CACHE_SIZE: hash_table_insert evicts beyond it
+    static const size_t sizes[] = {100, CACHE_SIZE};
+    static const double loads[] = {0.5, 1.0, 4.0}; // Items per bucket
+    Case cases[64];
+    int count = 0;
+    cases[count++] = (Case){.name = "hash_function", .run = bench_hash_function, .buckets = CACHE_SIZE};
+    bench_fn table_fns[] = {bench_insert, bench_search, bench_remove};
+    const char *table_names[] = {"hash_table_insert", "hash_table_search", "hash_table_remove"};
+    for (int f = 0; f < 3; f++)
+    {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+        {
+            for (size_t l = 0; l < sizeof(loads) / sizeof(loads[0]); l++)
+            {
+                Case *c = &cases[count++];
+                *c = (Case){.name = table_names[f], .run = table_fns[f], .items = sizes[s]};
+                c->buckets = (size_t)(sizes[s] / loads[l]);
+                snprintf(c->params, sizeof(c->params), "items=%zu;load=%.1f", c->items, loads[l]);
+            }
+        }
+    }
+    cases[count] = (Case){.name = "add_to_cache_evicting", .run = bench_add_evicting, .items = CACHE_SIZE};
+    snprintf(cases[count].params, sizeof(cases[count].params), "items=%d", CACHE_SIZE);
+    count++;
+    for (int threads = 1; threads <= max_threads; threads *= 2)
+    {
+        Case *c = &cases[count++];
+        *c = (Case){.name = "get_from_cache", .run = bench_get_threads, .items = CACHE_SIZE, .threads = threads};
+        snprintf(c->params, sizeof(c->params), "items=%d;threads=%d", CACHE_SIZE, threads);
+    }
+
+    BenchReport report = {0};
+    if (json) json_path = "-";
+    if (json_path && !bench_report_open(&report, json_path, "zu-bench"))
+    {
+        perror(json_path);
+        return 1;
+    }
+    if (!json) printf("benchmark,params,reps,ops_per_rep,median_ns,mad_ns,min_ns,ops_per_sec\n");
+    for (int i = 0; i < count; i++)
+    {
+        Case *c = &cases[i];
+        if (filter && !strstr(c->name, filter)) continue;
+        CaseResult r = run_case(c, warmup, reps);
+        if (c->table && c->table != memory_cache) free_hash_table(c->table);
+        c->table = NULL;
+
+        // The median and min share the MAD as their noise estimate
+        bench_report_metric(&report, c->name, c->params, "median_ns", r.median_ns, r.mad_ns, 1);
+        bench_report_metric(&report, c->name, c->params, "min_ns", r.min_ns, r.mad_ns, 1);
+        if (!json)
+        {
+            printf("%s,%s,%d,%zu,%.3f,%.3f,%.3f,%.0f\n", c->name, c->params, r.reps, r.ops, r.median_ns,
+                   r.mad_ns, r.min_ns, r.median_ns > 0 ? 1e9 / r.median_ns : 0);
+            fflush(stdout);
+        }
+    }
+    free_cache();
+    if (json_path && !bench_report_close(&report))
+    {
+        fprintf(stderr, "zu-bench: could not write %s\n", json_path);
+        return 1;
+    }
+    return 0;
+}
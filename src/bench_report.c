@@ -0,0 +1,320 @@
+#include "bench_report.h"
+#include "json.h"
+#include "version.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+
+// Both set by the Makefile when this file is compiled
+#ifndef ZU_GIT_COMMIT
+#define ZU_GIT_COMMIT "unknown"
+#endif
+#ifndef ZU_BUILD_CFLAGS
+#define ZU_BUILD_CFLAGS "unknown"
+#endif
+
+static void write_string(FILE *out, const char *s)
+{
+    size_t len;
+    char *escaped = json_escape(s ? s : "", s ? strlen(s) : 0, &len);
+    fputc('"', out);
+    if (escaped) fwrite(escaped, 1, len, out);
+    fputc('"', out);
+    free(escaped);
+}
+
+static void write_field(FILE *out, const char *name, const char *value)
+{
+    fprintf(out, "\"%s\":", name);
+    write_string(out, value);
+    fputc(',', out);
+}
+
+// The "model name" line of /proc/cpuinfo, or "unknown"
+static void cpu_model(char *model, size_t size)
+{
+    snprintf(model, size, "unknown");
+    FILE *cpuinfo = fopen("/proc/cpuinfo", "r");
+    if (!cpuinfo) return;
+    char line[256];
+    while (fgets(line, sizeof(line), cpuinfo))
+    {
+        char *colon = strchr(line, ':');
+        if (strncmp(line, "model name", 10) != 0 || !colon) continue;
+        colon += 1 + (colon[1] == ' ');
+        colon[strcspn(colon, "\n")] = '\0';
+        snprintf(model, size, "%s", colon);
+        break;
+    }
+    fclose(cpuinfo);
+}
+
+int bench_report_open(BenchReport *report, const char *path, const char *tool)
+{
+    report->results = 0;
+    report->out = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    if (!report->out) return 0;
+
+    char cpu[128], kernel[200], timestamp[32];
+    struct utsname host;
+    cpu_model(cpu, sizeof(cpu));
+    if (uname(&host) == 0) snprintf(kernel, sizeof(kernel), "%s %s %s", host.sysname, host.release, host.machine);
+    else snprintf(kernel, sizeof(kernel), "unknown");
+    time_t now = time(NULL);
+    struct tm utc;
+    gmtime_r(&now, &utc);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", &utc);
+
+    FILE *out = report->out;
+    fputc('{', out);
+    write_field(out, "tool", tool);
+    write_field(out, "version", ZU_VERSION);
+    write_field(out, "commit", ZU_GIT_COMMIT);
+#if defined(__GNUC__) && !defined(__clang__)
+    write_field(out, "compiler", "gcc " __VERSION__);
+#elif defined(__VERSION__)
+    write_field(out, "compiler", __VERSION__);
+#else
+    write_field(out, "compiler", "unknown");
+#endif
+    write_field(out, "cflags", ZU_BUILD_CFLAGS);
+    write_field(out, "cpu", cpu);
+    fprintf(out, "\"cpus\":%ld,", sysconf(_SC_NPROCESSORS_ONLN));
+    write_field(out, "kernel", kernel);
+    write_field(out, "timestamp", timestamp);
+    fprintf(out, "\"results\":[");
+    return 1;
+}
+
+void bench_report_metric(BenchReport *report, const char *benchmark, const char *params, const char *metric,
+                         double value, double noise, int lower_is_better)
+{
+    if (!report->out || !isfinite(value)) return;
+    FILE *out = report->out;
+    fprintf(out, "%s\n  {\"benchmark\":", report->results++ ? "," : "");
+    write_string(out, benchmark);
+    fprintf(out, ",\"params\":");
+    write_string(out, params);
+    fprintf(out, ",\"metric\":\"%s\",\"value\":%.10g,\"noise\":%.10g,\"better\":\"%s\"}", metric, value,
+            isfinite(noise) ? noise : 0.0, lower_is_better ? "lower" : "higher");
+}
+
+void bench_report_latency(BenchReport *report, const char *benchmark, const char *params, uint64_t count,
+                          double seconds, const LatencyHistogram *h)
+{
+    if (seconds > 0) bench_report_metric(report, benchmark, params, "ops_per_sec", count / seconds, 0, 0);
+    if (h->count == 0) return;
+    bench_report_metric(report, benchmark, params, "avg_us", h->sum_ns / 1000.0 / h->count, 0, 1);
+    bench_report_metric(report, benchmark, params, "p50_us", histogram_percentile(h, 50.0) / 1000.0, 0, 1);
+    bench_report_metric(report, benchmark, params, "p99_us", histogram_percentile(h, 99.0) / 1000.0, 0, 1);
+    bench_report_metric(report, benchmark, params, "p999_us", histogram_percentile(h, 99.9) / 1000.0, 0, 1);
+    bench_report_metric(report, benchmark, params, "max_us", h->max_ns / 1000.0, 0, 1);
+}
+
+int bench_report_close(BenchReport *report)
+{
+    if (!report->out) return 0;
+    fprintf(report->out, "\n]}\n");
+    int ok = !ferror(report->out);
+    if (report->out == stdout) ok = fflush(stdout) == 0 && ok;
+    else ok = fclose(report->out) == 0 && ok;
+    report->out = NULL;
+    return ok;
+}
+
+// --- Comparison ---
+
+typedef struct {
+    char *benchmark;
+    char *params;
+    char *metric;
+    double value;
+    double noise;
+    int lower_is_better;
+    int matched;
+} ResultEntry;
+
+typedef struct {
+    char *fields[6]; // tool, commit, compiler, cflags, cpu, kernel
+    ResultEntry *entries;
+    size_t count;
+    size_t capacity;
+} ResultFile;
+
+static const char *const environment_names[] = {"tool", "commit", "compiler", "cflags", "cpu", "kernel"};
+static const char *const result_names[] = {"benchmark", "params", "metric", "value", "noise", "better"};
+
+static int collect_result(size_t array, char **values, void *ctx)
+{
+    ResultFile *file = ctx;
+    (void)array;
+    if (!values[0] || !values[2] || !values[3]) return 0;
+    if (file->count == file->capacity)
+    {
+        size_t capacity = file->capacity ? file->capacity * 2 : 64;
+        ResultEntry *entries = realloc(file->entries, capacity * sizeof(ResultEntry));
+        if (!entries) return 0;
+        file->entries = entries;
+        file->capacity = capacity;
+    }
+    ResultEntry *e = &file->entries[file->count];
+    e->benchmark = strdup(values[0]);
+    e->params = strdup(values[1] ? values[1] : "");
+    e->metric = strdup(values[2]);
+    e->value = strtod(values[3], NULL);
+    e->noise = values[4] ? fabs(strtod(values[4], NULL)) : 0;
+    e->lower_is_better = !values[5] || strcmp(values[5], "higher") != 0;
+    e->matched = 0;
+    if (!e->benchmark || !e->params || !e->metric)
+    {
+        free(e->benchmark);
+        free(e->params);
+        free(e->metric);
+        return 0;
+    }
+    file->count++;
+    return 1;
+}
+
+static void free_result_file(ResultFile *file)
+{
+    for (size_t i = 0; i < 6; i++) free(file->fields[i]);
+    for (size_t i = 0; i < file->count; i++)
+    {
+        free(file->entries[i].benchmark);
+        free(file->entries[i].params);
+        free(file->entries[i].metric);
+    }
+    free(file->entries);
+}
+
+static int load_result_file(const char *path, ResultFile *file)
+{
+    memset(file, 0, sizeof(*file));
+    FILE *in = fopen(path, "rb");
+    if (!in)
+    {
+        perror(path);
+        return 0;
+    }
+    char *body = NULL;
+    size_t len = 0;
+    int ok = fseek(in, 0, SEEK_END) == 0;
+    long size = ok ? ftell(in) : -1;
+    if (size >= 0 && fseek(in, 0, SEEK_SET) == 0 && (body = malloc((size_t)size + 1)))
+    {
+        len = fread(body, 1, (size_t)size, in);
+        body[len] = '\0';
+    }
+    fclose(in);
+    if (!body) return 0;
+
+    static const char *const arrays[] = {"results"};
+    ok = json_parse_fields(body, len, environment_names, file->fields, 6) == JSON_OK && file->fields[0] &&
+         json_parse_object_arrays(body, len, arrays, 1, result_names, 6, collect_result, file) == JSON_OK;
+    free(body);
+    if (!ok)
+    {
+        fprintf(stderr, "%s: not a benchmark result file\n", path);
+        free_result_file(file);
+    }
+    return ok;
+}
+
+static const char *field(const ResultFile *file, size_t i)
+{
+    return file->fields[i] ? file->fields[i] : "unknown";
+}
+
+static ResultEntry *find_entry(ResultFile *file, const ResultEntry *like)
+{
+    for (size_t i = 0; i < file->count; i++)
+    {
+        ResultEntry *e = &file->entries[i];
+        if (!e->matched && strcmp(e->benchmark, like->benchmark) == 0 && strcmp(e->params, like->params) == 0 &&
+            strcmp(e->metric, like->metric) == 0)
+        {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static void print_name(FILE *out, const ResultEntry *e)
+{
+    char name[96];
+    if (e->params[0]) snprintf(name, sizeof(name), "%s[%s]", e->benchmark, e->params);
+    else snprintf(name, sizeof(name), "%s", e->benchmark);
+    fprintf(out, "  %-44s %-12s", name, e->metric);
+}
+
+int bench_report_compare(const char *base_path, const char *new_path, double threshold_pct, double sigmas,
+                         FILE *out)
+{
+    ResultFile base, current;
+    if (!load_result_file(base_path, &base)) return -1;
+    if (!load_result_file(new_path, &current))
+    {
+        free_result_file(&base);
+        return -1;
+    }
+
+    fprintf(out, "base: %s, commit %s, %s\n", field(&base, 0), field(&base, 1), field(&base, 4));
+    fprintf(out, "new:  %s, commit %s, %s\n", field(&current, 0), field(&current, 1), field(&current, 4));
+    static const char *const must_match[] = {"compiler", "cflags", "cpu", "kernel"};
+    for (size_t i = 2; i < 6; i++)
+    {
+        if (strcmp(field(&base, i), field(&current, i)) != 0)
+        {
+            fprintf(out, "warning: the runs differ in %s, so the deltas are not only the code\n", must_match[i - 2]);
+        }
+    }
+    fprintf(out, "\n  %-44s %-12s %12s %12s %9s  %s\n", "benchmark", "metric", "base", "new", "delta", "verdict");
+
+    int regressions = 0;
+    for (size_t i = 0; i < current.count; i++)
+    {
+        ResultEntry *now = &current.entries[i];
+        ResultEntry *was = find_entry(&base, now);
+        print_name(out, now);
+        if (!was)
+        {
+            fprintf(out, " %12s %12.4g %9s  new\n", "-", now->value, "");
+            continue;
+        }
+        was->matched = 1;
+
+        double change = now->value - was->value;
+        double pct = 0;
+        if (was->value != 0) pct = 100.0 * change / fabs(was->value);
+        else if (change != 0) pct = copysign(HUGE_VAL, change);
+        double worse_pct = now->lower_is_better ? pct : -pct; // Positive when the change is for the worse
+        double noise = sigmas * sqrt(was->noise * was->noise + now->noise * now->noise);
+        const char *verdict;
+        if (fabs(change) <= noise || change == 0) verdict = "noise";
+        else if (worse_pct < 0) verdict = "better";
+        else if (worse_pct <= threshold_pct) verdict = "worse";
+        else
+        {
+            verdict = "REGRESSION";
+            regressions++;
+        }
+        fprintf(out, " %12.4g %12.4g %+8.1f%%  %s\n", was->value, now->value, pct, verdict);
+    }
+    for (size_t i = 0; i < base.count; i++)
+    {
+        if (base.entries[i].matched) continue;
+        print_name(out, &base.entries[i]);
+        fprintf(out, " %12.4g %12s %9s  missing\n", base.entries[i].value, "-", "");
+    }
+    fprintf(out, "\n%d regression%s worse than %.1f%% beyond %.1f sigma of noise\n", regressions,
+            regressions == 1 ? "" : "s", threshold_pct, sigmas);
+
+    free_result_file(&base);
+    free_result_file(&current);
+    return regressions;
+}
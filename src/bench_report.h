@@ -0,0 +1,49 @@
+#ifndef BENCH_REPORT_H
+#define BENCH_REPORT_H
+
+#include "timer.h"  // For LatencyHistogram
+#include <stdio.h>
+#include <stdint.h>
+
+// Machine-readable benchmark results, shared by every benchmark mode (the
+// benchmark and benchmark_misses commands, zu-bench and zu-loadgen):
+//
+//   {"tool":"zu-bench","version":"...","commit":"...","compiler":"...",
+//    "cflags":"...","cpu":"...","cpus":8,"kernel":"...","timestamp":"...",
+//    "results":[{"benchmark":"hash_table_search","params":"items=100",
+//                "metric":"ns_per_op","value":35.4,"noise":0.06,"better":"lower"}]}
+//
+// The environment sits at the top level, and results are flat objects, one
+// per metric. "noise" estimates the metric's run-to-run spread (zu-bench
+// reports the median absolute deviation of its repetitions; single runs
+// report 0).
+
+typedef struct {
+    FILE *out;
+    int results; // Results written so far
+} BenchReport;
+
+// Open `path` ("-" for stdout) and write the environment of `tool`.
+// Returns 0 if the file cannot be created.
+int bench_report_open(BenchReport *report, const char *path, const char *tool);
+
+void bench_report_metric(BenchReport *report, const char *benchmark, const char *params, const char *metric,
+                         double value, double noise, int lower_is_better);
+
+// Throughput and average, p50, p99, p99.9 and maximum latency of `count`
+// operations timed into `h` over `seconds`
+void bench_report_latency(BenchReport *report, const char *benchmark, const char *params, uint64_t count,
+                          double seconds, const LatencyHistogram *h);
+
+// Finish the document. Returns 0 if anything failed to be written.
+int bench_report_close(BenchReport *report);
+
+// Compare two result files metric by metric and print the deltas to `out`.
+// A change counts only when it exceeds `sigmas` times the combined noise of
+// both sides, and is a regression when it is also worse by more than
+// `threshold_pct` percent. Returns the number of regressions, or -1 if a file
+// cannot be read or parsed.
+int bench_report_compare(const char *base_path, const char *new_path, double threshold_pct, double sigmas,
+                         FILE *out);
+
+#endif // BENCH_REPORT_H
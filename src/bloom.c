@@ -0,0 +1,371 @@
+#include "bloom.h"
+#include "config.h"
+#include "ds.h"
+#include "io.h"
+#include "metrics.h"
+#include "utils.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#define BLOCK_BITS 512 // One cache line
+#define BLOCK_WORDS (BLOCK_BITS / 64)
+#define FILTER_MAGIC 0x5A554231u // "ZUB1"
+#define FILTER_HEADER 24         // Magic (4), probes (4), keys (8), blocks (8)
+#define SIDECAR_HEADER 40        // dev, ino, size, mtime seconds, mtime nanoseconds (8 each)
+
+struct BloomFilter {
+    uint64_t *blocks; // BLOCK_WORDS words per block
+    size_t block_count;
+    size_t keys;
+    uint32_t probes;
+};
+
+static BloomFilter *bloom_alloc(size_t block_count, uint32_t probes)
+{
+    BloomFilter *filter = calloc(1, sizeof(BloomFilter));
+    if (!filter) return NULL;
+    filter->blocks = aligned_alloc(64, block_count * BLOCK_BITS / 8);
+    if (!filter->blocks)
+    {
+        free(filter);
+        return NULL;
+    }
+    memset(filter->blocks, 0, block_count * BLOCK_BITS / 8);
+    filter->block_count = block_count;
+    filter->probes = probes;
+    return filter;
+}
+
+BloomFilter *bloom_new(size_t expected_keys)
+{
+    size_t bits = expected_keys * BLOOM_BITS_PER_KEY;
+    size_t block_count = bits / BLOCK_BITS + 1;
+    uint32_t probes = (BLOOM_BITS_PER_KEY * 69 + 50) / 100; // bits per key * ln 2
+    return bloom_alloc(block_count, probes ? probes : 1);
+}
+
+void bloom_free(BloomFilter *filter)
+{
+    if (!filter) return;
+    free(filter->blocks);
+    free(filter);
+}
+
+// FNV-1a spreads short keys poorly in the high bits; finish with a 64-bit mixer
+static uint64_t key_hash(const char *key)
+{
+    uint64_t h = hash_content(key, strlen(key));
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// The high half picks the block, the low half seeds the probes inside it
+static uint64_t *key_block(const BloomFilter *filter, uint64_t h)
+{
+    size_t block = (size_t)(((h >> 32) * (uint64_t)filter->block_count) >> 32);
+    return filter->blocks + block * BLOCK_WORDS;
+}
+
+void bloom_add(BloomFilter *filter, const char *key)
+{
+    uint64_t h = key_hash(key);
+    uint64_t *block = key_block(filter, h);
+    uint32_t a = (uint32_t)h;
+    uint32_t b = (uint32_t)(h >> 41) | 1;
+    for (uint32_t i = 0; i < filter->probes; i++)
+    {
+        uint32_t bit = (a + i * b) % BLOCK_BITS;
+        block[bit / 64] |= 1ULL << (bit % 64);
+    }
+    filter->keys++;
+}
+
+int bloom_may_contain(const BloomFilter *filter, const char *key)
+{
+    uint64_t h = key_hash(key);
+    const uint64_t *block = key_block(filter, h);
+    uint32_t a = (uint32_t)h;
+    uint32_t b = (uint32_t)(h >> 41) | 1;
+    for (uint32_t i = 0; i < filter->probes; i++)
+    {
+        uint32_t bit = (a + i * b) % BLOCK_BITS;
+        if (!(block[bit / 64] & (1ULL << (bit % 64)))) return 0;
+    }
+    return 1;
+}
+
+size_t bloom_bits(const BloomFilter *filter)
+{
+    return filter->block_count * BLOCK_BITS;
+}
+
+size_t bloom_keys(const BloomFilter *filter)
+{
+    return filter->keys;
+}
+
+size_t bloom_encoded_size(const BloomFilter *filter)
+{
+    return FILTER_HEADER + filter->block_count * BLOCK_BITS / 8;
+}
+
+void bloom_encode(const BloomFilter *filter, char *out)
+{
+    uint32_t magic = FILTER_MAGIC;
+    uint64_t keys = filter->keys;
+    uint64_t block_count = filter->block_count;
+    memcpy(out, &magic, 4);
+    memcpy(out + 4, &filter->probes, 4);
+    memcpy(out + 8, &keys, 8);
+    memcpy(out + 16, &block_count, 8);
+    memcpy(out + FILTER_HEADER, filter->blocks, block_count * BLOCK_BITS / 8);
+}
+
+BloomFilter *bloom_decode(const char *data, size_t len)
+{
+    uint32_t magic, probes;
+    uint64_t keys, block_count;
+    if (len < FILTER_HEADER) return NULL;
+    memcpy(&magic, data, 4);
+    memcpy(&probes, data + 4, 4);
+    memcpy(&keys, data + 8, 8);
+    memcpy(&block_count, data + 16, 8);
+    if (magic != FILTER_MAGIC || probes == 0 || probes > BLOCK_BITS || block_count == 0 ||
+        block_count != (len - FILTER_HEADER) / (BLOCK_BITS / 8) || (len - FILTER_HEADER) % (BLOCK_BITS / 8) != 0)
+    {
+        return NULL;
+    }
+    BloomFilter *filter = bloom_alloc((size_t)block_count, probes);
+    if (!filter) return NULL;
+    memcpy(filter->blocks, data + FILTER_HEADER, len - FILTER_HEADER);
+    filter->keys = (size_t)keys;
+    return filter;
+}
+
+void bloom_track(const BloomFilter *filter)
+{
+    if (!filter) return;
+    metrics_gauge_add(GAUGE_BLOOM_BITS, (int64_t)bloom_bits(filter));
+    metrics_gauge_add(GAUGE_BLOOM_KEYS, (int64_t)filter->keys);
+}
+
+void bloom_untrack(const BloomFilter *filter)
+{
+    if (!filter) return;
+    metrics_gauge_add(GAUGE_BLOOM_BITS, -(int64_t)bloom_bits(filter));
+    metrics_gauge_add(GAUGE_BLOOM_KEYS, -(int64_t)filter->keys);
+}
+
+// --- Single-file engine ---
+
+typedef struct {
+    uint64_t dev;
+    uint64_t ino;
+    int64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+} Generation;
+
+static pthread_rwlock_t file_filter_lock = PTHREAD_RWLOCK_INITIALIZER;
+static _Atomic int file_filter_enabled = 1;
+static BloomFilter *file_filter;
+static Generation file_generation;
+
+static Generation generation_of(const struct stat *st)
+{
+    struct timespec mtime = stat_mtime(st);
+    return (Generation){(uint64_t)st->st_dev, (uint64_t)st->st_ino, (int64_t)st->st_size,
+                        (int64_t)mtime.tv_sec, (int64_t)mtime.tv_nsec};
+}
+
+static int same_generation(const Generation *a, const Generation *b)
+{
+    return a->dev == b->dev && a->ino == b->ino && a->size == b->size &&
+           a->mtime_sec == b->mtime_sec && a->mtime_nsec == b->mtime_nsec;
+}
+
+static void sidecar_path(char *path, size_t size, const char *suffix)
+{
+    snprintf(path, size, "%s.bloom%s", FILENAME, suffix);
+}
+
+// Make `filter` the file filter for `generation`. Called with file_filter_lock held exclusively.
+static void set_file_filter(BloomFilter *filter, const Generation *generation)
+{
+    bloom_untrack(file_filter);
+    bloom_free(file_filter);
+    file_filter = filter;
+    file_generation = *generation;
+    bloom_track(filter);
+}
+
+static int write_sidecar(const BloomFilter *filter, const Generation *generation)
+{
+    char path[4096], tmp_path[4096];
+    sidecar_path(path, sizeof(path), "");
+    sidecar_path(tmp_path, sizeof(tmp_path), ".tmp");
+
+    size_t len = SIDECAR_HEADER + bloom_encoded_size(filter);
+    char *data = malloc(len);
+    FILE *file = data ? fopen(tmp_path, "wb") : NULL;
+    if (!file)
+    {
+        free(data);
+        return 0;
+    }
+    memcpy(data, generation, SIDECAR_HEADER);
+    bloom_encode(filter, data + SIDECAR_HEADER);
+    int ok = fwrite(data, 1, len, file) == len && fflush(file) == 0;
+#if WRITER_FSYNC
+    ok = ok && io_fsync(file) == 0;
+#endif
+    if (fclose(file) != 0) ok = 0;
+    free(data);
+    ok = ok && rename(tmp_path, path) == 0;
+    if (!ok) unlink(tmp_path);
+    return ok;
+}
+
+static BloomFilter *read_sidecar(const Generation *generation)
+{
+    char path[4096];
+    sidecar_path(path, sizeof(path), "");
+    FILE *file = fopen(path, "rb");
+    if (!file) return NULL;
+
+    BloomFilter *filter = NULL;
+    Generation stored;
+    struct stat st;
+    if (fread(&stored, 1, SIDECAR_HEADER, file) == SIDECAR_HEADER && same_generation(&stored, generation) &&
+        fstat(fileno(file), &st) == 0 && st.st_size > SIDECAR_HEADER)
+    {
+        size_t len = (size_t)st.st_size - SIDECAR_HEADER;
+        char *data = malloc(len);
+        if (data && fread(data, 1, len, file) == len) filter = bloom_decode(data, len);
+        free(data);
+    }
+    fclose(file);
+    return filter;
+}
+
+// Two passes over a file the writer did not produce: count, then add
+static BloomFilter *build_from_file(FILE *file)
+{
+    char *key = NULL;
+    char *value = NULL;
+    size_t count = 0;
+    int result;
+    rewind(file);
+    while ((result = read_item_from_file(file, &key, &value)) > 0)
+    {
+        count++;
+        free(key);
+        free(value);
+    }
+    BloomFilter *filter = result == 0 ? bloom_new(count) : NULL;
+
+    rewind(file);
+    while (filter && (result = read_item_from_file(file, &key, &value)) > 0)
+    {
+        bloom_add(filter, key);
+        free(key);
+        free(value);
+    }
+    if (filter && result != 0)
+    {
+        bloom_free(filter);
+        filter = NULL;
+    }
+    long bytes = ftell(file);
+    if (bytes > 0) metrics_add(METRIC_DISK_BYTES_READ, 2 * (uint64_t)bytes);
+    rewind(file);
+    return filter;
+}
+
+int bloom_file_save(const BloomFilter *filter, const char *tmp_path)
+{
+    // rename() keeps the inode, size and mtime, so the generation can be taken now
+    struct stat st;
+    if (stat(tmp_path, &st) != 0) return 0;
+    Generation generation = generation_of(&st);
+    return write_sidecar(filter, &generation);
+}
+
+void bloom_file_install(BloomFilter *filter)
+{
+    struct stat st;
+    if (stat(FILENAME, &st) != 0)
+    {
+        bloom_free(filter);
+        return;
+    }
+    Generation generation = generation_of(&st);
+    pthread_rwlock_wrlock(&file_filter_lock);
+    set_file_filter(filter, &generation);
+    pthread_rwlock_unlock(&file_filter_lock);
+}
+
+// Install a filter built for `generation` unless the database has moved on
+// since, or another reader got there first. Takes ownership of `filter`.
+static void install_if_current(BloomFilter *filter, const Generation *generation)
+{
+    struct stat st;
+    pthread_rwlock_wrlock(&file_filter_lock);
+    // Under the lock, the writer cannot rename a newer file and install its
+    // filter between this stat and set_file_filter
+    if (stat(FILENAME, &st) == 0)
+    {
+        Generation current = generation_of(&st);
+        if (same_generation(&current, generation) &&
+            !(file_filter && same_generation(&file_generation, generation)))
+        {
+            set_file_filter(filter, generation);
+            filter = NULL;
+        }
+    }
+    pthread_rwlock_unlock(&file_filter_lock);
+    bloom_free(filter);
+}
+
+void bloom_file_enable(int enabled)
+{
+    atomic_store_explicit(&file_filter_enabled, enabled, memory_order_relaxed);
+}
+
+int bloom_file_check(const char *key, FILE *file, const struct stat *st)
+{
+    if (!atomic_load_explicit(&file_filter_enabled, memory_order_relaxed)) return -1;
+    Generation generation = generation_of(st);
+    int result = -1;
+    pthread_rwlock_rdlock(&file_filter_lock);
+    if (file_filter && same_generation(&file_generation, &generation))
+    {
+        result = bloom_may_contain(file_filter, key);
+    }
+    pthread_rwlock_unlock(&file_filter_lock);
+
+    if (result < 0)
+    {
+        // Loaded or rebuilt without the lock, so other readers keep using the
+        // installed filter meanwhile. Only the writer persists filters, so
+        // nothing races on the sidecar.
+        BloomFilter *filter = read_sidecar(&generation);
+        if (!filter) filter = build_from_file(file);
+        if (filter)
+        {
+            result = bloom_may_contain(filter, key);
+            install_if_current(filter, &generation);
+        }
+    }
+
+    if (result == 0) metrics_inc(METRIC_BLOOM_NEGATIVES);
+    return result;
+}
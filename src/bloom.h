@@ -0,0 +1,48 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <stddef.h> // For size_t
+#include <stdint.h>
+#include <stdio.h>  // For FILE
+#include <sys/stat.h> // For struct stat
+
+// Blocked Bloom filter: every key sets all of its bits inside one 64-byte
+// block, so a lookup touches a single cache line. Sized at BLOOM_BITS_PER_KEY.
+// A negative answer is exact; a positive one is wrong about 1% of the time.
+
+typedef struct BloomFilter BloomFilter;
+
+BloomFilter *bloom_new(size_t expected_keys);
+void bloom_free(BloomFilter *filter);
+void bloom_add(BloomFilter *filter, const char *key);
+int bloom_may_contain(const BloomFilter *filter, const char *key);
+
+size_t bloom_bits(const BloomFilter *filter);
+size_t bloom_keys(const BloomFilter *filter); // Keys added
+
+// Serialized form, for storing a filter inside another file
+size_t bloom_encoded_size(const BloomFilter *filter);
+void bloom_encode(const BloomFilter *filter, char *out);
+BloomFilter *bloom_decode(const char *data, size_t len); // NULL if malformed
+
+// Count a filter towards the zu_bloom_* gauges while it is in use, and stop
+void bloom_track(const BloomFilter *filter);
+void bloom_untrack(const BloomFilter *filter);
+
+// Filter for the single-file engine, persisted in FILENAME.bloom together with
+// the file generation it describes.
+
+// Persist `filter`, built for `tmp_path`, before the caller renames it over the
+// database file; then hand the filter over with bloom_file_install().
+int bloom_file_save(const BloomFilter *filter, const char *tmp_path);
+void bloom_file_install(BloomFilter *filter);
+
+// 0 if `key` is definitely not in the open database `file` (described by `st`),
+// 1 if it may be, -1 if there is no filter to ask. A filter that does not match
+// the file is reloaded from FILENAME.bloom, or rebuilt from `file` if that is
+// stale too. Call with the file locked for reading.
+int bloom_file_check(const char *key, FILE *file, const struct stat *st);
+// While disabled, bloom_file_check() returns -1, so every lookup scans the file
+void bloom_file_enable(int enabled);
+
+#endif // BLOOM_H
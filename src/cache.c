@@ -1,6 +1,8 @@
 #include "cache.h"
 #include "config.h"
 #include "ds.h"
+#include "metrics.h"
+#include "trace.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -9,9 +11,12 @@
 // Definition of global cache variable
 HashTable *memory_cache = NULL;
 
-// Definition of mutex variables
+// Bumped under cache_mutex by every write-side cache update
+static unsigned long write_generation = 0;
+
+// Definition of lock variables
 pthread_mutex_t cache_mutex;
-pthread_mutex_t file_mutex;
+pthread_rwlock_t file_lock;
 
 void init_cache(void)
 {
@@ -21,7 +26,7 @@ void init_cache(void)
 
         // Initialize mutexes for thread safety
         pthread_mutex_init(&cache_mutex, NULL);
-        pthread_mutex_init(&file_mutex, NULL);
+        pthread_rwlock_init(&file_lock, NULL);
     }
 }
 
@@ -34,8 +39,20 @@ void free_cache(void)
 
         // Destroy mutexes
         pthread_mutex_destroy(&cache_mutex);
-        pthread_mutex_destroy(&file_mutex);
+        pthread_rwlock_destroy(&file_lock);
+    }
+}
+
+void clear_cache(void)
+{
+    pthread_mutex_lock(&cache_mutex);
+    if (memory_cache)
+    {
+        free_hash_table(memory_cache);
+        memory_cache = create_hash_table(CACHE_SIZE);
     }
+    write_generation++; // Fills of values read before the clear are dropped
+    pthread_mutex_unlock(&cache_mutex);
 }
 
 // Internal function that assumes mutex is already locked
@@ -45,17 +62,45 @@ static void remove_from_cache_internal(const char *key)
     hash_table_remove(memory_cache, key);
 }
 
-void add_to_cache(const char *key, const char *value)
+// Internal insert; assumes cache_mutex is held
+static void add_to_cache_internal(const char *key, const char *value)
 {
-    pthread_mutex_lock(&cache_mutex);
-    if (memory_cache == NULL) init_cache();
-    hash_table_insert(memory_cache, key, value);
+    if (memory_cache == NULL) return;
+    unsigned int evicted = hash_table_insert(memory_cache, key, value);
+    if (evicted)
+    {
+        metrics_add(METRIC_CACHE_EVICTIONS, evicted);
+        TRACE_EVENT(cache, evict, key, evicted); // Made room for `key`
+    }
     // Update last_accessed for the item
     DataItem *item = hash_table_search(memory_cache, key);
     if (item) item->last_accessed = (unsigned int)time(NULL);
+}
+
+void add_to_cache(const char *key, const char *value)
+{
+    pthread_mutex_lock(&cache_mutex);
+    if (memory_cache == NULL) init_cache();
+    write_generation++;
+    add_to_cache_internal(key, value);
     pthread_mutex_unlock(&cache_mutex);
 }
 
+void fill_cache(const char *key, const char *value, unsigned long generation)
+{
+    pthread_mutex_lock(&cache_mutex);
+    if (generation == write_generation) add_to_cache_internal(key, value);
+    pthread_mutex_unlock(&cache_mutex);
+}
+
+unsigned long cache_generation(void)
+{
+    pthread_mutex_lock(&cache_mutex);
+    unsigned long generation = write_generation;
+    pthread_mutex_unlock(&cache_mutex);
+    return generation;
+}
+
 DataItem *get_from_cache(const char *key)
 {
     pthread_mutex_lock(&cache_mutex);
@@ -68,18 +113,58 @@ DataItem *get_from_cache(const char *key)
         if (time(NULL) - item->last_accessed > CACHE_TTL) {
             remove_from_cache_internal(key);
             pthread_mutex_unlock(&cache_mutex);
+            metrics_inc(METRIC_CACHE_EXPIRATIONS);
+            metrics_inc(METRIC_CACHE_MISSES);
+            TRACE_EVENT(cache, miss, key, 1); // 1: the entry had expired
             return NULL;
         }
         item->hit_count++;
         item->last_accessed = (unsigned int)time(NULL);
     }
     pthread_mutex_unlock(&cache_mutex);
+    metrics_inc(item ? METRIC_CACHE_HITS : METRIC_CACHE_MISSES);
+    if (item) TRACE_EVENT(cache, hit, key, 0);
+    else TRACE_EVENT(cache, miss, key, 0);
     return item;
 }
 
+int visit_from_cache(const char *key, cache_visitor_t visit, void *ctx)
+{
+    pthread_mutex_lock(&cache_mutex);
+    if (memory_cache == NULL) {
+        pthread_mutex_unlock(&cache_mutex);
+        metrics_inc(METRIC_CACHE_MISSES);
+        TRACE_EVENT(cache, miss, key, 0);
+        return 0;
+    }
+    DataItem *item = hash_table_search(memory_cache, key);
+    if (!item) {
+        pthread_mutex_unlock(&cache_mutex);
+        metrics_inc(METRIC_CACHE_MISSES);
+        TRACE_EVENT(cache, miss, key, 0);
+        return 0;
+    }
+    if (time(NULL) - item->last_accessed > CACHE_TTL) {
+        remove_from_cache_internal(key);
+        pthread_mutex_unlock(&cache_mutex);
+        metrics_inc(METRIC_CACHE_EXPIRATIONS);
+        metrics_inc(METRIC_CACHE_MISSES);
+        TRACE_EVENT(cache, miss, key, 1);
+        return 0;
+    }
+    item->hit_count++;
+    item->last_accessed = (unsigned int)time(NULL);
+    visit(item, ctx);
+    pthread_mutex_unlock(&cache_mutex);
+    metrics_inc(METRIC_CACHE_HITS);
+    TRACE_EVENT(cache, hit, key, 0);
+    return 1;
+}
+
 void remove_from_cache(const char *key)
 {
     pthread_mutex_lock(&cache_mutex);
+    write_generation++;
     remove_from_cache_internal(key);
     pthread_mutex_unlock(&cache_mutex);
 }
@@ -11,14 +11,28 @@ extern HashTable *memory_cache;
 // Mutex for protecting cache operations
 extern pthread_mutex_t cache_mutex;
 
-// Mutex for protecting file operations (thread-safe file access)
-extern pthread_mutex_t file_mutex;
+// Guards the database file. Readers share it. The writer thread also takes it
+// shared: it builds the next generation of the file beside the current one and
+// swaps it in with rename(), which readers observe atomically. Only code that
+// rewrites the file in place takes it exclusively.
+extern pthread_rwlock_t file_lock;
 
 // --- Cache Management Function Declarations ---
 void init_cache(void);
 void free_cache(void);
+void clear_cache(void); // Drop every entry, e.g. after switching databases
 void add_to_cache(const char *key, const char *value);
+// Reader-side fill after a disk lookup. Skipped if any write reached the cache
+// since `generation` was taken (see cache_generation), so a value read just
+// before a commit can never overwrite the committed one.
+void fill_cache(const char *key, const char *value, unsigned long generation);
+unsigned long cache_generation(void);
 DataItem *get_from_cache(const char *key);
 void remove_from_cache(const char *key);
 
+// Calls `visit` with the cached item while cache_mutex is held, so the item
+// can be read in place without copying. Returns 1 on a hit, 0 on a miss.
+typedef void (*cache_visitor_t)(const DataItem *item, void *ctx);
+int visit_from_cache(const char *key, cache_visitor_t visit, void *ctx);
+
 #endif // CACHE_H
@@ -4,11 +4,24 @@
 #include "cache.h"
 #include "io.h"
 #include "utils.h"
+#include "timer.h"
+#include "metrics.h"
+#include "writer.h"
+#include "index.h"
+#include "lsm.h"
+#include "slowlog.h"
+#include "trace.h"
+#include "hotkeys.h"
+#include "bloom.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
 #include <stdbool.h> // For bool, true, false
+#include <pthread.h>
+#ifdef __GLIBC__
+#include <malloc.h> // For mallinfo2
+#endif
 
 int zset_command(const char *key_to_set, const char *value_to_set)
 {
@@ -25,15 +38,222 @@ int zset_command(const char *key_to_set, const char *value_to_set)
         return CMD_EMPTY;
     }
 
-    if (update_key_on_disk(key_to_set, value_to_set) < 0)
+    struct timespec start;
+    TRACE_BEGIN(command, "set", key_to_set);
+    command_timer_start(&start);
+    metrics_inc(METRIC_CMD_SET);
+    hotkeys_touch(key_to_set, HOTKEYS_WRITE);
+
+    // The writer updates the cache once the write is durable
+    if (writer_submit(WRITE_SET, key_to_set, value_to_set) < 0)
+    {
+        metrics_inc(METRIC_CMD_ERRORS);
+        TRACE_END(command, "set", key_to_set, CMD_ERROR);
+        return CMD_ERROR;
+    }
+
+    slowlog_check("set", key_to_set, SLOWLOG_WRITE, metrics_record_since(LATENCY_SET, &start));
+    TRACE_END(command, "set", key_to_set, CMD_SUCCESS);
+    return CMD_SUCCESS;
+}
+
+// Run a read-modify-write operation through the writer
+static int execute_write_op(WriteOp *op, metric_counter_t counter, const char *name)
+{
+    if (!ensure_database_exists())
+    {
+        return CMD_ERROR;
+    }
+
+    struct timespec start;
+    TRACE_BEGIN(command, name, op->key);
+    command_timer_start(&start);
+    metrics_inc(counter);
+    hotkeys_touch(op->key, HOTKEYS_WRITE);
+
+    int result = writer_execute(op);
+    int status = CMD_SUCCESS;
+    if (result == WRITE_FAILED)
+    {
+        metrics_inc(METRIC_CMD_ERRORS);
+        status = CMD_ERROR;
+    }
+    else
+    {
+        slowlog_check(name, op->key, SLOWLOG_WRITE, metrics_record_since(LATENCY_SET, &start));
+        if (result == WRITE_NOT_INTEGER) status = CMD_NOT_INTEGER;
+        else if (result == WRITE_SKIPPED) status = CMD_MISMATCH;
+    }
+    TRACE_END(command, name, op->key, status);
+    return status;
+}
+
+int zincr_command(const char *key, long long delta, long long *result)
+{
+    if (!key || strlen(key) == 0) {
+        return CMD_EMPTY;
+    }
+
+    WriteOp op = {WRITE_INCR, key, NULL, NULL, delta, 0, 0};
+    int status = execute_write_op(&op, METRIC_CMD_INCR, "incr");
+    if (status == CMD_SUCCESS && result) *result = op.number;
+    return status;
+}
+
+int zappend_command(const char *key, const char *suffix, long long *new_length)
+{
+    if (!key || !suffix || strlen(key) == 0 || strlen(suffix) == 0) {
+        return CMD_EMPTY;
+    }
+
+    WriteOp op = {WRITE_APPEND, key, suffix, NULL, 0, 0, 0};
+    int status = execute_write_op(&op, METRIC_CMD_APPEND, "append");
+    if (status == CMD_SUCCESS && new_length) *new_length = op.number;
+    return status;
+}
+
+int zcas_command(const char *key, const char *expected, const char *new_value)
+{
+    if (!key || !expected || !new_value || strlen(key) == 0 || strlen(new_value) == 0) {
+        return CMD_EMPTY;
+    }
+
+    WriteOp op = {WRITE_CAS, key, new_value, expected, 0, 0, 0};
+    return execute_write_op(&op, METRIC_CMD_CAS, "cas");
+}
+
+void txn_init(Transaction *txn)
+{
+    memset(txn, 0, sizeof(*txn));
+}
+
+void txn_reset(Transaction *txn)
+{
+    for (size_t i = 0; i < txn->count; i++)
+    {
+        free((char *)txn->ops[i].key);
+        free((char *)txn->ops[i].value);
+        free((char *)txn->ops[i].expected);
+    }
+    for (size_t i = 0; i < txn->watch_count; i++)
+    {
+        free((char *)txn->watches[i].key);
+    }
+    free(txn->ops);
+    free(txn->watches);
+    txn_init(txn);
+}
+
+int txn_queue(Transaction *txn, write_op_t op, const char *key, const char *value,
+              const char *expected, long long delta)
+{
+    if (!key || strlen(key) == 0) {
+        return CMD_EMPTY;
+    }
+    int needs_value = op == WRITE_SET || op == WRITE_APPEND || op == WRITE_CAS;
+    if (needs_value && (!value || strlen(value) == 0)) {
+        return CMD_EMPTY;
+    }
+    if (op == WRITE_CAS && !expected) {
+        return CMD_EMPTY;
+    }
+
+    if (txn->count == txn->capacity)
     {
+        size_t capacity = txn->capacity ? txn->capacity * 2 : 8;
+        WriteOp *grown = realloc(txn->ops, capacity * sizeof(WriteOp));
+        if (!grown) return CMD_ERROR;
+        txn->ops = grown;
+        txn->capacity = capacity;
+    }
+
+    WriteOp *queued = &txn->ops[txn->count];
+    *queued = (WriteOp){op, my_strdup(key), needs_value ? my_strdup(value) : NULL,
+                        op == WRITE_CAS ? my_strdup(expected) : NULL, delta, 0, 0};
+    if (!queued->key || (needs_value && !queued->value) || (op == WRITE_CAS && !queued->expected))
+    {
+        free((char *)queued->key);
+        free((char *)queued->value);
+        free((char *)queued->expected);
         return CMD_ERROR;
     }
+    txn->count++;
+    return CMD_SUCCESS;
+}
 
-    add_to_cache(key_to_set, value_to_set);
+int txn_watch_version(Transaction *txn, const char *key, int exists, uint64_t content_hash)
+{
+    if (!key || strlen(key) == 0) {
+        return CMD_EMPTY;
+    }
+    if (txn->watch_count == txn->watch_capacity)
+    {
+        size_t capacity = txn->watch_capacity ? txn->watch_capacity * 2 : 4;
+        WriteWatch *grown = realloc(txn->watches, capacity * sizeof(WriteWatch));
+        if (!grown) return CMD_ERROR;
+        txn->watches = grown;
+        txn->watch_capacity = capacity;
+    }
+    char *copy = my_strdup(key);
+    if (!copy) return CMD_ERROR;
+    txn->watches[txn->watch_count++] = (WriteWatch){copy, exists, content_hash};
     return CMD_SUCCESS;
 }
 
+static void record_watch_hash(const char *value, size_t value_len, uint64_t content_hash, void *ctx)
+{
+    (void)value;
+    (void)value_len;
+    *(uint64_t *)ctx = content_hash;
+}
+
+int zwatch_command(Transaction *txn, const char *key)
+{
+    uint64_t content_hash = 0;
+    int result = zget_visit_command(key, record_watch_hash, &content_hash);
+    if (result != CMD_SUCCESS && result != CMD_NOT_FOUND) {
+        return result;
+    }
+    return txn_watch_version(txn, key, result == CMD_SUCCESS, content_hash);
+}
+
+int zexec_command(Transaction *txn)
+{
+    if (!ensure_database_exists())
+    {
+        return CMD_ERROR;
+    }
+
+    const char *first_key = txn->count ? txn->ops[0].key : NULL;
+    struct timespec start;
+    TRACE_BEGIN(command, "exec", first_key);
+    command_timer_start(&start);
+    metrics_inc(METRIC_CMD_EXEC);
+    for (size_t i = 0; i < txn->count; i++)
+    {
+        hotkeys_touch(txn->ops[i].key, HOTKEYS_WRITE);
+    }
+
+    int result = writer_transaction(txn->ops, txn->count, txn->watches, txn->watch_count);
+    int status = CMD_SUCCESS;
+    if (result == WRITE_FAILED)
+    {
+        metrics_inc(METRIC_CMD_ERRORS);
+        status = CMD_ERROR;
+    }
+    else
+    {
+        slowlog_check("exec", first_key, SLOWLOG_WRITE, metrics_record_since(LATENCY_SET, &start));
+        if (result != WRITE_APPLIED)
+        {
+            metrics_inc(METRIC_TXN_ABORTS);
+            status = result == WRITE_NOT_INTEGER ? CMD_NOT_INTEGER : CMD_MISMATCH;
+        }
+    }
+    TRACE_END(command, "exec", first_key, status);
+    return status;
+}
+
 int zget_command(const char *key_to_get, char **result_value)
 {
     if (!key_to_get || strlen(key_to_get) == 0) {
@@ -42,33 +262,108 @@ int zget_command(const char *key_to_get, char **result_value)
 
     *result_value = NULL; // Initialize to NULL
 
+    struct timespec start;
+    TRACE_BEGIN(command, "get", key_to_get);
+    command_timer_start(&start);
+    metrics_inc(METRIC_CMD_GET);
+    hotkeys_touch(key_to_get, HOTKEYS_READ);
+
     DataItem *item = get_from_cache(key_to_get);
     if (item)
     {
         *result_value = my_strdup(item->value);
         if (!*result_value) {
+            TRACE_END(command, "get", key_to_get, CMD_ERROR);
             return CMD_ERROR; // Memory allocation failed
         }
+        slowlog_check("get", key_to_get, SLOWLOG_CACHE, metrics_record_since(LATENCY_CACHE_HIT, &start));
+        TRACE_END(command, "get", key_to_get, CMD_SUCCESS);
         return CMD_SUCCESS;
     }
 
     char *value = NULL;
+    unsigned long generation = cache_generation();
     int result = find_key_on_disk(key_to_get, &value);
 
     if (result < 0)
     {
         free(value); // Clean up in case of error
+        metrics_inc(METRIC_CMD_ERRORS);
+        TRACE_END(command, "get", key_to_get, CMD_ERROR);
         return CMD_ERROR;
     }
     else if (result == 0)
     {
         free(value); // Clean up when key not found
+        slowlog_check("get", key_to_get, SLOWLOG_MISS, metrics_record_since(LATENCY_MISS, &start));
+        TRACE_END(command, "get", key_to_get, CMD_NOT_FOUND);
         return CMD_NOT_FOUND;
     }
 
     // Only add to cache if we successfully retrieved the value
-    add_to_cache(key_to_get, value);
+    fill_cache(key_to_get, value, generation);
     *result_value = value;
+    slowlog_check("get", key_to_get, SLOWLOG_DISK, metrics_record_since(LATENCY_DISK_HIT, &start));
+    TRACE_END(command, "get", key_to_get, CMD_SUCCESS);
+    return CMD_SUCCESS;
+}
+
+typedef struct {
+    value_visitor_t visit;
+    void *ctx;
+} ValueVisit;
+
+static void visit_cached_value(const DataItem *item, void *ctx)
+{
+    ValueVisit *v = ctx;
+    v->visit(item->value, strlen(item->value), item->content_hash, v->ctx);
+}
+
+int zget_visit_command(const char *key_to_get, value_visitor_t visit, void *ctx)
+{
+    if (!key_to_get || strlen(key_to_get) == 0) {
+        return CMD_EMPTY;
+    }
+
+    struct timespec start;
+    TRACE_BEGIN(command, "get", key_to_get);
+    command_timer_start(&start);
+    metrics_inc(METRIC_CMD_GET);
+    hotkeys_touch(key_to_get, HOTKEYS_READ);
+
+    ValueVisit v = {visit, ctx};
+    if (visit_from_cache(key_to_get, visit_cached_value, &v))
+    {
+        slowlog_check("get", key_to_get, SLOWLOG_CACHE, metrics_record_since(LATENCY_CACHE_HIT, &start));
+        TRACE_END(command, "get", key_to_get, CMD_SUCCESS);
+        return CMD_SUCCESS;
+    }
+
+    char *value = NULL;
+    unsigned long generation = cache_generation();
+    int result = find_key_on_disk(key_to_get, &value);
+
+    if (result < 0)
+    {
+        free(value);
+        metrics_inc(METRIC_CMD_ERRORS);
+        TRACE_END(command, "get", key_to_get, CMD_ERROR);
+        return CMD_ERROR;
+    }
+    else if (result == 0)
+    {
+        free(value);
+        slowlog_check("get", key_to_get, SLOWLOG_MISS, metrics_record_since(LATENCY_MISS, &start));
+        TRACE_END(command, "get", key_to_get, CMD_NOT_FOUND);
+        return CMD_NOT_FOUND;
+    }
+
+    size_t value_len = strlen(value);
+    visit(value, value_len, hash_content(value, value_len), ctx);
+    fill_cache(key_to_get, value, generation);
+    free(value);
+    slowlog_check("get", key_to_get, SLOWLOG_DISK, metrics_record_since(LATENCY_DISK_HIT, &start));
+    TRACE_END(command, "get", key_to_get, CMD_SUCCESS);
     return CMD_SUCCESS;
 }
 
@@ -78,12 +373,19 @@ int zrm_command(const char *key_to_remove)
         return CMD_EMPTY;
     }
 
-    remove_from_cache(key_to_remove);
+    struct timespec start;
+    TRACE_BEGIN(command, "rm", key_to_remove);
+    command_timer_start(&start);
+    metrics_inc(METRIC_CMD_RM);
+    hotkeys_touch(key_to_remove, HOTKEYS_WRITE);
 
-    int result = remove_key_from_disk(key_to_remove);
+    int result = writer_submit(WRITE_DELETE, key_to_remove, NULL);
+    slowlog_check("rm", key_to_remove, SLOWLOG_WRITE, metrics_record_since(LATENCY_DELETE, &start));
+    TRACE_END(command, "rm", key_to_remove, result);
 
     if (result < 0)
     {
+        metrics_inc(METRIC_CMD_ERRORS);
         return CMD_ERROR;
     }
     else if (result == 0)
@@ -106,63 +408,284 @@ int zall_command()
     return CMD_SUCCESS;
 }
 
+static int ordered_scan(const char *start, const char *end, const char *prefix, size_t limit, int with_values,
+                        DataItem **items, size_t *size, size_t *capacity, char **next)
+{
+    const char *name = prefix ? "scan" : "range";
+    const char *from = prefix ? prefix : start;
+    struct timespec began;
+    TRACE_BEGIN(command, name, from);
+    command_timer_start(&began);
+    metrics_inc(METRIC_CMD_RANGE);
+    if (limit > RANGE_MAX_COUNT) limit = RANGE_MAX_COUNT;
+    int status = CMD_SUCCESS;
+    if (!index_scan(start, end, prefix, limit, with_values, items, size, capacity, next))
+    {
+        metrics_inc(METRIC_CMD_ERRORS);
+        status = CMD_ERROR;
+    }
+    else
+    {
+        slowlog_check(name, from, SLOWLOG_SCAN, timer_elapsed_ns(&began));
+    }
+    TRACE_END(command, name, from, status);
+    return status;
+}
+
+int zscan_command(const char *prefix, const char *start, size_t limit, int with_values,
+                  DataItem **items, size_t *size, size_t *capacity, char **next)
+{
+    if (!prefix || strlen(prefix) == 0) {
+        return CMD_EMPTY;
+    }
+    return ordered_scan(start, NULL, prefix, limit, with_values, items, size, capacity, next);
+}
+
+int zrange_command(const char *start, const char *end, size_t limit, int with_values,
+                   DataItem **items, size_t *size, size_t *capacity, char **next)
+{
+    return ordered_scan(start, end, NULL, limit, with_values, items, size, capacity, next);
+}
+
+int zdbsize_command(int *count)
+{
+    struct timespec start;
+    TRACE_BEGIN(command, "dbsize", NULL);
+    command_timer_start(&start);
+    metrics_inc(METRIC_CMD_DBSIZE);
+    int result = count_keys_on_disk();
+    TRACE_END(command, "dbsize", NULL, result);
+    if (result < 0)
+    {
+        metrics_inc(METRIC_CMD_ERRORS);
+        return CMD_ERROR;
+    }
+    slowlog_check("dbsize", NULL, SLOWLOG_DISK, timer_elapsed_ns(&start));
+    *count = result;
+    return CMD_SUCCESS;
+}
+
 int init_db_command()
 {
     srand(time(NULL));
     const int MIN_LENGTH = 4;
     const int MAX_LENGTH = 64;
 
-    FILE *file = fopen(FILENAME, "wb");
-    if (!file)
+    // An LSM database gets the pairs added as one batch instead of being replaced
+    int lsm = lsm_selected();
+    char *keys[INIT_DB_SIZE] = {NULL};
+    char *values[INIT_DB_SIZE] = {NULL};
+    FILE *file = NULL;
+    if (lsm ? !lsm_ensure() : !(file = fopen(FILENAME, "wb")))
     {
         return CMD_ERROR;
     }
 
-    for (int i = 0; i < INIT_DB_SIZE; i++)
+    int ok = 1;
+    for (int i = 0; ok && i < INIT_DB_SIZE; i++)
     {
         int key_length = MIN_LENGTH + (rand() % (MAX_LENGTH - MIN_LENGTH + 1));
         int value_length = MIN_LENGTH + (rand() % (MAX_LENGTH - MIN_LENGTH + 1));
 
-        char *buffer_key = malloc(key_length + 1);
-        char *buffer_value = malloc(value_length + 1);
-
-        if (!buffer_key || !buffer_value)
+        keys[i] = malloc(key_length + 1);
+        values[i] = malloc(value_length + 1);
+        if (!keys[i] || !values[i])
         {
-            free(buffer_key);
-            free(buffer_value);
-            fclose(file);
-            return CMD_ERROR;
+            ok = 0;
+            break;
         }
 
-        generate_random_alphanumeric(buffer_key, key_length);
-        generate_random_alphanumeric(buffer_value, value_length);
+        generate_random_alphanumeric(keys[i], key_length);
+        generate_random_alphanumeric(values[i], value_length);
 
-        if (!write_item_to_file(file, buffer_key, buffer_value))
-        {
-            free(buffer_key);
-            free(buffer_value);
-            fclose(file);
-            return CMD_ERROR;
-        }
+        if (!lsm) ok = write_item_to_file(file, keys[i], values[i]);
+    }
+    if (ok && lsm) ok = lsm_apply((const char *const *)keys, (const char *const *)values, INIT_DB_SIZE);
 
-        free(buffer_key);
-        free(buffer_value);
+    for (int i = 0; i < INIT_DB_SIZE; i++)
+    {
+        free(keys[i]);
+        free(values[i]);
+    }
+    if (file) fclose(file);
+    return ok ? CMD_SUCCESS : CMD_ERROR;
+}
+
+int cache_status(void)
+{
+    if (!memory_cache)
+    {
+        return CMD_ERROR;
     }
 
-    fclose(file);
     return CMD_SUCCESS;
 }
 
-int cache_status(void)
+// Copy up to CACHE_STATUS_VALUE_LEN bytes of `value`, marking a cut with "..."
+static char *preview_value(const char *value)
+{
+    size_t len = strlen(value);
+    if (len <= CACHE_STATUS_VALUE_LEN) return my_strdup(value);
+    char *preview = malloc(CACHE_STATUS_VALUE_LEN + 4);
+    if (!preview) return NULL;
+    memcpy(preview, value, CACHE_STATUS_VALUE_LEN);
+    memcpy(preview + CACHE_STATUS_VALUE_LEN, "...", 4);
+    return preview;
+}
+
+int cache_page_command(unsigned int cursor, size_t count, DataItem **items, size_t *size, size_t *capacity,
+                       unsigned int *next_cursor)
 {
+    *next_cursor = 0;
+    pthread_mutex_lock(&cache_mutex);
     if (!memory_cache)
     {
+        pthread_mutex_unlock(&cache_mutex);
         return CMD_ERROR;
     }
+    unsigned int bucket = cursor;
+    // Whole buckets only, so a cursor never points into a chain
+    for (; bucket < memory_cache->size && *size < count; bucket++)
+    {
+        for (DataItem *item = memory_cache->table[bucket]; item; item = item->next)
+        {
+            ensure_list_capacity(items, capacity, *size + 1);
+            DataItem *copy = &(*items)[*size];
+            memset(copy, 0, sizeof(*copy));
+            copy->key = my_strdup(item->key);
+            copy->value = preview_value(item->value);
+            copy->hit_count = item->hit_count;
+            copy->last_accessed = item->last_accessed;
+            (*size)++;
+        }
+    }
+    if (bucket < memory_cache->size) *next_cursor = bucket;
+    pthread_mutex_unlock(&cache_mutex);
+    return CMD_SUCCESS;
+}
+
+int memory_command(MemoryStats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    pthread_mutex_lock(&cache_mutex);
+    if (memory_cache)
+    {
+        stats->cache_items = memory_cache->count;
+        stats->cache_bucket_count = memory_cache->size;
+        stats->cache_used_buckets = memory_cache->used_buckets;
+        stats->cache_entries = memory_cache->count * sizeof(DataItem);
+        stats->cache_keys = memory_cache->key_bytes;
+        stats->cache_values = memory_cache->value_bytes;
+        stats->cache_buckets = memory_cache->size * sizeof(DataItem *);
+        stats->cache_allocated = memory_cache->allocated_bytes;
+    }
+    pthread_mutex_unlock(&cache_mutex);
+
+    index_usage(&stats->index_entries, &stats->index_entry_capacity, &stats->index_key_bytes,
+                &stats->index_key_capacity);
+    stats->index_bytes = (size_t)metrics_gauge_get(GAUGE_INDEX_BYTES);
+    stats->bloom_bytes = (size_t)metrics_gauge_get(GAUGE_BLOOM_BITS) / 8;
+    stats->bloom_keys = (size_t)metrics_gauge_get(GAUGE_BLOOM_KEYS);
+    stats->memtable_bytes = (size_t)metrics_gauge_get(GAUGE_MEMTABLE_BYTES);
+    stats->http_buffers = (size_t)metrics_gauge_get(GAUGE_HTTP_BUFFER_BYTES);
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    struct mallinfo2 heap = mallinfo2();
+    stats->heap_mapped = heap.arena + heap.hblkhd;
+    stats->heap_in_use = heap.uordblks + heap.hblkhd;
+    stats->heap_free = heap.fordblks;
+#endif
+    return CMD_SUCCESS;
+}
+
+int latency_command(LatencyHistogram *histograms)
+{
+    for (int k = 0; k < LATENCY_KIND_COUNT; k++)
+    {
+        memset(&histograms[k], 0, sizeof(LatencyHistogram));
+        metrics_latency_snapshot((latency_kind_t)k, &histograms[k]);
+    }
+    return CMD_SUCCESS;
+}
+
+int stats_command(StorageStats *stats, int reset)
+{
+    metrics_io_snapshot(stats->io);
+    stats->cache_hits = metrics_counter_since_reset(METRIC_CACHE_HITS);
+    stats->cache_misses = metrics_counter_since_reset(METRIC_CACHE_MISSES);
+    stats->cache_evictions = metrics_counter_since_reset(METRIC_CACHE_EVICTIONS);
+    stats->cache_expirations = metrics_counter_since_reset(METRIC_CACHE_EXPIRATIONS);
+    if (reset) metrics_stats_reset();
+    return CMD_SUCCESS;
+}
 
+int hotkeys_command(HotKey *keys, size_t max, size_t *count)
+{
+    *count = hotkeys_get(keys, max);
     return CMD_SUCCESS;
 }
 
+int hotkeys_reset_command(void)
+{
+    hotkeys_reset();
+    return CMD_SUCCESS;
+}
+
+int hotkeys_config_command(long long sample_rate, long long decay_seconds, unsigned int *current_rate,
+                           unsigned int *current_decay)
+{
+    if (sample_rate > HOTKEYS_MAX_SAMPLE_RATE || decay_seconds > HOTKEYS_MAX_DECAY_SECONDS) return CMD_ERROR;
+    if (sample_rate >= 0) hotkeys_set_sample_rate((unsigned int)sample_rate);
+    if (decay_seconds >= 0) hotkeys_set_decay_seconds((unsigned int)decay_seconds);
+    *current_rate = hotkeys_get_sample_rate();
+    *current_decay = hotkeys_decay_seconds();
+    return CMD_SUCCESS;
+}
+
+int slowlog_get_command(SlowlogEntry *entries, size_t max, size_t *count)
+{
+    *count = slowlog_get(entries, max);
+    return CMD_SUCCESS;
+}
+
+int slowlog_len_command(size_t *len)
+{
+    *len = slowlog_len();
+    return CMD_SUCCESS;
+}
+
+int slowlog_reset_command(void)
+{
+    slowlog_reset();
+    return CMD_SUCCESS;
+}
+
+int slowlog_threshold_command(long long threshold_us, uint64_t *current_us)
+{
+    if (threshold_us >= 0) slowlog_set_threshold_us((uint64_t)threshold_us);
+    *current_us = slowlog_threshold_us();
+    return CMD_SUCCESS;
+}
+
+int trace_enable_command(int enabled)
+{
+    trace_set_enabled(enabled);
+    return CMD_SUCCESS;
+}
+
+int trace_clear_command(void)
+{
+    trace_clear();
+    return CMD_SUCCESS;
+}
+
+int trace_dump_command(FILE *out, long *events)
+{
+    *events = trace_dump(out);
+    return *events < 0 ? CMD_ERROR : CMD_SUCCESS;
+}
+
+#include "bench_report.h"
 #include "io_benchmark.h"
 
 void clear(void)
@@ -170,67 +693,174 @@ void clear(void)
     printf("\33[H\33[J");
 }
 
-int benchmark_command(void)
+static const char *distribution_name(key_distribution_t distribution)
 {
-    const char *benchmark_filename = "benchmark.zdb";
-    double init_time, get_time;
-    struct timespec start, end;
-    char **keys = NULL;
-    int num_keys = 0;
+    switch (distribution)
+    {
+    case KEYS_UNIFORM: return "uniform";
+    case KEYS_LATEST: return "latest";
+    default: return "zipfian";
+    }
+}
 
-    // 1. Initialize temporary database
-    clock_gettime(CLOCK_MONOTONIC, &start);
-    if (init_benchmark_db(benchmark_filename, BENCHMARK_DB_SIZE) != 0)
+static void print_latency_row(const char *name, uint64_t operations, double seconds, const LatencyHistogram *h)
+{
+    printf("  %-8s %10llu %12.0f %9.1f %9.1f %9.1f %9.1f %9.1f\n", name, (unsigned long long)operations,
+           operations / seconds, h->count ? h->sum_ns / 1000.0 / h->count : 0.0,
+           histogram_percentile(h, 50.0) / 1000.0, histogram_percentile(h, 99.0) / 1000.0,
+           histogram_percentile(h, 99.9) / 1000.0, h->max_ns / 1000.0);
+}
+
+int benchmark_command(const WorkloadConfig *config, const char *json_path)
+{
+    BenchReport report = {0};
+    if (json_path && !bench_report_open(&report, json_path, "zu benchmark"))
     {
+        perror(json_path);
         return CMD_ERROR;
     }
-    clock_gettime(CLOCK_MONOTONIC, &end);
-    init_time = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
-
-    // 2. Get all keys from the benchmark database
-    keys = get_all_keys_from_benchmark_db(benchmark_filename, &num_keys);
-    if (!keys || num_keys == 0)
+    WorkloadResult *result = malloc(sizeof(WorkloadResult));
+    if (!result || !workload_run(config, result))
     {
-        cleanup_benchmark_db(benchmark_filename);
+        free(result);
+        bench_report_close(&report);
         return CMD_ERROR;
     }
 
-    // 3. Perform zget operations and measure time
-    clock_gettime(CLOCK_MONOTONIC, &start);
-    for (int i = 0; i < num_keys; i++)
+    uint64_t total = 0;
+    for (int op = 0; op < WORKLOAD_OP_COUNT; op++) total += result->operations[op];
+
+    printf("\n=== BENCHMARK RECAP ===\n");
+    printf("Workload %s: %zu records, %zu-byte values, %s keys, %d threads, %.1f s\n", config->name,
+           config->records, config->value_size, distribution_name(config->distribution), config->threads,
+           result->run_seconds);
+    printf("  • Load time: %.2f ms\n", result->load_seconds * 1000.0);
+    printf("\nLatency (µs):\n");
+    printf("  %-8s %10s %12s %9s %9s %9s %9s %9s\n", "op", "count", "ops/sec", "avg", "p50", "p99", "p99.9",
+           "max");
+    for (int op = 0; op < WORKLOAD_OP_COUNT; op++)
     {
-        if (!keys[i]) continue; // Skip NULL keys (defensive programming)
+        if (config->mix[op] == 0) continue;
+        print_latency_row(workload_op_names[op], result->operations[op], result->run_seconds, &result->latency[op]);
+    }
+    print_latency_row("total", total, result->run_seconds, &result->overall);
+    printf("\nPerformance Metrics:\n");
+    printf("  • Throughput: %.2f ops/sec\n", total / result->run_seconds);
+    printf("  • Errors: %llu\n", (unsigned long long)result->errors);
+    printf("================================\n\n");
+
+    int status = CMD_SUCCESS;
+    if (json_path)
+    {
+        char params[160];
+        snprintf(params, sizeof(params), "workload=%s;records=%zu;value=%zu;dist=%s;threads=%d", config->name,
+                 config->records, config->value_size, distribution_name(config->distribution), config->threads);
+        for (int op = 0; op < WORKLOAD_OP_COUNT; op++)
+        {
+            if (config->mix[op] == 0) continue;
+            bench_report_latency(&report, workload_op_names[op], params, result->operations[op], result->run_seconds,
+                                 &result->latency[op]);
+        }
+        bench_report_latency(&report, "total", params, total, result->run_seconds, &result->overall);
+        bench_report_metric(&report, "total", params, "errors", (double)result->errors, 0, 1);
+        bench_report_metric(&report, "load", params, "seconds", result->load_seconds, 0, 1);
+        if (!bench_report_close(&report)) status = CMD_ERROR;
+    }
+    free(result);
+    return status;
+}
+
+typedef struct {
+    int thread_id;
+    int failed;
+} MissBenchmarkThread;
+
+static void *miss_benchmark_thread(void *arg)
+{
+    MissBenchmarkThread *t = arg;
+    char key[48];
+    for (int i = 0; i < MISS_BENCHMARK_LOOKUPS; i++)
+    {
+        // Absent keys are never cached, and with the Bloom filter off every
+        // lookup scans the whole file under the shared file lock
+        snprintf(key, sizeof(key), "missing:%d:%d", t->thread_id, i);
         char *value;
-        int result = zget_command(keys[i], &value);
-        if (result == CMD_SUCCESS && value) {
-            free(value);
+        if (zget_command(key, &value) != CMD_NOT_FOUND)
+        {
+            t->failed = 1;
+            return NULL;
         }
     }
-    clock_gettime(CLOCK_MONOTONIC, &end);
-    get_time = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+    return NULL;
+}
 
-    // Free keys
-    for (int i = 0; i < num_keys; i++) {
-        free(keys[i]);
+int miss_benchmark_command(int max_threads, const char *json_path)
+{
+    BenchReport report = {0};
+
+    if (max_threads < 1) max_threads = 1;
+    if (json_path && !bench_report_open(&report, json_path, "zu benchmark_misses"))
+    {
+        perror(json_path);
+        return CMD_ERROR;
+    }
+    if (init_benchmark_db(FILENAME, MISS_BENCHMARK_DB_SIZE) != 0)
+    {
+        bench_report_close(&report);
+        return CMD_ERROR;
     }
-    free(keys);
 
-    // 4. Clean up temporary database
-    cleanup_benchmark_db(benchmark_filename);
+    // The filter would answer every lookup without reading the file
+    bloom_file_enable(0);
 
-    // 5. Print benchmark recap with metrics
-    printf("\n=== BENCHMARK RECAP ===\n");
-    printf("Database Operations:\n");
-    printf("  • Database initialization: %.2f ms\n", init_time);
-    printf("  • Total keys processed: %d\n", num_keys);
-    printf("  • Get operations time: %.2f ms\n", get_time);
-    printf("\nPerformance Metrics:\n");
-    printf("  • Average time per get operation: %.4f ms\n", get_time / num_keys);
-    printf("  • Get operations per second: %.2f ops/sec\n", (num_keys * 1000.0) / get_time);
-    printf("  • Total benchmark time: %.2f ms\n", init_time + get_time);
-    printf("  • Database size: %d entries\n", BENCHMARK_DB_SIZE);
+    printf("\n=== CACHE MISS BENCHMARK ===\n");
+    printf("  %d records, %d lookups per thread\n\n", MISS_BENCHMARK_DB_SIZE, MISS_BENCHMARK_LOOKUPS);
+    printf("  threads      lookups/sec    speedup\n");
+
+    int status = CMD_SUCCESS;
+    double single_rate = 0;
+    for (int threads = 1; threads <= max_threads && status == CMD_SUCCESS; threads *= 2)
+    {
+        pthread_t *ids = malloc(threads * sizeof(pthread_t));
+        MissBenchmarkThread *args = calloc(threads, sizeof(MissBenchmarkThread));
+        if (!ids || !args)
+        {
+            free(ids);
+            free(args);
+            status = CMD_ERROR;
+            break;
+        }
 
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        int started = 0;
+        for (; started < threads; started++)
+        {
+            args[started].thread_id = started;
+            if (pthread_create(&ids[started], NULL, miss_benchmark_thread, &args[started]) != 0) break;
+        }
+        for (int i = 0; i < started; i++)
+        {
+            pthread_join(ids[i], NULL);
+            if (args[i].failed) status = CMD_ERROR;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        if (started < threads) status = CMD_ERROR;
+
+        double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        double rate = (double)started * MISS_BENCHMARK_LOOKUPS / seconds;
+        if (threads == 1) single_rate = rate;
+        printf("  %7d  %15.0f  %8.2fx\n", threads, rate, rate / single_rate);
+        char params[48];
+        snprintf(params, sizeof(params), "records=%d;threads=%d", MISS_BENCHMARK_DB_SIZE, threads);
+        bench_report_metric(&report, "miss_lookup", params, "ops_per_sec", rate, 0, 0);
+
+        free(ids);
+        free(args);
+    }
     printf("================================\n\n");
+    bloom_file_enable(1);
 
-    return CMD_SUCCESS;
+    if (json_path && !bench_report_close(&report)) status = CMD_ERROR;
+    return status;
 }
@@ -2,21 +2,152 @@
 #define COMMANDS_H
 
 #include <stdbool.h>
+#include <stddef.h> // For size_t
+#include <stdint.h>
+#include "ds.h"     // For DataItem
+#include "writer.h" // For WriteOp, WriteWatch
+#include "workload.h" // For WorkloadConfig
+#include "metrics.h"  // For LATENCY_KIND_COUNT
+#include "slowlog.h"  // For SlowlogEntry
+#include "hotkeys.h"  // For HotKey
+#include <stdio.h>    // For FILE
 
 // Command return codes
 #define CMD_SUCCESS 0
 #define CMD_ERROR -1
 #define CMD_NOT_FOUND -2
 #define CMD_EMPTY -3
+#define CMD_MISMATCH -4    // zcas: the current value differs from the expected one
+#define CMD_NOT_INTEGER -5 // zincr: the value is not an integer, or would overflow
 
 // Function signatures - all return status codes, no printing
 int zset_command(const char *key_to_set, const char *value_to_set);
 int zget_command(const char *key_to_get, char **result_value);
+
+// Zero-copy variant of zget: `visit` receives a borrowed pointer to the value,
+// valid only until it returns (on a cache hit it runs under the cache lock),
+// and the value's content hash for use as an ETag.
+typedef void (*value_visitor_t)(const char *value, size_t value_len, uint64_t content_hash, void *ctx);
+int zget_visit_command(const char *key_to_get, value_visitor_t visit, void *ctx);
 int zrm_command(const char *key);
+
+// Atomic read-modify-write commands, evaluated by the writer thread
+int zincr_command(const char *key, long long delta, long long *result);
+int zappend_command(const char *key, const char *suffix, long long *new_length);
+int zcas_command(const char *key, const char *expected, const char *new_value);
+
+// Transactions: writes are queued, then applied all-or-nothing in a single
+// commit by zexec_command. Watched keys make the commit conditional on them
+// being unchanged (by content hash) since they were watched. The transaction
+// owns copies of every key and value.
+typedef struct {
+    WriteOp *ops;
+    size_t count;
+    size_t capacity;
+    WriteWatch *watches;
+    size_t watch_count;
+    size_t watch_capacity;
+} Transaction;
+
+void txn_init(Transaction *txn);
+void txn_reset(Transaction *txn); // Drop queued writes and watches
+int txn_queue(Transaction *txn, write_op_t op, const char *key, const char *value,
+              const char *expected, long long delta);
+// Watch a key in a known state, e.g. the ETag a client read it with
+int txn_watch_version(Transaction *txn, const char *key, int exists, uint64_t content_hash);
+int zwatch_command(Transaction *txn, const char *key); // Watch the key's current state
+// Returns CMD_SUCCESS, CMD_MISMATCH if aborted by a watch or a failed CAS,
+// CMD_NOT_INTEGER if an INCR failed, or CMD_ERROR. Per-write results stay in
+// txn->ops until txn_reset.
+int zexec_command(Transaction *txn);
+
+// Ordered queries over the key index, in time proportional to the result:
+// matching records are appended to `items` in key order (values only if
+// `with_values`), at most `limit` of them. *next receives the key to pass as
+// `start` for the following page, or NULL once nothing is left.
+int zscan_command(const char *prefix, const char *start, size_t limit, int with_values,
+                  DataItem **items, size_t *size, size_t *capacity, char **next);
+int zrange_command(const char *start, const char *end, size_t limit, int with_values,
+                   DataItem **items, size_t *size, size_t *capacity, char **next);
+
 int zall_command(void);
+int zdbsize_command(int *count);
 int init_db_command(void);
 int cache_status(void);
+// One page of the cache, copied so the lock is held only for the page: items
+// from bucket `cursor` on until at least `count` are collected, with values cut
+// to CACHE_STATUS_VALUE_LEN bytes. *next_cursor is where the next page starts,
+// or 0 after the last one.
+int cache_page_command(unsigned int cursor, size_t count, DataItem **items, size_t *size, size_t *capacity,
+                       unsigned int *next_cursor);
+// Memory held by each part of the server, from counters kept up to date as
+// memory is allocated and freed (no structure is walked to compute it)
+typedef struct {
+    size_t cache_entries;   // DataItem structs
+    size_t cache_keys;
+    size_t cache_values;
+    size_t cache_buckets;   // Bucket array
+    size_t cache_allocated; // Entries, keys and values as sized by the allocator
+    unsigned int cache_items;
+    unsigned int cache_bucket_count;
+    unsigned int cache_used_buckets;
+    size_t index_bytes;     // Every key index, including one being built
+    size_t index_entries;   // Of the installed index
+    size_t index_entry_capacity;
+    size_t index_key_bytes;
+    size_t index_key_capacity;
+    size_t bloom_bytes;
+    size_t bloom_keys;
+    size_t memtable_bytes;
+    size_t http_buffers;
+    // The allocator's view of the heap (0 where it cannot tell)
+    size_t heap_mapped;     // Obtained from the system
+    size_t heap_in_use;
+    size_t heap_free;       // Free chunks still held: external fragmentation
+} MemoryStats;
+
+int memory_command(MemoryStats *stats);
+// Fill `histograms` (LATENCY_KIND_COUNT of them) with the latency recorded
+// so far on each command path, merged across threads
+int latency_command(LatencyHistogram *histograms);
+// Storage I/O by operation type and cache activity since the last reset
+typedef struct {
+    uint64_t io[IO_OP_KIND_COUNT][IO_STAT_KIND_COUNT];
+    uint64_t cache_hits;
+    uint64_t cache_misses;
+    uint64_t cache_evictions;
+    uint64_t cache_expirations; // Entries found older than CACHE_TTL (also counted as misses)
+} StorageStats;
+
+// Fill `stats`, then restart the counts from zero if `reset` is set
+int stats_command(StorageStats *stats, int reset);
+// Hot keys (see hotkeys.h): copy up to `max`, hottest first
+int hotkeys_command(HotKey *keys, size_t max, size_t *count);
+int hotkeys_reset_command(void);
+// Set the sample rate and decay window unless negative, then report both.
+// CMD_ERROR if either is above its HOTKEYS_MAX_* limit.
+int hotkeys_config_command(long long sample_rate, long long decay_seconds, unsigned int *current_rate,
+                           unsigned int *current_decay);
+
+// The slowlog (see slowlog.h): copy up to `max` entries, newest first, and
+// set *count to how many were copied
+int slowlog_get_command(SlowlogEntry *entries, size_t max, size_t *count);
+int slowlog_len_command(size_t *len);
+int slowlog_reset_command(void);
+// Set the slowlog threshold unless `threshold_us` is negative, then report it
+int slowlog_threshold_command(long long threshold_us, uint64_t *current_us);
+// The trace ring (see trace.h): start or stop recording, forget the events
+// recorded so far, or write them to `out` as Chrome trace-event JSON, setting
+// *events to how many were written
+int trace_enable_command(int enabled);
+int trace_clear_command(void);
+int trace_dump_command(FILE *out, long *events);
 void clear(void);
-int benchmark_command(void);
+// Run a YCSB-style workload, or concurrent lookups of absent keys on 1..n
+// threads, and print the results. Both overwrite FILENAME, so zu runs them on
+// a scratch database in a worker process. With a `json_path`, the results are
+// also written there (see bench_report.h).
+int benchmark_command(const WorkloadConfig *config, const char *json_path);
+int miss_benchmark_command(int max_threads, const char *json_path);
 
 #endif // COMMANDS_H
@@ -3,11 +3,54 @@
 
 #define INITIAL_CAPACITY 10
 #define INIT_DB_SIZE 50
-#define BENCHMARK_DB_SIZE 100000 // Number of key-value pairs for benchmark
+#define BENCHMARK_DB_SIZE 10000 // Records loaded before a benchmark workload runs
+#define BENCHMARK_SECONDS 10     // Length of the measured phase of a benchmark
+#define BENCHMARK_THREADS 4      // Client threads driving a benchmark workload
+#define BENCHMARK_VALUE_SIZE 100 // Bytes per benchmark value
+#define BENCHMARK_MAX_SCAN 100   // Longest scan in workload e
+#define MISS_BENCHMARK_DB_SIZE 2000 // Records scanned by every lookup in the cache-miss benchmark
+#define MISS_BENCHMARK_LOOKUPS 100 // Lookups per thread in the cache-miss benchmark
 #define CACHE_SIZE 1000
 #define CACHE_TTL 60
+#define CACHE_STATUS_PAGE 20 // Entries cache_status shows per page
+#define CACHE_STATUS_VALUE_LEN 64 // Bytes of each value cache_status shows
 #define REST_SERVER_PORT 1337
 #define HTTP_BUFFER_SIZE 1048576 // 1MB
+#define HTTP_WORKER_THREADS 4 // Threads serving REST requests
+#define HTTP_MAX_CONNECTIONS 256 // Open REST connections (queued + in service) before new ones get a 503
+#define HTTP_MAX_QUEUE 128 // Accepted connections waiting for a worker
+#define HTTP_MAX_INFLIGHT_WRITES 2 // Concurrent /set requests before storage counts as saturated
+#define HTTP_LISTEN_BACKLOG 511 // Kernel accept queue length for the REST listeners
+#define HTTP_RETRY_AFTER 1 // Seconds sent in Retry-After on a 503
+#define WRITER_QUEUE_SIZE 1024 // Pending writes the writer ring holds (power of two)
+#define WRITER_BATCH_MAX 256 // Writes committed by one file rewrite
+#define WRITER_FSYNC 1 // Set to 0 to skip fsync before each batch is renamed into place
+#define SCAN_BATCH_SIZE 256 // Records read per file lock acquisition during scans
+#define SCAN_DEFAULT_COUNT 100 // Keys returned by /scan when no count is given
+#define RANGE_MAX_COUNT 1000 // Most records returned by one zscan/zrange call or /range page
+#define BLOOM_BITS_PER_KEY 10 // Bloom filter size per data file / LSM table; ~1% false positives
+#define LSM_SUFFIX ".lsm" // Database paths ending in this use the LSM engine (a directory)
+#define LSM_MEMTABLE_BYTES (4 * 1024 * 1024) // Memtable size that triggers a flush to a new table
+#define LSM_BLOCK_SIZE 4096 // Target size of a table block; the sparse index has one key per block
+#define LSM_COMPACTION_TRIGGER 4 // Similar-sized tables that are merged into one
+#define LSM_SIZE_RATIO 2 // A table joins a compaction if at most this many times the newer ones' size
+#define LSM_MAX_TABLES 16 // Table count at which all tables are merged
+#define SLOWLOG_THRESHOLD_US 10000 // Commands slower than this are kept in the slowlog
+#define SLOWLOG_MAX_LEN 128 // Slowlog entries kept; older ones are overwritten
+#define SLOWLOG_KEY_LEN 64 // Bytes of each key kept in a slowlog entry
+#define TRACE_USDT 1 // Set to 0 to leave out the USDT probes even when <sys/sdt.h> is available
+#define TRACE_RING_EVENTS 8192 // Events kept per thread while tracing is on
+#define TRACE_ARG_LEN 32 // Bytes of a key or path kept in a trace event
+#define HOTKEYS_CAPACITY 64 // Keys tracked for hotkeys; more counters, better estimates
+#define HOTKEYS_SAMPLE_RATE 16 // Count about one request in this many per thread (0 = off)
+#define HOTKEYS_DECAY_SECONDS 60 // Hotkey counts halve once per this many seconds (0 = never)
+#define HOTKEYS_KEY_LEN 64 // Bytes of each hot key kept
+#define UNIX_SOCKET_ENABLED 1 // Set to 1 to also serve the REST API on a unix domain socket
+#define UNIX_SOCKET_PATH "zu.sock" // Filesystem path of the unix domain socket
+#define UNIX_SOCKET_PERMS 0660 // Permissions applied to the socket file (access control)
+#define RESP_SERVER_PORT 6380 // Port for the Redis-compatible (RESP2) listener
+#define RESP_MAX_CLIENTS 1024 // Maximum concurrent RESP connections
+#define RESP_MAX_ARG_LENGTH HTTP_BUFFER_SIZE // Largest bulk string accepted from a RESP client
 #define DEBUG_CLI 1 // Set to 1 to enable CLI output, 0 to disable
 #define DEBUG_HTTP 0 // Set to 1 to enable HTTP server output, 0 to disable
 extern char *FILENAME;
@@ -4,9 +4,42 @@
 #include <string.h>
 #include <stdlib.h>
 #include <limits.h> // For UINT_MAX
+#ifdef __GLIBC__
+#include <malloc.h> // For malloc_usable_size
+#endif
 
 // --- Hash Table Implementation ---
 
+size_t allocated_size(void *ptr, size_t requested)
+{
+#ifdef __GLIBC__
+    return ptr ? malloc_usable_size(ptr) : 0;
+#else
+    return ptr ? requested : 0;
+#endif
+}
+
+// The table's memory totals are kept up to date on every change, so reading
+// them never needs a walk of the table
+static void account_item(HashTable *ht, DataItem *item, int adding)
+{
+    size_t key_len = strlen(item->key) + 1, value_len = strlen(item->value) + 1;
+    size_t allocated = allocated_size(item, sizeof(DataItem)) + allocated_size(item->key, key_len) +
+                       allocated_size(item->value, value_len);
+    if (adding)
+    {
+        ht->key_bytes += key_len;
+        ht->value_bytes += value_len;
+        ht->allocated_bytes += allocated;
+    }
+    else
+    {
+        ht->key_bytes -= key_len;
+        ht->value_bytes -= value_len;
+        ht->allocated_bytes -= allocated;
+    }
+}
+
 // A simple hash function (djb2)
 unsigned int hash_function(const char *key, unsigned int size)
 {
@@ -19,12 +52,26 @@ unsigned int hash_function(const char *key, unsigned int size)
     return hash % size;
 }
 
+uint64_t hash_content(const char *data, size_t len)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
 HashTable *create_hash_table(unsigned int size)
 {
     HashTable *ht = malloc(sizeof(HashTable));
     if (!ht)
         return NULL;
     ht->size = size;
+    ht->count = 0;
+    ht->used_buckets = 0;
+    ht->key_bytes = ht->value_bytes = ht->allocated_bytes = 0;
     ht->table = calloc(size, sizeof(DataItem *));
     if (!ht->table)
     {
@@ -53,7 +100,7 @@ void free_hash_table(HashTable *ht)
     free(ht);
 }
 
-void hash_table_insert(HashTable *ht, const char *key, const char *value)
+unsigned int hash_table_insert(HashTable *ht, const char *key, const char *value)
 {
     unsigned int index = hash_function(key, ht->size);
     DataItem *current = ht->table[index];
@@ -65,9 +112,12 @@ void hash_table_insert(HashTable *ht, const char *key, const char *value)
         if (strcmp(current->key, key) == 0)
         {
             // Key found, update value
+            account_item(ht, current, 0);
             free(current->value);
             current->value = my_strdup(value);
-            return;
+            current->content_hash = hash_content(value, strlen(value));
+            account_item(ht, current, 1);
+            return 0;
         }
         prev = current;
         current = current->next;
@@ -76,9 +126,10 @@ void hash_table_insert(HashTable *ht, const char *key, const char *value)
     // Key not found, create new item
     DataItem *new_item = malloc(sizeof(DataItem));
     if (!new_item)
-        return; // Handle allocation failure
+        return 0; // Handle allocation failure
     new_item->key = my_strdup(key);
     new_item->value = my_strdup(value);
+    new_item->content_hash = hash_content(value, strlen(value));
     new_item->hit_count = 0;
     new_item->last_accessed = 0; // Or set current time
     new_item->next = NULL;
@@ -90,29 +141,15 @@ void hash_table_insert(HashTable *ht, const char *key, const char *value)
     else
     {
         ht->table[index] = new_item;
+        ht->used_buckets++;
     }
 
-    // After insert, check size and perform LRU eviction if needed
-    static unsigned int cached_item_count = 0; // Cache the count to avoid full scans
-    unsigned int current_items = 0;
-
-    // Count items efficiently (with periodic full recount for accuracy)
-    if (cached_item_count == 0 || (cached_item_count % 100) == 0) {
-        // Periodic full recount to maintain accuracy
-        current_items = 0;
-        for (unsigned int i = 0; i < ht->size; i++) {
-            DataItem *item = ht->table[i];
-            while (item) {
-                current_items++;
-                item = item->next;
-            }
-        }
-        cached_item_count = current_items;
-    } else {
-        current_items = cached_item_count + 1; // We just added one item
-    }
+    ht->count++;
+    account_item(ht, new_item, 1);
+    unsigned int current_items = ht->count;
 
     // Perform LRU eviction with safety bounds
+    unsigned int evicted = 0;
     unsigned int eviction_attempts = 0;
     const unsigned int max_evictions = CACHE_SIZE * 2; // Safety limit
 
@@ -125,7 +162,9 @@ void hash_table_insert(HashTable *ht, const char *key, const char *value)
         for (unsigned int i = 0; i < ht->size; i++) {
             DataItem *item = ht->table[i];
             while (item) {
-                if (item->last_accessed < lru_time) {
+                if (item == new_item) {
+                    // Never evict the item being inserted
+                } else if (item->last_accessed < lru_time) {
                     lru_time = item->last_accessed;
                     lru = item;
                 } else if (item->last_accessed == lru_time && item < lru) {
@@ -140,7 +179,7 @@ void hash_table_insert(HashTable *ht, const char *key, const char *value)
             // Attempt to remove the LRU item
             hash_table_remove(ht, lru->key);
             current_items--;
-            cached_item_count = current_items;
+            evicted++;
             eviction_attempts++;
         } else {
             // No removable items found, break to prevent infinite loop
@@ -157,12 +196,16 @@ void hash_table_insert(HashTable *ht, const char *key, const char *value)
                 DataItem *next = item->next;
                 free_data_item_contents(item);
                 free(item);
+                evicted++;
                 item = next;
             }
             ht->table[i] = NULL;
         }
-        cached_item_count = 0;
+        ht->count = 0;
+        ht->used_buckets = 0;
+        ht->key_bytes = ht->value_bytes = ht->allocated_bytes = 0;
     }
+    return evicted;
 }
 
 DataItem *hash_table_search(HashTable *ht, const char *key)
@@ -198,8 +241,11 @@ void hash_table_remove(HashTable *ht, const char *key)
             {
                 ht->table[index] = current->next;
             }
+            if (!ht->table[index]) ht->used_buckets--;
+            account_item(ht, current, 0);
             free_data_item_contents(current);
             free(current);
+            ht->count--;
             return;
         }
         prev = current;
@@ -233,6 +279,18 @@ void free_data_item_contents(DataItem *item)
     }
 }
 
+void free_data_list(DataItem **list, size_t *size, size_t *capacity)
+{
+    for (size_t i = 0; i < *size; i++)
+    {
+        free_data_item_contents(&(*list)[i]);
+    }
+    free(*list);
+    *list = NULL;
+    *size = 0;
+    *capacity = 0;
+}
+
 void ensure_list_capacity(DataItem **list, size_t *capacity, size_t needed_size)
 {
     if (*capacity < needed_size)
@@ -2,6 +2,7 @@
 #define DS_H
 
 #include <stdlib.h> // For size_t
+#include <stdint.h>
 
 // --- Data Structures ---
 typedef struct DataItem
@@ -10,12 +11,18 @@ typedef struct DataItem
     char *value;
     unsigned int hit_count;     // Hit count for caching
     unsigned int last_accessed; // Timestamp of last access
+    uint64_t content_hash;      // hash_content() of the value, used as its ETag
     struct DataItem *next;      // For chaining in hash table
 } DataItem;
 
 typedef struct
 {
-    unsigned int size;
+    unsigned int size;  // Buckets
+    unsigned int count; // Items
+    unsigned int used_buckets; // Buckets holding at least one item
+    size_t key_bytes;   // Keys and values, terminators included
+    size_t value_bytes;
+    size_t allocated_bytes; // Items, keys and values as sized by the allocator
     DataItem **table;
 } HashTable;
 
@@ -23,9 +30,11 @@ typedef struct
 HashTable *create_hash_table(unsigned int size);
 void free_hash_table(HashTable *ht);
 unsigned int hash_function(const char *key, unsigned int size);
-void hash_table_insert(HashTable *ht, const char *key, const char *value);
+uint64_t hash_content(const char *data, size_t len); // 64-bit FNV-1a
+unsigned int hash_table_insert(HashTable *ht, const char *key, const char *value); // Returns the number of evicted items
 DataItem *hash_table_search(HashTable *ht, const char *key);
 void hash_table_remove(HashTable *ht, const char *key);
+size_t allocated_size(void *ptr, size_t requested); // Bytes the allocator reserved for `ptr`
 
 // --- Helper Function Declarations ---
 char *my_strdup(const char *s);
@@ -0,0 +1,175 @@
+#include "hotkeys.h"
+#include "ds.h"
+#include "utils.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+    HotKey key;
+    uint64_t hash; // Of the whole key, so truncated keys stay apart
+} Counter;
+
+_Atomic unsigned int hotkeys_sample_rate = HOTKEYS_SAMPLE_RATE;
+_Thread_local unsigned int hotkeys_countdown = 0;
+
+static _Thread_local uint64_t sample_state = 0;
+
+static pthread_mutex_t counters_mutex = PTHREAD_MUTEX_INITIALIZER;
+static Counter counters[HOTKEYS_CAPACITY];
+static size_t used = 0;
+static unsigned int decay_seconds = HOTKEYS_DECAY_SECONDS;
+static time_t decayed_at = 0; // Start of the current decay window
+
+void hotkeys_sample(const char *key, hotkeys_op_t op, unsigned int rate)
+{
+    if (!sample_state) sample_state = ((uint64_t)(uintptr_t)&sample_state ^ (uint64_t)time(NULL)) | 1;
+    // Gaps uniform in [1, 2 * rate - 1] average `rate` without locking onto a
+    // request pattern that repeats every `rate` requests
+    hotkeys_countdown = 1 + (unsigned int)(random_next(&sample_state) % (2ULL * rate - 1));
+    hotkeys_record(key, op, rate);
+}
+
+static time_t now_seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec;
+}
+
+// Halve every count once per window that has passed. Holds counters_mutex.
+static void decay(time_t now)
+{
+    if (decay_seconds == 0 || decayed_at == 0)
+    {
+        decayed_at = now;
+        return;
+    }
+    time_t windows = (now - decayed_at) / decay_seconds;
+    if (windows <= 0) return;
+    decayed_at += windows * decay_seconds;
+    unsigned int shift = windows >= 64 ? 63 : (unsigned int)windows;
+
+    size_t kept = 0;
+    for (size_t i = 0; i < used; i++)
+    {
+        HotKey *k = &counters[i].key;
+        k->count >>= shift;
+        k->error >>= shift;
+        k->reads >>= shift;
+        k->writes >>= shift;
+        if (k->count > 0) counters[kept++] = counters[i];
+    }
+    used = kept;
+}
+
+void hotkeys_record(const char *key, hotkeys_op_t op, uint64_t weight)
+{
+    if (!key) return;
+    size_t length = strlen(key);
+    size_t kept = length < HOTKEYS_KEY_LEN ? length : HOTKEYS_KEY_LEN;
+    uint64_t hash = hash_content(key, length);
+
+    pthread_mutex_lock(&counters_mutex);
+    decay(now_seconds());
+
+    Counter *c = NULL;
+    for (size_t i = 0; i < used; i++)
+    {
+        if (counters[i].hash == hash && counters[i].key.key_length == length &&
+            memcmp(counters[i].key.key, key, kept) == 0)
+        {
+            c = &counters[i];
+            break;
+        }
+    }
+    if (!c)
+    {
+        uint64_t inherited = 0;
+        if (used < HOTKEYS_CAPACITY)
+        {
+            c = &counters[used++];
+        }
+        else
+        {
+            c = &counters[0];
+            for (size_t i = 1; i < used; i++)
+            {
+                if (counters[i].key.count < c->key.count) c = &counters[i];
+            }
+            inherited = c->key.count;
+        }
+        memset(c, 0, sizeof(*c));
+        c->hash = hash;
+        c->key.key_length = length;
+        memcpy(c->key.key, key, kept);
+        c->key.key[kept] = '\0';
+        c->key.count = c->key.error = inherited;
+    }
+    c->key.count += weight;
+    if (op == HOTKEYS_WRITE) c->key.writes += weight;
+    else c->key.reads += weight;
+
+    pthread_mutex_unlock(&counters_mutex);
+}
+
+static int hottest_first(const void *a, const void *b)
+{
+    uint64_t x = ((const HotKey *)a)->count, y = ((const HotKey *)b)->count;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+size_t hotkeys_get(HotKey *keys, size_t max)
+{
+    HotKey all[HOTKEYS_CAPACITY];
+    pthread_mutex_lock(&counters_mutex);
+    decay(now_seconds());
+    size_t count = used;
+    for (size_t i = 0; i < count; i++)
+    {
+        all[i] = counters[i].key;
+    }
+    pthread_mutex_unlock(&counters_mutex);
+
+    qsort(all, count, sizeof(HotKey), hottest_first);
+    size_t copied = count < max ? count : max;
+    memcpy(keys, all, copied * sizeof(HotKey));
+    return copied;
+}
+
+void hotkeys_reset(void)
+{
+    pthread_mutex_lock(&counters_mutex);
+    used = 0;
+    decayed_at = 0;
+    pthread_mutex_unlock(&counters_mutex);
+}
+
+unsigned int hotkeys_get_sample_rate(void)
+{
+    return atomic_load_explicit(&hotkeys_sample_rate, memory_order_relaxed);
+}
+
+void hotkeys_set_sample_rate(unsigned int rate)
+{
+    atomic_store_explicit(&hotkeys_sample_rate, rate, memory_order_relaxed);
+}
+
+unsigned int hotkeys_decay_seconds(void)
+{
+    pthread_mutex_lock(&counters_mutex);
+    unsigned int seconds = decay_seconds;
+    pthread_mutex_unlock(&counters_mutex);
+    return seconds;
+}
+
+void hotkeys_set_decay_seconds(unsigned int seconds)
+{
+    pthread_mutex_lock(&counters_mutex);
+    decay(now_seconds()); // Windows that already passed decay at the old length
+    decay_seconds = seconds;
+    decayed_at = now_seconds();
+    pthread_mutex_unlock(&counters_mutex);
+}
@@ -0,0 +1,66 @@
+#ifndef HOTKEYS_H
+#define HOTKEYS_H
+
+#include "config.h"
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The most requested keys, over reads and writes on every path, tracked with
+// the Space-Saving algorithm: HOTKEYS_CAPACITY counters, and a key that is not
+// counted yet takes over the smallest counter and inherits its count as a
+// possible overestimate. Any key requested more than 1/HOTKEYS_CAPACITY of the
+// time is guaranteed to be among them.
+//
+// Only about one request in `hotkeys_sample_rate` per thread is counted, with
+// the weight of the rate, so an unsampled request costs a thread-local
+// decrement. Counts halve once per decay window so that old stampedes fade.
+
+typedef enum {
+    HOTKEYS_READ,
+    HOTKEYS_WRITE
+} hotkeys_op_t;
+
+typedef struct {
+    char key[HOTKEYS_KEY_LEN + 1];
+    size_t key_length; // Of the whole key; only HOTKEYS_KEY_LEN bytes are kept
+    uint64_t count;    // Estimated requests, at most `error` too high
+    uint64_t error;
+    uint64_t reads;    // Of the count since the key took its counter
+    uint64_t writes;
+} HotKey;
+
+extern _Atomic unsigned int hotkeys_sample_rate; // 0 turns tracking off
+extern _Thread_local unsigned int hotkeys_countdown;
+
+void hotkeys_sample(const char *key, hotkeys_op_t op, unsigned int rate);
+
+static inline void hotkeys_touch(const char *key, hotkeys_op_t op)
+{
+    unsigned int rate = atomic_load_explicit(&hotkeys_sample_rate, memory_order_relaxed);
+    if (rate == 0) return;
+    // A countdown drawn at a larger rate is redrawn, so lowering the rate
+    // takes effect at once
+    if (hotkeys_countdown > 1 && hotkeys_countdown < 2 * rate)
+    {
+        hotkeys_countdown--;
+        return;
+    }
+    hotkeys_sample(key, op, rate);
+}
+
+// Count one request for `key` with the given weight, bypassing sampling
+void hotkeys_record(const char *key, hotkeys_op_t op, uint64_t weight);
+// Copy up to `max` keys into `keys`, hottest first, and return how many
+size_t hotkeys_get(HotKey *keys, size_t max);
+void hotkeys_reset(void);
+
+#define HOTKEYS_MAX_SAMPLE_RATE 1000000
+#define HOTKEYS_MAX_DECAY_SECONDS 86400 // A day
+
+unsigned int hotkeys_get_sample_rate(void);
+void hotkeys_set_sample_rate(unsigned int rate);
+unsigned int hotkeys_decay_seconds(void); // 0: counts never decay
+void hotkeys_set_decay_seconds(unsigned int seconds);
+
+#endif // HOTKEYS_H
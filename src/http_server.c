@@ -1,17 +1,26 @@
 #include "http_server.h"
 #include "commands.h"
 #include "cache.h"
+#include "io.h"
+#include "json.h"
+#include "metrics.h"
+#include "trace.h"
 #include "version.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/uio.h> // For struct iovec
 #include <netinet/in.h>
+#include <sys/un.h> // For sockaddr_un
+#include <sys/stat.h> // For chmod
+#include <poll.h>
 #include <unistd.h>
 #include <ctype.h> // For isxdigit
 #include <sys/time.h> // For usleep
 #include <fcntl.h> // For fcntl
 #include <errno.h> // For errno
+#include <pthread.h>
 
 #include "config.h"
 #define PORT REST_SERVER_PORT
@@ -166,111 +175,1042 @@ static int parse_query_params_safe(char *query, char **key_out, char **value_out
     return (*key_out || *value_out) ? 1 : 0;
 }
 
-// Function to parse JSON payload for POST requests - returns dynamically allocated strings
-static int parse_json_payload(const char *payload, char **key, char **value) {
-    *key = NULL;
-    *value = NULL;
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // Not available on macOS; SO_NOSIGPIPE is set on the socket instead
+#endif
 
-    // Check payload size for security
-    if (!payload || strlen(payload) > MAX_VALUE_LENGTH * 2) {
-        return 0; // Payload too large or null
+#define MAX_RESPONSE_IOV 8
+#define VALUE_JSON_PREFIX "{\"value\":\""
+#define VALUE_JSON_SUFFIX "\"}"
+
+// Headers shared by every response, formatted once at startup. Every
+// connection serves one request, which keep-alive clients are told.
+static char header_prefix[128];
+static size_t header_prefix_len;
+static char text_header_prefix[128]; // Same, for the plain-text /metrics exposition
+static size_t text_header_prefix_len;
+static char unavailable_header_prefix[192]; // JSON headers plus Retry-After, for 503s
+static size_t unavailable_header_prefix_len;
+
+static void init_response_headers(void) {
+    header_prefix_len = snprintf(header_prefix, sizeof(header_prefix),
+                                 "Server: Zu/%s\r\n"
+                                 "Content-Type: application/json\r\n"
+                                 "Connection: close\r\n",
+                                 ZU_VERSION);
+    text_header_prefix_len = snprintf(text_header_prefix, sizeof(text_header_prefix),
+                                      "Server: Zu/%s\r\n"
+                                      "Content-Type: text/plain; version=0.0.4\r\n"
+                                      "Connection: close\r\n",
+                                      ZU_VERSION);
+    unavailable_header_prefix_len = snprintf(unavailable_header_prefix, sizeof(unavailable_header_prefix),
+                                             "%sRetry-After: %d\r\n",
+                                             header_prefix, HTTP_RETRY_AFTER);
+}
+
+// A response assembled as an iovec: status line, shared headers,
+// Content-Length, then body pieces referenced in place.
+typedef struct {
+    struct iovec iov[MAX_RESPONSE_IOV];
+    int iovcnt;
+    size_t total_len;
+    char status_line[96];
+    char length_line[48];
+} Response;
+
+static void response_add(Response *r, const void *data, size_t len) {
+    r->iov[r->iovcnt].iov_base = (void *)data;
+    r->iov[r->iovcnt].iov_len = len;
+    r->iovcnt++;
+    r->total_len += len;
+}
+
+static void response_begin_with(Response *r, int status_code, const char *status_text,
+                                const char *headers, size_t headers_len, size_t body_len) {
+    r->iovcnt = 0;
+    r->total_len = 0;
+    int status_len = snprintf(r->status_line, sizeof(r->status_line), "HTTP/1.1 %d %s\r\n", status_code, status_text);
+    int length_len = snprintf(r->length_line, sizeof(r->length_line), "Content-Length: %zu\r\n\r\n", body_len);
+    response_add(r, r->status_line, status_len);
+    response_add(r, headers, headers_len);
+    response_add(r, r->length_line, length_len);
+}
+
+static void response_begin(Response *r, int status_code, const char *status_text, size_t body_len) {
+    response_begin_with(r, status_code, status_text, header_prefix, header_prefix_len, body_len);
+}
+
+// Add a header line; must be called before any body piece is added
+static void response_add_header(Response *r, const char *line, size_t len) {
+    r->iov[r->iovcnt] = r->iov[r->iovcnt - 1]; // Keep Content-Length and the blank line last
+    r->iov[r->iovcnt - 1].iov_base = (void *)line;
+    r->iov[r->iovcnt - 1].iov_len = len;
+    r->iovcnt++;
+    r->total_len += len;
+}
+
+// Write an iovec with sendmsg, resuming after partial writes. Entries that
+// were fully written get iov_len = 0 and a partially written entry is trimmed,
+// so on return the array describes exactly the unsent bytes.
+// With `nowait` set, stops at the first EAGAIN instead of blocking.
+// Returns the number of bytes sent, or -1 on error.
+static ssize_t send_iov(int client_socket, struct iovec *iov, int iovcnt, int nowait) {
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    size_t total = 0;
+    int first = 0;
+
+    while (first < iovcnt && iov[first].iov_len == 0) first++;
+    while (first < iovcnt) {
+        msg.msg_iov = iov + first;
+        msg.msg_iovlen = iovcnt - first;
+        ssize_t n = sendmsg(client_socket, &msg, MSG_NOSIGNAL | (nowait ? MSG_DONTWAIT : 0));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (nowait && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            return -1; // Includes SO_SNDTIMEO expiry on a blocking socket
+        }
+        total += (size_t)n;
+
+        size_t left = (size_t)n;
+        while (first < iovcnt && left >= iov[first].iov_len) {
+            left -= iov[first].iov_len;
+            iov[first].iov_len = 0;
+            first++;
+        }
+        if (first < iovcnt) {
+            iov[first].iov_base = (char *)iov[first].iov_base + left;
+            iov[first].iov_len -= left;
+        }
     }
+    return (ssize_t)total;
+}
 
-    // Skip leading whitespace
-    while (*payload == ' ' || *payload == '\t' || *payload == '\r' || *payload == '\n') {
-        payload++;
+// Copy the unsent part of an iovec into one heap buffer
+static char *copy_unsent(const struct iovec *iov, int iovcnt, size_t *len_out) {
+    size_t len = 0;
+    for (int i = 0; i < iovcnt; i++) len += iov[i].iov_len;
+    char *copy = malloc(len ? len : 1);
+    if (!copy) return NULL;
+    size_t pos = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        memcpy(copy + pos, iov[i].iov_base, iov[i].iov_len);
+        pos += iov[i].iov_len;
     }
+    *len_out = len;
+    return copy;
+}
+
+// Fast rejection used by admission control. Sent without blocking: a client
+// that cannot take a few hundred bytes right away just sees the connection close.
+static void send_unavailable(int client_socket, const char *body) {
+    Response r;
+    size_t body_len = strlen(body);
+    response_begin_with(&r, 503, "Service Unavailable", unavailable_header_prefix, unavailable_header_prefix_len, body_len);
+    response_add(&r, body, body_len);
+    send_iov(client_socket, r.iov, r.iovcnt, 1);
+}
+
+// Function to send HTTP response
+static void send_response(int client_socket, int status_code, const char *status_text, const char *body) {
+    Response r;
+    size_t body_len = strlen(body);
+    response_begin(&r, status_code, status_text, body_len);
+    response_add(&r, body, body_len);
+    send_iov(client_socket, r.iov, r.iovcnt, 0);
+}
+
+// Return the value of request header `name` (case-insensitive), trimmed and
+// copied into `out`, or NULL if the header is absent
+static const char *request_header(const char *request, const char *name, char *out, size_t out_size) {
+    size_t name_len = strlen(name);
+    const char *line = strchr(request, '\n');
+    while (line && line[1] != '\r' && line[1] != '\n' && line[1] != '\0') {
+        line++;
+        const char *end = strchr(line, '\n');
+        if (!end) end = line + strlen(line);
+        if (strncasecmp(line, name, name_len) == 0 && line[name_len] == ':') {
+            const char *value = line + name_len + 1;
+            while (value < end && (*value == ' ' || *value == '\t')) value++;
+            size_t len = end - value;
+            while (len > 0 && (value[len - 1] == '\r' || value[len - 1] == ' ')) len--;
+            if (len >= out_size) len = out_size - 1;
+            memcpy(out, value, len);
+            out[len] = '\0';
+            return out;
+        }
+        line = *end ? end : NULL;
+    }
+    return NULL;
+}
+
+typedef struct {
+    int client_socket;
+    const char *if_none_match; // Client's If-None-Match header, or NULL
+    char *pending;      // Unsent tail, copied out before the borrowed value is released
+    size_t pending_len;
+    int failed;
+} ValueReply;
+
+// True if an If-None-Match list contains `etag` (weak tags compare equal too)
+static int etag_matches(const char *if_none_match, const char *etag) {
+    if (strcmp(if_none_match, "*") == 0) return 1;
+    return strstr(if_none_match, etag) != NULL;
+}
+
+// Called with a value borrowed from the cache (under its lock) or from disk.
+// Sends {"value":"..."} straight from the value's bytes; whatever the socket
+// cannot take right away is copied so the lock is never held across a blocking write.
+// A matching If-None-Match is answered with a bodiless 304 without touching the value.
+static void send_value_reply(const char *value, size_t value_len, uint64_t content_hash, void *ctx) {
+    ValueReply *reply = ctx;
+    char *escaped = NULL;
+
+    char etag[24];
+    snprintf(etag, sizeof(etag), "\"%016llx\"", (unsigned long long)content_hash);
+    char etag_line[32];
+    int etag_line_len = snprintf(etag_line, sizeof(etag_line), "ETag: %s\r\n", etag);
+
+    if (reply->if_none_match && etag_matches(reply->if_none_match, etag)) {
+        static const char not_modified[] = "HTTP/1.1 304 Not Modified\r\n";
+        struct iovec iov[4] = {
+            {(void *)not_modified, sizeof(not_modified) - 1},
+            {header_prefix, header_prefix_len},
+            {etag_line, etag_line_len},
+            {(void *)"\r\n", 2},
+        };
+        size_t total = iov[0].iov_len + iov[1].iov_len + iov[2].iov_len + iov[3].iov_len;
+        ssize_t sent = send_iov(reply->client_socket, iov, 4, 1);
+        if (sent < 0) {
+            reply->failed = 1;
+        } else if ((size_t)sent < total) {
+            reply->pending = copy_unsent(iov, 4, &reply->pending_len);
+            if (!reply->pending) reply->failed = 1;
+        }
+        return;
+    }
+
+    if (json_plain_prefix(value, value_len) < value_len) {
+        escaped = json_escape(value, value_len, &value_len);
+        if (!escaped) {
+            reply->failed = 1;
+            return;
+        }
+        value = escaped;
+    }
+
+    Response r;
+    response_begin(&r, 200, "OK", sizeof(VALUE_JSON_PREFIX) - 1 + value_len + sizeof(VALUE_JSON_SUFFIX) - 1);
+    response_add_header(&r, etag_line, etag_line_len);
+    response_add(&r, VALUE_JSON_PREFIX, sizeof(VALUE_JSON_PREFIX) - 1);
+    response_add(&r, value, value_len);
+    response_add(&r, VALUE_JSON_SUFFIX, sizeof(VALUE_JSON_SUFFIX) - 1);
+
+    ssize_t sent = send_iov(reply->client_socket, r.iov, r.iovcnt, 1);
+    if (sent < 0) {
+        reply->failed = 1;
+    } else if ((size_t)sent < r.total_len) {
+        reply->pending = copy_unsent(r.iov, r.iovcnt, &reply->pending_len);
+        if (!reply->pending) reply->failed = 1;
+    }
+    free(escaped);
+}
+
+// Return the URL-decoded value of query parameter `name`, or NULL if absent
+static char *query_param(const char *query, const char *name) {
+    if (!query) return NULL;
+    size_t name_len = strlen(name);
+    const char *p = query;
+
+    while (*p) {
+        const char *end = strchr(p, '&');
+        if (!end) end = p + strlen(p);
+        if ((size_t)(end - p) > name_len && strncmp(p, name, name_len) == 0 && p[name_len] == '=') {
+            char *raw = strndup(p + name_len + 1, end - p - name_len - 1);
+            if (!raw) return NULL;
+            char *decoded = url_decode(raw);
+            free(raw);
+            return decoded;
+        }
+        if (!*end) break;
+        p = end + 1;
+    }
+    return NULL;
+}
+
+// Parse a non-negative decimal query parameter. Returns 0 if it is malformed.
+static int parse_long_param(const char *text, long *out) {
+    if (!text || !*text) return 0;
+    char *end;
+    errno = 0;
+    long value = strtol(text, &end, 10);
+    if (errno != 0 || *end != '\0' || value < 0) return 0;
+    *out = value;
+    return 1;
+}
+
+// --- Chunked transfer encoding ---
+
+#define CHUNK_BUFFER_SIZE 16384
+
+// Accumulates small writes and emits them as HTTP/1.1 chunks
+typedef struct {
+    int client_socket;
+    size_t len;
+    int failed;
+    char data[CHUNK_BUFFER_SIZE];
+} ChunkWriter;
+
+static void send_chunked_headers(int client_socket, int status_code, const char *status_text) {
+    static const char chunked[] = "Transfer-Encoding: chunked\r\n\r\n";
+    char status_line[96];
+    int status_len = snprintf(status_line, sizeof(status_line), "HTTP/1.1 %d %s\r\n", status_code, status_text);
+    struct iovec iov[3] = {
+        {status_line, status_len},
+        {header_prefix, header_prefix_len},
+        {(void *)chunked, sizeof(chunked) - 1},
+    };
+    send_iov(client_socket, iov, 3, 0);
+}
+
+static void chunk_flush(ChunkWriter *w) {
+    if (w->len == 0 || w->failed) return;
+    char size_line[24];
+    int size_len = snprintf(size_line, sizeof(size_line), "%zx\r\n", w->len);
+    struct iovec iov[3] = {
+        {size_line, size_len},
+        {w->data, w->len},
+        {(void *)"\r\n", 2},
+    };
+    if (send_iov(w->client_socket, iov, 3, 0) < 0) w->failed = 1;
+    w->len = 0;
+}
+
+static void chunk_write(ChunkWriter *w, const char *data, size_t len) {
+    while (len > 0 && !w->failed) {
+        size_t room = CHUNK_BUFFER_SIZE - w->len;
+        size_t n = len < room ? len : room;
+        memcpy(w->data + w->len, data, n);
+        w->len += n;
+        data += n;
+        len -= n;
+        if (w->len == CHUNK_BUFFER_SIZE) chunk_flush(w);
+    }
+}
+
+static void chunk_write_str(ChunkWriter *w, const char *s) {
+    chunk_write(w, s, strlen(s));
+}
+
+static void chunk_write_json_string(ChunkWriter *w, const char *s) {
+    size_t len = strlen(s);
+    chunk_write(w, "\"", 1);
+    if (json_plain_prefix(s, len) < len) {
+        size_t escaped_len;
+        char *escaped = json_escape(s, len, &escaped_len);
+        if (!escaped) {
+            w->failed = 1;
+            return;
+        }
+        chunk_write(w, escaped, escaped_len);
+        free(escaped);
+    } else {
+        chunk_write(w, s, len);
+    }
+    chunk_write(w, "\"", 1);
+}
+
+static void chunk_end(ChunkWriter *w) {
+    chunk_flush(w);
+    if (!w->failed) {
+        struct iovec last = {(void *)"0\r\n\r\n", 5};
+        send_iov(w->client_socket, &last, 1, 0);
+    }
+}
+
+// GET /scan?cursor=&count=&prefix=&values=1
+// Streams one page of keys (optionally with values) in key order and the cursor
+// to resume from: the key the next page starts at, or null when done. The
+// database is read SCAN_BATCH_SIZE records at a time, so neither the response
+// nor the file lock scales with the size of the export.
+static void handle_scan(int client_socket, const char *query) {
+    char *cursor = query_param(query, "cursor");
+    char *count_param = query_param(query, "count");
+    char *values_param = query_param(query, "values");
+    char *prefix = query_param(query, "prefix");
+
+    long count = SCAN_DEFAULT_COUNT;
+    int valid = !count_param || (parse_long_param(count_param, &count) && count > 0);
+    int with_values = values_param && (strcmp(values_param, "1") == 0 || strcmp(values_param, "true") == 0);
+    free(count_param);
+    free(values_param);
+    if (cursor && !*cursor) {
+        free(cursor); // An empty cursor starts from the first key
+        cursor = NULL;
+    }
+
+    if (!valid) {
+        send_response(client_socket, 400, "Bad Request", "{\"error\":\"Invalid count\"}");
+        free(cursor);
+        free(prefix);
+        return;
+    }
+
+    metrics_inc(METRIC_CMD_SCAN);
+    send_chunked_headers(client_socket, 200, "OK");
+    ChunkWriter *w = malloc(sizeof(ChunkWriter));
+    if (!w) {
+        free(cursor);
+        free(prefix);
+        return; // Headers are out; closing the connection truncates the response
+    }
+    w->client_socket = client_socket;
+    w->len = 0;
+    w->failed = 0;
+
+    chunk_write_str(w, with_values ? "{\"items\":[" : "{\"keys\":[");
 
-    // Simple JSON parsing for {"key":"...", "value":"..."} with whitespace tolerance
-    char *key_start = strstr(payload, "\"key\"");
-    char *value_start = strstr(payload, "\"value\"");
+    long returned = 0;
+    int read_ok = 1;
+    do {
+        DataItem *page = NULL;
+        size_t page_size = 0;
+        size_t page_capacity = 0;
+        size_t wanted = (size_t)(count - returned);
+        if (wanted > SCAN_BATCH_SIZE) wanted = SCAN_BATCH_SIZE;
 
-    if (key_start) {
-        // Find the colon after "key"
-        char *colon = strchr(key_start, ':');
-        if (colon) {
-            // Skip whitespace after colon
-            colon++;
-            while (*colon == ' ' || *colon == '\t' || *colon == '\r' || *colon == '\n') {
-                colon++;
+        char *next = NULL;
+        int ok = scan_disk_page(cursor, prefix, wanted, with_values, &page, &page_size, &page_capacity, &next);
+        free(cursor);
+        cursor = next;
+        if (!ok) {
+            free_data_list(&page, &page_size, &page_capacity);
+            read_ok = 0;
+            break;
+        }
+
+        // Records are sent after the file lock has been released
+        for (size_t i = 0; i < page_size; i++) {
+            if (returned + (long)i > 0) chunk_write(w, ",", 1);
+            if (with_values) {
+                chunk_write_str(w, "{\"key\":");
+                chunk_write_json_string(w, page[i].key);
+                chunk_write_str(w, ",\"value\":");
+                chunk_write_json_string(w, page[i].value);
+                chunk_write(w, "}", 1);
+            } else {
+                chunk_write_json_string(w, page[i].key);
             }
-            // Expect opening quote
-            if (*colon == '"') {
-                colon++; // Skip opening quote
-                char *key_end = strchr(colon, '"');
-                if (key_end) {
-                    int key_len = key_end - colon;
-
-                    // Validate key length before allocation
-                    if (key_len <= 0 || key_len > MAX_KEY_LENGTH) {
-                        return 0; // Invalid key length
-                    }
+        }
+        returned += (long)page_size;
+        free_data_list(&page, &page_size, &page_capacity);
+    } while (cursor && returned < count && !w->failed);
 
-                    *key = malloc(key_len + 1);
-                    if (*key) {
-                        memcpy(*key, colon, key_len);
-                        (*key)[key_len] = '\0'; // Ensure null termination
-                    } else {
-                        return 0; // Memory allocation failed
-                    }
+    chunk_write_str(w, "],\"cursor\":");
+    if (cursor) chunk_write_json_string(w, cursor);
+    else chunk_write_str(w, "null");
+    if (!read_ok) chunk_write_str(w, ",\"error\":\"Error reading database\"");
+    chunk_write(w, "}", 1);
+    chunk_end(w);
+
+    free(w);
+    free(cursor);
+    free(prefix);
+}
+
+// GET /range?start=&end=&prefix=&limit=&values=1
+// Keys in [start, end) and/or under a prefix, in key order, served from the key
+// index. "next" is the start of the following page, or null when done.
+static void handle_range(int client_socket, const char *query) {
+    char *start = query_param(query, "start");
+    char *end = query_param(query, "end");
+    char *prefix = query_param(query, "prefix");
+    char *limit_param = query_param(query, "limit");
+    char *values_param = query_param(query, "values");
+
+    long limit = SCAN_DEFAULT_COUNT;
+    int valid = !limit_param || (parse_long_param(limit_param, &limit) && limit > 0);
+    int with_values = values_param && (strcmp(values_param, "1") == 0 || strcmp(values_param, "true") == 0);
+    free(limit_param);
+    free(values_param);
+
+    DataItem *items = NULL;
+    size_t size = 0;
+    size_t capacity = 0;
+    char *next = NULL;
+    int result = CMD_ERROR;
+    if (!valid) {
+        send_response(client_socket, 400, "Bad Request", "{\"error\":\"Invalid limit\"}");
+    } else {
+        size_t count = limit > RANGE_MAX_COUNT ? RANGE_MAX_COUNT : (size_t)limit;
+        if (prefix && *prefix) {
+            result = zscan_command(prefix, start, count, with_values, &items, &size, &capacity, &next);
+        } else {
+            result = zrange_command(start, end, count, with_values, &items, &size, &capacity, &next);
+        }
+        if (result != CMD_SUCCESS) {
+            send_response(client_socket, 500, "Internal Server Error", "{\"error\":\"Error reading database\"}");
+        }
+    }
+
+    if (result == CMD_SUCCESS) {
+        ChunkWriter *w = malloc(sizeof(ChunkWriter));
+        if (w) {
+            send_chunked_headers(client_socket, 200, "OK");
+            w->client_socket = client_socket;
+            w->len = 0;
+            w->failed = 0;
+            chunk_write_str(w, with_values ? "{\"items\":[" : "{\"keys\":[");
+            for (size_t i = 0; i < size; i++) {
+                if (i > 0) chunk_write(w, ",", 1);
+                if (with_values) {
+                    chunk_write_str(w, "{\"key\":");
+                    chunk_write_json_string(w, items[i].key);
+                    chunk_write_str(w, ",\"value\":");
+                    chunk_write_json_string(w, items[i].value);
+                    chunk_write(w, "}", 1);
+                } else {
+                    chunk_write_json_string(w, items[i].key);
                 }
             }
+            chunk_write_str(w, "],\"next\":");
+            if (next) chunk_write_json_string(w, next);
+            else chunk_write_str(w, "null");
+            chunk_write(w, "}", 1);
+            chunk_end(w);
+            free(w);
+        } else {
+            send_response(client_socket, 500, "Internal Server Error", "{\"error\":\"Out of memory\"}");
         }
     }
 
-    if (value_start) {
-        // Find the colon after "value"
-        char *colon = strchr(value_start, ':');
-        if (colon) {
-            // Skip whitespace after colon
-            colon++;
-            while (*colon == ' ' || *colon == '\t' || *colon == '\r' || *colon == '\n') {
-                colon++;
-            }
-            // Expect opening quote
-            if (*colon == '"') {
-                colon++; // Skip opening quote
-                char *value_end = strchr(colon, '"');
-                if (value_end) {
-                    int value_len = value_end - colon;
-
-                    // Validate value length before allocation
-                    if (value_len <= 0 || value_len > MAX_VALUE_LENGTH) {
-                        if (*key) free(*key);
-                        *key = NULL;
-                        return 0; // Invalid value length
-                    }
+    free_data_list(&items, &size, &capacity);
+    free(next);
+    free(start);
+    free(end);
+    free(prefix);
+}
 
-                    *value = malloc(value_len + 1);
-                    if (*value) {
-                        memcpy(*value, colon, value_len);
-                        (*value)[value_len] = '\0'; // Ensure null termination
-                    } else {
-                        if (*key) free(*key);
-                        *key = NULL;
-                        return 0; // Memory allocation failed
-                    }
+// Every write rewrites the database file; past the limit, shed load instead of
+// parking more workers behind the writer. Returns 0 after answering with a 503.
+static int begin_write(int client_socket) {
+    if (metrics_gauge_add(GAUGE_HTTP_INFLIGHT_WRITES, 1) > HTTP_MAX_INFLIGHT_WRITES) {
+        metrics_gauge_add(GAUGE_HTTP_INFLIGHT_WRITES, -1);
+        metrics_inc(METRIC_HTTP_REJECTED_STORAGE);
+        send_unavailable(client_socket, "{\"error\":\"Storage busy\"}");
+        return 0;
+    }
+    return 1;
+}
+
+static void end_write(void) {
+    metrics_gauge_add(GAUGE_HTTP_INFLIGHT_WRITES, -1);
+}
+
+// Parse a JSON object body into the named string fields. Answers 400 and
+// returns 0 if the body is malformed or a field in `required` (a prefix of
+// `names`) is missing or empty.
+static int parse_body_fields(int client_socket, const char *body, size_t body_len,
+                             const char *const *names, char **values, size_t count, size_t required) {
+    if (!body || json_parse_fields(body, body_len, names, values, count) != JSON_OK) {
+        send_response(client_socket, 400, "Bad Request", "{\"error\":\"Invalid JSON payload\"}");
+        return 0;
+    }
+    for (size_t i = 0; i < required; i++) {
+        if (!values[i] || !*values[i] || (i == 0 && strlen(values[i]) > MAX_KEY_LENGTH)) {
+            send_response(client_socket, 400, "Bad Request", "{\"error\":\"Missing or invalid field in JSON payload\"}");
+            for (size_t j = 0; j < count; j++) free(values[j]);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// POST /incr {"key":...,"by":N} - "by" defaults to 1 and may be negative
+static void handle_incr(int client_socket, const char *body, size_t body_len) {
+    static const char *const names[] = {"key", "by"};
+    char *fields[2];
+    if (!parse_body_fields(client_socket, body, body_len, names, fields, 2, 1)) return;
+
+    long long delta = 1;
+    if (fields[1]) {
+        char *end;
+        errno = 0;
+        delta = strtoll(fields[1], &end, 10);
+        if (errno != 0 || end == fields[1] || *end != '\0') {
+            send_response(client_socket, 400, "Bad Request", "{\"error\":\"Invalid increment\"}");
+            free(fields[0]);
+            free(fields[1]);
+            return;
+        }
+    }
+
+    if (begin_write(client_socket)) {
+        long long value = 0;
+        int result = zincr_command(fields[0], delta, &value);
+        end_write();
+        if (result == CMD_SUCCESS) {
+            char reply[64];
+            snprintf(reply, sizeof(reply), "{\"value\":%lld}", value);
+            send_response(client_socket, 200, "OK", reply);
+        } else if (result == CMD_NOT_INTEGER) {
+            send_response(client_socket, 400, "Bad Request", "{\"error\":\"Value is not an integer or would overflow\"}");
+        } else {
+            send_response(client_socket, 500, "Internal Server Error", "{\"error\":\"Error updating key\"}");
+        }
+    }
+    free(fields[0]);
+    free(fields[1]);
+}
+
+// POST /append {"key":...,"value":...}
+static void handle_append(int client_socket, const char *body, size_t body_len) {
+    static const char *const names[] = {"key", "value"};
+    char *fields[2];
+    if (!parse_body_fields(client_socket, body, body_len, names, fields, 2, 2)) return;
+
+    if (begin_write(client_socket)) {
+        long long length = 0;
+        int result = zappend_command(fields[0], fields[1], &length);
+        end_write();
+        if (result == CMD_SUCCESS) {
+            char reply[64];
+            snprintf(reply, sizeof(reply), "{\"length\":%lld}", length);
+            send_response(client_socket, 200, "OK", reply);
+        } else {
+            send_response(client_socket, 500, "Internal Server Error", "{\"error\":\"Error updating key\"}");
+        }
+    }
+    free(fields[0]);
+    free(fields[1]);
+}
+
+// POST /cas {"key":...,"expected":...,"value":...} - 409 if the value changed
+static void handle_cas(int client_socket, const char *body, size_t body_len) {
+    static const char *const names[] = {"key", "value", "expected"};
+    char *fields[3];
+    if (!parse_body_fields(client_socket, body, body_len, names, fields, 3, 2)) return;
+
+    if (!fields[2]) {
+        send_response(client_socket, 400, "Bad Request", "{\"error\":\"Missing or invalid field in JSON payload\"}");
+    } else if (begin_write(client_socket)) {
+        int result = zcas_command(fields[0], fields[2], fields[1]);
+        end_write();
+        if (result == CMD_SUCCESS) {
+            send_response(client_socket, 200, "OK", "{\"status\":\"OK\"}");
+        } else if (result == CMD_MISMATCH) {
+            send_response(client_socket, 409, "Conflict", "{\"error\":\"Value does not match expected\"}");
+        } else {
+            send_response(client_socket, 500, "Internal Server Error", "{\"error\":\"Error updating key\"}");
+        }
+    }
+    for (int i = 0; i < 3; i++) free(fields[i]);
+}
+
+// Accumulates a /txn body while it is parsed
+typedef struct {
+    Transaction txn;
+    const char *error; // Set when an element is rejected
+} TxnRequest;
+
+enum { TXN_KEY, TXN_OP, TXN_VALUE, TXN_EXPECTED, TXN_BY, TXN_ETAG, TXN_FIELD_COUNT };
+
+static int parse_etag(const char *etag, uint64_t *content_hash) {
+    size_t len = strlen(etag);
+    if (len >= 2 && etag[0] == '"' && etag[len - 1] == '"') {
+        etag++;
+        len -= 2;
+    }
+    if (len == 0 || len > 16) return 0;
+    *content_hash = 0;
+    for (size_t i = 0; i < len; i++) {
+        int digit = isdigit((unsigned char)etag[i]) ? etag[i] - '0'
+                  : isxdigit((unsigned char)etag[i]) ? tolower((unsigned char)etag[i]) - 'a' + 10 : -1;
+        if (digit < 0) return 0;
+        *content_hash = *content_hash << 4 | (uint64_t)digit;
+    }
+    return 1;
+}
+
+// One element of "watch" (array 0) or "ops" (array 1)
+static int queue_txn_element(size_t array, char **fields, void *ctx) {
+    TxnRequest *t = ctx;
+    const char *key = fields[TXN_KEY];
+    if (!key || !*key || strlen(key) > MAX_KEY_LENGTH) {
+        t->error = "{\"error\":\"Missing or invalid key in transaction\"}";
+        return 0;
+    }
+
+    if (array == 0) {
+        // "etag" is the ETag the value was read with; null means the key must not exist
+        uint64_t content_hash = 0;
+        const char *etag = fields[TXN_ETAG];
+        int exists = etag && strcmp(etag, "null") != 0;
+        if (!etag || (exists && !parse_etag(etag, &content_hash))) {
+            t->error = "{\"error\":\"Missing or invalid etag in watch\"}";
+            return 0;
+        }
+        if (txn_watch_version(&t->txn, key, exists, content_hash) != CMD_SUCCESS) {
+            t->error = "{\"error\":\"Invalid watch\"}";
+            return 0;
+        }
+        return 1;
+    }
+
+    static const struct { const char *name; write_op_t op; } op_names[] = {
+        {"set", WRITE_SET}, {"del", WRITE_DELETE}, {"incr", WRITE_INCR}, {"append", WRITE_APPEND}, {"cas", WRITE_CAS}
+    };
+    const char *name = fields[TXN_OP];
+    size_t which = 0;
+    while (name && which < sizeof(op_names) / sizeof(op_names[0]) && strcmp(name, op_names[which].name) != 0) which++;
+    if (!name || which == sizeof(op_names) / sizeof(op_names[0])) {
+        t->error = "{\"error\":\"Unknown op in transaction\"}";
+        return 0;
+    }
+
+    long long delta = 1;
+    if (op_names[which].op == WRITE_INCR && fields[TXN_BY]) {
+        char *end;
+        errno = 0;
+        delta = strtoll(fields[TXN_BY], &end, 10);
+        if (errno != 0 || end == fields[TXN_BY] || *end != '\0') {
+            t->error = "{\"error\":\"Invalid increment\"}";
+            return 0;
+        }
+    }
+    if (txn_queue(&t->txn, op_names[which].op, key, fields[TXN_VALUE], fields[TXN_EXPECTED], delta) != CMD_SUCCESS) {
+        t->error = "{\"error\":\"Missing or invalid field in transaction\"}";
+        return 0;
+    }
+    return 1;
+}
+
+// POST /txn {"watch":[{"key":...,"etag":...}],"ops":[{"op":"set","key":...,"value":...},...]}
+// Ops are set, del, incr ("by"), append and cas ("expected"); they commit
+// all-or-nothing, and 409 means a watched key changed or a cas did not match.
+static void handle_txn(int client_socket, const char *body, size_t body_len) {
+    static const char *const arrays[] = {"watch", "ops"};
+    static const char *const names[] = {"key", "op", "value", "expected", "by", "etag"};
+    TxnRequest t = {.error = NULL};
+    txn_init(&t.txn);
+
+    if (!body || json_parse_object_arrays(body, body_len, arrays, 2, names, TXN_FIELD_COUNT, queue_txn_element, &t) != JSON_OK) {
+        send_response(client_socket, 400, "Bad Request", t.error ? t.error : "{\"error\":\"Invalid JSON payload\"}");
+        txn_reset(&t.txn);
+        return;
+    }
+    if (t.txn.count == 0) {
+        send_response(client_socket, 400, "Bad Request", "{\"error\":\"Transaction has no ops\"}");
+        txn_reset(&t.txn);
+        return;
+    }
+    if (!begin_write(client_socket)) {
+        txn_reset(&t.txn);
+        return;
+    }
+    int result = zexec_command(&t.txn);
+    end_write();
+
+    if (result == CMD_SUCCESS) {
+        // Per op: the new value for incr, the new length for append, else whether it applied
+        char *reply = malloc(t.txn.count * 24 + 32);
+        if (!reply) {
+            send_response(client_socket, 500, "Internal Server Error", "{\"error\":\"Out of memory\"}");
+        } else {
+            size_t len = (size_t)sprintf(reply, "{\"results\":[");
+            for (size_t i = 0; i < t.txn.count; i++) {
+                const WriteOp *op = &t.txn.ops[i];
+                if (i > 0) reply[len++] = ',';
+                if (op->op == WRITE_INCR || op->op == WRITE_APPEND) {
+                    len += (size_t)sprintf(reply + len, "%lld", op->number);
+                } else {
+                    len += (size_t)sprintf(reply + len, "%s", op->result == WRITE_APPLIED ? "true" : "false");
                 }
             }
+            strcpy(reply + len, "]}");
+            send_response(client_socket, 200, "OK", reply);
+            free(reply);
         }
+    } else if (result == CMD_MISMATCH) {
+        send_response(client_socket, 409, "Conflict", "{\"error\":\"Transaction aborted\"}");
+    } else if (result == CMD_NOT_INTEGER) {
+        send_response(client_socket, 400, "Bad Request", "{\"error\":\"Value is not an integer or would overflow\"}");
+    } else {
+        send_response(client_socket, 500, "Internal Server Error", "{\"error\":\"Error applying transaction\"}");
     }
+    txn_reset(&t.txn);
+}
 
-    return (*key != NULL && *value != NULL) ? 1 : 0;
+// Start of the request body, or NULL if the headers never ended
+static const char *request_body(const char *request, size_t request_len, size_t *body_len) {
+    const char *body = strstr(request, "\r\n\r\n");
+    if (body) {
+        body += 4;
+    } else if ((body = strstr(request, "\n\n")) != NULL) {
+        body += 2;
+    } else {
+        return NULL;
+    }
+    *body_len = request + request_len - body;
+    return body;
 }
 
-// Function to send HTTP response
-static void send_response(int client_socket, int status_code, const char *status_text, const char *body) {
-    // Use smaller buffer for response headers (responses are much smaller than requests)
-    char response[4096];
-    snprintf(response, sizeof(response), 
-             "HTTP/1.1 %d %s\r\n"
-             "Server: Zu/%s\r\n"
-             "Content-Type: application/json\r\n"
-             "Content-Length: %zu\r\n"
-             "\r\n"
-             "%s", 
-             status_code, status_text, ZU_VERSION, strlen(body), body);
-    send(client_socket, response, strlen(response), 0);
+// POST /set body: one {"key":...,"value":...} object or a batch array of them
+static void handle_set_payload(int client_socket, const char *payload, size_t payload_len) {
+    DataItem *items = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+
+    int parse_result = json_parse_set_payload(payload, payload_len, &items, &count, &capacity);
+
+    #if DEBUG_HTTP
+    printf("DEBUG: Parsed %zu item(s), status %d\n", count, parse_result);
+    #endif
+
+    if (parse_result == JSON_INVALID) {
+        send_response(client_socket, 400, "Bad Request", "{\"error\":\"Invalid JSON payload\"}");
+        return;
+    }
+    if (parse_result != JSON_OK) {
+        send_response(client_socket, 400, "Bad Request", "{\"error\":\"Missing key or value in JSON payload\"}");
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (strlen(items[i].key) == 0 || strlen(items[i].value) == 0) {
+            send_response(client_socket, 400, "Bad Request", "{\"error\":\"Missing key or value in JSON payload\"}");
+            free_data_list(&items, &count, &capacity);
+            return;
+        }
+        if (strlen(items[i].key) > MAX_KEY_LENGTH) {
+            send_response(client_socket, 400, "Bad Request", "{\"error\":\"Key too long\"}");
+            free_data_list(&items, &count, &capacity);
+            return;
+        }
+    }
+
+    if (!begin_write(client_socket)) {
+        free_data_list(&items, &count, &capacity);
+        return;
+    }
+
+    size_t applied = 0;
+    while (applied < count && zset_command(items[applied].key, items[applied].value) == CMD_SUCCESS) {
+        applied++;
+    }
+    end_write();
+
+    if (applied == count && count == 1) {
+        send_response(client_socket, 201, "OK", "{\"status\":\"OK\"}");
+    } else if (applied == count) {
+        char body[64];
+        snprintf(body, sizeof(body), "{\"status\":\"OK\",\"count\":%zu}", count);
+        send_response(client_socket, 201, "OK", body);
+    } else {
+        char body[96];
+        snprintf(body, sizeof(body), "{\"error\":\"Error setting key\",\"applied\":%zu}", applied);
+        send_response(client_socket, 500, "Internal Server Error", body);
+    }
+    free_data_list(&items, &count, &capacity);
+}
+
+// GET /metrics in the Prometheus text format
+static void handle_metrics(int client_socket) {
+    size_t len;
+    char *body = metrics_render(&len);
+    if (!body) {
+        send_response(client_socket, 500, "Internal Server Error", "{\"error\":\"Memory allocation failed\"}");
+        return;
+    }
+    Response r;
+    response_begin_with(&r, 200, "OK", text_header_prefix, text_header_prefix_len, len);
+    response_add(&r, body, len);
+    send_iov(client_socket, r.iov, r.iovcnt, 0);
+    free(body);
+}
+
+// GET /stats[?reset=1]: storage I/O per operation and cache activity as JSON
+static void handle_stats(int client_socket, const char *query) {
+    char *reset_param = query_param(query, "reset");
+    int reset = reset_param && strcmp(reset_param, "0") != 0;
+    free(reset_param);
+
+    StorageStats *stats = malloc(sizeof(StorageStats));
+    size_t cap = 8192, len = 0;
+    char *body = malloc(cap);
+    if (!stats || !body || stats_command(stats, reset) != CMD_SUCCESS) {
+        free(stats);
+        free(body);
+        send_response(client_socket, 500, "Internal Server Error", "{\"error\":\"Memory allocation failed\"}");
+        return;
+    }
+    // Fits: every number is at most 20 digits and the names are fixed
+    len += snprintf(body + len, cap - len,
+                    "{\"cache\":{\"hits\":%llu,\"misses\":%llu,\"evictions\":%llu,\"expirations\":%llu},\"io\":{",
+                    (unsigned long long)stats->cache_hits, (unsigned long long)stats->cache_misses,
+                    (unsigned long long)stats->cache_evictions, (unsigned long long)stats->cache_expirations);
+    for (int op = 0; op < IO_OP_KIND_COUNT; op++) {
+        len += snprintf(body + len, cap - len, "%s\"%s\":{", op ? "," : "", metrics_io_op_name((io_op_t)op));
+        for (int stat = 0; stat < IO_STAT_KIND_COUNT; stat++) {
+            len += snprintf(body + len, cap - len, "%s\"%s\":%llu", stat ? "," : "",
+                            metrics_io_stat_name((io_stat_t)stat), (unsigned long long)stats->io[op][stat]);
+        }
+        len += snprintf(body + len, cap - len, "}");
+    }
+    snprintf(body + len, cap - len, "}}");
+    send_response(client_socket, 200, "OK", body);
+    free(body);
+    free(stats);
+}
+
+// GET /memory: bytes held by each structure, allocator overhead and load factors
+static void handle_memory(int client_socket) {
+    MemoryStats m;
+    char body[2048];
+    memory_command(&m);
+    snprintf(body, sizeof(body),
+             "{\"cache\":{\"entries\":%zu,\"keys\":%zu,\"values\":%zu,\"buckets\":%zu,\"allocated\":%zu,"
+             "\"items\":%u,\"bucket_count\":%u,\"used_buckets\":%u},"
+             "\"index\":{\"bytes\":%zu,\"entries\":%zu,\"entry_capacity\":%zu,\"key_bytes\":%zu,\"key_capacity\":%zu},"
+             "\"bloom\":{\"bytes\":%zu,\"keys\":%zu},\"memtable\":{\"bytes\":%zu},\"http_buffers\":{\"bytes\":%zu},"
+             "\"heap\":{\"mapped\":%zu,\"in_use\":%zu,\"free\":%zu}}",
+             m.cache_entries, m.cache_keys, m.cache_values, m.cache_buckets, m.cache_allocated, m.cache_items,
+             m.cache_bucket_count, m.cache_used_buckets, m.index_bytes, m.index_entries, m.index_entry_capacity,
+             m.index_key_bytes, m.index_key_capacity, m.bloom_bytes, m.bloom_keys, m.memtable_bytes, m.http_buffers,
+             m.heap_mapped, m.heap_in_use, m.heap_free);
+    send_response(client_socket, 200, "OK", body);
+}
+
+// GET /slowlog[?count=n][&reset=1]: the slowest recent commands, newest first,
+// then clear the log if `reset` is set
+static void handle_slowlog(int client_socket, const char *query) {
+    char *count_param = query_param(query, "count");
+    char *reset_param = query_param(query, "reset");
+    long count = 10;
+    int valid = !count_param || (parse_long_param(count_param, &count) && count >= 0);
+    int reset = reset_param && strcmp(reset_param, "0") != 0;
+    free(count_param);
+    free(reset_param);
+    if (!valid) {
+        send_response(client_socket, 400, "Bad Request", "{\"error\":\"Invalid count\"}");
+        return;
+    }
+    if (count > SLOWLOG_MAX_LEN) count = SLOWLOG_MAX_LEN;
+
+    size_t returned = 0, len = 0;
+    uint64_t threshold_us;
+    // An escaped key is at most 6 bytes per byte kept, plus the fixed fields
+    size_t cap = 128 + (size_t)count * (6 * SLOWLOG_KEY_LEN + 256);
+    SlowlogEntry *entries = malloc((count ? (size_t)count : 1) * sizeof(SlowlogEntry));
+    char *body = malloc(cap);
+    if (!entries || !body) {
+        free(entries);
+        free(body);
+        send_response(client_socket, 500, "Internal Server Error", "{\"error\":\"Memory allocation failed\"}");
+        return;
+    }
+    slowlog_get_command(entries, (size_t)count, &returned);
+    slowlog_threshold_command(-1, &threshold_us);
+    if (reset) slowlog_reset_command();
+
+    len += snprintf(body + len, cap - len, "{\"threshold_us\":%llu,\"entries\":[", (unsigned long long)threshold_us);
+    for (size_t i = 0; i < returned; i++) {
+        const SlowlogEntry *e = &entries[i];
+        size_t key_len;
+        char *key = json_escape(e->key, strlen(e->key), &key_len);
+        len += snprintf(body + len, cap - len,
+                        "%s{\"id\":%llu,\"timestamp_us\":%llu,\"duration_us\":%.3f,\"command\":\"%s\",\"path\":\"%s\","
+                        "\"bytes_read\":%llu,\"key\":\"%.*s\",\"key_length\":%zu}",
+                        i ? "," : "", (unsigned long long)e->id, (unsigned long long)e->timestamp_us,
+                        e->duration_ns / 1000.0, e->command, slowlog_path_name(e->path),
+                        (unsigned long long)e->bytes_read, key ? (int)key_len : 0, key ? key : "", e->key_length);
+        free(key);
+    }
+    snprintf(body + len, cap - len, "]}");
+    send_response(client_socket, 200, "OK", body);
+    free(body);
+    free(entries);
+}
+
+// GET /hotkeys[?count=n][&sample=n][&decay=s][&reset=1]: the most requested
+// keys, hottest first, then apply the new sample rate and decay window and
+// clear the counts as asked
+static void handle_hotkeys(int client_socket, const char *query) {
+    char *count_param = query_param(query, "count");
+    char *sample_param = query_param(query, "sample");
+    char *decay_param = query_param(query, "decay");
+    char *reset_param = query_param(query, "reset");
+    long count = 10, sample = -1, decay = -1;
+    int valid = (!count_param || (parse_long_param(count_param, &count) && count >= 0)) &&
+                (!sample_param || (parse_long_param(sample_param, &sample) && sample >= 0 &&
+                                   sample <= HOTKEYS_MAX_SAMPLE_RATE)) &&
+                (!decay_param || (parse_long_param(decay_param, &decay) && decay >= 0 &&
+                                  decay <= HOTKEYS_MAX_DECAY_SECONDS));
+    int reset = reset_param && strcmp(reset_param, "0") != 0;
+    free(count_param);
+    free(sample_param);
+    free(decay_param);
+    free(reset_param);
+    if (!valid) {
+        send_response(client_socket, 400, "Bad Request", "{\"error\":\"Invalid count, sample or decay\"}");
+        return;
+    }
+    if (count > HOTKEYS_CAPACITY) count = HOTKEYS_CAPACITY;
+
+    HotKey keys[HOTKEYS_CAPACITY];
+    size_t returned = 0, len = 0;
+    unsigned int rate, seconds;
+    // An escaped key is at most 6 bytes per byte kept, plus the fixed fields
+    size_t cap = 128 + (size_t)count * (6 * HOTKEYS_KEY_LEN + 160);
+    char *body = malloc(cap);
+    if (!body) {
+        send_response(client_socket, 500, "Internal Server Error", "{\"error\":\"Memory allocation failed\"}");
+        return;
+    }
+    hotkeys_command(keys, (size_t)count, &returned);
+    hotkeys_config_command(-1, -1, &rate, &seconds);
+    if (reset) hotkeys_reset_command();
+    if (sample >= 0 || decay >= 0) hotkeys_config_command(sample, decay, &rate, &seconds);
+
+    len += snprintf(body + len, cap - len, "{\"sample_rate\":%u,\"decay_seconds\":%u,\"keys\":[", rate, seconds);
+    for (size_t i = 0; i < returned; i++) {
+        const HotKey *k = &keys[i];
+        size_t key_len;
+        char *key = json_escape(k->key, strlen(k->key), &key_len);
+        len += snprintf(body + len, cap - len,
+                        "%s{\"key\":\"%.*s\",\"key_length\":%zu,\"count\":%llu,\"error\":%llu,\"reads\":%llu,"
+                        "\"writes\":%llu}",
+                        i ? "," : "", key ? (int)key_len : 0, key ? key : "", k->key_length,
+                        (unsigned long long)k->count, (unsigned long long)k->error, (unsigned long long)k->reads,
+                        (unsigned long long)k->writes);
+        free(key);
+    }
+    snprintf(body + len, cap - len, "]}");
+    send_response(client_socket, 200, "OK", body);
+    free(body);
+}
+
+// GET /trace[?enable=0|1][&clear=1]: the trace rings as Chrome trace-event
+// JSON, then start or stop recording and forget the events as asked
+static void handle_trace(int client_socket, const char *query) {
+    char *enable_param = query_param(query, "enable");
+    char *clear_param = query_param(query, "clear");
+    char *body = NULL;
+    size_t len = 0;
+    long events = 0;
+    FILE *out = open_memstream(&body, &len);
+    int result = out ? trace_dump_command(out, &events) : CMD_ERROR;
+    if (out && fclose(out) != 0) result = CMD_ERROR;
+
+    if (result == CMD_SUCCESS) {
+        if (enable_param) trace_enable_command(strcmp(enable_param, "0") != 0);
+        if (clear_param && strcmp(clear_param, "0") != 0) trace_clear_command();
+        send_response(client_socket, 200, "OK", body);
+    } else {
+        send_response(client_socket, 500, "Internal Server Error", "{\"error\":\"Could not write the trace\"}");
+    }
+    free(body);
+    free(enable_param);
+    free(clear_param);
 }
 
 // Function to read full HTTP request including body
@@ -342,11 +1282,23 @@ static int read_full_request(int client_socket, char *buffer, int buffer_size) {
     return total_read;
 }
 
+// Request buffers are large, so the memory they hold is tracked
+static char *acquire_request_buffer(void) {
+    char *buffer = malloc(BUFFER_SIZE);
+    if (buffer) metrics_gauge_add(GAUGE_HTTP_BUFFER_BYTES, BUFFER_SIZE);
+    return buffer;
+}
+
+static void release_request_buffer(char *buffer) {
+    if (buffer) metrics_gauge_add(GAUGE_HTTP_BUFFER_BYTES, -(int64_t)BUFFER_SIZE);
+    free(buffer);
+}
+
 // Function to handle client requests
 void handle_client(int client_socket)
 {
     // Use dynamic allocation for large buffer to avoid stack overflow
-    char *buffer = malloc(BUFFER_SIZE);
+    char *buffer = acquire_request_buffer();
     if (!buffer) {
         send_response(client_socket, 500, "Internal Server Error", "{\"error\":\"Memory allocation failed\"}");
         close(client_socket);
@@ -359,14 +1311,21 @@ void handle_client(int client_socket)
     timeout.tv_sec = 5;
     timeout.tv_usec = 0;
     setsockopt(client_socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(client_socket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+#ifdef SO_NOSIGPIPE
+    int nosigpipe = 1;
+    setsockopt(client_socket, SOL_SOCKET, SO_NOSIGPIPE, &nosigpipe, sizeof(nosigpipe));
+#endif
     
     int bytes_read = read_full_request(client_socket, buffer, BUFFER_SIZE);
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
     
     if (bytes_read <= 0) {
         #if DEBUG_HTTP
         printf("DEBUG: Failed to read request, bytes_read: %d\n", bytes_read);
         #endif
-        free(buffer);
+        release_request_buffer(buffer);
         close(client_socket);
         return;
     }
@@ -374,33 +1333,37 @@ void handle_client(int client_socket)
     // Check if request was too large
     if (bytes_read == -1) {
         send_response(client_socket, 413, "Payload Too Large", "{\"error\":\"Request body exceeds maximum size limit\"}");
-        free(buffer);
+        release_request_buffer(buffer);
         close(client_socket);
         return;
     }
 
     // Make a copy of the buffer for parsing headers (strtok modifies the string)
-    char *header_buffer = malloc(BUFFER_SIZE);
+    char *header_buffer = acquire_request_buffer();
     if (!header_buffer) {
         send_response(client_socket, 500, "Internal Server Error", "{\"error\":\"Memory allocation failed\"}");
-        free(buffer);
+        release_request_buffer(buffer);
         close(client_socket);
         return;
     }
     strcpy(header_buffer, buffer);
     
-    // Parse HTTP request
-    char *method = strtok(header_buffer, " ");
-    char *uri = strtok(NULL, " ");
+    // Parse HTTP request (strtok_r: several workers parse concurrently)
+    char *save;
+    char *method = strtok_r(header_buffer, " ", &save);
+    char *uri = strtok_r(NULL, " ", &save);
     
     if (!method || !uri) {
         send_response(client_socket, 400, "Bad Request", "{\"error\":\"Invalid request\"}");
+        release_request_buffer(buffer);
+        release_request_buffer(header_buffer);
         close(client_socket);
         return;
     }
 
-    char *path = strtok(uri, "?");
-    char *query = strtok(NULL, "");
+    char *path = strtok_r(uri, "?", &save);
+    char *query = strtok_r(NULL, "", &save);
+    TRACE_BEGIN(http, "request", path);
     
     // Determine request type
     enum {
@@ -420,12 +1383,38 @@ void handle_client(int client_socket)
         ENDPOINT_HEALTH,
         ENDPOINT_GET,
         ENDPOINT_SET,
+        ENDPOINT_SCAN,
+        ENDPOINT_RANGE,
+        ENDPOINT_METRICS,
+        ENDPOINT_STATS,
+        ENDPOINT_SLOWLOG,
+        ENDPOINT_TRACE,
+        ENDPOINT_MEMORY,
+        ENDPOINT_HOTKEYS,
+        ENDPOINT_INCR,
+        ENDPOINT_APPEND,
+        ENDPOINT_CAS,
+        ENDPOINT_TXN,
         ENDPOINT_UNKNOWN
     } endpoint = ENDPOINT_UNKNOWN;
     
     if (strcmp(path, "/health") == 0) endpoint = ENDPOINT_HEALTH;
     else if (strcmp(path, "/get") == 0) endpoint = ENDPOINT_GET;
     else if (strcmp(path, "/set") == 0) endpoint = ENDPOINT_SET;
+    else if (strcmp(path, "/scan") == 0) endpoint = ENDPOINT_SCAN;
+    else if (strcmp(path, "/range") == 0) endpoint = ENDPOINT_RANGE;
+    else if (strcmp(path, "/metrics") == 0) endpoint = ENDPOINT_METRICS;
+    else if (strcmp(path, "/stats") == 0) endpoint = ENDPOINT_STATS;
+    else if (strcmp(path, "/slowlog") == 0) endpoint = ENDPOINT_SLOWLOG;
+    else if (strcmp(path, "/trace") == 0) endpoint = ENDPOINT_TRACE;
+    else if (strcmp(path, "/memory") == 0) endpoint = ENDPOINT_MEMORY;
+    else if (strcmp(path, "/hotkeys") == 0) endpoint = ENDPOINT_HOTKEYS;
+    else if (strcmp(path, "/incr") == 0) endpoint = ENDPOINT_INCR;
+    else if (strcmp(path, "/append") == 0) endpoint = ENDPOINT_APPEND;
+    else if (strcmp(path, "/cas") == 0) endpoint = ENDPOINT_CAS;
+    else if (strcmp(path, "/txn") == 0) endpoint = ENDPOINT_TXN;
+
+    metrics_inc(METRIC_HTTP_REQUESTS);
     
     switch (endpoint) {
         case ENDPOINT_HEALTH:
@@ -448,23 +1437,22 @@ void handle_client(int client_socket)
                     if (key) free(key);
                     if (dummy_value) free(dummy_value);
                 } else {
-                    char *result_value;
-                    int result = zget_command(key, &result_value);
-
-                    if (result == CMD_SUCCESS && result_value != NULL) {
-                        // Dynamically allocate response body to handle large values
-                        size_t response_size = strlen(result_value) + 100; // Extra space for JSON structure
-                        char *response_body = malloc(response_size);
-                        if (response_body) {
-                            snprintf(response_body, response_size, "{\"value\":\"%s\"}", result_value);
-                            send_response(client_socket, 200, "", response_body);
-                            free(response_body);
-                        } else {
-                            send_response(client_socket, 500, "Internal Server Error", "{\"error\":\"Memory allocation failed\"}");
+                    char if_none_match[256];
+                    ValueReply reply = {client_socket, NULL, NULL, 0, 0};
+                    reply.if_none_match = request_header(buffer, "If-None-Match", if_none_match, sizeof(if_none_match));
+                    int result = zget_visit_command(key, send_value_reply, &reply);
+
+                    if (result == CMD_SUCCESS) {
+                        if (reply.pending && !reply.failed) {
+                            // Finish a large value now that the cache lock is released
+                            struct iovec rest = {reply.pending, reply.pending_len};
+                            send_iov(client_socket, &rest, 1, 0);
                         }
-                        free(result_value);
-                    } else {
+                        free(reply.pending);
+                    } else if (result == CMD_NOT_FOUND) {
                         send_response(client_socket, 404, "Not Found", "{\"error\":\"Key not found\"}");
+                    } else {
+                        send_response(client_socket, 500, "Internal Server Error", "{\"error\":\"Error reading key\"}");
                     }
                     free(key);
                     if (dummy_value) free(dummy_value);
@@ -541,58 +1529,214 @@ void handle_client(int client_socket)
                     printf("DEBUG: JSON payload after whitespace skip: '%s'\n", payload_start);
                     #endif
                     
-                    char *key = NULL;
-                    char *value = NULL;
-                    int parse_result = parse_json_payload(payload_start, &key, &value);
-                    
-                    #if DEBUG_HTTP
-                    printf("DEBUG: Parsed key: '%s', value: '%s'\n", key ? key : "NULL", value ? value : "NULL");
-                    #endif
-                    
-                    if (!parse_result || !key || !value || strlen(key) == 0 || strlen(value) == 0) {
-                        send_response(client_socket, 400, "Bad Request", "{\"error\":\"Missing key or value in JSON payload\"}");
-                    } else {
-                        int result = zset_command(key, value);
-                        if (result == CMD_SUCCESS) {
-                            send_response(client_socket, 201, "OK", "{\"status\":\"OK\"}");
-                        } else {
-                            send_response(client_socket, 500, "Internal Server Error", "{\"error\":\"Error setting key\"}");
-                        }
-                    }
-                    
-                    // Free dynamically allocated memory
-                    if (key) free(key);
-                    if (value) free(value);
+                    handle_set_payload(client_socket, payload_start, buffer + bytes_read - payload_start);
                 }
             }
             break;
             
+        case ENDPOINT_SCAN:
+            if (request_type != REQ_GET) {
+                send_response(client_socket, 405, "Method Not Allowed", "{\"error\":\"GET method required\"}");
+            } else {
+                handle_scan(client_socket, query);
+            }
+            break;
+
+        case ENDPOINT_RANGE:
+            if (request_type != REQ_GET) {
+                send_response(client_socket, 405, "Method Not Allowed", "{\"error\":\"GET method required\"}");
+            } else {
+                handle_range(client_socket, query);
+            }
+            break;
+
+        case ENDPOINT_METRICS:
+            handle_metrics(client_socket);
+            break;
+
+        case ENDPOINT_STATS:
+        case ENDPOINT_SLOWLOG:
+        case ENDPOINT_TRACE:
+        case ENDPOINT_MEMORY:
+        case ENDPOINT_HOTKEYS:
+            if (request_type != REQ_GET) {
+                send_response(client_socket, 405, "Method Not Allowed", "{\"error\":\"GET method required\"}");
+            } else if (endpoint == ENDPOINT_STATS) {
+                handle_stats(client_socket, query);
+            } else if (endpoint == ENDPOINT_SLOWLOG) {
+                handle_slowlog(client_socket, query);
+            } else if (endpoint == ENDPOINT_MEMORY) {
+                handle_memory(client_socket);
+            } else if (endpoint == ENDPOINT_HOTKEYS) {
+                handle_hotkeys(client_socket, query);
+            } else {
+                handle_trace(client_socket, query);
+            }
+            break;
+
+        case ENDPOINT_INCR:
+        case ENDPOINT_APPEND:
+        case ENDPOINT_CAS:
+        case ENDPOINT_TXN:
+            if (request_type != REQ_POST) {
+                send_response(client_socket, 405, "Method Not Allowed", "{\"error\":\"POST method required\"}");
+            } else {
+                size_t body_len = 0;
+                const char *body = request_body(buffer, bytes_read, &body_len);
+                if (endpoint == ENDPOINT_INCR) handle_incr(client_socket, body, body_len);
+                else if (endpoint == ENDPOINT_APPEND) handle_append(client_socket, body, body_len);
+                else if (endpoint == ENDPOINT_CAS) handle_cas(client_socket, body, body_len);
+                else handle_txn(client_socket, body, body_len);
+            }
+            break;
+
         case ENDPOINT_UNKNOWN:
             send_response(client_socket, 404, "Not Found", "{\"error\":\"Endpoint not found\"}");
             break;
     }
 
+    metrics_record_since(LATENCY_HTTP, &start);
+    TRACE_END(http, "request", path, bytes_read);
+
     // Clean up allocated memory
-    free(buffer);
-    free(header_buffer);
+    release_request_buffer(buffer);
+    release_request_buffer(header_buffer);
     close(client_socket);
 }
 
+// Bind the optional AF_UNIX listener. Returns the listening fd or -1.
+static int open_unix_listener(const char *path, mode_t mode) {
+    struct sockaddr_un address;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Unix socket path too long: %s\n", path);
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("unix socket failed");
+        return -1;
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    unlink(path); // Remove a stale socket left by a previous run
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+        perror("unix bind failed");
+        close(fd);
+        return -1;
+    }
+    // Access control is delegated to filesystem permissions on the socket
+    if (chmod(path, mode) < 0) {
+        perror("unix chmod failed");
+        close(fd);
+        unlink(path);
+        return -1;
+    }
+    if (listen(fd, HTTP_LISTEN_BACKLOG) < 0) {
+        perror("unix listen failed");
+        close(fd);
+        unlink(path);
+        return -1;
+    }
+    return fd;
+}
+
+// --- Admission control ---
+
+// Accepted connections waiting for a worker. Bounded, so a burst turns into
+// fast 503s at the door instead of an unbounded pile of stalled clients.
+static int connection_queue[HTTP_MAX_QUEUE];
+static size_t queue_head;
+static size_t queue_count;
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_not_empty = PTHREAD_COND_INITIALIZER;
+
+// Returns 0 if the queue is full
+static int queue_push(int client_socket) {
+    pthread_mutex_lock(&queue_mutex);
+    if (queue_count == HTTP_MAX_QUEUE) {
+        pthread_mutex_unlock(&queue_mutex);
+        return 0;
+    }
+    connection_queue[(queue_head + queue_count) % HTTP_MAX_QUEUE] = client_socket;
+    queue_count++;
+    metrics_gauge_add(GAUGE_HTTP_QUEUE_DEPTH, 1);
+    pthread_cond_signal(&queue_not_empty);
+    pthread_mutex_unlock(&queue_mutex);
+    return 1;
+}
+
+// Blocks until a connection is queued. Returns -1 once the server is stopping
+// and the queue has drained.
+static int queue_pop(void) {
+    pthread_mutex_lock(&queue_mutex);
+    while (queue_count == 0 && server_running) {
+        pthread_cond_wait(&queue_not_empty, &queue_mutex);
+    }
+    int client_socket = -1;
+    if (queue_count > 0) {
+        client_socket = connection_queue[queue_head];
+        queue_head = (queue_head + 1) % HTTP_MAX_QUEUE;
+        queue_count--;
+        metrics_gauge_add(GAUGE_HTTP_QUEUE_DEPTH, -1);
+    }
+    pthread_mutex_unlock(&queue_mutex);
+    return client_socket;
+}
+
+static void *http_worker(void *arg) {
+    (void)arg;
+    int client_socket;
+    while ((client_socket = queue_pop()) >= 0) {
+        handle_client(client_socket);
+        metrics_gauge_add(GAUGE_HTTP_CONNECTIONS, -1);
+    }
+    return NULL;
+}
+
+// Queue a freshly accepted connection, or turn it away with a 503
+static void admit_connection(int client_socket) {
+    const char *rejection = NULL;
+    if (metrics_gauge_add(GAUGE_HTTP_CONNECTIONS, 1) > HTTP_MAX_CONNECTIONS) {
+        metrics_inc(METRIC_HTTP_REJECTED_CONNECTIONS);
+        rejection = "{\"error\":\"Too many connections\"}";
+    } else if (!queue_push(client_socket)) {
+        metrics_inc(METRIC_HTTP_REJECTED_QUEUE);
+        rejection = "{\"error\":\"Server busy\"}";
+    }
+    if (rejection) {
+        send_unavailable(client_socket, rejection);
+        // Discard whatever request bytes already arrived so close() sends a FIN,
+        // not an RST that could destroy the 503 before the client reads it
+        char discard[4096];
+        while (recv(client_socket, discard, sizeof(discard), MSG_DONTWAIT) > 0) {}
+        close(client_socket);
+        metrics_gauge_add(GAUGE_HTTP_CONNECTIONS, -1);
+    }
+}
+
 void start_inhouse_rest_server(void)
 {
     int server_fd, client_socket;
     struct sockaddr_in address;
-    int addrlen = sizeof(address);
 
     init_cache(); // Ensure cache is initialized for zget/zset
+    init_response_headers();
 
     // Creating socket file descriptor
-    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0)
+    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
     {
         perror("socket failed");
         exit(EXIT_FAILURE);
     }
 
+    // Allow a restart while connections from the previous run sit in TIME_WAIT
+    int reuse = 1;
+    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
     address.sin_family = AF_INET;
     address.sin_addr.s_addr = INADDR_ANY;
     address.sin_port = htons(PORT);
@@ -603,7 +1747,7 @@ void start_inhouse_rest_server(void)
         perror("bind failed");
         exit(EXIT_FAILURE);
     }
-    if (listen(server_fd, 10) < 0)
+    if (listen(server_fd, HTTP_LISTEN_BACKLOG) < 0)
     {
         perror("listen");
         exit(EXIT_FAILURE);
@@ -611,25 +1755,84 @@ void start_inhouse_rest_server(void)
 
     printf("Starting in-house REST server on port %d\n", PORT);
 
-    // Set server socket to non-blocking mode to allow clean shutdown
+    int unix_fd = -1;
+#if UNIX_SOCKET_ENABLED
+    unix_fd = open_unix_listener(UNIX_SOCKET_PATH, UNIX_SOCKET_PERMS);
+    if (unix_fd >= 0) {
+        printf("Starting in-house REST server on unix socket %s\n", UNIX_SOCKET_PATH);
+    }
+#endif
+
+    // Set server sockets to non-blocking mode to allow clean shutdown
     int flags = fcntl(server_fd, F_GETFL, 0);
     fcntl(server_fd, F_SETFL, flags | O_NONBLOCK);
+    if (unix_fd >= 0) {
+        flags = fcntl(unix_fd, F_GETFL, 0);
+        fcntl(unix_fd, F_SETFL, flags | O_NONBLOCK);
+    }
+
+    pthread_t workers[HTTP_WORKER_THREADS];
+    int num_workers = 0;
+    for (int i = 0; i < HTTP_WORKER_THREADS; i++) {
+        if (pthread_create(&workers[num_workers], NULL, http_worker, NULL) != 0) {
+            perror("Failed to create HTTP worker");
+            continue;
+        }
+        num_workers++;
+    }
+    if (num_workers == 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    struct pollfd listeners[2];
+    int num_listeners = 0;
+    listeners[num_listeners++].fd = server_fd;
+    if (unix_fd >= 0) listeners[num_listeners++].fd = unix_fd;
 
     while (server_running)
     {
-        if ((client_socket = accept(server_fd, (struct sockaddr *)&address, (socklen_t *)&addrlen)) < 0)
-        {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                // No incoming connection, sleep briefly and check shutdown flag again
-                usleep(10000); // 10ms
-                continue;
-            } else {
+        for (int i = 0; i < num_listeners; i++) {
+            listeners[i].events = POLLIN;
+            listeners[i].revents = 0;
+        }
+        // Wake up periodically to check the shutdown flag
+        int ready = poll(listeners, num_listeners, 100);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            exit(EXIT_FAILURE);
+        }
+
+        for (int i = 0; i < num_listeners; i++) {
+            if (!(listeners[i].revents & POLLIN)) continue;
+            if ((client_socket = accept(listeners[i].fd, NULL, NULL)) < 0)
+            {
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ECONNABORTED || errno == EINTR) {
+                    continue;
+                }
                 perror("accept");
                 exit(EXIT_FAILURE);
             }
+            metrics_inc(METRIC_HTTP_CONNECTIONS);
+            TRACE_EVENT(http, accept, NULL, client_socket);
+            // Accepted sockets may inherit O_NONBLOCK; the handler expects blocking reads
+            flags = fcntl(client_socket, F_GETFL, 0);
+            fcntl(client_socket, F_SETFL, flags & ~O_NONBLOCK);
+            admit_connection(client_socket);
         }
-        handle_client(client_socket);
+    }
+
+    // Let the workers finish what is queued, then exit
+    pthread_mutex_lock(&queue_mutex);
+    pthread_cond_broadcast(&queue_not_empty);
+    pthread_mutex_unlock(&queue_mutex);
+    for (int i = 0; i < num_workers; i++) {
+        pthread_join(workers[i], NULL);
     }
 
     close(server_fd);
-}
\ No newline at end of file
+    if (unix_fd >= 0) {
+        close(unix_fd);
+        unlink(UNIX_SOCKET_PATH);
+    }
+}
@@ -1,6 +1,9 @@
 #ifndef HTTP_SERVER_H
 #define HTTP_SERVER_H
 
+// Cleared on shutdown; every listener loop polls it
+extern volatile int server_running;
+
 void start_inhouse_rest_server(void);
 
 #endif // HTTP_SERVER_H
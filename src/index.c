@@ -0,0 +1,355 @@
+#include "index.h"
+#include "config.h"
+#include "cache.h"
+#include "io.h"
+#include "metrics.h"
+#include "lsm.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/file.h> // For flock
+#include <sys/stat.h>
+
+typedef struct {
+    size_t key;  // Offset of the key in KeyIndex.keys
+    long record; // Offset of the record in the database file
+} IndexEntry;
+
+struct KeyIndex {
+    char *keys; // Every key, NUL-terminated, back to back
+    size_t keys_len;
+    size_t keys_capacity;
+    IndexEntry *entries;
+    size_t count;
+    size_t capacity;
+    // The file generation the offsets refer to
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+};
+
+// Lock order: file_lock, then index_lock
+static pthread_rwlock_t index_lock = PTHREAD_RWLOCK_INITIALIZER;
+static KeyIndex *current_index;
+
+KeyIndex *index_new(void)
+{
+    return calloc(1, sizeof(KeyIndex));
+}
+
+void index_free(KeyIndex *index)
+{
+    if (!index) return;
+    metrics_gauge_add(GAUGE_INDEX_BYTES,
+                      -(int64_t)(index->keys_capacity + index->capacity * sizeof(IndexEntry)));
+    free(index->keys);
+    free(index->entries);
+    free(index);
+}
+
+int index_add(KeyIndex *index, const char *key, long record_offset)
+{
+    size_t key_len = strlen(key) + 1;
+    if (index->keys_len + key_len > index->keys_capacity)
+    {
+        size_t capacity = index->keys_capacity ? index->keys_capacity : 4096;
+        while (capacity < index->keys_len + key_len) capacity *= 2;
+        char *grown = realloc(index->keys, capacity);
+        if (!grown) return 0;
+        index->keys = grown;
+        metrics_gauge_add(GAUGE_INDEX_BYTES, (int64_t)(capacity - index->keys_capacity));
+        index->keys_capacity = capacity;
+    }
+    if (index->count == index->capacity)
+    {
+        size_t capacity = index->capacity ? index->capacity * 2 : 256;
+        IndexEntry *grown = realloc(index->entries, capacity * sizeof(IndexEntry));
+        if (!grown) return 0;
+        index->entries = grown;
+        metrics_gauge_add(GAUGE_INDEX_BYTES, (int64_t)((capacity - index->capacity) * sizeof(IndexEntry)));
+        index->capacity = capacity;
+    }
+    memcpy(index->keys + index->keys_len, key, key_len);
+    index->entries[index->count++] = (IndexEntry){index->keys_len, record_offset};
+    index->keys_len += key_len;
+    return 1;
+}
+
+static const char *entry_key(const KeyIndex *index, size_t i)
+{
+    return index->keys + index->entries[i].key;
+}
+
+static void set_generation(KeyIndex *index, const struct stat *st)
+{
+    index->dev = st->st_dev;
+    index->ino = st->st_ino;
+    index->size = st->st_size;
+    index->mtime = stat_mtime(st);
+}
+
+static int describes(const KeyIndex *index, const struct stat *st)
+{
+    struct timespec mtime = stat_mtime(st);
+    return index->dev == st->st_dev && index->ino == st->st_ino && index->size == st->st_size &&
+           index->mtime.tv_sec == mtime.tv_sec && index->mtime.tv_nsec == mtime.tv_nsec;
+}
+
+// Whether `st` still describes FILENAME. The writer renames a new generation
+// over it under the exclusive index_lock, so the answer holds while that is held.
+static int is_current(const struct stat *st)
+{
+    struct stat now;
+    if (stat(FILENAME, &now) != 0) return 0;
+    KeyIndex current = {0};
+    set_generation(&current, &now);
+    return describes(&current, st);
+}
+
+// Only used while building an index under the exclusive index_lock
+static const char *sort_keys;
+
+static int compare_entries(const void *a, const void *b)
+{
+    const IndexEntry *ea = a;
+    const IndexEntry *eb = b;
+    int cmp = strcmp(sort_keys + ea->key, sort_keys + eb->key);
+    if (cmp != 0) return cmp;
+    return (ea->record > eb->record) - (ea->record < eb->record); // First record of a key wins
+}
+
+// Index a file the writer did not produce. Called with index_lock held exclusively.
+static KeyIndex *build_index(FILE *file, const struct stat *st)
+{
+    KeyIndex *index = index_new();
+    if (!index) return NULL;
+
+    char *key = NULL;
+    char *value = NULL;
+    long offset = 0;
+    int sorted = 1;
+    int result;
+    rewind(file);
+    while ((result = read_item_from_file(file, &key, &value)) > 0)
+    {
+        if (index->count > 0 && strcmp(entry_key(index, index->count - 1), key) >= 0) sorted = 0;
+        int added = index_add(index, key, offset);
+        offset += item_record_size(key, value);
+        free(key);
+        free(value);
+        if (!added)
+        {
+            result = -1;
+            break;
+        }
+    }
+    if (result < 0 || ferror(file))
+    {
+        index_free(index);
+        return NULL;
+    }
+    if (offset > 0)
+    {
+        metrics_add(METRIC_DISK_BYTES_READ, (uint64_t)offset);
+        io_account(IO_STAT_BYTES_READ, (uint64_t)offset);
+    }
+
+    if (!sorted)
+    {
+        sort_keys = index->keys;
+        qsort(index->entries, index->count, sizeof(IndexEntry), compare_entries);
+        size_t kept = 0;
+        for (size_t i = 0; i < index->count; i++)
+        {
+            if (kept > 0 && strcmp(entry_key(index, kept - 1), entry_key(index, i)) == 0) continue;
+            index->entries[kept++] = index->entries[i];
+        }
+        index->count = kept;
+    }
+    set_generation(index, st);
+    metrics_inc(METRIC_INDEX_REBUILDS);
+    return index;
+}
+
+int index_replace_file(const char *tmp_path, KeyIndex *next)
+{
+    // rename() keeps the inode, size and mtime, so the generation can be taken now
+    struct stat st;
+    if (next && stat(tmp_path, &st) == 0)
+    {
+        set_generation(next, &st);
+    }
+    else
+    {
+        index_free(next);
+        next = NULL; // Rebuilt by the next reader
+    }
+
+    pthread_rwlock_wrlock(&index_lock);
+    int ok = rename(tmp_path, FILENAME) == 0;
+    if (ok)
+    {
+        index_free(current_index);
+        current_index = next;
+        next = NULL;
+    }
+    pthread_rwlock_unlock(&index_lock);
+
+    index_free(next);
+    return ok;
+}
+
+void index_usage(size_t *entries, size_t *entry_capacity, size_t *key_bytes, size_t *key_capacity)
+{
+    pthread_rwlock_rdlock(&index_lock);
+    *entries = current_index ? current_index->count : 0;
+    *entry_capacity = current_index ? current_index->capacity : 0;
+    *key_bytes = current_index ? current_index->keys_len : 0;
+    *key_capacity = current_index ? current_index->keys_capacity : 0;
+    pthread_rwlock_unlock(&index_lock);
+}
+
+// First entry whose key is >= `key`
+static size_t lower_bound(const KeyIndex *index, const char *key)
+{
+    size_t lo = 0;
+    size_t hi = index->count;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (strcmp(entry_key(index, mid), key) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static int in_range(const char *key, const char *end, const char *prefix, size_t prefix_len)
+{
+    if (end && strcmp(key, end) >= 0) return 0;
+    return !prefix || strncmp(key, prefix, prefix_len) == 0;
+}
+
+int index_scan(const char *start, const char *end, const char *prefix, size_t limit, int with_values,
+               DataItem **items, size_t *size, size_t *capacity, char **next)
+{
+    return index_scan_for(IO_OP_INDEX, start, end, prefix, limit, with_values, items, size, capacity, next);
+}
+
+int index_scan_for(io_op_t op, const char *start, const char *end, const char *prefix, size_t limit,
+                   int with_values, DataItem **items, size_t *size, size_t *capacity, char **next)
+{
+    if (next) *next = NULL;
+    io_begin(op);
+    if (lsm_selected()) return lsm_scan(start, end, prefix, limit, with_values, items, size, capacity, next);
+
+    io_lock_file(0);
+    FILE *file = io_fopen(FILENAME, "rb");
+    if (!file)
+    {
+        pthread_rwlock_unlock(&file_lock);
+        return 1; // No database yet: nothing matches
+    }
+    struct stat st;
+    if (io_flock(file, LOCK_SH) == -1 || fstat(fileno(file), &st) == -1)
+    {
+        fclose(file);
+        pthread_rwlock_unlock(&file_lock);
+        return 0;
+    }
+
+    int ok = 1;
+    KeyIndex *stale = NULL; // For a file the writer replaced after it was opened
+    pthread_rwlock_rdlock(&index_lock);
+    if (!current_index || !describes(current_index, &st))
+    {
+        pthread_rwlock_unlock(&index_lock);
+        pthread_rwlock_wrlock(&index_lock);
+        if (!current_index || !describes(current_index, &st))
+        {
+            KeyIndex *built = build_index(file, &st);
+            if (built && is_current(&st))
+            {
+                index_free(current_index);
+                current_index = built;
+            }
+            else
+            {
+                stale = built; // Serves this scan only; the installed index is newer
+            }
+            ok = built != NULL;
+        }
+    }
+
+    if (ok)
+    {
+        const KeyIndex *index = stale ? stale : current_index;
+        size_t prefix_len = prefix ? strlen(prefix) : 0;
+        const char *from = start ? start : prefix;
+        if (start && prefix && strcmp(prefix, start) > 0) from = prefix;
+        size_t i = from ? lower_bound(index, from) : 0;
+        long position = -1;
+        long bytes_read = 0;
+
+        for (size_t returned = 0; ok && i < index->count && returned < limit; i++, returned++)
+        {
+            const char *key = entry_key(index, i);
+            if (!in_range(key, end, prefix, prefix_len)) break;
+
+            char *value = NULL;
+            if (with_values)
+            {
+                // Seek only when the records are not adjacent, which after a
+                // writer commit they always are
+                char *record_key = NULL;
+                long record = index->entries[i].record;
+                if (record != position && fseek(file, record, SEEK_SET) != 0)
+                {
+                    ok = 0;
+                    break;
+                }
+                if (read_item_from_file(file, &record_key, &value) <= 0)
+                {
+                    ok = 0;
+                    break;
+                }
+                position = record + item_record_size(record_key, value);
+                bytes_read += position - record;
+                free(record_key);
+            }
+
+            char *copy = my_strdup(key);
+            if (!copy)
+            {
+                free(value);
+                ok = 0;
+                break;
+            }
+            ensure_list_capacity(items, capacity, *size + 1);
+            (*items)[*size].key = copy;
+            (*items)[*size].value = value;
+            (*size)++;
+        }
+
+        if (ok && next && i < index->count && in_range(entry_key(index, i), end, prefix, prefix_len))
+        {
+            *next = my_strdup(entry_key(index, i));
+            ok = *next != NULL;
+        }
+        if (bytes_read > 0)
+        {
+            metrics_add(METRIC_DISK_BYTES_READ, (uint64_t)bytes_read);
+            io_account(IO_STAT_BYTES_READ, (uint64_t)bytes_read);
+        }
+    }
+    pthread_rwlock_unlock(&index_lock);
+    index_free(stale);
+
+    flock(fileno(file), LOCK_UN);
+    fclose(file);
+    pthread_rwlock_unlock(&file_lock);
+    return ok;
+}
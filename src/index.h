@@ -0,0 +1,42 @@
+#ifndef INDEX_H
+#define INDEX_H
+
+#include "ds.h"     // For DataItem
+#include "metrics.h" // For io_op_t
+#include <stddef.h> // For size_t
+
+// Ordered key index over the database file: every key with the offset of its
+// record, sorted by key. The writer keeps the file itself sorted and hands over
+// a fresh index with each generation it commits, so ordered queries cost a
+// binary search plus the records they return. If the file was changed some
+// other way (init_db, an older data file), the index is rebuilt on first use.
+
+typedef struct KeyIndex KeyIndex;
+
+// Build an index; keys must be added in ascending order
+KeyIndex *index_new(void);
+int index_add(KeyIndex *index, const char *key, long record_offset);
+void index_free(KeyIndex *index);
+
+// Rename `tmp_path` over the database file and install `next` (may be NULL) as
+// its index in one step, so no reader pairs a file with another generation's
+// index. Takes ownership of `next`. Returns 0 if the rename failed.
+int index_replace_file(const char *tmp_path, KeyIndex *next);
+
+// Append up to `limit` records to `items` in key order, starting at the first
+// key >= `start` (NULL = the first key) and stopping before `end` (NULL = no
+// bound) or at the first key not starting with `prefix` (NULL = any). Values
+// are read only if `with_values` (otherwise they are NULL). If more records
+// match, *next (optional) receives a copy of the key to resume from, else NULL.
+// Returns 1 on success, 0 on error.
+int index_scan(const char *start, const char *end, const char *prefix, size_t limit, int with_values,
+               DataItem **items, size_t *size, size_t *capacity, char **next);
+// index_scan, with the I/O charged to `op` instead of IO_OP_INDEX
+int index_scan_for(io_op_t op, const char *start, const char *end, const char *prefix, size_t limit,
+                   int with_values, DataItem **items, size_t *size, size_t *capacity, char **next);
+
+// Size of the installed index (all 0 if there is none): entries and key bytes
+// in use, and what is allocated for them
+void index_usage(size_t *entries, size_t *entry_capacity, size_t *key_bytes, size_t *key_capacity);
+
+#endif // INDEX_H
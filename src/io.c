@@ -2,12 +2,20 @@
 #include "config.h"
 #include "ds.h"
 #include "cache.h"
+#include "metrics.h"
+#include "lsm.h"
+#include "bloom.h"
+#include "trace.h"
+#include "index.h"
 
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <errno.h>
+#include <unistd.h>   // For fsync
 #include <sys/file.h> // For flock
+#include <sys/stat.h>
 
 // Define our record separator and escape sequences
 #define RECORD_SEP '\x1E'  // Record Separator (RS) - separates records
@@ -83,6 +91,66 @@ char* read_escaped_string(FILE *file) {
     return buffer;
 }
 
+// The operation this thread's I/O is charged to, set by io_begin
+static _Thread_local io_op_t current_op = IO_OP_FIND;
+static _Thread_local uint64_t current_bytes_read; // Read since the last io_begin
+
+void io_begin(io_op_t op) {
+    current_op = op;
+    current_bytes_read = 0;
+    metrics_io_add(op, IO_STAT_CALLS, 1);
+}
+
+void io_account(io_stat_t stat, uint64_t amount) {
+    if (stat == IO_STAT_BYTES_READ) current_bytes_read += amount;
+    metrics_io_add(current_op, stat, amount);
+}
+
+uint64_t io_last_bytes_read(void) {
+    return current_bytes_read;
+}
+
+FILE *io_fopen(const char *path, const char *mode) {
+    FILE *file = fopen(path, mode);
+    if (file) metrics_io_add(current_op, IO_STAT_OPENS, 1);
+    return file;
+}
+
+// Try without blocking first, so only contended locks pay for the clock reads
+int io_flock(FILE *file, int operation) {
+    if (flock(fileno(file), operation | LOCK_NB) == 0) return 0;
+    if (errno != EWOULDBLOCK) return -1;
+    struct timespec start;
+    command_timer_start(&start);
+    int result = flock(fileno(file), operation);
+    metrics_io_add(current_op, IO_STAT_FLOCK_WAITS, 1);
+    metrics_io_add(current_op, IO_STAT_FLOCK_WAIT_NS, timer_elapsed_ns(&start));
+    return result;
+}
+
+void io_lock_file(int exclusive) {
+    if ((exclusive ? pthread_rwlock_trywrlock(&file_lock) : pthread_rwlock_tryrdlock(&file_lock)) == 0) return;
+    struct timespec start;
+    command_timer_start(&start);
+    if (exclusive) pthread_rwlock_wrlock(&file_lock);
+    else pthread_rwlock_rdlock(&file_lock);
+    metrics_io_add(current_op, IO_STAT_LOCK_WAITS, 1);
+    metrics_io_add(current_op, IO_STAT_LOCK_WAIT_NS, timer_elapsed_ns(&start));
+}
+
+int io_fsync(FILE *file) {
+    metrics_io_add(current_op, IO_STAT_FSYNCS, 1);
+    return fsync(fileno(file));
+}
+
+// Record the bytes moved through `file` since offset `start`, before it is closed
+static void account_bytes_read(FILE *file, long start) {
+    long end = ftell(file);
+    if (end <= start) return;
+    metrics_add(METRIC_DISK_BYTES_READ, (uint64_t)(end - start));
+    io_account(IO_STAT_BYTES_READ, (uint64_t)(end - start));
+}
+
 // Helper function to write a single item to file
 int write_item_to_file(FILE *file, const char *key, const char *value) {
     if (!write_escaped_string(file, key)) return 0;
@@ -92,6 +160,18 @@ int write_item_to_file(FILE *file, const char *key, const char *value) {
     return 1;
 }
 
+static long escaped_length(const char *str) {
+    long len = 0;
+    for (const char *p = str; *p; p++) {
+        len += (*p == RECORD_SEP || *p == ESCAPE_CHAR || *p == KEY_VALUE_SEP) ? 2 : 1;
+    }
+    return len;
+}
+
+long item_record_size(const char *key, const char *value) {
+    return escaped_length(key) + escaped_length(value) + 2; // Plus both separators
+}
+
 // Helper function to read a single item from file
 int read_item_from_file(FILE *file, char **key, char **value) {
     *key = read_escaped_string(file);
@@ -116,153 +196,61 @@ int read_item_from_file(FILE *file, char **key, char **value) {
         return -1; // Invalid format
     }
     
+    metrics_io_add(current_op, IO_STAT_RECORDS, 1);
     return 1; // Success
 }
 
-int load_all_data_from_disk(DataItem **full_data_list, size_t *list_size, size_t *list_capacity)
+int scan_disk_page(const char *cursor, const char *prefix, size_t max_matches, int with_values,
+                   DataItem **page, size_t *page_size, size_t *page_capacity, char **next_cursor)
 {
-    FILE *file = fopen(FILENAME, "rb");
-    if (file == NULL)
-    {
-        return 1; // File not found, that's okay
-    }
-    if (flock(fileno(file), LOCK_SH) == -1) { // Shared lock for reading
-        fclose(file);
-        return 0;
-    }
-
-    char *current_key = NULL;
-    char *current_value = NULL;
-
-    while (1)
-    {
-        int result = read_item_from_file(file, &current_key, &current_value);
-        if (result <= 0)
-        {
-            if (result == 0) // End of file
-                break;
-            // Error occurred
-            free(current_key);
-            free(current_value);
-            flock(fileno(file), LOCK_UN);
-            fclose(file);
-            return 0;
-        }
-
-        ensure_list_capacity(full_data_list, list_capacity, *list_size + 1);
-        (*full_data_list)[*list_size].key = my_strdup(current_key);
-        (*full_data_list)[*list_size].value = my_strdup(current_value);
-
-        if (!(*full_data_list)[*list_size].key || !(*full_data_list)[*list_size].value)
-        {
-            perror("Failed to allocate memory for data list entry");
-            if ((*full_data_list)[*list_size].key) free((*full_data_list)[*list_size].key);
-            if ((*full_data_list)[*list_size].value) free((*full_data_list)[*list_size].value);
-            free(current_key);
-            free(current_value);
-            flock(fileno(file), LOCK_UN);
-            fclose(file);
-            return 0;
-        }
-
-        (*list_size)++;
-        free(current_key);
-        free(current_value);
-    }
-
-    if (ferror(file))
-    {
-        perror("File read error during full load");
-        flock(fileno(file), LOCK_UN);
-        fclose(file);
-        return 0;
-    }
-    flock(fileno(file), LOCK_UN);
-    fclose(file);
-    return 1;
+    // The index lists keys in order and the cursor is a key, so writes between
+    // pages neither skip nor repeat the keys that were there all along
+    return index_scan_for(IO_OP_SCAN, cursor, NULL, prefix, max_matches, with_values, page, page_size,
+                          page_capacity, next_cursor);
 }
 
-void save_all_data_to_disk(DataItem *data_list, size_t list_size)
+int print_all_data_from_disk(void)
 {
-    FILE *file = fopen(FILENAME, "wb");
-    if (file == NULL)
+    if (!lsm_selected())
     {
-        perror("Failed to open file for writing all data");
-        return;
-    }
-    if (flock(fileno(file), LOCK_EX) == -1) { // Exclusive lock for writing
-        fclose(file);
-        return;
-    }
-
-    for (size_t i = 0; i < list_size; i++)
-    {
-        if (!write_item_to_file(file, data_list[i].key, data_list[i].value))
+        FILE *file = io_fopen(FILENAME, "rb");
+        if (file == NULL)
         {
-            perror("Error writing data to disk file");
-            flock(fileno(file), LOCK_UN);
-            fclose(file);
-            return;
+            printf("(empty)\n");
+            return 0; // File not found is considered empty
         }
-    }
-
-    if (fclose(file) != 0)
-    {
-        perror("Failed to close file after writing all data");
-    } else {
-        flock(fileno(file), LOCK_UN);
-    }
-}
-
-int print_all_data_from_disk(void)
-{
-    FILE *file = fopen(FILENAME, "rb");
-    if (file == NULL)
-    {
-        printf("(empty)\n");
-        return 0; // File not found is considered empty
-    }
-    if (flock(fileno(file), LOCK_SH) == -1) {
         fclose(file);
-        return 0;
     }
 
+    // Print page by page so writers are only blocked for one page at a time
     int key_count = 0;
-    char *current_key = NULL;
-    char *current_value = NULL;
-
-    while (1)
+    char *cursor = NULL;
+    do
     {
-        int result = read_item_from_file(file, &current_key, &current_value);
-        if (result <= 0)
+        DataItem *page = NULL;
+        size_t page_size = 0;
+        size_t page_capacity = 0;
+        char *next = NULL;
+
+        int ok = index_scan_for(IO_OP_LIST, cursor, NULL, NULL, SCAN_BATCH_SIZE, 1, &page, &page_size,
+                                &page_capacity, &next);
+        free(cursor);
+        cursor = next;
+        if (!ok)
         {
-            if (result == 0) // End of file
-                break;
-            // Error occurred
+            free_data_list(&page, &page_size, &page_capacity);
+            free(cursor);
             printf("Error: Invalid database format\n");
-            flock(fileno(file), LOCK_UN);
-            fclose(file);
             return 0;
         }
+        for (size_t i = 0; i < page_size; i++)
+        {
+            printf("%s:%s \n", page[i].key, page[i].value);
+            key_count++;
+        }
+        free_data_list(&page, &page_size, &page_capacity);
+    } while (cursor != NULL);
 
-        printf("%s:%s \n", current_key, current_value);
-        key_count++;
-
-        // Free the current pair
-        free(current_key);
-        free(current_value);
-    }
-
-    if (ferror(file))
-    {
-        printf("Error: File read error during print\n");
-        flock(fileno(file), LOCK_UN);
-        fclose(file);
-        return 0;
-    }
-
-    flock(fileno(file), LOCK_UN);
-    fclose(file);
     printf("Total keys: %d\n", key_count);
     if (key_count == 0)
     {
@@ -272,427 +260,68 @@ int print_all_data_from_disk(void)
     return 1;
 }
 
-int find_key_on_disk(const char *key, char **value)
+int count_keys_on_disk(void)
 {
-    pthread_mutex_lock(&file_mutex);
+    io_begin(IO_OP_DBSIZE);
+    if (lsm_selected()) return lsm_count();
 
-    FILE *file = fopen(FILENAME, "rb");
-    if (!file)
-    {
-        pthread_mutex_unlock(&file_mutex);
-        return -1; // File error
-    }
-    if (flock(fileno(file), LOCK_SH) == -1) {
-        fclose(file);
-        pthread_mutex_unlock(&file_mutex);
-        return -1;
-    }
+    io_lock_file(0);
 
-    char *current_key = NULL;
-    char *current_value = NULL;
-    int found = 0;
-
-    while (!found && read_item_from_file(file, &current_key, &current_value) > 0)
-    {
-        if (strcmp(current_key, key) == 0)
-        {
-            *value = current_value; // Transfer ownership of value to caller
-            free(current_key);      // Free the key as we don't need it
-            found = 1;
-        }
-        else
-        {
-            free(current_key);
-            free(current_value);
-        }
-    }
-
-    flock(fileno(file), LOCK_UN);
-    fclose(file);
-    pthread_mutex_unlock(&file_mutex);
-    return found;
-}
-
-int remove_key_from_disk(const char *key)
-{
-    pthread_mutex_lock(&file_mutex);
-
-    // First read all items except the one to remove into memory
-    DataItem *items = NULL;
-    size_t items_size = 0;
-    size_t items_capacity = 0;
-    int found = 0;
-
-    FILE *file = fopen(FILENAME, "rb");
+    FILE *file = io_fopen(FILENAME, "rb");
     if (file == NULL)
     {
-        pthread_mutex_unlock(&file_mutex);
-        return 0; // File doesn't exist
+        pthread_rwlock_unlock(&file_lock);
+        return 0; // File not found is considered empty
     }
-    if (flock(fileno(file), LOCK_EX) == -1) { // Exclusive for read-modify-write
+    if (io_flock(file, LOCK_SH) == -1) {
         fclose(file);
-        pthread_mutex_unlock(&file_mutex);
+        pthread_rwlock_unlock(&file_lock);
         return -1;
     }
 
+    int key_count = 0;
     char *current_key = NULL;
     char *current_value = NULL;
+    int result;
 
-    while (1)
-    {
-        int result = read_item_from_file(file, &current_key, &current_value);
-        if (result <= 0)
-        {
-            if (result == 0) // End of file
-                break;
-            // Error occurred
-            free(current_key);
-            free(current_value);
-            flock(fileno(file), LOCK_UN);
-            fclose(file);
-            return -1;
-        }
-
-        if (strcmp(current_key, key) != 0)
-        {
-            // Add to items list if it's not the key to remove
-            if (items_size >= items_capacity)
-            {
-                items_capacity = items_capacity == 0 ? 10 : items_capacity * 2;
-                items = realloc(items, items_capacity * sizeof(DataItem));
-                if (!items)
-                {
-                    free(current_key);
-                    free(current_value);
-                    flock(fileno(file), LOCK_UN);
-                    fclose(file);
-                    pthread_mutex_unlock(&file_mutex);
-                    return -1;
-                }
-            }
-            items[items_size].key = current_key;
-            items[items_size].value = current_value;
-            items_size++;
-        }
-        else
-        {
-            found = 1;
-            free(current_key);
-            free(current_value);
-        }
-    }
-
-    flock(fileno(file), LOCK_UN);
-    fclose(file);
-
-    if (!found)
-    {
-        // Free any allocated items
-        for (size_t i = 0; i < items_size; i++)
-        {
-            free(items[i].key);
-            free(items[i].value);
-        }
-        free(items);
-        pthread_mutex_unlock(&file_mutex);
-        return 0; // Key not found
-    }
-
-    // Write back all items except the removed one
-    file = fopen(FILENAME, "wb");
-    if (file == NULL)
+    while ((result = read_item_from_file(file, &current_key, &current_value)) > 0)
     {
-        // Free any allocated items
-        for (size_t i = 0; i < items_size; i++)
-        {
-            free(items[i].key);
-            free(items[i].value);
-        }
-        free(items);
-        pthread_mutex_unlock(&file_mutex);
-        return -1;
-    }
-    if (flock(fileno(file), LOCK_EX) == -1) {
-        // Free any allocated items
-        for (size_t i = 0; i < items_size; i++)
-        {
-            free(items[i].key);
-            free(items[i].value);
-        }
-        free(items);
-        fclose(file);
-        pthread_mutex_unlock(&file_mutex);
-        return -1;
-    }
-
-    // Write all items back to file
-    for (size_t i = 0; i < items_size; i++)
-    {
-        if (!write_item_to_file(file, items[i].key, items[i].value))
-        {
-            // Free remaining items
-            for (size_t j = i; j < items_size; j++)
-            {
-                free(items[j].key);
-                free(items[j].value);
-            }
-            free(items);
-            flock(fileno(file), LOCK_UN);
-            fclose(file);
-            pthread_mutex_unlock(&file_mutex);
-            return -1;
-        }
-        free(items[i].key);
-        free(items[i].value);
-    }
-
-    free(items);
-    flock(fileno(file), LOCK_UN);
-    fclose(file);
-    pthread_mutex_unlock(&file_mutex);
-    return 1; // Successfully removed
-}
-
-int update_key_on_disk(const char *key, const char *new_value)
-{
-    pthread_mutex_lock(&file_mutex);
-
-    // Read all items into memory
-    DataItem *items = NULL;
-    size_t items_size = 0;
-    size_t items_capacity = 0;
-    int found = 0;
-
-    FILE *file = fopen(FILENAME, "rb");
-    if (file != NULL)
-    {
-        if (flock(fileno(file), LOCK_EX) == -1) {
-            fclose(file);
-            pthread_mutex_unlock(&file_mutex);
-            return -1;
-        }
-
-        char *current_key = NULL;
-        char *current_value = NULL;
-
-        while (read_item_from_file(file, &current_key, &current_value) > 0)
-        {
-            if (strcmp(current_key, key) == 0)
-            {
-                // Update the value
-                free(current_value);
-                current_value = my_strdup(new_value);
-                found = 1;
-            }
-
-            if (items_size >= items_capacity)
-            {
-                items_capacity = items_capacity == 0 ? 10 : items_capacity * 2;
-                items = realloc(items, items_capacity * sizeof(DataItem));
-            }
-            items[items_size].key = current_key;
-            items[items_size].value = current_value;
-            items_size++;
-        }
-        flock(fileno(file), LOCK_UN);
-        fclose(file);
-    }
-
-    // If key was not found, add it
-    if (!found)
-    {
-        if (items_size >= items_capacity)
-        {
-            items_capacity = items_capacity == 0 ? 10 : items_capacity * 2;
-            items = realloc(items, items_capacity * sizeof(DataItem));
-        }
-        items[items_size].key = my_strdup(key);
-        items[items_size].value = my_strdup(new_value);
-        items_size++;
-    }
-
-    // Write everything back to the file
-    file = fopen(FILENAME, "wb");
-    if (file == NULL)
-    {
-        pthread_mutex_unlock(&file_mutex);
-        return -1;
-    }
-    if (flock(fileno(file), LOCK_EX) == -1) {
-        fclose(file);
-        pthread_mutex_unlock(&file_mutex);
-        return -1;
-    }
-
-    for (size_t i = 0; i < items_size; i++)
-    {
-        write_item_to_file(file, items[i].key, items[i].value);
-        free(items[i].key);
-        free(items[i].value);
+        key_count++;
+        free(current_key);
+        free(current_value);
     }
 
-    free(items);
     flock(fileno(file), LOCK_UN);
+    account_bytes_read(file, 0);
     fclose(file);
-    pthread_mutex_unlock(&file_mutex);
-    return 1;
+    pthread_rwlock_unlock(&file_lock);
+    return result < 0 ? -1 : key_count;
 }
 
-// Helper function to clean up duplicate keys in the database
-int cleanup_duplicate_keys(void)
+static int find_in_file(const char *key, char **value)
 {
-    pthread_mutex_lock(&file_mutex);
-
-    // First read all unique items into memory
-    DataItem *items = NULL;
-    size_t items_size = 0;
-    size_t items_capacity = 0;
+    io_lock_file(0);
 
-    FILE *file = fopen(FILENAME, "rb");
-    if (file == NULL)
-    {
-        pthread_mutex_unlock(&file_mutex);
-        return 0; // File doesn't exist
-    }
-    if (flock(fileno(file), LOCK_EX) == -1) {
-        fclose(file);
-        pthread_mutex_unlock(&file_mutex);
-        return -1;
-    }
-
-    char *current_key = NULL;
-    char *current_value = NULL;
-
-    while (1)
-    {
-        int result = read_item_from_file(file, &current_key, &current_value);
-        if (result <= 0)
-        {
-            if (result == 0) // End of file
-                break;
-            // Error occurred
-            free(current_key);
-            free(current_value);
-            flock(fileno(file), LOCK_UN);
-            fclose(file);
-            return -1;
-        }
-
-        // Check if this key already exists in our items list
-        int is_duplicate = 0;
-        for (size_t i = 0; i < items_size; i++)
-        {
-            if (strcmp(items[i].key, current_key) == 0)
-            {
-                is_duplicate = 1;
-                break;
-            }
-        }
-
-        if (!is_duplicate)
-        {
-            // Add to items list if it's not a duplicate
-            if (items_size >= items_capacity)
-            {
-                items_capacity = items_capacity == 0 ? 10 : items_capacity * 2;
-                items = realloc(items, items_capacity * sizeof(DataItem));
-                if (!items)
-                {
-                    free(current_key);
-                    free(current_value);
-                    flock(fileno(file), LOCK_UN);
-                    fclose(file);
-                    pthread_mutex_unlock(&file_mutex);
-                    return -1;
-                }
-            }
-            items[items_size].key = current_key;
-            items[items_size].value = current_value;
-            items_size++;
-        }
-        else
-        {
-            // Free duplicate key-value pair
-            free(current_key);
-            free(current_value);
-        }
-    }
-
-    flock(fileno(file), LOCK_UN);
-    fclose(file);
-
-    // Write back only unique items
-    file = fopen(FILENAME, "wb");
-    if (file == NULL)
-    {
-        // Free any allocated items
-        for (size_t i = 0; i < items_size; i++)
-        {
-            free(items[i].key);
-            free(items[i].value);
-        }
-        free(items);
-        return -1;
-    }
-    if (flock(fileno(file), LOCK_EX) == -1) {
-        // Free any allocated items
-        for (size_t i = 0; i < items_size; i++)
-        {
-            free(items[i].key);
-            free(items[i].value);
-        }
-        free(items);
-        fclose(file);
-        pthread_mutex_unlock(&file_mutex);
-        return -1;
-    }
-
-    // Write all unique items back to file
-    for (size_t i = 0; i < items_size; i++)
-    {
-        if (!write_item_to_file(file, items[i].key, items[i].value))
-        {
-            // Free remaining items
-            for (size_t j = i; j < items_size; j++)
-            {
-                free(items[j].key);
-                free(items[j].value);
-            }
-            free(items);
-            flock(fileno(file), LOCK_UN);
-            fclose(file);
-            pthread_mutex_unlock(&file_mutex);
-            return -1;
-        }
-        free(items[i].key);
-        free(items[i].value);
-    }
-
-    free(items);
-    flock(fileno(file), LOCK_UN);
-    fclose(file);
-    pthread_mutex_unlock(&file_mutex);
-    return 1; // Successfully cleaned up
-}
-
-// Internal function that assumes mutex is already locked
-static int find_key_on_disk_internal(const char *key, char **value)
-{
-    FILE *file = fopen(FILENAME, "rb");
+    FILE *file = io_fopen(FILENAME, "rb");
     if (!file)
     {
+        pthread_rwlock_unlock(&file_lock);
         return -1; // File error
     }
-    if (flock(fileno(file), LOCK_SH) == -1) {
+    struct stat st;
+    if (io_flock(file, LOCK_SH) == -1 || fstat(fileno(file), &st) == -1) {
         fclose(file);
+        pthread_rwlock_unlock(&file_lock);
         return -1;
     }
 
+    // A definite miss from the filter saves scanning the whole file
+    int filtered = bloom_file_check(key, file, &st);
     char *current_key = NULL;
     char *current_value = NULL;
     int found = 0;
 
-    while (!found && read_item_from_file(file, &current_key, &current_value) > 0)
+    while (filtered != 0 && !found && read_item_from_file(file, &current_key, &current_value) > 0)
     {
         if (strcmp(current_key, key) == 0)
         {
@@ -706,59 +335,37 @@ static int find_key_on_disk_internal(const char *key, char **value)
             free(current_value);
         }
     }
+    if (filtered == 1 && !found) metrics_inc(METRIC_BLOOM_FALSE_POSITIVES);
 
     flock(fileno(file), LOCK_UN);
+    account_bytes_read(file, 0);
     fclose(file);
+    pthread_rwlock_unlock(&file_lock);
     return found;
 }
 
-int append_key_to_disk(const char *key, const char *value)
+int find_key_on_disk(const char *key, char **value)
 {
-    pthread_mutex_lock(&file_mutex);
-
-    // First check if key exists (without acquiring mutex again)
-    char *existing_value = NULL;
-    int exists = find_key_on_disk_internal(key, &existing_value);
-    if (exists > 0)
-    {
-        free(existing_value);
-        pthread_mutex_unlock(&file_mutex);
-        return 0; // Key already exists
-    }
-
-    FILE *file = fopen(FILENAME, "ab"); // Open for append
-    if (file == NULL)
-    {
-        // If file doesn't exist, try to create it
-        file = fopen(FILENAME, "wb");
-        if (file == NULL) {
-            pthread_mutex_unlock(&file_mutex);
-            return 0;
-        }
-    }
-    if (flock(fileno(file), LOCK_EX) == -1) {
-        fclose(file);
-        pthread_mutex_unlock(&file_mutex);
-        return 0;
-    }
-
-    int success = write_item_to_file(file, key, value);
-    flock(fileno(file), LOCK_UN);
-    fclose(file);
-    pthread_mutex_unlock(&file_mutex);
-    return success;
+    io_begin(IO_OP_FIND);
+    TRACE_BEGIN(disk, "find", key);
+    int result = lsm_selected() ? lsm_get(key, value) : find_in_file(key, value);
+    TRACE_END(disk, "find", key, result);
+    return result;
 }
 
 // Helper function to check if database exists and create it if needed
 int ensure_database_exists(void) {
-    pthread_mutex_lock(&file_mutex);
+    if (lsm_selected()) return lsm_ensure(); // Created on first use, without asking
+
+    io_begin(IO_OP_EXISTS);
+    io_lock_file(0);
 
-    FILE *file = fopen(FILENAME, "rb");
+    FILE *file = io_fopen(FILENAME, "rb");
     if (file) {
-        flock(fileno(file), LOCK_SH);
+        io_flock(file, LOCK_SH);
         flock(fileno(file), LOCK_UN);
         fclose(file);
-        pthread_mutex_unlock(&file_mutex);
+        pthread_rwlock_unlock(&file_lock);
         return 1;  // Database exists
     }
 
@@ -766,7 +373,7 @@ int ensure_database_exists(void) {
     printf("Database does not exist. Create empty database? (YES/NO): ");
     char response[10];
     if (!fgets(response, sizeof(response), stdin)) {
-        pthread_mutex_unlock(&file_mutex);
+        pthread_rwlock_unlock(&file_lock);
         return 0;  // Error reading input
     }
 
@@ -779,21 +386,21 @@ int ensure_database_exists(void) {
     }
 
     if (strcmp(response, "YES") == 0) {
-        file = fopen(FILENAME, "wb");
+        file = io_fopen(FILENAME, "wb");
         if (file) {
-            flock(fileno(file), LOCK_EX);
+            io_flock(file, LOCK_EX);
             flock(fileno(file), LOCK_UN);
             fclose(file);
             printf("Empty database created.\n");
-            pthread_mutex_unlock(&file_mutex);
+            pthread_rwlock_unlock(&file_lock);
             return 1;
         }
         printf("Error: Could not create database file.\n");
-        pthread_mutex_unlock(&file_mutex);
+        pthread_rwlock_unlock(&file_lock);
         return 0;
     }
 
     printf("Database creation cancelled.\n");
-    pthread_mutex_unlock(&file_mutex);
+    pthread_rwlock_unlock(&file_lock);
     return 0;
 }
\ No newline at end of file
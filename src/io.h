@@ -1,25 +1,39 @@
 #ifndef IO_H
 #define IO_H
 
-#include "ds.h"     // For DataItem
-#include <stddef.h> // For size_t
-#include <stdio.h>  // For FILE
+#include "ds.h"      // For DataItem
+#include "metrics.h" // For io_op_t, io_stat_t
+#include <stddef.h>  // For size_t
+#include <stdio.h>   // For FILE
 
 // --- Disk I/O Function Declarations ---
-int load_all_data_from_disk(DataItem **full_data_list, size_t *list_size, size_t *list_capacity);
-void save_all_data_to_disk(DataItem *data_list, size_t list_size);
 int print_all_data_from_disk(void); // New function to print directly from disk
 
+// Read one page of up to `max_matches` records in key order, starting at the
+// key `cursor` (NULL = the first key) and keeping those whose key starts with
+// `prefix` (NULL = all). Values are read only if `with_values`. *next_cursor
+// receives a copy of the key the following page starts at, or NULL at the end.
+int scan_disk_page(const char *cursor, const char *prefix, size_t max_matches, int with_values,
+                   DataItem **page, size_t *page_size, size_t *page_capacity, char **next_cursor);
+
 // New optimized functions
 int find_key_on_disk(const char *key, char **value);
-int update_key_on_disk(const char *key, const char *new_value);
-int remove_key_from_disk(const char *key);
-int append_key_to_disk(const char *key, const char *value);
-int cleanup_duplicate_keys(void); // New function to clean up duplicate keys
+int count_keys_on_disk(void); // Number of records in the database file
 int ensure_database_exists(void); // New function to check/create database
 
 // Helper function declarations
 int write_item_to_file(FILE *file, const char *key, const char *value);
 int read_item_from_file(FILE *file, char **key, char **value);
+long item_record_size(const char *key, const char *value); // Bytes write_item_to_file emits
+
+// --- I/O accounting (see metrics.h) ---
+// Charge the calling thread's I/O from here on to `op`, counting one call
+void io_begin(io_op_t op);
+void io_account(io_stat_t stat, uint64_t amount); // Add to the current operation
+uint64_t io_last_bytes_read(void); // Bytes this thread read since its last io_begin
+FILE *io_fopen(const char *path, const char *mode);
+int io_flock(FILE *file, int operation); // flock() that records time spent blocked
+void io_lock_file(int exclusive);        // Take file_lock, recording time spent blocked
+int io_fsync(FILE *file);
 
 #endif // ZU_IO_H
@@ -0,0 +1,642 @@
+#include "json.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define JSON_MAX_DEPTH 64 // Nesting limit when skipping unknown members
+#define JSON_MAX_FIELDS 8 // Members extracted per object by json_parse_object_arrays
+
+typedef struct {
+    const char *p;
+    const char *end;
+} JsonCursor;
+
+// Find the first byte that ends a run of literal string content: a quote, a
+// backslash or a control character. Like simdjson's string scanner, this
+// classifies 16 bytes per step and only falls back to bytewise code for the tail.
+size_t json_plain_prefix(const char *s, size_t len)
+{
+    const char *p = s;
+    const char *end = s + len;
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control_max = _mm_set1_epi8(0x1F);
+    while (end - p >= 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)p);
+        __m128i special = _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash));
+        // Unsigned byte <= 0x1F  <=>  min(byte, 0x1F) == byte
+        special = _mm_or_si128(special, _mm_cmpeq_epi8(_mm_min_epu8(chunk, control_max), chunk));
+        int mask = _mm_movemask_epi8(special);
+        if (mask)
+        {
+            return (size_t)(p - s) + (size_t)__builtin_ctz((unsigned int)mask);
+        }
+        p += 16;
+    }
+#endif
+    while (p < end && *p != '"' && *p != '\\' && (unsigned char)*p >= 0x20)
+    {
+        p++;
+    }
+    return (size_t)(p - s);
+}
+
+static void skip_whitespace(JsonCursor *c)
+{
+    while (c->p < c->end && (*c->p == ' ' || *c->p == '\t' || *c->p == '\r' || *c->p == '\n'))
+    {
+        c->p++;
+    }
+}
+
+static int hex_digit(char ch)
+{
+    if (ch >= '0' && ch <= '9') return ch - '0';
+    if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+    if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+    return -1;
+}
+
+static int parse_hex4(JsonCursor *c, unsigned int *out)
+{
+    if (c->end - c->p < 4) return 0;
+    unsigned int value = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        int digit = hex_digit(c->p[i]);
+        if (digit < 0) return 0;
+        value = (value << 4) | (unsigned int)digit;
+    }
+    c->p += 4;
+    *out = value;
+    return 1;
+}
+
+static size_t encode_utf8(unsigned int cp, char *out)
+{
+    if (cp < 0x80)
+    {
+        out[0] = (char)cp;
+        return 1;
+    }
+    if (cp < 0x800)
+    {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000)
+    {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+// Decode one escape sequence (cursor just past the backslash) into `out`.
+// Returns the number of bytes written, or 0 if the escape is invalid.
+static size_t decode_escape(JsonCursor *c, char *out)
+{
+    if (c->p >= c->end) return 0;
+    char ch = *c->p++;
+    switch (ch)
+    {
+    case '"': *out = '"'; return 1;
+    case '\\': *out = '\\'; return 1;
+    case '/': *out = '/'; return 1;
+    case 'b': *out = '\b'; return 1;
+    case 'f': *out = '\f'; return 1;
+    case 'n': *out = '\n'; return 1;
+    case 'r': *out = '\r'; return 1;
+    case 't': *out = '\t'; return 1;
+    case 'u':
+    {
+        unsigned int cp;
+        if (!parse_hex4(c, &cp)) return 0;
+        if (cp >= 0xD800 && cp <= 0xDBFF)
+        {
+            // High surrogate: must be followed by \uDC00-\uDFFF
+            unsigned int low;
+            if (c->end - c->p < 2 || c->p[0] != '\\' || c->p[1] != 'u') return 0;
+            c->p += 2;
+            if (!parse_hex4(c, &low) || low < 0xDC00 || low > 0xDFFF) return 0;
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+        }
+        else if (cp >= 0xDC00 && cp <= 0xDFFF)
+        {
+            return 0; // Lone low surrogate
+        }
+        if (cp == 0) return 0; // Keys and values are NUL-terminated strings
+        return encode_utf8(cp, out);
+    }
+    default:
+        return 0;
+    }
+}
+
+// Parse a string literal (cursor on the opening quote) into a new buffer.
+// Plain runs are located with json_plain_prefix and copied in bulk; the common
+// escape-free string costs one scan and one memcpy.
+static int parse_string(JsonCursor *c, char **out, size_t *out_len)
+{
+    if (c->p >= c->end || *c->p != '"') return 0;
+    c->p++;
+
+    size_t run = json_plain_prefix(c->p, (size_t)(c->end - c->p));
+    if (c->p + run >= c->end) return 0; // Unterminated
+    if (c->p[run] == '"')
+    {
+        char *s = malloc(run + 1);
+        if (!s) return 0;
+        memcpy(s, c->p, run);
+        s[run] = '\0';
+        c->p += run + 1;
+        *out = s;
+        *out_len = run;
+        return 1;
+    }
+
+    // Slow path: the string contains escapes. Decoded output never exceeds
+    // the encoded input, so the remaining input length bounds the buffer.
+    size_t capacity = (size_t)(c->end - c->p) + 1;
+    char *s = malloc(capacity);
+    if (!s) return 0;
+    size_t len = 0;
+
+    for (;;)
+    {
+        run = json_plain_prefix(c->p, (size_t)(c->end - c->p));
+        memcpy(s + len, c->p, run);
+        len += run;
+        c->p += run;
+        if (c->p >= c->end) break; // Unterminated
+
+        char ch = *c->p++;
+        if (ch == '"')
+        {
+            s[len] = '\0';
+            *out = s;
+            *out_len = len;
+            return 1;
+        }
+        if (ch != '\\') break; // Raw control character
+        size_t written = decode_escape(c, s + len);
+        if (written == 0) break;
+        len += written;
+    }
+
+    free(s);
+    return 0;
+}
+
+static int skip_value(JsonCursor *c, int depth);
+
+static int skip_container(JsonCursor *c, char close, int depth)
+{
+    if (depth > JSON_MAX_DEPTH) return 0;
+    c->p++; // Opening bracket
+    skip_whitespace(c);
+    if (c->p < c->end && *c->p == close)
+    {
+        c->p++;
+        return 1;
+    }
+    for (;;)
+    {
+        if (close == '}')
+        {
+            char *name;
+            size_t name_len;
+            skip_whitespace(c);
+            if (!parse_string(c, &name, &name_len)) return 0;
+            free(name);
+            skip_whitespace(c);
+            if (c->p >= c->end || *c->p != ':') return 0;
+            c->p++;
+        }
+        if (!skip_value(c, depth + 1)) return 0;
+        skip_whitespace(c);
+        if (c->p >= c->end) return 0;
+        if (*c->p == close)
+        {
+            c->p++;
+            return 1;
+        }
+        if (*c->p != ',') return 0;
+        c->p++;
+    }
+}
+
+static int skip_literal(JsonCursor *c, const char *literal)
+{
+    size_t len = strlen(literal);
+    if ((size_t)(c->end - c->p) < len || memcmp(c->p, literal, len) != 0) return 0;
+    c->p += len;
+    return 1;
+}
+
+// Skip over any JSON value (used for unknown members)
+static int skip_value(JsonCursor *c, int depth)
+{
+    skip_whitespace(c);
+    if (c->p >= c->end) return 0;
+    switch (*c->p)
+    {
+    case '"':
+    {
+        char *s;
+        size_t len;
+        if (!parse_string(c, &s, &len)) return 0;
+        free(s);
+        return 1;
+    }
+    case '{': return skip_container(c, '}', depth);
+    case '[': return skip_container(c, ']', depth);
+    case 't': return skip_literal(c, "true");
+    case 'f': return skip_literal(c, "false");
+    case 'n': return skip_literal(c, "null");
+    default:
+    {
+        const char *start = c->p;
+        while (c->p < c->end && (strchr("+-.eE", *c->p) || (*c->p >= '0' && *c->p <= '9')))
+        {
+            c->p++;
+        }
+        return c->p > start;
+    }
+    }
+}
+
+// Span of a number or true/false/null literal, copied as text
+static int parse_literal_text(JsonCursor *c, char **out)
+{
+    const char *start = c->p;
+    if (!skip_value(c, 1) || c->p == start || *start == '{' || *start == '[') return 0;
+    *out = malloc((size_t)(c->p - start) + 1);
+    if (!*out) return 0;
+    memcpy(*out, start, (size_t)(c->p - start));
+    (*out)[c->p - start] = '\0';
+    return 1;
+}
+
+// Parse a flat object at the cursor into the named slots. On failure the
+// slots are freed and reset to NULL.
+static int parse_fields_object(JsonCursor *c, const char *const *names, char **values, size_t count)
+{
+    for (size_t i = 0; i < count; i++) values[i] = NULL;
+
+    skip_whitespace(c);
+    if (c->p >= c->end || *c->p != '{') return 0;
+    c->p++;
+    skip_whitespace(c);
+    if (c->p < c->end && *c->p == '}')
+    {
+        c->p++;
+        return 1;
+    }
+    for (;;)
+    {
+        char *name;
+        size_t name_len;
+        skip_whitespace(c);
+        if (!parse_string(c, &name, &name_len)) goto invalid;
+        skip_whitespace(c);
+        if (c->p >= c->end || *c->p != ':')
+        {
+            free(name);
+            goto invalid;
+        }
+        c->p++;
+        skip_whitespace(c);
+
+        char **target = NULL;
+        for (size_t i = 0; i < count && !target; i++)
+        {
+            if (strcmp(name, names[i]) == 0) target = &values[i];
+        }
+        free(name);
+
+        if (target)
+        {
+            char *s;
+            size_t s_len;
+            int parsed = c->p < c->end && *c->p == '"' ? parse_string(c, &s, &s_len) : parse_literal_text(c, &s);
+            if (!parsed) goto invalid;
+            free(*target); // Duplicate member: the last one wins
+            *target = s;
+        }
+        else if (!skip_value(c, 1))
+        {
+            goto invalid;
+        }
+
+        skip_whitespace(c);
+        if (c->p >= c->end) goto invalid;
+        if (*c->p == '}')
+        {
+            c->p++;
+            return 1;
+        }
+        if (*c->p != ',') goto invalid;
+        c->p++;
+    }
+
+invalid:
+    for (size_t i = 0; i < count; i++)
+    {
+        free(values[i]);
+        values[i] = NULL;
+    }
+    return 0;
+}
+
+int json_parse_fields(const char *body, size_t len, const char *const *names, char **values, size_t count)
+{
+    JsonCursor c = {body, body + len};
+    if (!parse_fields_object(&c, names, values, count)) return JSON_INVALID;
+    skip_whitespace(&c);
+    if (c.p == c.end) return JSON_OK;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        free(values[i]);
+        values[i] = NULL;
+    }
+    return JSON_INVALID;
+}
+
+// Parse an array of flat objects at the cursor, visiting each element
+static int parse_object_array(JsonCursor *c, size_t array, const char *const *names, size_t count,
+                              json_object_visitor_t visit, void *ctx)
+{
+    char *values[JSON_MAX_FIELDS];
+    if (c->p >= c->end || *c->p != '[') return 0;
+    c->p++;
+    skip_whitespace(c);
+    if (c->p < c->end && *c->p == ']')
+    {
+        c->p++;
+        return 1;
+    }
+    for (;;)
+    {
+        if (!parse_fields_object(c, names, values, count)) return 0;
+        int keep_going = visit(array, values, ctx);
+        for (size_t i = 0; i < count; i++) free(values[i]);
+        if (!keep_going) return 0;
+
+        skip_whitespace(c);
+        if (c->p >= c->end) return 0;
+        if (*c->p == ']')
+        {
+            c->p++;
+            return 1;
+        }
+        if (*c->p != ',') return 0;
+        c->p++;
+        skip_whitespace(c);
+    }
+}
+
+int json_parse_object_arrays(const char *body, size_t len, const char *const *arrays, size_t array_count,
+                             const char *const *names, size_t name_count, json_object_visitor_t visit, void *ctx)
+{
+    if (name_count > JSON_MAX_FIELDS) return JSON_INVALID;
+
+    JsonCursor cursor = {body, body + len};
+    JsonCursor *c = &cursor;
+    skip_whitespace(c);
+    if (c->p >= c->end || *c->p != '{') return JSON_INVALID;
+    c->p++;
+    skip_whitespace(c);
+    if (c->p < c->end && *c->p == '}')
+    {
+        c->p++;
+    }
+    else
+    {
+        for (;;)
+        {
+            char *name;
+            size_t name_len;
+            skip_whitespace(c);
+            if (!parse_string(c, &name, &name_len)) return JSON_INVALID;
+            skip_whitespace(c);
+            if (c->p >= c->end || *c->p != ':')
+            {
+                free(name);
+                return JSON_INVALID;
+            }
+            c->p++;
+            skip_whitespace(c);
+
+            size_t array = array_count;
+            for (size_t i = 0; i < array_count && array == array_count; i++)
+            {
+                if (strcmp(name, arrays[i]) == 0) array = i;
+            }
+            free(name);
+
+            if (array < array_count)
+            {
+                if (!parse_object_array(c, array, names, name_count, visit, ctx)) return JSON_INVALID;
+            }
+            else if (!skip_value(c, 1))
+            {
+                return JSON_INVALID;
+            }
+
+            skip_whitespace(c);
+            if (c->p >= c->end) return JSON_INVALID;
+            if (*c->p == '}')
+            {
+                c->p++;
+                break;
+            }
+            if (*c->p != ',') return JSON_INVALID;
+            c->p++;
+        }
+    }
+
+    skip_whitespace(c);
+    return c->p == c->end ? JSON_OK : JSON_INVALID;
+}
+
+// Parse one {"key":...,"value":...} object and append it to the list
+static int parse_set_object(JsonCursor *c, DataItem **items, size_t *count, size_t *capacity)
+{
+    char *key = NULL;
+    char *value = NULL;
+    int status = JSON_INVALID;
+
+    if (c->p >= c->end || *c->p != '{') return JSON_INVALID;
+    c->p++;
+    skip_whitespace(c);
+    if (c->p < c->end && *c->p == '}')
+    {
+        c->p++;
+        return JSON_MISSING_FIELD;
+    }
+
+    for (;;)
+    {
+        char *name;
+        size_t name_len;
+        skip_whitespace(c);
+        if (!parse_string(c, &name, &name_len)) goto done;
+        skip_whitespace(c);
+        if (c->p >= c->end || *c->p != ':')
+        {
+            free(name);
+            goto done;
+        }
+        c->p++;
+        skip_whitespace(c);
+
+        char **target = NULL;
+        if (strcmp(name, "key") == 0) target = &key;
+        else if (strcmp(name, "value") == 0) target = &value;
+        free(name);
+
+        if (target)
+        {
+            char *s;
+            size_t len;
+            if (!parse_string(c, &s, &len)) goto done; // Non-string key/value
+            free(*target); // Duplicate member: the last one wins
+            *target = s;
+        }
+        else if (!skip_value(c, 1))
+        {
+            goto done;
+        }
+
+        skip_whitespace(c);
+        if (c->p >= c->end) goto done;
+        if (*c->p == '}')
+        {
+            c->p++;
+            break;
+        }
+        if (*c->p != ',') goto done;
+        c->p++;
+    }
+
+    if (!key || !value)
+    {
+        status = JSON_MISSING_FIELD;
+        goto done;
+    }
+    ensure_list_capacity(items, capacity, *count + 1);
+    (*items)[*count].key = key;
+    (*items)[*count].value = value;
+    (*count)++;
+    return JSON_OK;
+
+done:
+    free(key);
+    free(value);
+    return status;
+}
+
+int json_parse_set_payload(const char *body, size_t len, DataItem **items, size_t *count, size_t *capacity)
+{
+    JsonCursor c = {body, body + len};
+    int status;
+
+    skip_whitespace(&c);
+    if (c.p >= c.end) return JSON_INVALID;
+
+    if (*c.p == '[')
+    {
+        // Batch form: [{"key":...,"value":...}, ...]
+        c.p++;
+        skip_whitespace(&c);
+        if (c.p < c.end && *c.p == ']')
+        {
+            c.p++;
+            status = JSON_MISSING_FIELD; // Empty batch
+        }
+        else
+        {
+            for (;;)
+            {
+                skip_whitespace(&c);
+                status = parse_set_object(&c, items, count, capacity);
+                if (status != JSON_OK) break;
+                skip_whitespace(&c);
+                if (c.p < c.end && *c.p == ',')
+                {
+                    c.p++;
+                    continue;
+                }
+                if (c.p < c.end && *c.p == ']')
+                {
+                    c.p++;
+                }
+                else
+                {
+                    status = JSON_INVALID;
+                }
+                break;
+            }
+        }
+    }
+    else
+    {
+        status = parse_set_object(&c, items, count, capacity);
+    }
+
+    if (status == JSON_OK)
+    {
+        skip_whitespace(&c);
+        if (c.p != c.end) status = JSON_INVALID; // Trailing garbage
+    }
+    if (status != JSON_OK)
+    {
+        free_data_list(items, count, capacity);
+    }
+    return status;
+}
+
+char *json_escape(const char *s, size_t len, size_t *out_len)
+{
+    char *out = malloc(len * 6 + 1); // Worst case: every byte becomes \u00XX
+    if (!out) return NULL;
+    char *p = out;
+    size_t i = 0;
+    while (i < len)
+    {
+        size_t run = json_plain_prefix(s + i, len - i);
+        memcpy(p, s + i, run);
+        p += run;
+        i += run;
+        if (i >= len) break;
+
+        unsigned char ch = (unsigned char)s[i++];
+        switch (ch)
+        {
+        case '"': *p++ = '\\'; *p++ = '"'; break;
+        case '\\': *p++ = '\\'; *p++ = '\\'; break;
+        case '\n': *p++ = '\\'; *p++ = 'n'; break;
+        case '\r': *p++ = '\\'; *p++ = 'r'; break;
+        case '\t': *p++ = '\\'; *p++ = 't'; break;
+        default: p += sprintf(p, "\\u%04x", ch); break;
+        }
+    }
+    *p = '\0';
+    *out_len = (size_t)(p - out);
+    return out;
+}
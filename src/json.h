@@ -0,0 +1,42 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include "ds.h"     // For DataItem
+#include <stddef.h> // For size_t
+
+// Return codes for json_parse_set_payload
+#define JSON_OK 0
+#define JSON_INVALID -1       // Malformed JSON or a non-string key/value
+#define JSON_MISSING_FIELD -2 // An object without both "key" and "value"
+
+// Parse a /set request body in a single pass. Accepts one object
+// {"key":"...","value":"..."} or a batch array [{...},{...}], with members in
+// any order and unknown members ignored. String escapes (including \uXXXX and
+// surrogate pairs) are decoded into freshly allocated key/value buffers that are
+// appended to `items` (see ensure_list_capacity / free_data_list).
+int json_parse_set_payload(const char *body, size_t len, DataItem **items, size_t *count, size_t *capacity);
+
+// Parse a flat object, extracting the members named in `names` into the
+// matching `values` slot (malloc'd; NULL if absent). Strings are decoded and
+// numbers or true/false/null are returned as their literal text. Other members
+// are skipped. On JSON_INVALID every slot is freed and reset to NULL.
+int json_parse_fields(const char *body, size_t len, const char *const *names, char **values, size_t count);
+
+// Parse an object whose members named in `arrays` hold arrays of flat objects,
+// e.g. {"watch":[{...}],"ops":[{...}]}. For each element, the members named in
+// `names` (at most 8) are extracted as by json_parse_fields and passed to
+// `visit` with the index of the array the element came from, in document order.
+// The values are freed after `visit` returns. If `visit` returns 0 parsing
+// stops and JSON_INVALID is returned. Other members are skipped.
+typedef int (*json_object_visitor_t)(size_t array, char **values, void *ctx);
+int json_parse_object_arrays(const char *body, size_t len, const char *const *arrays, size_t array_count,
+                             const char *const *names, size_t name_count, json_object_visitor_t visit, void *ctx);
+
+// Number of leading bytes that can be copied into a JSON string literal as-is
+// (i.e. the offset of the first '"', '\\' or control character).
+size_t json_plain_prefix(const char *s, size_t len);
+
+// Escape `s` for use inside a JSON string literal. Returns a malloc'd buffer.
+char *json_escape(const char *s, size_t len, size_t *out_len);
+
+#endif // JSON_H
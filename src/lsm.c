@@ -0,0 +1,1328 @@
+#include "lsm.h"
+#include "config.h"
+#include "ds.h"
+#include "metrics.h"
+#include "bloom.h"
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+// Integers are stored in host byte order; data directories are not portable
+// between architectures.
+#define TABLE_MAGIC 0x5A554C32u // "ZUL2"
+#define FOOTER_SIZE 32          // Filter offset (8), index offset (8), block count (4), entries (8), magic (4)
+#define ENTRY_HEADER 9          // Kind (1), key length (4), value length (4)
+#define FRAME_HEADER 12         // WAL batch: payload length (4), payload hash (8)
+#define MAX_HEIGHT 16           // Skip list levels
+#define KIND_DELETE 0
+#define KIND_PUT 1
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t capacity;
+} Buffer;
+
+static int buffer_reserve(Buffer *b, size_t extra)
+{
+    if (b->len + extra <= b->capacity) return 1;
+    size_t capacity = b->capacity ? b->capacity : 4096;
+    while (capacity < b->len + extra) capacity *= 2;
+    char *grown = realloc(b->data, capacity);
+    if (!grown) return 0;
+    b->data = grown;
+    b->capacity = capacity;
+    return 1;
+}
+
+static int buffer_append(Buffer *b, const void *data, size_t len)
+{
+    if (!buffer_reserve(b, len)) return 0;
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+    return 1;
+}
+
+static int buffer_set_string(Buffer *b, const char *s)
+{
+    b->len = 0;
+    return buffer_append(b, s, strlen(s) + 1);
+}
+
+static int write_all(int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t written = write(fd, data, len);
+        if (written < 0)
+        {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        data += written;
+        len -= (size_t)written;
+    }
+    return 1;
+}
+
+static int read_all(int fd, char *data, size_t len, off_t offset)
+{
+    while (len > 0)
+    {
+        ssize_t got = pread(fd, data, len, offset);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return 0;
+        data += got;
+        len -= (size_t)got;
+        offset += got;
+    }
+    return 1;
+}
+
+// Entries, in tables and in the log: kind, key length, value length, then the
+// key and value each NUL-terminated so they can be used in place
+static int encode_entry(Buffer *b, int kind, const char *key, const char *value)
+{
+    uint32_t key_len = (uint32_t)strlen(key);
+    uint32_t value_len = value ? (uint32_t)strlen(value) : 0;
+    if (!buffer_reserve(b, ENTRY_HEADER + key_len + value_len + 2)) return 0;
+    char *p = b->data + b->len;
+    p[0] = (char)kind;
+    memcpy(p + 1, &key_len, 4);
+    memcpy(p + 5, &value_len, 4);
+    memcpy(p + ENTRY_HEADER, key, key_len + 1);
+    memcpy(p + ENTRY_HEADER + key_len + 1, value ? value : "", value_len + 1);
+    b->len += ENTRY_HEADER + key_len + value_len + 2;
+    return 1;
+}
+
+typedef struct {
+    int kind;
+    const char *key;
+    const char *value;
+} Entry;
+
+// Decode the entry at data[*pos]. Returns 0 at the end or on a malformed entry.
+static int decode_entry(const char *data, size_t len, size_t *pos, Entry *e)
+{
+    if (len - *pos < ENTRY_HEADER) return 0;
+    uint32_t key_len, value_len;
+    memcpy(&key_len, data + *pos + 1, 4);
+    memcpy(&value_len, data + *pos + 5, 4);
+    size_t size = (size_t)ENTRY_HEADER + key_len + value_len + 2;
+    if (len - *pos < size) return 0;
+    e->kind = data[*pos];
+    e->key = data + *pos + ENTRY_HEADER;
+    e->value = e->key + key_len + 1;
+    if (e->key[key_len] != '\0' || e->value[value_len] != '\0') return 0;
+    *pos += size;
+    return 1;
+}
+
+// --- Memtable: a skip list. Written only under the database's exclusive lock. ---
+
+typedef struct MemNode {
+    char *key;
+    char *value; // NULL for a deletion
+    struct MemNode *next[];
+} MemNode;
+
+typedef struct {
+    MemNode *head;
+    int height;
+    size_t bytes;
+    size_t count;
+    uint32_t rng;
+} Memtable;
+
+static MemNode *node_new(int height)
+{
+    return calloc(1, sizeof(MemNode) + (size_t)height * sizeof(MemNode *));
+}
+
+static Memtable *memtable_new(void)
+{
+    Memtable *m = calloc(1, sizeof(Memtable));
+    if (!m) return NULL;
+    m->head = node_new(MAX_HEIGHT);
+    if (!m->head)
+    {
+        free(m);
+        return NULL;
+    }
+    m->height = 1;
+    m->rng = 0x9E3779B9u;
+    return m;
+}
+
+static void memtable_free(Memtable *m)
+{
+    if (!m) return;
+    MemNode *node = m->head->next[0];
+    while (node)
+    {
+        MemNode *next = node->next[0];
+        free(node->key);
+        free(node->value);
+        free(node);
+        node = next;
+    }
+    metrics_gauge_add(GAUGE_MEMTABLE_BYTES, -(int64_t)m->bytes);
+    free(m->head);
+    free(m);
+}
+
+// Each level holds a quarter of the nodes of the level below
+static int random_height(Memtable *m)
+{
+    int height = 1;
+    for (;;)
+    {
+        m->rng ^= m->rng << 13;
+        m->rng ^= m->rng >> 17;
+        m->rng ^= m->rng << 5;
+        if ((m->rng & 3) != 0 || height == MAX_HEIGHT) return height;
+        height++;
+    }
+}
+
+// First node with a key >= `key` (NULL = the first node). If `update` is given,
+// it receives the last node before that position on every level.
+static MemNode *memtable_seek(const Memtable *m, const char *key, MemNode **update)
+{
+    MemNode *x = m->head;
+    for (int level = m->height - 1; level >= 0; level--)
+    {
+        while (key && x->next[level] && strcmp(x->next[level]->key, key) < 0) x = x->next[level];
+        if (update) update[level] = x;
+    }
+    return key ? x->next[0] : m->head->next[0];
+}
+
+static int memtable_put(Memtable *m, const char *key, const char *value)
+{
+    MemNode *update[MAX_HEIGHT];
+    MemNode *x = memtable_seek(m, key, update);
+    char *copy = NULL;
+    if (value && !(copy = my_strdup(value))) return 0;
+
+    if (x && strcmp(x->key, key) == 0)
+    {
+        int64_t old_len = x->value ? (int64_t)strlen(x->value) : 0, new_len = value ? (int64_t)strlen(value) : 0;
+        m->bytes = m->bytes - (size_t)old_len + (size_t)new_len;
+        metrics_gauge_add(GAUGE_MEMTABLE_BYTES, new_len - old_len);
+        free(x->value);
+        x->value = copy;
+        return 1;
+    }
+
+    int height = random_height(m);
+    MemNode *node = node_new(height);
+    if (!node || !(node->key = my_strdup(key)))
+    {
+        free(node);
+        free(copy);
+        return 0;
+    }
+    node->value = copy;
+    for (int level = m->height; level < height; level++) update[level] = m->head;
+    if (height > m->height) m->height = height;
+    for (int level = 0; level < height; level++)
+    {
+        node->next[level] = update[level]->next[level];
+        update[level]->next[level] = node;
+    }
+    size_t added = sizeof(MemNode) + (size_t)height * sizeof(MemNode *) + strlen(key) + (value ? strlen(value) : 0);
+    m->bytes += added;
+    metrics_gauge_add(GAUGE_MEMTABLE_BYTES, (int64_t)added);
+    m->count++;
+    return 1;
+}
+
+// --- Tables ---
+
+typedef struct {
+    char *first_key;
+    uint64_t offset;
+    uint32_t size;
+} BlockRef;
+
+typedef struct {
+    uint64_t id;
+    int fd;
+    uint64_t file_size;
+    uint64_t entries;
+    BlockRef *blocks;
+    size_t block_count;
+    BloomFilter *filter; // NULL if the table's filter could not be read
+} Table;
+
+static void table_path(char *path, size_t size, const char *dir, uint64_t id)
+{
+    snprintf(path, size, "%s/%06llu.sst", dir, (unsigned long long)id);
+}
+
+static void table_close(Table *t, const char *unlink_dir)
+{
+    if (!t) return;
+    if (t->fd >= 0) close(t->fd);
+    if (unlink_dir)
+    {
+        char path[4096];
+        table_path(path, sizeof(path), unlink_dir, t->id);
+        unlink(path);
+    }
+    for (size_t i = 0; i < t->block_count; i++) free(t->blocks[i].first_key);
+    free(t->blocks);
+    bloom_untrack(t->filter);
+    bloom_free(t->filter);
+    free(t);
+}
+
+static Table *table_open(const char *dir, uint64_t id)
+{
+    char path[4096];
+    table_path(path, sizeof(path), dir, id);
+    Table *t = calloc(1, sizeof(Table));
+    if (!t) return NULL;
+    t->id = id;
+    t->fd = open(path, O_RDONLY);
+
+    struct stat st;
+    char footer[FOOTER_SIZE];
+    uint64_t filter_offset = 0;
+    uint64_t index_offset = 0;
+    uint32_t block_count = 0;
+    uint32_t magic = 0;
+    if (t->fd < 0 || fstat(t->fd, &st) != 0 || st.st_size < FOOTER_SIZE ||
+        !read_all(t->fd, footer, FOOTER_SIZE, st.st_size - FOOTER_SIZE))
+    {
+        table_close(t, NULL);
+        return NULL;
+    }
+    t->file_size = (uint64_t)st.st_size;
+    memcpy(&filter_offset, footer, 8);
+    memcpy(&index_offset, footer + 8, 8);
+    memcpy(&block_count, footer + 16, 4);
+    memcpy(&t->entries, footer + 20, 8);
+    memcpy(&magic, footer + 28, 4);
+    if (magic != TABLE_MAGIC || index_offset > t->file_size - FOOTER_SIZE || filter_offset > index_offset)
+    {
+        table_close(t, NULL);
+        return NULL;
+    }
+
+    // The filter stays in memory so misses never read a block
+    size_t filter_len = (size_t)(index_offset - filter_offset);
+    char *filter = malloc(filter_len ? filter_len : 1);
+    if (filter && read_all(t->fd, filter, filter_len, (off_t)filter_offset))
+    {
+        t->filter = bloom_decode(filter, filter_len);
+        bloom_track(t->filter);
+    }
+    free(filter);
+
+    size_t index_len = (size_t)(t->file_size - FOOTER_SIZE - index_offset);
+    char *index = malloc(index_len ? index_len : 1);
+    t->blocks = calloc(block_count ? block_count : 1, sizeof(BlockRef));
+    int ok = index && t->blocks && read_all(t->fd, index, index_len, (off_t)index_offset);
+    size_t pos = 0;
+    for (uint32_t i = 0; ok && i < block_count; i++)
+    {
+        // First key (length-prefixed, NUL-terminated), block offset, block size
+        uint32_t key_len;
+        ok = index_len - pos >= 4;
+        if (ok) memcpy(&key_len, index + pos, 4);
+        ok = ok && index_len - pos >= 4 + (size_t)key_len + 1 + 12 && index[pos + 4 + key_len] == '\0';
+        if (ok) ok = (t->blocks[i].first_key = my_strdup(index + pos + 4)) != NULL;
+        if (ok)
+        {
+            t->block_count++;
+            pos += 4 + key_len + 1;
+            memcpy(&t->blocks[i].offset, index + pos, 8);
+            memcpy(&t->blocks[i].size, index + pos + 8, 4);
+            pos += 12;
+        }
+    }
+    free(index);
+    if (!ok)
+    {
+        table_close(t, NULL);
+        return NULL;
+    }
+    return t;
+}
+
+// Builds a table file from entries added in key order
+typedef struct {
+    int fd;
+    uint64_t offset;
+    Buffer block;
+    Buffer index;
+    uint32_t block_count;
+    uint64_t entries;
+    BloomFilter *filter;
+} TableWriter;
+
+static int table_writer_flush_block(TableWriter *w)
+{
+    if (w->block.len == 0) return 1;
+    uint32_t key_len;
+    memcpy(&key_len, w->block.data + 1, 4);
+    uint64_t offset = w->offset;
+    uint32_t size = (uint32_t)w->block.len;
+    int ok = write_all(w->fd, w->block.data, w->block.len) &&
+             buffer_append(&w->index, &key_len, 4) &&
+             buffer_append(&w->index, w->block.data + ENTRY_HEADER, key_len + 1) &&
+             buffer_append(&w->index, &offset, 8) &&
+             buffer_append(&w->index, &size, 4);
+    w->offset += w->block.len;
+    w->block.len = 0;
+    w->block_count++;
+    return ok;
+}
+
+static int table_writer_add(TableWriter *w, int kind, const char *key, const char *value)
+{
+    if (!encode_entry(&w->block, kind, key, value)) return 0;
+    w->entries++;
+    bloom_add(w->filter, key); // Deletions too: they must shadow older tables
+    return w->block.len < LSM_BLOCK_SIZE || table_writer_flush_block(w);
+}
+
+static int table_writer_finish(TableWriter *w)
+{
+    char footer[FOOTER_SIZE];
+    int ok = table_writer_flush_block(w);
+    uint64_t filter_offset = w->offset;
+    size_t filter_len = bloom_encoded_size(w->filter);
+    char *filter = malloc(filter_len);
+    if (filter)
+    {
+        bloom_encode(w->filter, filter);
+        ok = ok && write_all(w->fd, filter, filter_len);
+    }
+    uint64_t index_offset = w->offset + filter_len;
+    uint32_t magic = TABLE_MAGIC;
+    memcpy(footer, &filter_offset, 8);
+    memcpy(footer + 8, &index_offset, 8);
+    memcpy(footer + 16, &w->block_count, 4);
+    memcpy(footer + 20, &w->entries, 8);
+    memcpy(footer + 28, &magic, 4);
+    ok = ok && filter && write_all(w->fd, w->index.data ? w->index.data : "", w->index.len) &&
+         write_all(w->fd, footer, FOOTER_SIZE);
+#if WRITER_FSYNC
+    ok = ok && fsync(w->fd) == 0;
+#endif
+    if (ok) metrics_add(METRIC_DISK_BYTES_WRITTEN, index_offset + w->index.len + FOOTER_SIZE);
+    if (close(w->fd) != 0) ok = 0;
+    free(filter);
+    free(w->block.data);
+    free(w->index.data);
+    bloom_free(w->filter);
+    return ok;
+}
+
+// Walks a table's entries in order, one block in memory at a time
+typedef struct {
+    Table *table;
+    size_t block;
+    Buffer data;
+    size_t pos;
+    Entry entry;
+    int valid;
+} TableIter;
+
+static int table_iter_load(TableIter *it, size_t block)
+{
+    BlockRef *ref = &it->table->blocks[block];
+    it->block = block;
+    it->pos = 0;
+    it->data.len = 0;
+    if (!buffer_reserve(&it->data, ref->size) || !read_all(it->table->fd, it->data.data, ref->size, (off_t)ref->offset))
+    {
+        return 0;
+    }
+    it->data.len = ref->size;
+    metrics_add(METRIC_DISK_BYTES_READ, ref->size);
+    return 1;
+}
+
+// Advance to the next entry. Returns 0 on a read error; it->valid is cleared at the end.
+static int table_iter_next(TableIter *it)
+{
+    while (!decode_entry(it->data.data, it->data.len, &it->pos, &it->entry))
+    {
+        if (it->pos < it->data.len || it->block + 1 >= it->table->block_count)
+        {
+            it->valid = 0;
+            return it->pos >= it->data.len; // Malformed block if data is left over
+        }
+        if (!table_iter_load(it, it->block + 1))
+        {
+            it->valid = 0;
+            return 0;
+        }
+    }
+    it->valid = 1;
+    return 1;
+}
+
+// Position at the first entry with a key >= `key` (NULL = the first entry)
+static int table_iter_seek(TableIter *it, Table *t, const char *key)
+{
+    it->table = t;
+    it->valid = 0;
+    if (t->block_count == 0) return 1;
+
+    // Last block whose first key is <= key: only it can hold the key
+    size_t lo = 0;
+    size_t hi = t->block_count;
+    while (key && lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (strcmp(t->blocks[mid].first_key, key) <= 0) lo = mid + 1;
+        else hi = mid;
+    }
+    size_t block = lo > 0 ? lo - 1 : 0;
+    if (!table_iter_load(it, block)) return 0;
+    do
+    {
+        if (!table_iter_next(it)) return 0;
+    } while (it->valid && key && strcmp(it->entry.key, key) < 0);
+    return 1;
+}
+
+// --- Merging: memtable and tables, newest first, newest version wins ---
+
+typedef struct {
+    MemNode *node; // Memtable source when `iter.table` is NULL
+    TableIter iter;
+    const char *key;
+    int kind;
+    const char *value;
+} Source;
+
+typedef struct {
+    Source *sources;
+    size_t count;
+    Buffer key; // Current entry, copied out of its source
+    Buffer value;
+    int kind;
+} MergeIter;
+
+static void source_sync(Source *s)
+{
+    if (s->iter.table)
+    {
+        s->key = s->iter.valid ? s->iter.entry.key : NULL;
+        s->kind = s->iter.entry.kind;
+        s->value = s->iter.entry.value;
+    }
+    else
+    {
+        s->key = s->node ? s->node->key : NULL;
+        s->kind = s->node && s->node->value ? KIND_PUT : KIND_DELETE;
+        s->value = s->node && s->node->value ? s->node->value : "";
+    }
+}
+
+static int source_next(Source *s)
+{
+    if (s->iter.table)
+    {
+        if (!table_iter_next(&s->iter)) return 0;
+    }
+    else
+    {
+        s->node = s->node->next[0];
+    }
+    source_sync(s);
+    return 1;
+}
+
+static void merge_free(MergeIter *m)
+{
+    for (size_t i = 0; i < m->count; i++) free(m->sources[i].iter.data.data);
+    free(m->sources);
+    free(m->key.data);
+    free(m->value.data);
+}
+
+static int merge_init(MergeIter *m, Memtable *mem, Table **tables, size_t table_count, const char *start)
+{
+    memset(m, 0, sizeof(*m));
+    m->sources = calloc(table_count + 1, sizeof(Source));
+    if (!m->sources) return 0;
+    if (mem)
+    {
+        Source *s = &m->sources[m->count++];
+        s->node = memtable_seek(mem, start, NULL);
+        source_sync(s);
+    }
+    for (size_t i = 0; i < table_count; i++)
+    {
+        Source *s = &m->sources[m->count++];
+        if (!table_iter_seek(&s->iter, tables[i], start))
+        {
+            merge_free(m);
+            return 0;
+        }
+        source_sync(s);
+    }
+    return 1;
+}
+
+// Step to the next distinct key. Returns 1 with the entry in m->key/value/kind,
+// 0 at the end, -1 on a read error.
+static int merge_next(MergeIter *m)
+{
+    Source *winner = NULL;
+    for (size_t i = 0; i < m->count; i++)
+    {
+        Source *s = &m->sources[i];
+        if (s->key && (!winner || strcmp(s->key, winner->key) < 0)) winner = s; // Ties keep the newest
+    }
+    if (!winner) return 0;
+    m->kind = winner->kind;
+    if (!buffer_set_string(&m->key, winner->key) || !buffer_set_string(&m->value, winner->value)) return -1;
+    for (size_t i = 0; i < m->count; i++)
+    {
+        Source *s = &m->sources[i];
+        if (s->key && strcmp(s->key, m->key.data) == 0 && !source_next(s)) return -1;
+    }
+    return 1;
+}
+
+// --- The open database ---
+
+typedef struct {
+    char *path;
+    pthread_rwlock_t lock;  // Memtable and table list: shared for reads
+    pthread_mutex_t write_mutex; // Log appends and flushes
+    pthread_mutex_t manifest_mutex; // Table list changes plus their MANIFEST
+    pthread_mutex_t compact_mutex;  // One compaction at a time
+    Memtable *mem;
+    Table **tables; // Newest first
+    size_t table_count;
+    _Atomic uint64_t next_id;
+    int wal_fd;
+
+    pthread_t compactor;
+    int compactor_running;
+    pthread_mutex_t wake_mutex;
+    pthread_cond_t wake_cond;
+    int stopping;
+
+    int refs;     // Calls using the database, plus one while it is `db`; guarded by open_mutex
+    int retiring; // No longer `db` once the calls using it finish
+} Lsm;
+
+static Lsm *db;
+static pthread_mutex_t open_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t released_cond = PTHREAD_COND_INITIALIZER; // A retiring database was closed
+
+int lsm_selected(void)
+{
+    size_t len = strlen(FILENAME);
+    size_t suffix_len = strlen(LSM_SUFFIX);
+    return len > suffix_len && strcmp(FILENAME + len - suffix_len, LSM_SUFFIX) == 0;
+}
+
+// Write MANIFEST for `ids` (newest first). Called with manifest_mutex held.
+static int write_manifest(Lsm *d, const uint64_t *ids, size_t count)
+{
+    char path[4096], tmp_path[4096];
+    snprintf(path, sizeof(path), "%s/MANIFEST", d->path);
+    snprintf(tmp_path, sizeof(tmp_path), "%s/MANIFEST.tmp", d->path);
+    FILE *file = fopen(tmp_path, "w");
+    if (!file) return 0;
+    int ok = fprintf(file, "next %llu\n", (unsigned long long)atomic_load(&d->next_id)) > 0;
+    for (size_t i = 0; ok && i < count; i++)
+    {
+        ok = fprintf(file, "table %llu\n", (unsigned long long)ids[i]) > 0;
+    }
+    ok = ok && fflush(file) == 0;
+#if WRITER_FSYNC
+    ok = ok && fsync(fileno(file)) == 0;
+#endif
+    if (fclose(file) != 0) ok = 0;
+    ok = ok && rename(tmp_path, path) == 0;
+    if (!ok) perror("lsm: failed to write MANIFEST");
+    return ok;
+}
+
+// Replace tables [start, start + count) with `replacement` (may be NULL) and
+// persist the new list. If `mem` is given, its memtable is swapped in at the
+// same moment and *mem receives the old one.
+static int install_tables(Lsm *d, size_t start, size_t count, Table *replacement, Memtable **mem)
+{
+    pthread_mutex_lock(&d->manifest_mutex);
+    pthread_rwlock_wrlock(&d->lock);
+    size_t new_count = d->table_count - count + (replacement ? 1 : 0);
+    Table **tables = malloc((new_count ? new_count : 1) * sizeof(Table *));
+    uint64_t *ids = calloc(new_count ? new_count : 1, sizeof(uint64_t));
+    if (!tables || !ids)
+    {
+        pthread_rwlock_unlock(&d->lock);
+        pthread_mutex_unlock(&d->manifest_mutex);
+        free(tables);
+        free(ids);
+        return 0;
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < start; i++) tables[n++] = d->tables[i];
+    if (replacement) tables[n++] = replacement;
+    for (size_t i = start + count; i < d->table_count; i++) tables[n++] = d->tables[i];
+    for (size_t i = 0; i < n; i++) ids[i] = tables[i]->id;
+    free(d->tables);
+    d->tables = tables;
+    d->table_count = n;
+    if (mem)
+    {
+        Memtable *old = d->mem;
+        d->mem = *mem;
+        *mem = old;
+    }
+    pthread_rwlock_unlock(&d->lock);
+
+    int ok = write_manifest(d, ids, n);
+    pthread_mutex_unlock(&d->manifest_mutex);
+    free(ids);
+    return ok;
+}
+
+// Start writing table file `*id`, a fresh number, for up to `expected_keys` entries
+static int table_create(Lsm *d, TableWriter *w, uint64_t *id, size_t expected_keys)
+{
+    *id = atomic_fetch_add(&d->next_id, 1);
+    char path[4096];
+    table_path(path, sizeof(path), d->path, *id);
+    memset(w, 0, sizeof(*w));
+    w->filter = bloom_new(expected_keys);
+    if (!w->filter) return 0;
+    w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (w->fd < 0)
+    {
+        bloom_free(w->filter);
+        return 0;
+    }
+    return 1;
+}
+
+static void wake_compactor(Lsm *d)
+{
+    pthread_mutex_lock(&d->wake_mutex);
+    pthread_cond_signal(&d->wake_cond);
+    pthread_mutex_unlock(&d->wake_mutex);
+}
+
+// Write the memtable to a new table and start a new log. Called with write_mutex held.
+static int flush_memtable(Lsm *d)
+{
+    if (d->mem->count == 0) return 1;
+
+    TableWriter w;
+    uint64_t id;
+    if (!table_create(d, &w, &id, d->mem->count)) return 0;
+
+    pthread_rwlock_rdlock(&d->lock);
+    int drop_deletes = d->table_count == 0; // Nothing older for a deletion to hide
+    pthread_rwlock_unlock(&d->lock);
+
+    // Only this thread modifies the memtable, so it can be read without the lock
+    int ok = 1;
+    for (MemNode *node = d->mem->head->next[0]; ok && node; node = node->next[0])
+    {
+        if (!node->value && drop_deletes) continue;
+        ok = table_writer_add(&w, node->value ? KIND_PUT : KIND_DELETE, node->key, node->value);
+    }
+    ok = table_writer_finish(&w) && ok;
+    Table *table = ok ? table_open(d->path, id) : NULL;
+    Memtable *fresh = table ? memtable_new() : NULL;
+    if (!fresh)
+    {
+        char path[4096];
+        table_close(table, NULL);
+        table_path(path, sizeof(path), d->path, id);
+        unlink(path);
+        return 0;
+    }
+
+    // The table and the empty memtable become visible together
+    Memtable *mem = fresh;
+    ok = install_tables(d, 0, 0, table, &mem);
+    if (mem == fresh)
+    {
+        memtable_free(fresh); // Not installed
+        table_close(table, d->path);
+        return 0;
+    }
+    memtable_free(mem);
+
+    // Once MANIFEST lists the table the log is redundant. A crash before this
+    // point only replays entries the table already holds.
+    if (ok)
+    {
+        ok = ftruncate(d->wal_fd, 0) == 0;
+#if WRITER_FSYNC
+        ok = ok && fsync(d->wal_fd) == 0;
+#endif
+    }
+    metrics_inc(METRIC_LSM_FLUSHES);
+    wake_compactor(d);
+    return ok;
+}
+
+// Size-tiered choice: the newest tables, extended while the next older table
+// is at most LSM_SIZE_RATIO times what was gathered so far. Worth merging once
+// LSM_COMPACTION_TRIGGER tables qualify, or always past LSM_MAX_TABLES.
+static size_t pick_compaction(Lsm *d)
+{
+    if (d->table_count >= LSM_MAX_TABLES) return d->table_count;
+    uint64_t gathered = d->table_count ? d->tables[0]->file_size : 0;
+    size_t n = d->table_count ? 1 : 0;
+    while (n < d->table_count && d->tables[n]->file_size <= gathered * LSM_SIZE_RATIO)
+    {
+        gathered += d->tables[n]->file_size;
+        n++;
+    }
+    return n >= LSM_COMPACTION_TRIGGER ? n : 0;
+}
+
+// Merge the tables pick_compaction() chooses, or all of them, into one
+static int compact_tables(Lsm *d, int all)
+{
+    pthread_mutex_lock(&d->compact_mutex);
+
+    // Tables are immutable and only removed here, so the run can be read
+    // without the lock; flushes meanwhile only add newer tables in front
+    pthread_rwlock_rdlock(&d->lock);
+    size_t n = all ? d->table_count : pick_compaction(d);
+    Table **run = malloc((n ? n : 1) * sizeof(Table *));
+    if (run) memcpy(run, d->tables, n * sizeof(Table *));
+    int bottom = n == d->table_count; // Includes the oldest table: deletions can go
+    pthread_rwlock_unlock(&d->lock);
+    if (!run || n < 2)
+    {
+        free(run);
+        pthread_mutex_unlock(&d->compact_mutex);
+        return run != NULL;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    TRACE_BEGIN(compaction, "compaction", NULL);
+    size_t expected_keys = 0;
+    for (size_t i = 0; i < n; i++) expected_keys += (size_t)run[i]->entries;
+    TableWriter w;
+    uint64_t id;
+    int created = table_create(d, &w, &id, expected_keys);
+    MergeIter m;
+    int ok = created && merge_init(&m, NULL, run, n, NULL);
+    if (ok)
+    {
+        int step = 0;
+        while (ok && (step = merge_next(&m)) > 0)
+        {
+            if (m.kind == KIND_DELETE && bottom) continue;
+            ok = table_writer_add(&w, m.kind, m.key.data, m.value.data);
+        }
+        ok = ok && step == 0;
+        merge_free(&m);
+    }
+    if (created) ok = table_writer_finish(&w) && ok;
+
+    Table *merged = NULL;
+    if (ok)
+    {
+        merged = table_open(d->path, id);
+        ok = merged != NULL;
+    }
+    if (ok && merged->entries == 0)
+    {
+        table_close(merged, d->path); // Everything in the run was deleted
+        merged = NULL;
+    }
+
+    if (ok)
+    {
+        // The run is still contiguous; find where flushes have pushed it
+        pthread_rwlock_rdlock(&d->lock);
+        size_t start = 0;
+        while (d->tables[start] != run[0]) start++;
+        pthread_rwlock_unlock(&d->lock);
+        ok = install_tables(d, start, n, merged, NULL);
+    }
+    if (ok)
+    {
+        for (size_t i = 0; i < n; i++) table_close(run[i], d->path);
+        metrics_inc(METRIC_LSM_COMPACTIONS);
+        metrics_record_since(LATENCY_COMPACTION, &start);
+    }
+    else if (created)
+    {
+        perror("lsm: compaction failed");
+        if (merged) table_close(merged, d->path);
+        else
+        {
+            char path[4096];
+            table_path(path, sizeof(path), d->path, id);
+            unlink(path);
+        }
+    }
+    TRACE_END(compaction, "compaction", NULL, ok ? (int64_t)n : -1); // Tables merged
+    free(run);
+    pthread_mutex_unlock(&d->compact_mutex);
+    return ok;
+}
+
+static void *compactor_main(void *arg)
+{
+    Lsm *d = arg;
+    pthread_mutex_lock(&d->wake_mutex);
+    while (!d->stopping)
+    {
+        pthread_rwlock_rdlock(&d->lock);
+        size_t n = pick_compaction(d);
+        pthread_rwlock_unlock(&d->lock);
+        if (n == 0)
+        {
+            pthread_cond_wait(&d->wake_cond, &d->wake_mutex);
+            continue;
+        }
+        pthread_mutex_unlock(&d->wake_mutex);
+        int ok = compact_tables(d, 0);
+        pthread_mutex_lock(&d->wake_mutex);
+        if (!ok) break; // Leave the tables as they are rather than retry in a loop
+    }
+    pthread_mutex_unlock(&d->wake_mutex);
+    return NULL;
+}
+
+// Replay complete batches from the log; a torn tail from a crash is cut off
+static int replay_wal(Lsm *d)
+{
+    struct stat st;
+    if (fstat(d->wal_fd, &st) != 0) return 0;
+    size_t len = (size_t)st.st_size;
+    char *data = malloc(len ? len : 1);
+    if (!data || !read_all(d->wal_fd, data, len, 0))
+    {
+        free(data);
+        return 0;
+    }
+
+    size_t pos = 0;
+    int ok = 1;
+    while (ok && len - pos >= FRAME_HEADER)
+    {
+        uint32_t payload_len;
+        uint64_t hash;
+        memcpy(&payload_len, data + pos, 4);
+        memcpy(&hash, data + pos + 4, 8);
+        if (len - pos - FRAME_HEADER < payload_len ||
+            hash_content(data + pos + FRAME_HEADER, payload_len) != hash)
+        {
+            break;
+        }
+        const char *payload = data + pos + FRAME_HEADER;
+        size_t entry_pos = 0;
+        Entry e;
+        while (ok && decode_entry(payload, payload_len, &entry_pos, &e))
+        {
+            ok = memtable_put(d->mem, e.key, e.kind == KIND_PUT ? e.value : NULL);
+        }
+        pos += FRAME_HEADER + payload_len;
+    }
+    free(data);
+    if (ok && pos < len) ok = ftruncate(d->wal_fd, (off_t)pos) == 0;
+    return ok;
+}
+
+static int is_live_table(const Lsm *d, uint64_t id)
+{
+    for (size_t i = 0; i < d->table_count; i++)
+    {
+        if (d->tables[i]->id == id) return 1;
+    }
+    return 0;
+}
+
+static void close_database(Lsm *d)
+{
+    if (!d) return;
+    if (d->compactor_running)
+    {
+        pthread_mutex_lock(&d->wake_mutex);
+        d->stopping = 1;
+        pthread_cond_signal(&d->wake_cond);
+        pthread_mutex_unlock(&d->wake_mutex);
+        pthread_join(d->compactor, NULL);
+    }
+    for (size_t i = 0; i < d->table_count; i++) table_close(d->tables[i], NULL);
+    free(d->tables);
+    memtable_free(d->mem);
+    if (d->wal_fd >= 0) close(d->wal_fd);
+    pthread_rwlock_destroy(&d->lock);
+    pthread_mutex_destroy(&d->write_mutex);
+    pthread_mutex_destroy(&d->manifest_mutex);
+    pthread_mutex_destroy(&d->compact_mutex);
+    pthread_mutex_destroy(&d->wake_mutex);
+    pthread_cond_destroy(&d->wake_cond);
+    free(d->path);
+    free(d);
+}
+
+static Lsm *open_database(const char *path)
+{
+    if (mkdir(path, 0755) != 0 && errno != EEXIST)
+    {
+        perror("lsm: failed to create database directory");
+        return NULL;
+    }
+    Lsm *d = calloc(1, sizeof(Lsm));
+    if (!d) return NULL;
+    d->wal_fd = -1;
+    pthread_rwlock_init(&d->lock, NULL);
+    pthread_mutex_init(&d->write_mutex, NULL);
+    pthread_mutex_init(&d->manifest_mutex, NULL);
+    pthread_mutex_init(&d->compact_mutex, NULL);
+    pthread_mutex_init(&d->wake_mutex, NULL);
+    pthread_cond_init(&d->wake_cond, NULL);
+    d->path = my_strdup(path);
+    d->mem = memtable_new();
+    atomic_store(&d->next_id, 1);
+    int ok = d->path && d->mem;
+
+    char file_path[4096];
+    snprintf(file_path, sizeof(file_path), "%s/MANIFEST", path);
+    FILE *manifest = ok ? fopen(file_path, "r") : NULL;
+    if (manifest)
+    {
+        char word[16];
+        unsigned long long id;
+        while (ok && fscanf(manifest, "%15s %llu", word, &id) == 2)
+        {
+            if (strcmp(word, "next") == 0)
+            {
+                atomic_store(&d->next_id, id);
+                continue;
+            }
+            Table *t = table_open(path, id);
+            Table **grown = t ? realloc(d->tables, (d->table_count + 1) * sizeof(Table *)) : NULL;
+            if (!grown)
+            {
+                fprintf(stderr, "lsm: cannot open table %06llu\n", id);
+                table_close(t, NULL);
+                ok = 0;
+                break;
+            }
+            d->tables = grown;
+            d->tables[d->table_count++] = t;
+        }
+        fclose(manifest);
+    }
+
+    // Tables not in MANIFEST are leftovers of an interrupted flush or compaction
+    DIR *dir = ok ? opendir(path) : NULL;
+    if (dir)
+    {
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL)
+        {
+            unsigned long long id;
+            char tail[8];
+            if (sscanf(entry->d_name, "%llu.%7s", &id, tail) == 2 && strcmp(tail, "sst") == 0 &&
+                !is_live_table(d, id))
+            {
+                snprintf(file_path, sizeof(file_path), "%s/%s", path, entry->d_name);
+                unlink(file_path);
+            }
+        }
+        closedir(dir);
+    }
+
+    if (ok)
+    {
+        snprintf(file_path, sizeof(file_path), "%s/wal.log", path);
+        d->wal_fd = open(file_path, O_RDWR | O_CREAT | O_APPEND, 0644);
+        ok = d->wal_fd >= 0 && replay_wal(d);
+    }
+    if (ok)
+    {
+        ok = pthread_create(&d->compactor, NULL, compactor_main, d) == 0;
+        d->compactor_running = ok;
+    }
+    if (!ok)
+    {
+        fprintf(stderr, "lsm: failed to open %s\n", path);
+        close_database(d);
+        return NULL;
+    }
+    return d;
+}
+
+// Drop a reference; the last one closes the database. Called with open_mutex held.
+static void unref_database(Lsm *d)
+{
+    if (--d->refs > 0) return;
+    if (db == d) db = NULL;
+    close_database(d);
+    pthread_cond_broadcast(&released_cond);
+}
+
+// Stop handing out `db` and wait for the calls still using it to finish, so
+// the same directory is never open twice. Called with open_mutex held.
+static void retire_database(void)
+{
+    while (db)
+    {
+        if (!db->retiring)
+        {
+            db->retiring = 1;
+            unref_database(db); // The reference `db` itself held
+            continue;
+        }
+        pthread_cond_wait(&released_cond, &open_mutex);
+    }
+}
+
+// The database at FILENAME, opened on first use, with a reference the caller
+// gives back through release_database(). A process serves one LSM database at
+// a time; pointing FILENAME elsewhere closes the previous one once the calls
+// using it are done.
+static Lsm *acquire_database(void)
+{
+    pthread_mutex_lock(&open_mutex);
+    if (db && (db->retiring || strcmp(db->path, FILENAME) != 0)) retire_database();
+    if (!db && (db = open_database(FILENAME))) db->refs = 1;
+    Lsm *d = db;
+    if (d) d->refs++;
+    pthread_mutex_unlock(&open_mutex);
+    return d;
+}
+
+static void release_database(Lsm *d)
+{
+    pthread_mutex_lock(&open_mutex);
+    unref_database(d);
+    pthread_mutex_unlock(&open_mutex);
+}
+
+int lsm_ensure(void)
+{
+    Lsm *d = acquire_database();
+    if (d) release_database(d);
+    return d != NULL;
+}
+
+void lsm_close(void)
+{
+    pthread_mutex_lock(&open_mutex);
+    retire_database();
+    pthread_mutex_unlock(&open_mutex);
+}
+
+int lsm_get(const char *key, char **value)
+{
+    Lsm *d = acquire_database();
+    if (!d) return -1;
+
+    int result = 0;
+    pthread_rwlock_rdlock(&d->lock);
+    MemNode *node = memtable_seek(d->mem, key, NULL);
+    if (node && strcmp(node->key, key) == 0)
+    {
+        result = node->value ? 1 : 0;
+        if (result && !(*value = my_strdup(node->value))) result = -1;
+    }
+    else
+    {
+        TableIter it = {0};
+        for (size_t i = 0; i < d->table_count; i++)
+        {
+            Table *t = d->tables[i];
+            if (t->filter && !bloom_may_contain(t->filter, key))
+            {
+                metrics_inc(METRIC_BLOOM_NEGATIVES);
+                continue;
+            }
+            if (!table_iter_seek(&it, t, key))
+            {
+                result = -1;
+                break;
+            }
+            if (it.valid && strcmp(it.entry.key, key) == 0)
+            {
+                result = it.entry.kind == KIND_PUT ? 1 : 0;
+                if (result && !(*value = my_strdup(it.entry.value))) result = -1;
+                break;
+            }
+            if (t->filter) metrics_inc(METRIC_BLOOM_FALSE_POSITIVES);
+        }
+        free(it.data.data);
+    }
+    pthread_rwlock_unlock(&d->lock);
+    release_database(d);
+    return result;
+}
+
+int lsm_apply(const char *const *keys, const char *const *values, size_t count)
+{
+    Lsm *d = acquire_database();
+    if (!d) return 0;
+
+    Buffer frame = {0};
+    int ok = buffer_reserve(&frame, FRAME_HEADER);
+    frame.len = FRAME_HEADER;
+    for (size_t i = 0; ok && i < count; i++)
+    {
+        ok = encode_entry(&frame, values[i] ? KIND_PUT : KIND_DELETE, keys[i], values[i]);
+    }
+    if (!ok)
+    {
+        free(frame.data);
+        release_database(d);
+        return 0;
+    }
+    uint32_t payload_len = (uint32_t)(frame.len - FRAME_HEADER);
+    uint64_t hash = hash_content(frame.data + FRAME_HEADER, payload_len);
+    memcpy(frame.data, &payload_len, 4);
+    memcpy(frame.data + 4, &hash, 8);
+
+    pthread_mutex_lock(&d->write_mutex);
+    ok = write_all(d->wal_fd, frame.data, frame.len);
+#if WRITER_FSYNC
+    ok = ok && fdatasync(d->wal_fd) == 0;
+#endif
+    if (ok)
+    {
+        metrics_add(METRIC_DISK_BYTES_WRITTEN, frame.len);
+        pthread_rwlock_wrlock(&d->lock);
+        for (size_t i = 0; ok && i < count; i++) ok = memtable_put(d->mem, keys[i], values[i]);
+        pthread_rwlock_unlock(&d->lock);
+    }
+    // The batch is durable in the log, so a failed flush is retried by the next one
+    if (ok && d->mem->bytes >= LSM_MEMTABLE_BYTES && !flush_memtable(d))
+    {
+        perror("lsm: memtable flush failed");
+    }
+    pthread_mutex_unlock(&d->write_mutex);
+    free(frame.data);
+    release_database(d);
+    return ok;
+}
+
+static int in_range(const char *key, const char *end, const char *prefix, size_t prefix_len)
+{
+    if (end && strcmp(key, end) >= 0) return 0;
+    return !prefix || strncmp(key, prefix, prefix_len) == 0;
+}
+
+int lsm_scan(const char *start, const char *end, const char *prefix, size_t limit, int with_values,
+             DataItem **items, size_t *size, size_t *capacity, char **next)
+{
+    if (next) *next = NULL;
+    Lsm *d = acquire_database();
+    if (!d) return 0;
+
+    const char *from = start ? start : prefix;
+    if (start && prefix && strcmp(prefix, start) > 0) from = prefix;
+    size_t prefix_len = prefix ? strlen(prefix) : 0;
+
+    pthread_rwlock_rdlock(&d->lock);
+    MergeIter m;
+    int ok = merge_init(&m, d->mem, d->tables, d->table_count, from);
+    size_t returned = 0;
+    int step = 0;
+    while (ok && (step = merge_next(&m)) > 0)
+    {
+        if (m.kind == KIND_DELETE) continue;
+        if (!in_range(m.key.data, end, prefix, prefix_len)) break;
+        if (returned == limit)
+        {
+            if (next) ok = (*next = my_strdup(m.key.data)) != NULL;
+            break;
+        }
+        char *key = my_strdup(m.key.data);
+        char *value = with_values ? my_strdup(m.value.data) : NULL;
+        if (!key || (with_values && !value))
+        {
+            free(key);
+            free(value);
+            ok = 0;
+            break;
+        }
+        ensure_list_capacity(items, capacity, *size + 1);
+        (*items)[*size].key = key;
+        (*items)[*size].value = value;
+        (*size)++;
+        returned++;
+    }
+    if (step < 0) ok = 0;
+    if (m.sources) merge_free(&m);
+    pthread_rwlock_unlock(&d->lock);
+    release_database(d);
+    return ok;
+}
+
+int lsm_count(void)
+{
+    Lsm *d = acquire_database();
+    if (!d) return -1;
+
+    pthread_rwlock_rdlock(&d->lock);
+    MergeIter m;
+    int count = merge_init(&m, d->mem, d->tables, d->table_count, NULL) ? 0 : -1;
+    int step = 0;
+    while (count >= 0 && (step = merge_next(&m)) > 0)
+    {
+        if (m.kind == KIND_PUT) count++;
+    }
+    if (count >= 0) merge_free(&m);
+    pthread_rwlock_unlock(&d->lock);
+    release_database(d);
+    return step < 0 ? -1 : count;
+}
+
+int lsm_flush(void)
+{
+    Lsm *d = acquire_database();
+    if (!d) return 0;
+    pthread_mutex_lock(&d->write_mutex);
+    int ok = flush_memtable(d);
+    pthread_mutex_unlock(&d->write_mutex);
+    release_database(d);
+    return ok;
+}
+
+int lsm_compact(void)
+{
+    Lsm *d = acquire_database();
+    if (!d) return 0;
+    int ok = compact_tables(d, 1);
+    release_database(d);
+    return ok;
+}
+
+int lsm_table_count(void)
+{
+    Lsm *d = acquire_database();
+    if (!d) return -1;
+    pthread_rwlock_rdlock(&d->lock);
+    int count = (int)d->table_count;
+    pthread_rwlock_unlock(&d->lock);
+    release_database(d);
+    return count;
+}
@@ -0,0 +1,47 @@
+#ifndef LSM_H
+#define LSM_H
+
+#include "ds.h"     // For DataItem
+#include <stddef.h> // For size_t
+
+// Optional log-structured merge-tree engine, for datasets far larger than
+// memory. A database whose path ends in LSM_SUFFIX is a directory holding:
+//
+//   wal.log    - every committed batch, replayed into the memtable on open
+//   NNNNNN.sst - immutable tables sorted by key, in blocks of ~LSM_BLOCK_SIZE
+//                with a sparse index (first key of each block) at the end
+//   MANIFEST   - the live tables, newest first
+//
+// Writes go to the write-ahead log and a skip-list memtable, which is flushed
+// to a new table once it reaches LSM_MEMTABLE_BYTES. A background thread merges
+// similar-sized tables (size-tiered compaction). Lookups check the memtable,
+// then tables from newest to oldest, reading at most one block per table and
+// none where the table's Bloom filter rules the key out.
+//
+// The io.h and index.h entry points dispatch here when lsm_selected(), so the
+// command layer and the writer thread work unchanged on either engine.
+
+int lsm_selected(void); // FILENAME names an LSM database
+
+int lsm_ensure(void); // Open the database at FILENAME, creating it if needed
+void lsm_close(void); // Stop compaction and release the open database
+
+// 1 if found (*value is malloc'd), 0 if not, -1 on error
+int lsm_get(const char *key, char **value);
+int lsm_count(void); // Live keys, or -1 on error
+
+// Durably apply a batch: values[i] == NULL deletes keys[i]. The batch is one
+// write-ahead log record, so after a crash it is replayed entirely or not at all.
+int lsm_apply(const char *const *keys, const char *const *values, size_t count);
+
+// Ordered scan with the semantics of index_scan()
+int lsm_scan(const char *start, const char *end, const char *prefix, size_t limit, int with_values,
+             DataItem **items, size_t *size, size_t *capacity, char **next);
+
+// Force a memtable flush / a full compaction (normally automatic)
+int lsm_flush(void);
+int lsm_compact(void);
+
+int lsm_table_count(void);
+
+#endif // LSM_H
@@ -0,0 +1,441 @@
+#include "metrics.h"
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+// One shard per thread, aligned so neighbouring shards never share a cache line.
+// Only the owning thread writes a shard; scrapers read it with relaxed loads.
+typedef struct MetricsShard {
+    _Alignas(64) _Atomic uint64_t counters[METRIC_COUNTER_COUNT];
+    SharedHistogram latency[LATENCY_KIND_COUNT];
+    _Atomic uint64_t io[IO_OP_KIND_COUNT][IO_STAT_KIND_COUNT];
+    atomic_int in_use;
+    struct MetricsShard *next;
+} MetricsShard;
+
+static const char *counter_names[METRIC_COUNTER_COUNT][2] = {
+    [METRIC_CMD_GET] = {"zu_commands_total{command=\"get\"}", "Commands executed, by command"},
+    [METRIC_CMD_SET] = {"zu_commands_total{command=\"set\"}", NULL},
+    [METRIC_CMD_RM] = {"zu_commands_total{command=\"rm\"}", NULL},
+    [METRIC_CMD_INCR] = {"zu_commands_total{command=\"incr\"}", NULL},
+    [METRIC_CMD_APPEND] = {"zu_commands_total{command=\"append\"}", NULL},
+    [METRIC_CMD_CAS] = {"zu_commands_total{command=\"cas\"}", NULL},
+    [METRIC_CMD_EXEC] = {"zu_commands_total{command=\"exec\"}", NULL},
+    [METRIC_CMD_SCAN] = {"zu_commands_total{command=\"scan\"}", NULL},
+    [METRIC_CMD_RANGE] = {"zu_commands_total{command=\"range\"}", NULL},
+    [METRIC_CMD_DBSIZE] = {"zu_commands_total{command=\"dbsize\"}", NULL},
+    [METRIC_CMD_ERRORS] = {"zu_command_errors_total", "Commands that failed with a storage error"},
+    [METRIC_CACHE_HITS] = {"zu_cache_hits_total", "Lookups served from the memory cache"},
+    [METRIC_CACHE_MISSES] = {"zu_cache_misses_total", "Lookups that fell through to disk"},
+    [METRIC_CACHE_EVICTIONS] = {"zu_cache_evictions_total", "Entries evicted from a full cache"},
+    [METRIC_CACHE_EXPIRATIONS] = {"zu_cache_expirations_total", "Entries dropped from the cache after CACHE_TTL"},
+    [METRIC_DISK_BYTES_READ] = {"zu_disk_read_bytes_total", "Bytes read from the database file"},
+    [METRIC_DISK_BYTES_WRITTEN] = {"zu_disk_written_bytes_total", "Bytes written to the database file"},
+    [METRIC_WRITER_BATCHES] = {"zu_writer_batches_total", "Batches committed by the writer thread"},
+    [METRIC_WRITER_OPS] = {"zu_writer_ops_total", "Writes committed by the writer thread"},
+    [METRIC_TXN_ABORTS] = {"zu_transaction_aborts_total", "Transactions aborted by a watch or a failed operation"},
+    [METRIC_INDEX_REBUILDS] = {"zu_index_rebuilds_total", "Key index rebuilds after the file changed outside the writer"},
+    [METRIC_LSM_FLUSHES] = {"zu_lsm_flushes_total", "LSM memtables written out as tables"},
+    [METRIC_LSM_COMPACTIONS] = {"zu_lsm_compactions_total", "LSM compactions merging tables into one"},
+    [METRIC_BLOOM_NEGATIVES] = {"zu_bloom_negatives_total", "Disk reads skipped because a Bloom filter ruled the key out"},
+    [METRIC_BLOOM_FALSE_POSITIVES] = {"zu_bloom_false_positives_total", "Disk reads a Bloom filter allowed for a key that was not there"},
+    [METRIC_HTTP_CONNECTIONS] = {"zu_http_connections_total", "Connections accepted by the REST server"},
+    [METRIC_HTTP_REQUESTS] = {"zu_http_requests_total", "Requests handled by the REST server"},
+    [METRIC_HTTP_REJECTED_CONNECTIONS] = {"zu_http_rejections_total{reason=\"connections\"}", "REST requests answered with 503, by reason"},
+    [METRIC_HTTP_REJECTED_QUEUE] = {"zu_http_rejections_total{reason=\"queue\"}", NULL},
+    [METRIC_HTTP_REJECTED_STORAGE] = {"zu_http_rejections_total{reason=\"storage\"}", NULL},
+    [METRIC_RESP_CONNECTIONS] = {"zu_resp_connections_total", "Connections accepted by the RESP server"},
+    [METRIC_RESP_DISCONNECTIONS] = {"zu_resp_disconnections_total", "RESP connections closed"},
+    [METRIC_RESP_COMMANDS] = {"zu_resp_commands_total", "Commands executed by the RESP server"},
+};
+
+static const char *gauge_names[METRIC_GAUGE_COUNT][2] = {
+    [GAUGE_HTTP_CONNECTIONS] = {"zu_http_connections", "Open REST connections, queued or in service"},
+    [GAUGE_HTTP_QUEUE_DEPTH] = {"zu_http_queue_depth", "REST connections waiting for a worker"},
+    [GAUGE_HTTP_INFLIGHT_WRITES] = {"zu_http_inflight_writes", "REST writes currently being applied"},
+    [GAUGE_WRITER_PENDING] = {"zu_writer_pending", "Writes waiting for the writer thread to commit them"},
+    [GAUGE_BLOOM_BITS] = {"zu_bloom_filter_bits", "Bits in the Bloom filters in use"},
+    [GAUGE_BLOOM_KEYS] = {"zu_bloom_filter_keys", "Keys added to the Bloom filters in use"},
+    [GAUGE_INDEX_BYTES] = {"zu_memory_index_bytes", "Bytes allocated by key indexes"},
+    [GAUGE_MEMTABLE_BYTES] = {"zu_memory_memtable_bytes", "Bytes held by LSM memtables"},
+    [GAUGE_HTTP_BUFFER_BYTES] = {"zu_memory_http_buffer_bytes", "Bytes of REST request buffers in use"},
+};
+
+static _Atomic int64_t gauges[METRIC_GAUGE_COUNT];
+
+static const char *latency_names[LATENCY_KIND_COUNT] = {
+    [LATENCY_CACHE_HIT] = "cache_hit",
+    [LATENCY_DISK_HIT] = "disk_hit",
+    [LATENCY_MISS] = "miss",
+    [LATENCY_SET] = "set",
+    [LATENCY_DELETE] = "delete",
+    [LATENCY_COMPACTION] = "compaction",
+    [LATENCY_HTTP] = "http",
+};
+
+static const char *io_op_names[IO_OP_KIND_COUNT] = {
+    [IO_OP_FIND] = "find",
+    [IO_OP_SCAN] = "scan",
+    [IO_OP_LIST] = "list",
+    [IO_OP_DBSIZE] = "dbsize",
+    [IO_OP_COMMIT] = "commit",
+    [IO_OP_INDEX] = "index",
+    [IO_OP_EXISTS] = "exists",
+};
+
+static const char *io_stat_names[IO_STAT_KIND_COUNT] = {
+    [IO_STAT_CALLS] = "calls",
+    [IO_STAT_BYTES_READ] = "bytes_read",
+    [IO_STAT_BYTES_WRITTEN] = "bytes_written",
+    [IO_STAT_RECORDS] = "records",
+    [IO_STAT_OPENS] = "opens",
+    [IO_STAT_FSYNCS] = "fsyncs",
+    [IO_STAT_FLOCK_WAITS] = "flock_waits",
+    [IO_STAT_FLOCK_WAIT_NS] = "flock_wait_ns",
+    [IO_STAT_LOCK_WAITS] = "lock_waits",
+    [IO_STAT_LOCK_WAIT_NS] = "lock_wait_ns",
+};
+
+// Totals as of the last metrics_stats_reset
+static pthread_mutex_t baseline_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t counter_baseline[METRIC_COUNTER_COUNT];
+static uint64_t io_baseline[IO_OP_KIND_COUNT][IO_STAT_KIND_COUNT];
+
+static MetricsShard *_Atomic shard_list = NULL;
+static pthread_mutex_t shard_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t shard_key;
+static pthread_once_t shard_key_once = PTHREAD_ONCE_INIT;
+static _Thread_local MetricsShard *local_shard = NULL;
+
+// Thread exit: keep the totals but let a future thread reuse the shard
+static void release_shard(void *shard)
+{
+    atomic_store(&((MetricsShard *)shard)->in_use, 0);
+}
+
+static void create_shard_key(void)
+{
+    pthread_key_create(&shard_key, release_shard);
+}
+
+static MetricsShard *acquire_shard(void)
+{
+    pthread_once(&shard_key_once, create_shard_key);
+    pthread_mutex_lock(&shard_mutex);
+
+    MetricsShard *shard = atomic_load(&shard_list);
+    while (shard && atomic_load(&shard->in_use))
+    {
+        shard = shard->next;
+    }
+    if (shard)
+    {
+        atomic_store(&shard->in_use, 1);
+    }
+    else
+    {
+        shard = aligned_alloc(64, sizeof(MetricsShard));
+        if (!shard)
+        {
+            perror("metrics: shard allocation failed");
+            exit(EXIT_FAILURE);
+        }
+        memset(shard, 0, sizeof(MetricsShard));
+        atomic_store(&shard->in_use, 1);
+        shard->next = atomic_load(&shard_list);
+        atomic_store(&shard_list, shard); // Publish after the shard is initialized
+    }
+
+    pthread_mutex_unlock(&shard_mutex);
+    pthread_setspecific(shard_key, shard);
+    return shard;
+}
+
+static inline MetricsShard *get_shard(void)
+{
+    MetricsShard *shard = local_shard;
+    if (!shard)
+    {
+        shard = local_shard = acquire_shard();
+    }
+    return shard;
+}
+
+void metrics_add(metric_counter_t counter, uint64_t amount)
+{
+    single_writer_add(&get_shard()->counters[counter], amount);
+}
+
+void metrics_inc(metric_counter_t counter)
+{
+    metrics_add(counter, 1);
+}
+
+void metrics_record_latency(latency_kind_t kind, uint64_t nanoseconds)
+{
+    shared_histogram_record(&get_shard()->latency[kind], nanoseconds);
+}
+
+uint64_t metrics_record_since(latency_kind_t kind, const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t elapsed = (int64_t)(now.tv_sec - start->tv_sec) * 1000000000LL + (now.tv_nsec - start->tv_nsec);
+    uint64_t nanoseconds = elapsed > 0 ? (uint64_t)elapsed : 0;
+    metrics_record_latency(kind, nanoseconds);
+    return nanoseconds;
+}
+
+const char *metrics_latency_name(latency_kind_t kind)
+{
+    return latency_names[kind];
+}
+
+void metrics_latency_snapshot(latency_kind_t kind, LatencyHistogram *into)
+{
+    for (MetricsShard *shard = atomic_load(&shard_list); shard; shard = shard->next)
+    {
+        shared_histogram_merge(into, &shard->latency[kind]);
+    }
+}
+
+int64_t metrics_gauge_add(metric_gauge_t gauge, int64_t delta)
+{
+    return atomic_fetch_add(&gauges[gauge], delta) + delta;
+}
+
+int64_t metrics_gauge_get(metric_gauge_t gauge)
+{
+    return atomic_load(&gauges[gauge]);
+}
+
+uint64_t metrics_counter_total(metric_counter_t counter)
+{
+    uint64_t total = 0;
+    for (MetricsShard *shard = atomic_load(&shard_list); shard; shard = shard->next)
+    {
+        total += atomic_load_explicit(&shard->counters[counter], memory_order_relaxed);
+    }
+    return total;
+}
+
+void metrics_io_add(io_op_t op, io_stat_t stat, uint64_t amount)
+{
+    single_writer_add(&get_shard()->io[op][stat], amount);
+}
+
+const char *metrics_io_op_name(io_op_t op)
+{
+    return io_op_names[op];
+}
+
+const char *metrics_io_stat_name(io_stat_t stat)
+{
+    return io_stat_names[stat];
+}
+
+static void io_totals(uint64_t stats[IO_OP_KIND_COUNT][IO_STAT_KIND_COUNT])
+{
+    memset(stats, 0, sizeof(uint64_t) * IO_OP_KIND_COUNT * IO_STAT_KIND_COUNT);
+    for (MetricsShard *shard = atomic_load(&shard_list); shard; shard = shard->next)
+    {
+        for (int op = 0; op < IO_OP_KIND_COUNT; op++)
+        {
+            for (int stat = 0; stat < IO_STAT_KIND_COUNT; stat++)
+            {
+                stats[op][stat] += atomic_load_explicit(&shard->io[op][stat], memory_order_relaxed);
+            }
+        }
+    }
+}
+
+void metrics_io_snapshot(uint64_t stats[IO_OP_KIND_COUNT][IO_STAT_KIND_COUNT])
+{
+    io_totals(stats);
+    pthread_mutex_lock(&baseline_mutex);
+    for (int op = 0; op < IO_OP_KIND_COUNT; op++)
+    {
+        for (int stat = 0; stat < IO_STAT_KIND_COUNT; stat++)
+        {
+            // A reset racing with the totals above can leave a baseline ahead of them
+            uint64_t base = io_baseline[op][stat];
+            stats[op][stat] = stats[op][stat] > base ? stats[op][stat] - base : 0;
+        }
+    }
+    pthread_mutex_unlock(&baseline_mutex);
+}
+
+uint64_t metrics_counter_since_reset(metric_counter_t counter)
+{
+    uint64_t total = metrics_counter_total(counter);
+    pthread_mutex_lock(&baseline_mutex);
+    uint64_t base = counter_baseline[counter];
+    pthread_mutex_unlock(&baseline_mutex);
+    return total > base ? total - base : 0;
+}
+
+void metrics_stats_reset(void)
+{
+    uint64_t io[IO_OP_KIND_COUNT][IO_STAT_KIND_COUNT];
+    io_totals(io);
+    pthread_mutex_lock(&baseline_mutex);
+    for (int c = 0; c < METRIC_COUNTER_COUNT; c++)
+    {
+        counter_baseline[c] = metrics_counter_total((metric_counter_t)c);
+    }
+    memcpy(io_baseline, io, sizeof(io));
+    pthread_mutex_unlock(&baseline_mutex);
+}
+
+// --- Exposition ---
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+    int failed;
+} TextBuffer;
+
+static void text_appendf(TextBuffer *b, const char *fmt, ...)
+{
+    if (b->failed) return;
+    for (;;)
+    {
+        va_list args;
+        va_start(args, fmt);
+        int n = vsnprintf(b->data + b->len, b->cap - b->len, fmt, args);
+        va_end(args);
+        if (n < 0)
+        {
+            b->failed = 1;
+            return;
+        }
+        if ((size_t)n < b->cap - b->len)
+        {
+            b->len += (size_t)n;
+            return;
+        }
+        size_t new_cap = b->cap * 2 + (size_t)n;
+        char *new_data = realloc(b->data, new_cap);
+        if (!new_data)
+        {
+            b->failed = 1;
+            return;
+        }
+        b->data = new_data;
+        b->cap = new_cap;
+    }
+}
+
+char *metrics_render(size_t *len)
+{
+    TextBuffer b = {malloc(8192), 0, 8192, 0};
+    if (!b.data) return NULL;
+
+    uint64_t totals[METRIC_COUNTER_COUNT] = {0};
+    LatencyHistogram *latency = calloc(LATENCY_KIND_COUNT, sizeof(LatencyHistogram));
+    if (!latency)
+    {
+        free(b.data);
+        return NULL;
+    }
+
+    for (MetricsShard *shard = atomic_load(&shard_list); shard; shard = shard->next)
+    {
+        for (int c = 0; c < METRIC_COUNTER_COUNT; c++)
+        {
+            totals[c] += atomic_load_explicit(&shard->counters[c], memory_order_relaxed);
+        }
+        for (int k = 0; k < LATENCY_KIND_COUNT; k++)
+        {
+            shared_histogram_merge(&latency[k], &shard->latency[k]);
+        }
+    }
+
+    for (int c = 0; c < METRIC_COUNTER_COUNT; c++)
+    {
+        const char *name = counter_names[c][0];
+        const char *help = counter_names[c][1];
+        if (help)
+        {
+            int family = (int)strcspn(name, "{"); // Labelled series share one HELP/TYPE
+            text_appendf(&b, "# HELP %.*s %s\n# TYPE %.*s counter\n", family, name, help, family, name);
+        }
+        text_appendf(&b, "%s %llu\n", name, (unsigned long long)totals[c]);
+    }
+
+    uint64_t lookups = totals[METRIC_CACHE_HITS] + totals[METRIC_CACHE_MISSES];
+    text_appendf(&b, "# HELP zu_cache_hit_ratio Fraction of lookups served from the cache\n# TYPE zu_cache_hit_ratio gauge\n");
+    text_appendf(&b, "zu_cache_hit_ratio %.6f\n", lookups ? (double)totals[METRIC_CACHE_HITS] / (double)lookups : 0.0);
+
+    for (int g = 0; g < METRIC_GAUGE_COUNT; g++)
+    {
+        text_appendf(&b, "# HELP %s %s\n# TYPE %s gauge\n%s %lld\n", gauge_names[g][0], gauge_names[g][1],
+                     gauge_names[g][0], gauge_names[g][0], (long long)atomic_load(&gauges[g]));
+    }
+
+    uint64_t filtered = totals[METRIC_BLOOM_NEGATIVES] + totals[METRIC_BLOOM_FALSE_POSITIVES];
+    int64_t bloom_keys = atomic_load(&gauges[GAUGE_BLOOM_KEYS]);
+    text_appendf(&b, "# HELP zu_bloom_false_positive_rate Fraction of absent keys the Bloom filters let through\n# TYPE zu_bloom_false_positive_rate gauge\n");
+    text_appendf(&b, "zu_bloom_false_positive_rate %.6f\n",
+                 filtered ? (double)totals[METRIC_BLOOM_FALSE_POSITIVES] / (double)filtered : 0.0);
+    text_appendf(&b, "# HELP zu_bloom_bits_per_key Bloom filter bits per key\n# TYPE zu_bloom_bits_per_key gauge\n");
+    text_appendf(&b, "zu_bloom_bits_per_key %.2f\n",
+                 bloom_keys > 0 ? (double)atomic_load(&gauges[GAUGE_BLOOM_BITS]) / (double)bloom_keys : 0.0);
+
+    text_appendf(&b, "# HELP zu_resp_connections Open RESP connections\n# TYPE zu_resp_connections gauge\n");
+    text_appendf(&b, "zu_resp_connections %llu\n",
+                 (unsigned long long)(totals[METRIC_RESP_CONNECTIONS] - totals[METRIC_RESP_DISCONNECTIONS]));
+
+    struct stat st;
+    text_appendf(&b, "# HELP zu_disk_file_bytes Size of the database file\n# TYPE zu_disk_file_bytes gauge\n");
+    text_appendf(&b, "zu_disk_file_bytes %lld\n", stat(FILENAME, &st) == 0 ? (long long)st.st_size : 0LL);
+
+    text_appendf(&b, "# HELP zu_command_latency_seconds Command latency by path\n# TYPE zu_command_latency_seconds histogram\n");
+    for (int k = 0; k < LATENCY_KIND_COUNT; k++)
+    {
+        const LatencyHistogram *h = &latency[k];
+        for (int i = 0; i < LATENCY_BUCKETS; i++)
+        {
+            uint64_t bound = 1ULL << (10 + i);
+            text_appendf(&b, "zu_command_latency_seconds_bucket{path=\"%s\",le=\"%g\"} %llu\n",
+                         latency_names[k], (double)bound / 1e9, (unsigned long long)histogram_count_below(h, bound));
+        }
+        text_appendf(&b, "zu_command_latency_seconds_bucket{path=\"%s\",le=\"+Inf\"} %llu\n",
+                     latency_names[k], (unsigned long long)h->count);
+        text_appendf(&b, "zu_command_latency_seconds_sum{path=\"%s\"} %.9f\n", latency_names[k], (double)h->sum_ns / 1e9);
+        text_appendf(&b, "zu_command_latency_seconds_count{path=\"%s\"} %llu\n",
+                     latency_names[k], (unsigned long long)h->count);
+    }
+
+    // Percentiles from the full-resolution histograms, which the buckets above only approximate
+    static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    text_appendf(&b, "# HELP zu_command_latency_quantile_seconds Command latency percentiles by path\n# TYPE zu_command_latency_quantile_seconds gauge\n");
+    for (int k = 0; k < LATENCY_KIND_COUNT; k++)
+    {
+        for (size_t q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); q++)
+        {
+            text_appendf(&b, "zu_command_latency_quantile_seconds{path=\"%s\",quantile=\"%g\"} %.9f\n",
+                         latency_names[k], quantiles[q], (double)histogram_percentile(&latency[k], quantiles[q] * 100.0) / 1e9);
+        }
+    }
+    text_appendf(&b, "# HELP zu_command_latency_max_seconds Slowest command by path\n# TYPE zu_command_latency_max_seconds gauge\n");
+    for (int k = 0; k < LATENCY_KIND_COUNT; k++)
+    {
+        text_appendf(&b, "zu_command_latency_max_seconds{path=\"%s\"} %.9f\n", latency_names[k], (double)latency[k].max_ns / 1e9);
+    }
+    free(latency);
+
+    if (b.failed)
+    {
+        free(b.data);
+        return NULL;
+    }
+    *len = b.len;
+    return b.data;
+}
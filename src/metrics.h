@@ -0,0 +1,140 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h> // For size_t
+#include <stdint.h>
+#include <time.h>   // For struct timespec
+#include "timer.h"  // For LatencyHistogram
+
+// Monotonic counters. Each thread increments its own shard, so recording a
+// metric never touches a cache line shared with another thread; readers sum
+// the shards when /metrics is scraped.
+typedef enum {
+    METRIC_CMD_GET,
+    METRIC_CMD_SET,
+    METRIC_CMD_RM,
+    METRIC_CMD_INCR,
+    METRIC_CMD_APPEND,
+    METRIC_CMD_CAS,
+    METRIC_CMD_EXEC,
+    METRIC_CMD_SCAN,
+    METRIC_CMD_RANGE,
+    METRIC_CMD_DBSIZE,
+    METRIC_CMD_ERRORS,
+    METRIC_CACHE_HITS,
+    METRIC_CACHE_MISSES,
+    METRIC_CACHE_EVICTIONS,
+    METRIC_CACHE_EXPIRATIONS,
+    METRIC_DISK_BYTES_READ,
+    METRIC_DISK_BYTES_WRITTEN,
+    METRIC_WRITER_BATCHES,
+    METRIC_WRITER_OPS,
+    METRIC_TXN_ABORTS,
+    METRIC_INDEX_REBUILDS,
+    METRIC_LSM_FLUSHES,
+    METRIC_LSM_COMPACTIONS,
+    METRIC_BLOOM_NEGATIVES,
+    METRIC_BLOOM_FALSE_POSITIVES,
+    METRIC_HTTP_CONNECTIONS,
+    METRIC_HTTP_REQUESTS,
+    METRIC_HTTP_REJECTED_CONNECTIONS,
+    METRIC_HTTP_REJECTED_QUEUE,
+    METRIC_HTTP_REJECTED_STORAGE,
+    METRIC_RESP_CONNECTIONS,
+    METRIC_RESP_DISCONNECTIONS,
+    METRIC_RESP_COMMANDS,
+    METRIC_COUNTER_COUNT
+} metric_counter_t;
+
+// Gauges that admission control reads back, so they are kept as single
+// shared atomics rather than per-thread shards
+typedef enum {
+    GAUGE_HTTP_CONNECTIONS,    // Open REST connections, queued or in service
+    GAUGE_HTTP_QUEUE_DEPTH,    // Connections waiting for a worker
+    GAUGE_HTTP_INFLIGHT_WRITES, // /set requests currently applying
+    GAUGE_WRITER_PENDING,      // Writes submitted to the writer and not yet committed
+    GAUGE_BLOOM_BITS,          // Bits in the Bloom filters in use
+    GAUGE_BLOOM_KEYS,          // Keys those filters were built from
+    GAUGE_INDEX_BYTES,         // Allocated by key indexes, including ones being built
+    GAUGE_MEMTABLE_BYTES,      // Held by LSM memtables
+    GAUGE_HTTP_BUFFER_BYTES,   // REST request buffers of the requests in service
+    METRIC_GAUGE_COUNT
+} metric_gauge_t;
+
+// Latency histograms, one per command path. Each thread records into its own
+// log-linear SharedHistogram; readers merge them.
+typedef enum {
+    LATENCY_CACHE_HIT,  // zget served from the cache
+    LATENCY_DISK_HIT,   // zget read from disk
+    LATENCY_MISS,       // zget of an absent key
+    LATENCY_SET,        // zset and the read-modify-write commands
+    LATENCY_DELETE,
+    LATENCY_COMPACTION, // One LSM compaction
+    LATENCY_HTTP,       // A REST request, from fully read to answered
+    LATENCY_KIND_COUNT
+} latency_kind_t;
+
+// Storage I/O accounting by the kind of operation that caused it (see io.h).
+// Kept in the per-thread shards alongside the counters.
+typedef enum {
+    IO_OP_FIND,    // Point lookups
+    IO_OP_SCAN,    // zscan/zrange pages
+    IO_OP_LIST,    // zall
+    IO_OP_DBSIZE,  // Record counts
+    IO_OP_COMMIT,  // Writer thread batches
+    IO_OP_INDEX,   // Key index lookups and rebuilds
+    IO_OP_EXISTS,  // The database-exists check before each command
+    IO_OP_KIND_COUNT
+} io_op_t;
+
+typedef enum {
+    IO_STAT_CALLS,
+    IO_STAT_BYTES_READ,
+    IO_STAT_BYTES_WRITTEN,
+    IO_STAT_RECORDS,       // Records parsed
+    IO_STAT_OPENS,         // Files opened
+    IO_STAT_FSYNCS,
+    IO_STAT_FLOCK_WAITS,   // flock() calls that had to block
+    IO_STAT_FLOCK_WAIT_NS,
+    IO_STAT_LOCK_WAITS,    // file_lock acquisitions that had to block
+    IO_STAT_LOCK_WAIT_NS,
+    IO_STAT_KIND_COUNT
+} io_stat_t;
+
+// Prometheus buckets: bucket i counts samples below 2^(10 + i) nanoseconds,
+// about 1µs up to 34s
+#define LATENCY_BUCKETS 26
+
+void metrics_add(metric_counter_t counter, uint64_t amount);
+void metrics_inc(metric_counter_t counter);
+void metrics_record_latency(latency_kind_t kind, uint64_t nanoseconds);
+// Record the time elapsed since `start` (taken with CLOCK_MONOTONIC) and return it
+uint64_t metrics_record_since(latency_kind_t kind, const struct timespec *start);
+
+// Name of a latency path, as used in the `path` label
+const char *metrics_latency_name(latency_kind_t kind);
+// Merge every thread's histogram for `kind` into `into`
+void metrics_latency_snapshot(latency_kind_t kind, LatencyHistogram *into);
+
+// Adjust a gauge and return its new value
+int64_t metrics_gauge_add(metric_gauge_t gauge, int64_t delta);
+int64_t metrics_gauge_get(metric_gauge_t gauge);
+
+// Sum of a counter across all threads
+uint64_t metrics_counter_total(metric_counter_t counter);
+
+void metrics_io_add(io_op_t op, io_stat_t stat, uint64_t amount);
+const char *metrics_io_op_name(io_op_t op);
+const char *metrics_io_stat_name(io_stat_t stat);
+
+// The `stats` view: I/O and counter totals since the last metrics_stats_reset.
+// Resetting only moves the baseline, so /metrics counters stay monotonic.
+void metrics_io_snapshot(uint64_t stats[IO_OP_KIND_COUNT][IO_STAT_KIND_COUNT]);
+uint64_t metrics_counter_since_reset(metric_counter_t counter);
+void metrics_stats_reset(void);
+
+// Render every metric in the Prometheus text exposition format.
+// Returns a malloc'd buffer, or NULL on allocation failure.
+char *metrics_render(size_t *len);
+
+#endif // METRICS_H
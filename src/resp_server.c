@@ -0,0 +1,676 @@
+#include "resp_server.h"
+#include "http_server.h"
+#include "commands.h"
+#include "cache.h"
+#include "metrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h> // For strcasecmp
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h> // For TCP_NODELAY
+#include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h> // For LLONG_MIN
+#include <ctype.h>
+
+#include "config.h"
+
+#define RESP_MAX_ARGS (1024 * 1024)     // Upper bound for multibulk element count
+#define RESP_MAX_INLINE_LENGTH 65536    // Upper bound for an inline command line
+#define RESP_OUTPUT_SOFT_LIMIT 1048576  // Stop executing pipelined commands past this much unsent output
+#define RESP_READ_CHUNK 16384
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // Not available on macOS; SO_NOSIGPIPE is set on the socket instead
+#endif
+
+typedef struct {
+    int fd;
+    char *in;          // Bytes received but not yet executed
+    size_t in_len;
+    size_t in_cap;
+    char *out;         // Replies not yet written to the socket
+    size_t out_len;
+    size_t out_pos;
+    size_t out_cap;
+    char **argv;       // Arguments of the command being executed (point into `in`)
+    size_t *argv_len;
+    size_t argv_cap;
+    int close_after_write;
+} RespClient;
+
+// Grow a byte buffer so it can hold at least `needed` bytes
+static int buffer_reserve(char **buf, size_t *cap, size_t needed) {
+    if (*cap >= needed) return 1;
+    size_t new_cap = *cap == 0 ? RESP_READ_CHUNK : *cap;
+    while (new_cap < needed) new_cap *= 2;
+    char *new_buf = realloc(*buf, new_cap);
+    if (!new_buf) return 0;
+    *buf = new_buf;
+    *cap = new_cap;
+    return 1;
+}
+
+static int argv_reserve(RespClient *c, size_t needed) {
+    if (c->argv_cap >= needed) return 1;
+    size_t new_cap = c->argv_cap == 0 ? 8 : c->argv_cap;
+    while (new_cap < needed) new_cap *= 2;
+    char **new_argv = realloc(c->argv, new_cap * sizeof(char *));
+    if (!new_argv) return 0;
+    c->argv = new_argv;
+    size_t *new_len = realloc(c->argv_len, new_cap * sizeof(size_t));
+    if (!new_len) return 0;
+    c->argv_len = new_len;
+    c->argv_cap = new_cap;
+    return 1;
+}
+
+// --- Reply encoding ---
+
+static void reply_raw(RespClient *c, const char *data, size_t len) {
+    if (!buffer_reserve(&c->out, &c->out_cap, c->out_len + len)) {
+        c->close_after_write = 1; // Out of memory: drop the connection once flushed
+        return;
+    }
+    memcpy(c->out + c->out_len, data, len);
+    c->out_len += len;
+}
+
+static void reply_status(RespClient *c, const char *status) {
+    reply_raw(c, "+", 1);
+    reply_raw(c, status, strlen(status));
+    reply_raw(c, "\r\n", 2);
+}
+
+static void reply_error(RespClient *c, const char *message) {
+    reply_raw(c, "-ERR ", 5);
+    reply_raw(c, message, strlen(message));
+    reply_raw(c, "\r\n", 2);
+}
+
+static void reply_prefixed_number(RespClient *c, char prefix, long long number) {
+    char header[32];
+    int len = snprintf(header, sizeof(header), "%c%lld\r\n", prefix, number);
+    reply_raw(c, header, len);
+}
+
+static void reply_integer(RespClient *c, long long number) {
+    reply_prefixed_number(c, ':', number);
+}
+
+static void reply_array_header(RespClient *c, long long count) {
+    reply_prefixed_number(c, '*', count);
+}
+
+static void reply_bulk(RespClient *c, const char *data, size_t len) {
+    reply_prefixed_number(c, '$', (long long)len);
+    reply_raw(c, data, len);
+    reply_raw(c, "\r\n", 2);
+}
+
+static void reply_null(RespClient *c) {
+    reply_raw(c, "$-1\r\n", 5);
+}
+
+// Map a command-layer status code to the matching error reply
+static void reply_command_error(RespClient *c, int result) {
+    if (result == CMD_EMPTY) {
+        reply_error(c, "empty keys and values are not supported");
+    } else if (result == CMD_NOT_INTEGER) {
+        reply_error(c, "value is not an integer or out of range");
+    } else {
+        reply_error(c, "storage error");
+    }
+}
+
+// --- Command handlers ---
+
+static void resp_ping(RespClient *c, int argc, char **argv, size_t *argv_len) {
+    if (argc == 2) {
+        reply_bulk(c, argv[1], argv_len[1]);
+    } else {
+        reply_status(c, "PONG");
+    }
+}
+
+static void resp_get(RespClient *c, int argc, char **argv, size_t *argv_len) {
+    (void)argc;
+    (void)argv_len;
+    char *value = NULL;
+    int result = zget_command(argv[1], &value);
+    if (result == CMD_SUCCESS && value) {
+        reply_bulk(c, value, strlen(value));
+    } else if (result == CMD_NOT_FOUND) {
+        reply_null(c);
+    } else {
+        reply_command_error(c, result);
+    }
+    free(value);
+}
+
+static void resp_set(RespClient *c, int argc, char **argv, size_t *argv_len) {
+    (void)argc;
+    (void)argv_len;
+    int result = zset_command(argv[1], argv[2]);
+    if (result == CMD_SUCCESS) {
+        reply_status(c, "OK");
+    } else {
+        reply_command_error(c, result);
+    }
+}
+
+static void resp_mset(RespClient *c, int argc, char **argv, size_t *argv_len) {
+    (void)argv_len;
+    if (argc % 2 == 0) {
+        reply_error(c, "wrong number of arguments for 'mset' command");
+        return;
+    }
+    for (int i = 1; i < argc; i += 2) {
+        int result = zset_command(argv[i], argv[i + 1]);
+        if (result != CMD_SUCCESS) {
+            reply_command_error(c, result);
+            return;
+        }
+    }
+    reply_status(c, "OK");
+}
+
+static void resp_mget(RespClient *c, int argc, char **argv, size_t *argv_len) {
+    (void)argv_len;
+    reply_array_header(c, argc - 1);
+    for (int i = 1; i < argc; i++) {
+        char *value = NULL;
+        if (zget_command(argv[i], &value) == CMD_SUCCESS && value) {
+            reply_bulk(c, value, strlen(value));
+        } else {
+            reply_null(c);
+        }
+        free(value);
+    }
+}
+
+static void resp_del(RespClient *c, int argc, char **argv, size_t *argv_len) {
+    (void)argv_len;
+    long long removed = 0;
+    for (int i = 1; i < argc; i++) {
+        if (zrm_command(argv[i]) == CMD_SUCCESS) removed++;
+    }
+    reply_integer(c, removed);
+}
+
+// INCR, DECR, INCRBY and DECRBY share one handler: the sign comes from the
+// command name and the amount from the optional third argument
+static void resp_incr(RespClient *c, int argc, char **argv, size_t *argv_len) {
+    (void)argv_len;
+    long long delta = 1;
+    if (argc == 3) {
+        char *end;
+        errno = 0;
+        delta = strtoll(argv[2], &end, 10);
+        if (errno != 0 || end == argv[2] || *end != '\0' || delta == LLONG_MIN) {
+            reply_error(c, "value is not an integer or out of range");
+            return;
+        }
+    }
+    if (tolower((unsigned char)argv[0][0]) == 'd') delta = -delta;
+
+    long long value = 0;
+    int result = zincr_command(argv[1], delta, &value);
+    if (result == CMD_SUCCESS) {
+        reply_integer(c, value);
+    } else {
+        reply_command_error(c, result);
+    }
+}
+
+static void resp_append(RespClient *c, int argc, char **argv, size_t *argv_len) {
+    (void)argc;
+    (void)argv_len;
+    long long length = 0;
+    int result = zappend_command(argv[1], argv[2], &length);
+    if (result == CMD_SUCCESS) {
+        reply_integer(c, length);
+    } else {
+        reply_command_error(c, result);
+    }
+}
+
+// CAS key expected new - not a Redis command; replies 1 if swapped, 0 if not
+static void resp_cas(RespClient *c, int argc, char **argv, size_t *argv_len) {
+    (void)argc;
+    (void)argv_len;
+    int result = zcas_command(argv[1], argv[2], argv[3]);
+    if (result == CMD_SUCCESS || result == CMD_MISMATCH) {
+        reply_integer(c, result == CMD_SUCCESS);
+    } else {
+        reply_command_error(c, result);
+    }
+}
+
+static void resp_exists(RespClient *c, int argc, char **argv, size_t *argv_len) {
+    (void)argv_len;
+    long long found = 0;
+    for (int i = 1; i < argc; i++) {
+        char *value = NULL;
+        if (zget_command(argv[i], &value) == CMD_SUCCESS) found++;
+        free(value);
+    }
+    reply_integer(c, found);
+}
+
+static void resp_dbsize(RespClient *c, int argc, char **argv, size_t *argv_len) {
+    (void)argc;
+    (void)argv;
+    (void)argv_len;
+    int count = 0;
+    int result = zdbsize_command(&count);
+    if (result == CMD_SUCCESS) {
+        reply_integer(c, count);
+    } else {
+        reply_command_error(c, result);
+    }
+}
+
+// Clients such as redis-cli and redis-benchmark probe COMMAND and CONFIG on
+// connect; an empty array tells them there is nothing to configure.
+static void resp_empty_array(RespClient *c, int argc, char **argv, size_t *argv_len) {
+    (void)argc;
+    (void)argv;
+    (void)argv_len;
+    reply_array_header(c, 0);
+}
+
+static void resp_quit(RespClient *c, int argc, char **argv, size_t *argv_len) {
+    (void)argc;
+    (void)argv;
+    (void)argv_len;
+    reply_status(c, "OK");
+    c->close_after_write = 1;
+}
+
+typedef void (*resp_handler_t)(RespClient *c, int argc, char **argv, size_t *argv_len);
+
+typedef struct {
+    const char *name;
+    int arity; // Exact argument count including the name, or -N for "at least N"
+    resp_handler_t handler;
+} RespCommand;
+
+static const RespCommand resp_commands[] = {
+    {"ping", -1, resp_ping},
+    {"get", 2, resp_get},
+    {"set", 3, resp_set},
+    {"del", -2, resp_del},
+    {"mget", -2, resp_mget},
+    {"mset", -3, resp_mset},
+    {"exists", -2, resp_exists},
+    {"incr", 2, resp_incr},
+    {"decr", 2, resp_incr},
+    {"incrby", 3, resp_incr},
+    {"decrby", 3, resp_incr},
+    {"append", 3, resp_append},
+    {"cas", 4, resp_cas},
+    {"dbsize", 1, resp_dbsize},
+    {"command", -1, resp_empty_array},
+    {"config", -1, resp_empty_array},
+    {"quit", 1, resp_quit},
+};
+
+static void execute_command(RespClient *c, int argc) {
+    char **argv = c->argv;
+    size_t *argv_len = c->argv_len;
+
+    for (int i = 0; i < argc; i++) {
+        // Keys and values are NUL-terminated strings throughout zu
+        if (memchr(argv[i], '\0', argv_len[i])) {
+            reply_error(c, "arguments cannot contain NUL bytes");
+            return;
+        }
+    }
+
+    for (size_t i = 0; i < sizeof(resp_commands) / sizeof(resp_commands[0]); i++) {
+        const RespCommand *cmd = &resp_commands[i];
+        if (strcasecmp(argv[0], cmd->name) != 0) continue;
+
+        if ((cmd->arity > 0 && argc != cmd->arity) || (cmd->arity < 0 && argc < -cmd->arity)) {
+            char message[96];
+            snprintf(message, sizeof(message), "wrong number of arguments for '%s' command", cmd->name);
+            reply_error(c, message);
+            return;
+        }
+        cmd->handler(c, argc, argv, argv_len);
+        return;
+    }
+
+    char message[128];
+    snprintf(message, sizeof(message), "unknown command '%.64s'", argv[0]);
+    reply_error(c, message);
+}
+
+// --- Request parsing ---
+
+// Parse a CRLF-terminated decimal length starting at `p`.
+// Returns 1 and sets *next past the CRLF, 0 if more input is needed, -1 on malformed input.
+static int parse_line_number(const char *p, const char *end, long long *out, const char **next) {
+    const char *cr = memchr(p, '\r', end - p);
+    if (!cr || cr + 1 >= end) {
+        return (end - p > 32) ? -1 : 0;
+    }
+    if (cr[1] != '\n') return -1;
+
+    int negative = 0;
+    if (p < cr && *p == '-') {
+        negative = 1;
+        p++;
+    }
+    if (p == cr || cr - p > 18) return -1;
+
+    long long value = 0;
+    for (; p < cr; p++) {
+        if (*p < '0' || *p > '9') return -1;
+        value = value * 10 + (*p - '0');
+    }
+    *out = negative ? -value : value;
+    *next = cr + 2;
+    return 1;
+}
+
+// Parse a "*N\r\n$len\r\n<bytes>\r\n..." request. "*0\r\n" is an empty command.
+static int parse_multibulk(RespClient *c, const char *start, const char *end, int *argc, size_t *consumed) {
+    long long count;
+    const char *p;
+    int r = parse_line_number(start + 1, end, &count, &p);
+    if (r <= 0) return r;
+    if (count < 0 || count > RESP_MAX_ARGS) return -1;
+
+    for (long long i = 0; i < count; i++) {
+        if (p >= end) return 0;
+        if (*p != '$') return -1;
+
+        long long len;
+        r = parse_line_number(p + 1, end, &len, &p);
+        if (r <= 0) return r;
+        if (len < 0 || len > RESP_MAX_ARG_LENGTH) return -1;
+        if (end - p < len + 2) return 0;
+        if (p[len] != '\r' || p[len + 1] != '\n') return -1;
+
+        // Grow with the arguments received, not the count the client claims
+        if (!argv_reserve(c, (size_t)i + 1)) return -1;
+        c->argv[i] = (char *)p;
+        c->argv_len[i] = (size_t)len;
+        p += len + 2;
+    }
+
+    // The whole command is buffered; terminate each argument in place over its CR
+    for (long long i = 0; i < count; i++) {
+        c->argv[i][c->argv_len[i]] = '\0';
+    }
+    *argc = (int)count;
+    *consumed = p - start;
+    return 1;
+}
+
+// Parse a whitespace-separated inline command (telnet / nc style).
+static int parse_inline(RespClient *c, char *start, const char *end, int *argc, size_t *consumed) {
+    char *newline = memchr(start, '\n', end - start);
+    if (!newline) {
+        return (end - start > RESP_MAX_INLINE_LENGTH) ? -1 : 0;
+    }
+
+    char *line_end = newline;
+    if (line_end > start && line_end[-1] == '\r') line_end--;
+    *line_end = '\0';
+
+    int count = 0;
+    char *p = start;
+    while (p < line_end) {
+        while (p < line_end && (*p == ' ' || *p == '\t')) p++;
+        if (p >= line_end) break;
+        if (!argv_reserve(c, count + 1)) return -1;
+        c->argv[count] = p;
+        while (p < line_end && *p != ' ' && *p != '\t') p++;
+        c->argv_len[count] = p - c->argv[count];
+        *p++ = '\0';
+        count++;
+    }
+
+    *argc = count;
+    *consumed = newline + 1 - start;
+    return 1;
+}
+
+// Execute every complete command in the input buffer.
+// Returns 1 if execution stopped early because too much output is pending.
+static int process_input(RespClient *c) {
+    size_t pos = 0;
+    int stalled = 0;
+
+    while (pos < c->in_len && !c->close_after_write) {
+        if (c->out_len - c->out_pos > RESP_OUTPUT_SOFT_LIMIT) {
+            stalled = 1;
+            break;
+        }
+
+        char *start = c->in + pos;
+        const char *end = c->in + c->in_len;
+        int argc = 0;
+        size_t consumed = 0;
+        int r = (*start == '*') ? parse_multibulk(c, start, end, &argc, &consumed)
+                                : parse_inline(c, start, end, &argc, &consumed);
+        if (r == 0) break;
+        if (r < 0) {
+            reply_error(c, "Protocol error");
+            c->close_after_write = 1;
+            break;
+        }
+
+        pos += consumed;
+        if (argc > 0) {
+            metrics_inc(METRIC_RESP_COMMANDS);
+            execute_command(c, argc);
+        }
+    }
+
+    if (pos > 0) {
+        memmove(c->in, c->in + pos, c->in_len - pos);
+        c->in_len -= pos;
+    }
+    return stalled;
+}
+
+// --- Connection handling ---
+
+// Write as much pending output as the socket accepts. Returns -1 on a hard error.
+static int flush_output(RespClient *c) {
+    while (c->out_pos < c->out_len) {
+        ssize_t n = send(c->fd, c->out + c->out_pos, c->out_len - c->out_pos, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            return -1;
+        }
+        c->out_pos += (size_t)n;
+    }
+    c->out_len = 0;
+    c->out_pos = 0;
+    return 0;
+}
+
+// Drain readable bytes into the input buffer. Returns 0 on EOF, -1 on error, 1 otherwise.
+static int read_input(RespClient *c) {
+    size_t total = 0;
+    // Bound the work per wakeup so one pipelining client cannot starve the others
+    while (total < RESP_OUTPUT_SOFT_LIMIT) {
+        if (!buffer_reserve(&c->in, &c->in_cap, c->in_len + RESP_READ_CHUNK)) return -1;
+        size_t room = c->in_cap - c->in_len;
+        ssize_t n = read(c->fd, c->in + c->in_len, room);
+        if (n > 0) {
+            c->in_len += (size_t)n;
+            total += (size_t)n;
+            if ((size_t)n < room) return 1; // Short read: socket drained
+            continue;
+        }
+        if (n == 0) return 0;
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return 1;
+        return -1;
+    }
+    return 1;
+}
+
+// Returns -1 when the connection should be closed
+static int service_client(RespClient *c, short revents) {
+    int eof = 0;
+
+    if (revents & (POLLERR | POLLNVAL)) return -1;
+    if (revents & (POLLIN | POLLHUP)) {
+        int r = read_input(c);
+        if (r < 0) return -1;
+        eof = (r == 0);
+    }
+
+    int stalled;
+    do {
+        stalled = process_input(c);
+        if (flush_output(c) < 0) return -1;
+    } while (stalled && c->out_len == 0);
+
+    if (eof) return -1;
+    if (c->close_after_write && c->out_len == 0) return -1;
+    return 0;
+}
+
+static RespClient *client_create(int fd) {
+    RespClient *c = calloc(1, sizeof(RespClient));
+    if (!c) return NULL;
+    c->fd = fd;
+    return c;
+}
+
+static void client_free(RespClient *c) {
+    metrics_inc(METRIC_RESP_DISCONNECTIONS);
+    close(c->fd);
+    free(c->in);
+    free(c->out);
+    free(c->argv);
+    free(c->argv_len);
+    free(c);
+}
+
+static void set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+void start_resp_server(void)
+{
+    struct sockaddr_in address;
+    int server_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (server_fd < 0)
+    {
+        perror("RESP socket failed");
+        return;
+    }
+
+    int reuse = 1;
+    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(RESP_SERVER_PORT);
+
+    if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0 || listen(server_fd, 511) < 0)
+    {
+        perror("RESP bind/listen failed");
+        close(server_fd);
+        return;
+    }
+    set_nonblocking(server_fd);
+    init_cache();
+
+    printf("Starting RESP server on port %d\n", RESP_SERVER_PORT);
+
+    RespClient **clients = calloc(RESP_MAX_CLIENTS, sizeof(RespClient *));
+    struct pollfd *fds = calloc(RESP_MAX_CLIENTS + 1, sizeof(struct pollfd));
+    if (!clients || !fds)
+    {
+        free(clients);
+        free(fds);
+        close(server_fd);
+        return;
+    }
+    int num_clients = 0;
+
+    while (server_running)
+    {
+        fds[0].fd = server_fd;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        for (int i = 0; i < num_clients; i++) {
+            RespClient *c = clients[i];
+            fds[i + 1].fd = c->fd;
+            // Stop reading from clients that are not draining their replies
+            fds[i + 1].events = (c->out_len - c->out_pos > RESP_OUTPUT_SOFT_LIMIT) ? 0 : POLLIN;
+            if (c->out_len > 0) fds[i + 1].events |= POLLOUT;
+            fds[i + 1].revents = 0;
+        }
+
+        // The timeout bounds how long shutdown waits for an idle loop
+        int ready = poll(fds, num_clients + 1, 100);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            perror("RESP poll");
+            break;
+        }
+        if (ready == 0) continue;
+
+        // Walk backwards so a closed client can be replaced by the last one
+        for (int i = num_clients - 1; i >= 0; i--) {
+            short revents = fds[i + 1].revents;
+            if (!revents) continue;
+            if (service_client(clients[i], revents) < 0) {
+                client_free(clients[i]);
+                clients[i] = clients[--num_clients];
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            for (;;) {
+                int client_fd = accept(server_fd, NULL, NULL);
+                if (client_fd < 0) break;
+                if (num_clients >= RESP_MAX_CLIENTS) {
+                    static const char busy[] = "-ERR max number of clients reached\r\n";
+                    ssize_t ignored = write(client_fd, busy, sizeof(busy) - 1);
+                    (void)ignored;
+                    close(client_fd);
+                    continue;
+                }
+                set_nonblocking(client_fd);
+                int nodelay = 1;
+                setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+#ifdef SO_NOSIGPIPE
+                setsockopt(client_fd, SOL_SOCKET, SO_NOSIGPIPE, &nodelay, sizeof(nodelay));
+#endif
+                RespClient *c = client_create(client_fd);
+                if (!c) {
+                    close(client_fd);
+                    continue;
+                }
+                metrics_inc(METRIC_RESP_CONNECTIONS);
+                clients[num_clients++] = c;
+            }
+        }
+    }
+
+    for (int i = 0; i < num_clients; i++) {
+        client_free(clients[i]);
+    }
+    free(clients);
+    free(fds);
+    close(server_fd);
+}
@@ -0,0 +1,8 @@
+#ifndef RESP_SERVER_H
+#define RESP_SERVER_H
+
+// Redis RESP2 listener: serves GET/SET/DEL/MGET/MSET/EXISTS/DBSIZE/PING
+// through the same command layer as the CLI and REST server.
+void start_resp_server(void);
+
+#endif // RESP_SERVER_H
@@ -0,0 +1,137 @@
+#include "slowlog.h"
+#include "io.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+    _Atomic uint64_t sequence; // Odd while a writer fills the entry; 0 if never written
+    SlowlogEntry entry;
+} SlowlogSlot;
+
+_Atomic uint64_t slowlog_threshold_ns = SLOWLOG_THRESHOLD_US * 1000ULL;
+
+static SlowlogSlot ring[SLOWLOG_MAX_LEN];
+static _Atomic uint64_t next_id = 1;
+static _Atomic uint64_t first_visible_id = 1; // Entries below this were reset away
+
+static const char *path_names[SLOWLOG_PATH_COUNT] = {
+    [SLOWLOG_CACHE] = "cache",
+    [SLOWLOG_DISK] = "disk",
+    [SLOWLOG_MISS] = "miss",
+    [SLOWLOG_WRITE] = "write",
+    [SLOWLOG_SCAN] = "scan",
+};
+
+const char *slowlog_path_name(slowlog_path_t path)
+{
+    return path < SLOWLOG_PATH_COUNT ? path_names[path] : "unknown";
+}
+
+void slowlog_record(const char *command, const char *key, slowlog_path_t path, uint64_t duration_ns)
+{
+    uint64_t id = atomic_fetch_add_explicit(&next_id, 1, memory_order_relaxed);
+    SlowlogSlot *slot = &ring[id % SLOWLOG_MAX_LEN];
+
+    // Claim the slot. If another writer holds it, the ring has wrapped
+    // around within one write, and this entry is dropped rather than waited on.
+    uint64_t sequence = atomic_load_explicit(&slot->sequence, memory_order_relaxed);
+    if ((sequence & 1) || !atomic_compare_exchange_strong_explicit(&slot->sequence, &sequence, sequence + 1,
+                                                                   memory_order_acquire, memory_order_relaxed))
+    {
+        return;
+    }
+    atomic_thread_fence(memory_order_release);
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    SlowlogEntry *e = &slot->entry;
+    e->id = id;
+    e->timestamp_us = (uint64_t)now.tv_sec * 1000000ULL + (uint64_t)now.tv_nsec / 1000;
+    e->duration_ns = duration_ns;
+    // Cache hits did no I/O, and writes did theirs on the writer thread
+    e->bytes_read = path == SLOWLOG_CACHE || path == SLOWLOG_WRITE ? 0 : io_last_bytes_read();
+    e->command = command;
+    e->path = path;
+    e->key_length = key ? strlen(key) : 0;
+    size_t kept = e->key_length < SLOWLOG_KEY_LEN ? e->key_length : SLOWLOG_KEY_LEN;
+    if (kept) memcpy(e->key, key, kept);
+    e->key[kept] = '\0';
+
+    atomic_store_explicit(&slot->sequence, sequence + 2, memory_order_release);
+}
+
+// Copy a slot that may be written concurrently. Returns 0 if it is empty or
+// kept changing while being read.
+static int read_slot(SlowlogSlot *slot, SlowlogEntry *into)
+{
+    for (int attempt = 0; attempt < 4; attempt++)
+    {
+        uint64_t before = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        if (before == 0) return 0;
+        if (before & 1) continue;
+        memcpy(into, &slot->entry, sizeof(*into));
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&slot->sequence, memory_order_relaxed) == before) return 1;
+    }
+    return 0;
+}
+
+static int newest_first(const void *a, const void *b)
+{
+    uint64_t x = ((const SlowlogEntry *)a)->id, y = ((const SlowlogEntry *)b)->id;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+// Every entry still visible, newest first; returns how many (or -1)
+static long collect(SlowlogEntry **entries)
+{
+    *entries = malloc(SLOWLOG_MAX_LEN * sizeof(SlowlogEntry));
+    if (!*entries) return -1;
+    uint64_t first = atomic_load_explicit(&first_visible_id, memory_order_relaxed);
+    long count = 0;
+    for (size_t i = 0; i < SLOWLOG_MAX_LEN; i++)
+    {
+        SlowlogEntry *e = &(*entries)[count];
+        if (read_slot(&ring[i], e) && e->id >= first) count++;
+    }
+    qsort(*entries, (size_t)count, sizeof(SlowlogEntry), newest_first);
+    return count;
+}
+
+size_t slowlog_get(SlowlogEntry *entries, size_t max)
+{
+    SlowlogEntry *all;
+    long count = collect(&all);
+    if (count < 0) return 0;
+    size_t copied = (size_t)count < max ? (size_t)count : max;
+    memcpy(entries, all, copied * sizeof(SlowlogEntry));
+    free(all);
+    return copied;
+}
+
+size_t slowlog_len(void)
+{
+    SlowlogEntry *all;
+    long count = collect(&all);
+    free(all);
+    return count < 0 ? 0 : (size_t)count;
+}
+
+void slowlog_reset(void)
+{
+    atomic_store_explicit(&first_visible_id, atomic_load_explicit(&next_id, memory_order_relaxed),
+                          memory_order_relaxed);
+}
+
+uint64_t slowlog_threshold_us(void)
+{
+    return atomic_load_explicit(&slowlog_threshold_ns, memory_order_relaxed) / 1000;
+}
+
+void slowlog_set_threshold_us(uint64_t threshold_us)
+{
+    uint64_t ns = threshold_us > UINT64_MAX / 1000 ? UINT64_MAX : threshold_us * 1000;
+    atomic_store_explicit(&slowlog_threshold_ns, ns, memory_order_relaxed);
+}
@@ -0,0 +1,58 @@
+#ifndef SLOWLOG_H
+#define SLOWLOG_H
+
+#include "config.h"
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Commands that take longer than a threshold, kept in a fixed ring of
+// SLOWLOG_MAX_LEN entries that the newest overwrite. Recording takes no lock:
+// each slot carries a sequence number that is odd while it is being written,
+// and readers retry or skip a slot that changed under them.
+
+// Where a command found its answer
+typedef enum {
+    SLOWLOG_CACHE, // Served from the memory cache
+    SLOWLOG_DISK,  // Read from storage
+    SLOWLOG_MISS,  // Storage was searched and the key is absent
+    SLOWLOG_WRITE, // Handed to the writer and committed
+    SLOWLOG_SCAN,  // Ordered scan through the index
+    SLOWLOG_PATH_COUNT
+} slowlog_path_t;
+
+typedef struct {
+    uint64_t id;           // Increases by one per entry, across resets
+    uint64_t timestamp_us; // Unix time the command finished
+    uint64_t duration_ns;
+    uint64_t bytes_read;   // Storage bytes the command read (0 from the cache or the writer)
+    const char *command;
+    slowlog_path_t path;
+    size_t key_length;     // Of the whole key; only SLOWLOG_KEY_LEN bytes are kept
+    char key[SLOWLOG_KEY_LEN + 1];
+} SlowlogEntry;
+
+extern _Atomic uint64_t slowlog_threshold_ns;
+
+void slowlog_record(const char *command, const char *key, slowlog_path_t path, uint64_t duration_ns);
+
+// Record the command if it was slow. A fast command pays for this one
+// comparison only.
+static inline void slowlog_check(const char *command, const char *key, slowlog_path_t path, uint64_t duration_ns)
+{
+    if (duration_ns >= atomic_load_explicit(&slowlog_threshold_ns, memory_order_relaxed))
+    {
+        slowlog_record(command, key, path, duration_ns);
+    }
+}
+
+// Copy up to `max` entries into `entries`, newest first, and return how many
+size_t slowlog_get(SlowlogEntry *entries, size_t max);
+size_t slowlog_len(void);
+void slowlog_reset(void);
+const char *slowlog_path_name(slowlog_path_t path);
+
+uint64_t slowlog_threshold_us(void);
+void slowlog_set_threshold_us(uint64_t threshold_us);
+
+#endif // SLOWLOG_H
@@ -20,6 +20,15 @@ double command_timer_end(const struct timespec *start_time)
     return (double)seconds * 1000.0 + (double)nanoseconds / 1000000.0;
 }
 
+uint64_t timer_elapsed_ns(const struct timespec *start_time)
+{
+    struct timespec end_time;
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+    int64_t ns = (int64_t)(end_time.tv_sec - start_time->tv_sec) * 1000000000 +
+                 (end_time.tv_nsec - start_time->tv_nsec);
+    return ns > 0 ? (uint64_t)ns : 0;
+}
+
 void cache_timer_start(struct timespec *start_time)
 {
     clock_gettime(CLOCK_MONOTONIC, start_time);
@@ -31,4 +40,91 @@ int cache_timer_end(const struct timespec *start_time)
     clock_gettime(CLOCK_MONOTONIC, &end_time);
     int seconds = end_time.tv_sec - start_time->tv_sec;
     return seconds;
-}
\ No newline at end of file
+}
+
+// Values below 2^(SUB_BITS+1) map to themselves. Above, the top SUB_BITS+1
+// significant bits pick the bucket: `shift` selects the power of two and the
+// remaining bits the linear sub-bucket within it.
+static unsigned histogram_index(uint64_t value)
+{
+    if (value < (2ULL << HISTOGRAM_SUB_BITS)) return (unsigned)value;
+    if (value > HISTOGRAM_MAX_NS) value = HISTOGRAM_MAX_NS;
+    unsigned shift = 63 - (unsigned)__builtin_clzll(value) - HISTOGRAM_SUB_BITS;
+    return ((shift + 1) << HISTOGRAM_SUB_BITS) + (unsigned)(value >> shift) - (1U << HISTOGRAM_SUB_BITS);
+}
+
+// Largest value that maps to bucket `index`
+static uint64_t histogram_bucket_max(unsigned index)
+{
+    if (index < (2U << HISTOGRAM_SUB_BITS)) return index;
+    unsigned shift = (index >> HISTOGRAM_SUB_BITS) - 1;
+    uint64_t mantissa = (index & ((1U << HISTOGRAM_SUB_BITS) - 1)) + (1U << HISTOGRAM_SUB_BITS);
+    return ((mantissa + 1) << shift) - 1;
+}
+
+void histogram_record(LatencyHistogram *h, uint64_t nanoseconds)
+{
+    h->counts[histogram_index(nanoseconds)]++;
+    h->count++;
+    h->sum_ns += nanoseconds;
+    if (nanoseconds > h->max_ns) h->max_ns = nanoseconds;
+}
+
+void histogram_merge(LatencyHistogram *into, const LatencyHistogram *from)
+{
+    for (unsigned i = 0; i < HISTOGRAM_BUCKETS; i++) into->counts[i] += from->counts[i];
+    into->count += from->count;
+    into->sum_ns += from->sum_ns;
+    if (from->max_ns > into->max_ns) into->max_ns = from->max_ns;
+}
+
+uint64_t histogram_percentile(const LatencyHistogram *h, double percentile)
+{
+    if (h->count == 0) return 0;
+    uint64_t rank = (uint64_t)(percentile / 100.0 * (double)h->count + 0.5);
+    if (rank < 1) rank = 1;
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        seen += h->counts[i];
+        if (seen >= rank)
+        {
+            uint64_t value = histogram_bucket_max(i);
+            return value < h->max_ns ? value : h->max_ns;
+        }
+    }
+    return h->max_ns;
+}
+
+uint64_t histogram_count_below(const LatencyHistogram *h, uint64_t nanoseconds)
+{
+    unsigned end = nanoseconds > HISTOGRAM_MAX_NS ? HISTOGRAM_BUCKETS : histogram_index(nanoseconds);
+    uint64_t count = 0;
+    for (unsigned i = 0; i < end; i++) count += h->counts[i];
+    return count;
+}
+
+void shared_histogram_record(SharedHistogram *h, uint64_t nanoseconds)
+{
+    single_writer_add(&h->counts[histogram_index(nanoseconds)], 1);
+    single_writer_add(&h->sum_ns, nanoseconds);
+    if (nanoseconds > atomic_load_explicit(&h->max_ns, memory_order_relaxed))
+    {
+        atomic_store_explicit(&h->max_ns, nanoseconds, memory_order_relaxed);
+    }
+}
+
+void shared_histogram_merge(LatencyHistogram *into, const SharedHistogram *from)
+{
+    // The count is taken from the buckets read, so a concurrent record can
+    // never leave percentiles looking for samples that are not there
+    for (unsigned i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        uint64_t count = atomic_load_explicit(&from->counts[i], memory_order_relaxed);
+        into->counts[i] += count;
+        into->count += count;
+    }
+    into->sum_ns += atomic_load_explicit(&from->sum_ns, memory_order_relaxed);
+    uint64_t max_ns = atomic_load_explicit(&from->max_ns, memory_order_relaxed);
+    if (max_ns > into->max_ns) into->max_ns = max_ns;
+}
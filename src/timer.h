@@ -1,6 +1,8 @@
 #ifndef TIMER_H
 #define TIMER_H
 
+#include <stdint.h>
+#include <stdatomic.h>
 #include <time.h> // For struct timespec
 
 void cache_timer_start(struct timespec *start_time);
@@ -8,5 +10,49 @@ int cache_timer_end(const struct timespec *start_time);
 
 void command_timer_start(struct timespec *start_time);
 double command_timer_end(const struct timespec *start_time);
+uint64_t timer_elapsed_ns(const struct timespec *start_time);
+
+// Log-linear latency histogram in nanoseconds: exact below 64ns, then 32
+// linear sub-buckets per power of two, so any percentile is within ~3%.
+// Samples above HISTOGRAM_MAX_NS (~18 minutes) share the last bucket.
+// Not synchronized: each thread records into its own and they are merged.
+#define HISTOGRAM_SUB_BITS 5
+#define HISTOGRAM_MAX_BITS 40
+#define HISTOGRAM_MAX_NS ((1ULL << HISTOGRAM_MAX_BITS) - 1)
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAX_BITS + 1 - HISTOGRAM_SUB_BITS) << HISTOGRAM_SUB_BITS)
+
+typedef struct {
+    uint64_t counts[HISTOGRAM_BUCKETS];
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+} LatencyHistogram;
+
+void histogram_record(LatencyHistogram *h, uint64_t nanoseconds);
+void histogram_merge(LatencyHistogram *into, const LatencyHistogram *from);
+// Value at or below which `percentile` percent of samples fall (0 if empty)
+uint64_t histogram_percentile(const LatencyHistogram *h, double percentile);
+// Samples below `nanoseconds`; exact when it is a power of two
+uint64_t histogram_count_below(const LatencyHistogram *h, uint64_t nanoseconds);
+
+// The same buckets for a histogram that one thread records into while any
+// other thread may read it. Only the owner writes, with relaxed stores, so
+// recording takes no lock and no atomic read-modify-write; readers merge a
+// snapshot of it into a LatencyHistogram.
+typedef struct {
+    _Atomic uint64_t counts[HISTOGRAM_BUCKETS];
+    _Atomic uint64_t sum_ns;
+    _Atomic uint64_t max_ns;
+} SharedHistogram;
+
+void shared_histogram_record(SharedHistogram *h, uint64_t nanoseconds); // Owning thread only
+void shared_histogram_merge(LatencyHistogram *into, const SharedHistogram *from);
+
+// Add to a slot that only the calling thread writes: a relaxed load and store
+// instead of a locked add. Used by the histograms above and the metrics shards.
+static inline void single_writer_add(_Atomic uint64_t *slot, uint64_t amount)
+{
+    atomic_store_explicit(slot, atomic_load_explicit(slot, memory_order_relaxed) + amount, memory_order_relaxed);
+}
 
 #endif // ZU_TIMER_H
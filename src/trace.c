@@ -0,0 +1,174 @@
+#include "trace.h"
+#include "json.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+    uint64_t timestamp_ns; // CLOCK_MONOTONIC
+    const char *category;
+    const char *name;
+    int64_t value;
+    char phase; // Chrome's B(egin), E(nd) or i(nstant)
+    char arg[TRACE_ARG_LEN + 1];
+} TraceEvent;
+
+// One per thread, written only by its owner. Readers copy a range of events
+// and then drop any the owner may have overwritten meanwhile.
+typedef struct TraceRing {
+    struct TraceRing *next;
+    _Atomic int in_use;
+    int thread;             // tid in the dump
+    _Atomic uint64_t head;  // Events ever written
+    _Atomic uint64_t first; // Events before this one were cleared
+    TraceEvent events[TRACE_RING_EVENTS];
+} TraceRing;
+
+_Atomic int trace_enabled = 0;
+
+static TraceRing *_Atomic ring_list = NULL;
+static pthread_mutex_t ring_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t ring_key;
+static pthread_once_t ring_key_once = PTHREAD_ONCE_INIT;
+static _Thread_local TraceRing *local_ring = NULL;
+static int next_thread = 1;
+
+// Thread exit: let a future thread reuse the ring
+static void release_ring(void *ring)
+{
+    atomic_store(&((TraceRing *)ring)->in_use, 0);
+}
+
+static void create_ring_key(void)
+{
+    pthread_key_create(&ring_key, release_ring);
+}
+
+// Rings are only allocated by threads that record while tracing is on
+static TraceRing *acquire_ring(void)
+{
+    pthread_once(&ring_key_once, create_ring_key);
+    pthread_mutex_lock(&ring_mutex);
+
+    TraceRing *ring = atomic_load(&ring_list);
+    while (ring && atomic_load(&ring->in_use))
+    {
+        ring = ring->next;
+    }
+    if (ring)
+    {
+        // The previous owner's events would be shown under this thread
+        atomic_store(&ring->first, atomic_load(&ring->head));
+        atomic_store(&ring->in_use, 1);
+    }
+    else if ((ring = calloc(1, sizeof(TraceRing))))
+    {
+        atomic_store(&ring->in_use, 1);
+        ring->next = atomic_load(&ring_list);
+        atomic_store(&ring_list, ring); // Publish after the ring is initialized
+    }
+    if (ring) ring->thread = next_thread++;
+
+    pthread_mutex_unlock(&ring_mutex);
+    if (ring) pthread_setspecific(ring_key, ring);
+    return ring;
+}
+
+void trace_record(char phase, const char *category, const char *name, const char *arg, int64_t value)
+{
+    TraceRing *ring = local_ring;
+    if (!ring && !(ring = local_ring = acquire_ring())) return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    TraceEvent *e = &ring->events[head % TRACE_RING_EVENTS];
+    e->timestamp_ns = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+    e->category = category;
+    e->name = name;
+    e->value = value;
+    e->phase = phase;
+    size_t kept = arg ? strnlen(arg, TRACE_ARG_LEN) : 0;
+    if (kept) memcpy(e->arg, arg, kept);
+    e->arg[kept] = '\0';
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+void trace_set_enabled(int enabled)
+{
+    atomic_store(&trace_enabled, enabled ? 1 : 0);
+}
+
+void trace_clear(void)
+{
+    for (TraceRing *ring = atomic_load(&ring_list); ring; ring = ring->next)
+    {
+        atomic_store(&ring->first, atomic_load(&ring->head));
+    }
+}
+
+static void write_string(FILE *out, const char *s)
+{
+    size_t len = strlen(s);
+    if (json_plain_prefix(s, len) == len)
+    {
+        fprintf(out, "\"%s\"", s);
+        return;
+    }
+    size_t escaped_len;
+    char *escaped = json_escape(s, len, &escaped_len);
+    fprintf(out, "\"%.*s\"", escaped ? (int)escaped_len : 0, escaped ? escaped : "");
+    free(escaped);
+}
+
+// Copy the ring's surviving events into `events`; returns how many
+static size_t snapshot_ring(TraceRing *ring, TraceEvent *events)
+{
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint64_t from = atomic_load(&ring->first);
+    if (head > TRACE_RING_EVENTS && from < head - TRACE_RING_EVENTS) from = head - TRACE_RING_EVENTS;
+    for (uint64_t i = from; i < head; i++)
+    {
+        events[i - from] = ring->events[i % TRACE_RING_EVENTS];
+    }
+    atomic_thread_fence(memory_order_acquire);
+
+    // Events the owner has lapped since they were copied may be torn
+    uint64_t now = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint64_t skip = 0;
+    if (now > TRACE_RING_EVENTS && now - TRACE_RING_EVENTS > from) skip = now - TRACE_RING_EVENTS - from;
+    if (skip >= head - from) return 0;
+    memmove(events, events + skip, (size_t)(head - from - skip) * sizeof(TraceEvent));
+    return (size_t)(head - from - skip);
+}
+
+long trace_dump(FILE *out)
+{
+    TraceEvent *events = malloc(TRACE_RING_EVENTS * sizeof(TraceEvent));
+    if (!events) return -1;
+
+    long written = 0;
+    int pid = (int)getpid();
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    for (TraceRing *ring = atomic_load(&ring_list); ring; ring = ring->next)
+    {
+        size_t count = snapshot_ring(ring, events);
+        for (size_t i = 0; i < count; i++)
+        {
+            const TraceEvent *e = &events[i];
+            fprintf(out, "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d,",
+                    written++ ? "," : "", e->name, e->category, e->phase, e->timestamp_ns / 1000.0, pid,
+                    ring->thread);
+            if (e->phase == 'i') fprintf(out, "\"s\":\"t\",");
+            fprintf(out, "\"args\":{\"arg\":");
+            write_string(out, e->arg);
+            fprintf(out, ",\"value\":%lld}}", (long long)e->value);
+        }
+    }
+    fprintf(out, "\n]}\n");
+    free(events);
+    return ferror(out) ? -1 : written;
+}
@@ -0,0 +1,72 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "config.h"
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Tracepoints on the hot paths, each of which is both
+//
+//  - a USDT probe `zu:<group>__start`, `zu:<group>__done` or
+//    `zu:<group>__<event>` for perf and bpftrace, compiled in when
+//    <sys/sdt.h> is available (a single nop until a tracer attaches), and
+//  - an event in the calling thread's trace ring while tracing is on
+//    (trace_set_enabled), which trace_dump writes as Chrome trace-event JSON.
+//
+// While tracing is off a tracepoint costs the nop and one relaxed load.
+//
+// Probe arguments: start (name, arg), done (name, arg, result) and events
+// (arg, value), where name is a static string and arg a string or NULL.
+
+#if TRACE_USDT && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define TRACE_HAVE_USDT 1
+#endif
+#endif
+
+#ifdef TRACE_HAVE_USDT
+#define TRACE_PROBE2(probe, a, b) DTRACE_PROBE2(zu, probe, a, b)
+#define TRACE_PROBE3(probe, a, b, c) DTRACE_PROBE3(zu, probe, a, b, c)
+#else
+#define TRACE_PROBE2(probe, a, b) ((void)(a), (void)(b))
+#define TRACE_PROBE3(probe, a, b, c) ((void)(a), (void)(b), (void)(c))
+#endif
+
+extern _Atomic int trace_enabled;
+
+static inline int trace_on(void)
+{
+    return atomic_load_explicit(&trace_enabled, memory_order_relaxed);
+}
+
+// Append to the calling thread's ring; `category` and `name` must be static
+void trace_record(char phase, const char *category, const char *name, const char *arg, int64_t value);
+
+#define TRACE_BEGIN(group, name, arg) \
+    do { \
+        TRACE_PROBE2(group##__start, (const char *)(name), (const char *)(arg)); \
+        if (trace_on()) trace_record('B', #group, name, arg, 0); \
+    } while (0)
+
+#define TRACE_END(group, name, arg, result) \
+    do { \
+        TRACE_PROBE3(group##__done, (const char *)(name), (const char *)(arg), (int64_t)(result)); \
+        if (trace_on()) trace_record('E', #group, name, arg, result); \
+    } while (0)
+
+#define TRACE_EVENT(group, event, arg, value) \
+    do { \
+        TRACE_PROBE2(group##__##event, (const char *)(arg), (int64_t)(value)); \
+        if (trace_on()) trace_record('i', #group, #group "_" #event, arg, value); \
+    } while (0)
+
+void trace_set_enabled(int enabled);
+// Forget every event recorded so far
+void trace_clear(void);
+// Write the events in the rings as Chrome trace-event JSON (chrome://tracing,
+// Perfetto). Returns the number of events written, or -1 on a write error.
+long trace_dump(FILE *out);
+
+#endif // TRACE_H
@@ -1,7 +1,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
-
+#include <math.h>
+#include "utils.h"
 
 void generate_random_alphanumeric(char *str, size_t length) {
     // Alphanumeric character set: a-z, A-Z, 0-9
@@ -19,3 +20,50 @@ void generate_random_alphanumeric(char *str, size_t length) {
     }
     str[length] = '\0'; // Null-terminate the string
 }
+
+struct timespec stat_mtime(const struct stat *st) {
+#ifdef __APPLE__
+    return st->st_mtimespec;
+#else
+    return st->st_mtim;
+#endif
+}
+
+uint64_t random_next(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+double random_unit(uint64_t *state) {
+    return (double)(random_next(state) >> 11) / 9007199254740992.0; // 53 random bits
+}
+
+static double zeta(uint64_t n, double theta) {
+    double sum = 0;
+    for (uint64_t i = 1; i <= n; i++) {
+        sum += 1.0 / pow((double)i, theta);
+    }
+    return sum;
+}
+
+void zipfian_init(ZipfianGenerator *z, uint64_t items, double theta) {
+    z->items = items ? items : 1;
+    z->theta = theta;
+    z->alpha = 1.0 / (1.0 - theta);
+    z->zetan = zeta(z->items, theta);
+    double zeta2 = zeta(2, theta);
+    z->eta = (1.0 - pow(2.0 / (double)z->items, 1.0 - theta)) / (1.0 - zeta2 / z->zetan);
+}
+
+uint64_t zipfian_next(const ZipfianGenerator *z, uint64_t *state) {
+    double u = random_unit(state);
+    double uz = u * z->zetan;
+    if (uz < 1.0) return 0;
+    if (uz < 1.0 + pow(0.5, z->theta)) return z->items > 1 ? 1 : 0;
+    uint64_t rank = (uint64_t)((double)z->items * pow(z->eta * u - z->eta + 1.0, z->alpha));
+    return rank < z->items ? rank : z->items - 1;
+}
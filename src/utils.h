@@ -4,7 +4,33 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <time.h>     // For struct timespec
+#include <sys/stat.h> // For struct stat
 
 void generate_random_alphanumeric(char *str, size_t length);
 
-#endif
\ No newline at end of file
+// Modification time of `st` to the nanosecond (st_mtim on Linux, st_mtimespec on macOS)
+struct timespec stat_mtime(const struct stat *st);
+
+// xorshift64* generator; each thread keeps its own state (any nonzero seed)
+uint64_t random_next(uint64_t *state);
+double random_unit(uint64_t *state); // Uniform in [0, 1)
+
+// Zipfian ranks in [0, items): rank 0 is the most popular. Uses the method of
+// Gray et al. ("Quickly generating billion-record synthetic databases"), as
+// YCSB does; initialization is O(items), each draw O(1).
+typedef struct {
+    uint64_t items;
+    double theta;
+    double alpha;
+    double zetan;
+    double eta;
+} ZipfianGenerator;
+
+#define ZIPFIAN_THETA 0.99 // YCSB's default skew
+
+void zipfian_init(ZipfianGenerator *z, uint64_t items, double theta);
+uint64_t zipfian_next(const ZipfianGenerator *z, uint64_t *state);
+
+#endif
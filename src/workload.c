@@ -0,0 +1,381 @@
+#include "workload.h"
+#include "config.h"
+#include "commands.h"
+#include "ds.h"
+#include "io.h"
+#include "lsm.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+
+#define LOAD_BATCH 1000 // Records per LSM batch while loading
+
+const char *const workload_op_names[WORKLOAD_OP_COUNT] = {
+    [WORKLOAD_READ] = "read",
+    [WORKLOAD_UPDATE] = "update",
+    [WORKLOAD_INSERT] = "insert",
+    [WORKLOAD_DELETE] = "delete",
+    [WORKLOAD_SCAN] = "scan",
+    [WORKLOAD_READ_MODIFY_WRITE] = "rmw",
+};
+
+// The core YCSB workloads
+static const struct {
+    const char *name;
+    int mix[WORKLOAD_OP_COUNT];
+    key_distribution_t distribution;
+} presets[] = {
+    {"a", {[WORKLOAD_READ] = 50, [WORKLOAD_UPDATE] = 50}, KEYS_ZIPFIAN},  // Update heavy
+    {"b", {[WORKLOAD_READ] = 95, [WORKLOAD_UPDATE] = 5}, KEYS_ZIPFIAN},   // Read mostly
+    {"c", {[WORKLOAD_READ] = 100}, KEYS_ZIPFIAN},                          // Read only
+    {"d", {[WORKLOAD_READ] = 95, [WORKLOAD_INSERT] = 5}, KEYS_LATEST},    // Read latest
+    {"e", {[WORKLOAD_SCAN] = 95, [WORKLOAD_INSERT] = 5}, KEYS_ZIPFIAN},   // Short ranges
+    {"f", {[WORKLOAD_READ] = 50, [WORKLOAD_READ_MODIFY_WRITE] = 50}, KEYS_ZIPFIAN}, // Read-modify-write
+};
+
+int workload_preset(const char *name, WorkloadConfig *config)
+{
+    for (size_t i = 0; i < sizeof(presets) / sizeof(presets[0]); i++)
+    {
+        if (strcmp(name, presets[i].name) != 0) continue;
+        memset(config, 0, sizeof(*config));
+        snprintf(config->name, sizeof(config->name), "%s", name);
+        memcpy(config->mix, presets[i].mix, sizeof(config->mix));
+        config->distribution = presets[i].distribution;
+        config->records = BENCHMARK_DB_SIZE;
+        config->value_size = BENCHMARK_VALUE_SIZE;
+        config->max_scan_length = BENCHMARK_MAX_SCAN;
+        config->threads = BENCHMARK_THREADS;
+        config->seconds = BENCHMARK_SECONDS;
+        return 1;
+    }
+    return 0;
+}
+
+static int parse_size(const char *text, size_t *out)
+{
+    char *end;
+    unsigned long long value = strtoull(text, &end, 10);
+    if (*text == '\0' || *text == '-' || *end != '\0') return 0;
+    *out = (size_t)value;
+    return 1;
+}
+
+int workload_option(WorkloadConfig *config, const char *option)
+{
+    const char *equals = strchr(option, '=');
+    if (!equals) return 0;
+    size_t name_len = (size_t)(equals - option);
+    const char *value = equals + 1;
+    size_t number;
+
+#define OPTION(n) (name_len == strlen(n) && strncmp(option, n, name_len) == 0)
+    for (int op = 0; op < WORKLOAD_OP_COUNT; op++)
+    {
+        if (!OPTION(workload_op_names[op])) continue;
+        if (!parse_size(value, &number) || number > 100) return 0;
+        config->mix[op] = (int)number;
+        snprintf(config->name, sizeof(config->name), "custom");
+        return 1;
+    }
+    if (OPTION("records")) return parse_size(value, &config->records) && config->records > 0;
+    if (OPTION("value")) return parse_size(value, &config->value_size) && config->value_size > 0;
+    if (OPTION("scanlen")) return parse_size(value, &config->max_scan_length) && config->max_scan_length > 0;
+    if (OPTION("threads"))
+    {
+        if (!parse_size(value, &number) || number < 1 || number > 1024) return 0;
+        config->threads = (int)number;
+        return 1;
+    }
+    if (OPTION("seconds"))
+    {
+        char *end;
+        config->seconds = strtod(value, &end);
+        return *value != '\0' && *end == '\0' && config->seconds > 0;
+    }
+    if (OPTION("dist"))
+    {
+        if (strcmp(value, "uniform") == 0) config->distribution = KEYS_UNIFORM;
+        else if (strcmp(value, "zipfian") == 0) config->distribution = KEYS_ZIPFIAN;
+        else if (strcmp(value, "latest") == 0) config->distribution = KEYS_LATEST;
+        else return 0;
+        return 1;
+    }
+#undef OPTION
+    return 0;
+}
+
+int workload_valid(const WorkloadConfig *config)
+{
+    int total = 0;
+    for (int op = 0; op < WORKLOAD_OP_COUNT; op++) total += config->mix[op];
+    return total == 100 && config->records > 0 && config->value_size > 0 && config->threads > 0 &&
+           config->seconds > 0 && config->max_scan_length > 0;
+}
+
+// --- Scratch database ---
+
+// Keys are zero-padded so that numeric and key order agree
+static void format_key(char *key, size_t size, uint64_t number)
+{
+    snprintf(key, size, "user%012llu", (unsigned long long)number);
+}
+
+void workload_remove_scratch(const char *path)
+{
+    char file[4096];
+    DIR *dir = opendir(path);
+    if (dir)
+    {
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL)
+        {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+            snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+            unlink(file);
+        }
+        closedir(dir);
+        rmdir(path);
+        return;
+    }
+    unlink(path);
+    snprintf(file, sizeof(file), "%s.bloom", path);
+    unlink(file);
+}
+
+// Write the initial records straight to storage; only the run is measured
+static int load_records(const WorkloadConfig *config)
+{
+    char *value = malloc(config->value_size + 1);
+    char (*keys)[32] = malloc(LOAD_BATCH * sizeof(*keys));
+    const char **key_list = malloc(LOAD_BATCH * sizeof(const char *));
+    const char **value_list = malloc(LOAD_BATCH * sizeof(const char *));
+    int ok = value && keys && key_list && value_list;
+    if (ok) generate_random_alphanumeric(value, config->value_size);
+
+    FILE *file = NULL;
+    if (ok && !lsm_selected())
+    {
+        file = fopen(FILENAME, "wb");
+        ok = file != NULL;
+    }
+    for (size_t start = 0; ok && start < config->records; start += LOAD_BATCH)
+    {
+        size_t count = config->records - start < LOAD_BATCH ? config->records - start : LOAD_BATCH;
+        for (size_t i = 0; ok && i < count; i++)
+        {
+            format_key(keys[i], sizeof(keys[i]), start + i);
+            key_list[i] = keys[i];
+            value_list[i] = value;
+            if (file) ok = write_item_to_file(file, keys[i], value);
+        }
+        if (ok && !file) ok = lsm_apply((const char *const *)key_list, (const char *const *)value_list, count);
+    }
+    if (file && fclose(file) != 0) ok = 0;
+
+    free(value);
+    free(keys);
+    free(key_list);
+    free(value_list);
+    return ok;
+}
+
+// --- Worker threads ---
+
+typedef struct {
+    const WorkloadConfig *config;
+    const ZipfianGenerator *zipfian;
+    _Atomic uint64_t *key_count; // Records loaded plus inserts so far
+    atomic_int *stop;
+    uint64_t rng;
+    uint64_t operations[WORKLOAD_OP_COUNT];
+    uint64_t errors;
+    LatencyHistogram *latency; // WORKLOAD_OP_COUNT of them
+} WorkloadThread;
+
+static workload_op_t choose_op(WorkloadThread *t)
+{
+    int roll = (int)(random_next(&t->rng) % 100);
+    for (int op = 0; op < WORKLOAD_OP_COUNT; op++)
+    {
+        roll -= t->config->mix[op];
+        if (roll < 0) return (workload_op_t)op;
+    }
+    return WORKLOAD_READ;
+}
+
+static uint64_t choose_key(WorkloadThread *t)
+{
+    uint64_t count = atomic_load(t->key_count);
+    switch (t->config->distribution)
+    {
+    case KEYS_UNIFORM:
+        return random_next(&t->rng) % count;
+    case KEYS_LATEST: {
+        uint64_t rank = zipfian_next(t->zipfian, &t->rng);
+        return rank < count ? count - 1 - rank : 0;
+    }
+    case KEYS_ZIPFIAN:
+    default: {
+        // Hash the rank so the hot keys are not all adjacent
+        uint64_t rank = zipfian_next(t->zipfian, &t->rng);
+        return hash_content((const char *)&rank, sizeof(rank)) % t->config->records;
+    }
+    }
+}
+
+// Vary the value a little per write without the cost of regenerating it
+static void touch_value(WorkloadThread *t, char *value)
+{
+    size_t position = random_next(&t->rng) % t->config->value_size;
+    value[position] = (char)('a' + random_next(&t->rng) % 26);
+}
+
+// rand() is not thread-safe, so workers fill their values from their own state
+static void fill_value(WorkloadThread *t, char *value)
+{
+    for (size_t i = 0; i < t->config->value_size; i++) value[i] = (char)('a' + random_next(&t->rng) % 26);
+    value[t->config->value_size] = '\0';
+}
+
+static int run_op(WorkloadThread *t, workload_op_t op, char *value)
+{
+    char key[32];
+    char *current = NULL;
+    int result;
+    switch (op)
+    {
+    case WORKLOAD_READ:
+        format_key(key, sizeof(key), choose_key(t));
+        result = zget_command(key, &current);
+        free(current);
+        return result == CMD_SUCCESS || result == CMD_NOT_FOUND;
+    case WORKLOAD_UPDATE:
+        format_key(key, sizeof(key), choose_key(t));
+        touch_value(t, value);
+        return zset_command(key, value) == CMD_SUCCESS;
+    case WORKLOAD_INSERT:
+        format_key(key, sizeof(key), atomic_fetch_add(t->key_count, 1));
+        return zset_command(key, value) == CMD_SUCCESS;
+    case WORKLOAD_DELETE:
+        format_key(key, sizeof(key), choose_key(t));
+        result = zrm_command(key);
+        return result == CMD_SUCCESS || result == CMD_NOT_FOUND;
+    case WORKLOAD_SCAN: {
+        DataItem *items = NULL;
+        size_t size = 0, capacity = 0;
+        char *next = NULL;
+        size_t length = 1 + random_next(&t->rng) % t->config->max_scan_length;
+        format_key(key, sizeof(key), choose_key(t));
+        result = zrange_command(key, NULL, length, 1, &items, &size, &capacity, &next);
+        free_data_list(&items, &size, &capacity);
+        free(next);
+        return result == CMD_SUCCESS;
+    }
+    case WORKLOAD_READ_MODIFY_WRITE:
+        format_key(key, sizeof(key), choose_key(t));
+        result = zget_command(key, &current);
+        free(current);
+        if (result != CMD_SUCCESS && result != CMD_NOT_FOUND) return 0;
+        touch_value(t, value);
+        return zset_command(key, value) == CMD_SUCCESS;
+    default:
+        return 0;
+    }
+}
+
+static void *workload_thread(void *arg)
+{
+    WorkloadThread *t = arg;
+    char *value = malloc(t->config->value_size + 1);
+    if (!value)
+    {
+        t->errors++;
+        return NULL;
+    }
+    fill_value(t, value);
+
+    while (!atomic_load_explicit(t->stop, memory_order_relaxed))
+    {
+        workload_op_t op = choose_op(t);
+        struct timespec start;
+        command_timer_start(&start);
+        if (!run_op(t, op, value)) t->errors++;
+        histogram_record(&t->latency[op], timer_elapsed_ns(&start));
+        t->operations[op]++;
+    }
+    free(value);
+    return NULL;
+}
+
+int workload_run(const WorkloadConfig *config, WorkloadResult *result)
+{
+    memset(result, 0, sizeof(*result));
+    ZipfianGenerator zipfian;
+    zipfian_init(&zipfian, config->records, ZIPFIAN_THETA);
+    WorkloadThread *threads = calloc((size_t)config->threads, sizeof(WorkloadThread));
+    pthread_t *ids = calloc((size_t)config->threads, sizeof(pthread_t));
+    LatencyHistogram *latency = calloc((size_t)config->threads * WORKLOAD_OP_COUNT, sizeof(LatencyHistogram));
+    if (!threads || !ids || !latency)
+    {
+        free(threads);
+        free(ids);
+        free(latency);
+        return 0;
+    }
+
+    struct timespec start;
+    command_timer_start(&start);
+    int ok = load_records(config);
+    result->load_seconds = (double)timer_elapsed_ns(&start) / 1e9;
+
+    _Atomic uint64_t key_count = config->records;
+    atomic_int stop = 0;
+    int started = 0;
+    command_timer_start(&start);
+    for (; ok && started < config->threads; started++)
+    {
+        WorkloadThread *t = &threads[started];
+        t->config = config;
+        t->zipfian = &zipfian;
+        t->key_count = &key_count;
+        t->stop = &stop;
+        t->rng = ((uint64_t)time(NULL) << 16) ^ (0x9E3779B97F4A7C15ULL * (uint64_t)(started + 1));
+        t->latency = &latency[(size_t)started * WORKLOAD_OP_COUNT];
+        if (pthread_create(&ids[started], NULL, workload_thread, t) != 0) break;
+    }
+    if (ok && started < config->threads) ok = 0;
+
+    if (started > 0)
+    {
+        struct timespec duration = {(time_t)config->seconds,
+                                    (long)((config->seconds - (double)(time_t)config->seconds) * 1e9)};
+        while (ok && nanosleep(&duration, &duration) != 0) {}
+        atomic_store(&stop, 1);
+    }
+    for (int i = 0; i < started; i++) pthread_join(ids[i], NULL);
+    result->run_seconds = (double)timer_elapsed_ns(&start) / 1e9;
+
+    for (int i = 0; i < started; i++)
+    {
+        result->errors += threads[i].errors;
+        for (int op = 0; op < WORKLOAD_OP_COUNT; op++)
+        {
+            result->operations[op] += threads[i].operations[op];
+            histogram_merge(&result->latency[op], &threads[i].latency[op]);
+            histogram_merge(&result->overall, &threads[i].latency[op]);
+        }
+    }
+
+    free(threads);
+    free(ids);
+    free(latency);
+    return ok;
+}
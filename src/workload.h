@@ -0,0 +1,70 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include "timer.h"  // For LatencyHistogram
+#include <stddef.h> // For size_t
+#include <stdint.h>
+
+// YCSB-style workload generator. A run loads `records` keys into the database
+// at FILENAME, then drives the operation mix from `threads` threads through
+// the command layer (cache, writer, disk) for `seconds`, timing every
+// operation. The database is overwritten, so it must be a scratch one in a
+// process of its own: zu runs benchmarks in a worker process (see zu.c).
+
+typedef enum {
+    WORKLOAD_READ,
+    WORKLOAD_UPDATE,
+    WORKLOAD_INSERT,
+    WORKLOAD_DELETE,
+    WORKLOAD_SCAN,
+    WORKLOAD_READ_MODIFY_WRITE,
+    WORKLOAD_OP_COUNT
+} workload_op_t;
+
+typedef enum {
+    KEYS_UNIFORM,
+    KEYS_ZIPFIAN, // Popular keys scattered over the key space
+    KEYS_LATEST   // Zipfian over recency: the newest inserts are hottest
+} key_distribution_t;
+
+typedef struct {
+    char name[16];
+    int mix[WORKLOAD_OP_COUNT]; // Percent of operations of each kind, summing to 100
+    key_distribution_t distribution;
+    size_t records;
+    size_t value_size;
+    size_t max_scan_length; // Scans read 1..max_scan_length records
+    int threads;
+    double seconds;
+} WorkloadConfig;
+
+typedef struct {
+    uint64_t operations[WORKLOAD_OP_COUNT];
+    uint64_t errors;
+    double load_seconds;
+    double run_seconds;
+    LatencyHistogram latency[WORKLOAD_OP_COUNT];
+    LatencyHistogram overall;
+} WorkloadResult;
+
+extern const char *const workload_op_names[WORKLOAD_OP_COUNT];
+
+// Fill `config` with the defaults and the mix of YCSB workload "a".."f".
+// Returns 0 for an unknown name.
+int workload_preset(const char *name, WorkloadConfig *config);
+
+// Apply one "name=value" setting: records, value, threads, seconds, scanlen,
+// dist (uniform|zipfian|latest) or an operation percentage (read, update,
+// insert, delete, scan, rmw). Returns 0 if it is not valid.
+int workload_option(WorkloadConfig *config, const char *option);
+
+// 1 if the mix sums to 100 and the sizes are usable
+int workload_valid(const WorkloadConfig *config);
+
+// Load and run the workload against FILENAME, replacing what it holds.
+// Returns 1 on success, 0 if the database could not be set up.
+int workload_run(const WorkloadConfig *config, WorkloadResult *result);
+// Remove a scratch database file, or an LSM directory and its files
+void workload_remove_scratch(const char *path);
+
+#endif // WORKLOAD_H
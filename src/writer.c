@@ -0,0 +1,771 @@
+#include "writer.h"
+#include "config.h"
+#include "ds.h"
+#include "cache.h"
+#include "io.h"
+#include "metrics.h"
+#include "index.h"
+#include "bloom.h"
+#include "lsm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/file.h> // For flock
+
+#define RING_MASK (WRITER_QUEUE_SIZE - 1)
+_Static_assert((WRITER_QUEUE_SIZE & RING_MASK) == 0, "WRITER_QUEUE_SIZE must be a power of two");
+
+// A submitted operation, or a transaction's group of them. Lives on the
+// submitter's stack until `done` is set.
+typedef struct {
+    WriteOp *ops;
+    size_t count;
+    const WriteWatch *watches;
+    size_t watch_count;
+    int transaction;
+    int result;
+    int done;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} WriteRequest;
+
+// Bounded MPSC ring (Vyukov): each slot's sequence number says whether it is
+// free for the producer at `pos` (seq == pos) or holds that producer's request
+// (seq == pos + 1). Producers claim positions with one CAS; the single consumer
+// needs no atomic read-modify-write at all.
+typedef struct {
+    _Atomic size_t sequence;
+    WriteRequest *request;
+} RingSlot;
+
+static RingSlot ring[WRITER_QUEUE_SIZE];
+static _Alignas(64) _Atomic size_t enqueue_pos;
+static _Alignas(64) size_t dequeue_pos; // Writer thread only
+
+static pthread_t writer_thread;
+static atomic_int writer_running;
+static atomic_int submitters; // Producers between their running check and their push
+static atomic_int writer_sleeping;
+static pthread_mutex_t wake_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake_cond = PTHREAD_COND_INITIALIZER;
+
+// Serializes batch application. Batches only take file_lock shared, so this is
+// what keeps the writer and the inline fallback from building two generations at once.
+static pthread_mutex_t apply_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void ring_init(void)
+{
+    for (size_t i = 0; i < WRITER_QUEUE_SIZE; i++)
+    {
+        atomic_store_explicit(&ring[i].sequence, i, memory_order_relaxed);
+    }
+    atomic_store(&enqueue_pos, 0);
+    dequeue_pos = 0;
+}
+
+// Returns 0 if the ring is full
+static int ring_push(WriteRequest *request)
+{
+    size_t pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+    RingSlot *slot;
+    for (;;)
+    {
+        slot = &ring[pos & RING_MASK];
+        size_t seq = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            return 0;
+        }
+        else
+        {
+            pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+        }
+    }
+    slot->request = request;
+    atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+    return 1;
+}
+
+static WriteRequest *ring_pop(void)
+{
+    RingSlot *slot = &ring[dequeue_pos & RING_MASK];
+    size_t seq = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    if ((intptr_t)seq - (intptr_t)(dequeue_pos + 1) < 0) return NULL;
+    WriteRequest *request = slot->request;
+    atomic_store_explicit(&slot->sequence, dequeue_pos + WRITER_QUEUE_SIZE, memory_order_release);
+    dequeue_pos++;
+    return request;
+}
+
+static int ring_empty(void)
+{
+    RingSlot *slot = &ring[dequeue_pos & RING_MASK];
+    return (intptr_t)atomic_load_explicit(&slot->sequence, memory_order_acquire) - (intptr_t)(dequeue_pos + 1) < 0;
+}
+
+// --- Batch application ---
+
+// Final state of one distinct key touched by a batch
+typedef struct {
+    const char *key;
+    const char *value; // Current value (borrowed), NULL if the key does not exist
+    long disk_index;   // Position of the record in the file, -1 if new
+    int dirty;
+    int appended;
+} BatchKey;
+
+static int compare_key_names(const void *a, const void *b)
+{
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+static int compare_batch_key(const void *key, const void *entry)
+{
+    return strcmp((const char *)key, ((const BatchKey *)entry)->key);
+}
+
+static BatchKey *find_batch_key(BatchKey *keys, size_t count, const char *key)
+{
+    return bsearch(key, keys, count, sizeof(BatchKey), compare_batch_key);
+}
+
+// Read every record of the locked database file. *sorted is cleared if the
+// keys are not strictly ascending (a file the writer did not produce).
+static int read_records(FILE *file, DataItem **items, size_t *size, size_t *capacity, int *sorted)
+{
+    char *key = NULL;
+    char *value = NULL;
+    int result;
+    while ((result = read_item_from_file(file, &key, &value)) > 0)
+    {
+        if (*size > 0 && strcmp((*items)[*size - 1].key, key) >= 0) *sorted = 0;
+        ensure_list_capacity(items, capacity, *size + 1);
+        (*items)[*size].key = key;
+        (*items)[*size].value = value;
+        (*size)++;
+    }
+    return result == 0 && !ferror(file);
+}
+
+static int compare_items_by_key(const void *a, const void *b)
+{
+    const DataItem *ia = *(const DataItem *const *)a;
+    const DataItem *ib = *(const DataItem *const *)b;
+    int cmp = strcmp(ia->key, ib->key);
+    return cmp != 0 ? cmp : (ia > ib) - (ia < ib); // Keep file order among duplicates
+}
+
+// Write one record of the new generation, index it and add it to its filter
+static int emit_record(FILE *file, KeyIndex **index, BloomFilter *filter, long *offset, const char *key,
+                       const char *value)
+{
+    if (filter) bloom_add(filter, key);
+    if (*index && !index_add(*index, key, *offset))
+    {
+        index_free(*index);
+        *index = NULL; // Readers rebuild it instead
+    }
+    *offset += item_record_size(key, value);
+    return write_item_to_file(file, key, value);
+}
+
+// Write the new generation of the file next to the old one, make it durable,
+// then atomically replace the old one. Records are written in key order, merging
+// the batch's new keys in, so the key index and Bloom filter come out of the same pass.
+static int commit_records(DataItem *items, size_t size, BatchKey **item_keys, int sorted,
+                          BatchKey *keys, size_t key_count)
+{
+    // A file that is not sorted yet (init_db, an older data file) is sorted once
+    DataItem **order = NULL;
+    if (!sorted)
+    {
+        order = malloc(size * sizeof(DataItem *));
+        if (!order) return 0;
+        for (size_t i = 0; i < size; i++) order[i] = &items[i];
+        qsort(order, size, sizeof(DataItem *), compare_items_by_key);
+    }
+
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", FILENAME);
+    FILE *file = io_fopen(tmp_path, "wb");
+    if (!file)
+    {
+        perror("writer: failed to open temporary file");
+        free(order);
+        return 0;
+    }
+
+    KeyIndex *index = index_new();
+    BloomFilter *filter = bloom_new(size + key_count); // Upper bound on the records written
+    long offset = 0;
+    size_t next_new = 0;
+    const char *previous = NULL;
+    int ok = 1;
+    for (size_t n = 0; ok && n <= size; n++)
+    {
+        size_t i = 0;
+        const char *key = NULL;
+        if (n < size)
+        {
+            i = order ? (size_t)(order[n] - items) : n;
+            key = items[i].key;
+        }
+
+        // New keys that sort before this record (all remaining ones at the end)
+        for (; ok && next_new < key_count && (!key || strcmp(keys[next_new].key, key) < 0); next_new++)
+        {
+            BatchKey *k = &keys[next_new];
+            if (k->disk_index < 0 && k->value) ok = emit_record(file, &index, filter, &offset, k->key, k->value);
+        }
+        if (!key || !ok) continue;
+        if (previous && strcmp(previous, key) == 0) continue; // Later duplicates are dropped
+        previous = key;
+
+        BatchKey *k = item_keys[i];
+        if (!k)
+        {
+            ok = emit_record(file, &index, filter, &offset, key, items[i].value);
+        }
+        else if (k->value)
+        {
+            ok = emit_record(file, &index, filter, &offset, key, k->value);
+        }
+    }
+    free(order);
+
+    if (ok) ok = fflush(file) == 0;
+#if WRITER_FSYNC
+    if (ok) ok = io_fsync(file) == 0;
+#endif
+    if (fclose(file) != 0) ok = 0;
+    if (ok && filter && !bloom_file_save(filter, tmp_path))
+    {
+        bloom_free(filter); // Readers rebuild it instead
+        filter = NULL;
+    }
+    if (ok)
+    {
+        ok = index_replace_file(tmp_path, index);
+    }
+    else
+    {
+        index_free(index);
+    }
+    if (ok && filter) bloom_file_install(filter);
+    else bloom_free(filter);
+    if (!ok)
+    {
+        perror("writer: failed to commit batch");
+        unlink(tmp_path);
+        return 0;
+    }
+    if (offset > 0)
+    {
+        metrics_add(METRIC_DISK_BYTES_WRITTEN, (uint64_t)offset);
+        io_account(IO_STAT_BYTES_WRITTEN, (uint64_t)offset);
+    }
+    return 1;
+}
+
+// Evaluate one operation against the key's current value (NULL if absent).
+// Operations that derive a new value return it in *new_value (malloc'd).
+static int evaluate_op(WriteOp *op, const char *current, char **new_value)
+{
+    switch (op->op)
+    {
+        case WRITE_SET:
+            return WRITE_APPLIED;
+        case WRITE_DELETE:
+            return current ? WRITE_APPLIED : WRITE_SKIPPED;
+        case WRITE_CAS:
+            return current && strcmp(current, op->expected) == 0 ? WRITE_APPLIED : WRITE_SKIPPED;
+        case WRITE_INCR:
+        {
+            long long number = 0;
+            if (current)
+            {
+                char *end;
+                errno = 0;
+                number = strtoll(current, &end, 10);
+                if (errno != 0 || end == current || *end != '\0') return WRITE_NOT_INTEGER;
+            }
+            if ((op->delta > 0 && number > LLONG_MAX - op->delta) ||
+                (op->delta < 0 && number < LLONG_MIN - op->delta))
+                return WRITE_NOT_INTEGER;
+            number += op->delta;
+            char buffer[32];
+            snprintf(buffer, sizeof(buffer), "%lld", number);
+            *new_value = my_strdup(buffer);
+            if (!*new_value) return WRITE_FAILED;
+            op->number = number;
+            return WRITE_APPLIED;
+        }
+        case WRITE_APPEND:
+        {
+            size_t current_len = current ? strlen(current) : 0;
+            size_t append_len = strlen(op->value);
+            *new_value = malloc(current_len + append_len + 1);
+            if (!*new_value) return WRITE_FAILED;
+            memcpy(*new_value, current ? current : "", current_len);
+            memcpy(*new_value + current_len, op->value, append_len + 1);
+            op->number = (long long)(current_len + append_len);
+            return WRITE_APPLIED;
+        }
+    }
+    return WRITE_FAILED;
+}
+
+// Values computed by INCR/APPEND, owned by the batch until it is published
+typedef struct {
+    char **values;
+    size_t count;
+} ComputedValues;
+
+// Evaluate one operation and update its key's state in the batch.
+// Returns 0 if out of memory.
+static int apply_op(WriteOp *op, BatchKey *k, ComputedValues *computed)
+{
+    char *new_value = NULL;
+    op->result = evaluate_op(op, k->value, &new_value);
+    if (new_value)
+    {
+        char **grown = realloc(computed->values, (computed->count + 1) * sizeof(char *));
+        if (!grown)
+        {
+            free(new_value);
+            return 0;
+        }
+        computed->values = grown;
+        computed->values[computed->count++] = new_value;
+        k->value = new_value;
+    }
+    else if (op->result == WRITE_APPLIED)
+    {
+        k->value = op->op == WRITE_DELETE ? NULL : op->value;
+    }
+    k->dirty |= op->result == WRITE_APPLIED;
+    return 1;
+}
+
+static int watch_matches(const WriteWatch *watch, const BatchKey *k)
+{
+    if (!k->value) return !watch->exists;
+    return watch->exists && hash_content(k->value, strlen(k->value)) == watch->content_hash;
+}
+
+// State of a key before a transaction's operation touched it
+typedef struct {
+    BatchKey *key;
+    const char *value;
+    int dirty;
+} UndoEntry;
+
+// Evaluate a transaction against the state left by the requests before it.
+// If a watch or an operation fails, every key it touched is restored, so the
+// group lands in this generation of the file entirely or not at all.
+// Returns 0 if out of memory.
+static int apply_transaction(WriteRequest *request, BatchKey *keys, size_t key_count, ComputedValues *computed)
+{
+    request->result = WRITE_APPLIED;
+    for (size_t i = 0; i < request->count; i++) request->ops[i].result = WRITE_SKIPPED;
+    for (size_t i = 0; i < request->watch_count; i++)
+    {
+        if (!watch_matches(&request->watches[i], find_batch_key(keys, key_count, request->watches[i].key)))
+        {
+            request->result = WRITE_ABORTED;
+            return 1;
+        }
+    }
+    if (request->count == 0) return 1;
+
+    UndoEntry *undo = malloc(request->count * sizeof(UndoEntry));
+    if (!undo) return 0;
+    size_t done = 0;
+    int ok = 1;
+    while (done < request->count)
+    {
+        WriteOp *op = &request->ops[done];
+        BatchKey *k = find_batch_key(keys, key_count, op->key);
+        undo[done++] = (UndoEntry){k, k->value, k->dirty};
+        if (!(ok = apply_op(op, k, computed))) break;
+        if (op->result == WRITE_NOT_INTEGER || op->result == WRITE_FAILED)
+        {
+            request->result = op->result;
+            break;
+        }
+        if (op->op == WRITE_CAS && op->result == WRITE_SKIPPED)
+        {
+            request->result = WRITE_ABORTED;
+            break;
+        }
+    }
+    if (!ok || request->result != WRITE_APPLIED)
+    {
+        // Roll back in reverse; only the failing operation keeps its result
+        for (size_t i = done; i-- > 0;)
+        {
+            undo[i].key->value = undo[i].value;
+            undo[i].key->dirty = undo[i].dirty;
+            if (i + 1 < done) request->ops[i].result = WRITE_SKIPPED;
+        }
+    }
+    free(undo);
+    return ok;
+}
+
+// LSM engine: look up each key of the batch instead of reading a whole file.
+// The values are owned by `items`.
+static int load_lsm_values(BatchKey *keys, size_t key_count, DataItem **items, size_t *size, size_t *capacity)
+{
+    for (size_t i = 0; i < key_count; i++)
+    {
+        char *value = NULL;
+        int found = lsm_get(keys[i].key, &value);
+        if (found < 0) return 0;
+        if (found == 0) continue;
+        ensure_list_capacity(items, capacity, *size + 1);
+        (*items)[*size].key = NULL;
+        (*items)[*size].value = value;
+        keys[i].disk_index = (long)*size;
+        keys[i].value = value;
+        (*size)++;
+    }
+    return 1;
+}
+
+// LSM engine: the changed keys go to the log and memtable as one batch
+static int commit_lsm(const BatchKey *keys, size_t key_count)
+{
+    const char **names = malloc(key_count * sizeof(const char *));
+    const char **values = malloc(key_count * sizeof(const char *));
+    size_t n = 0;
+    for (size_t i = 0; names && values && i < key_count; i++)
+    {
+        if (!keys[i].dirty) continue;
+        names[n] = keys[i].key;
+        values[n] = keys[i].value;
+        n++;
+    }
+    int ok = names && values && lsm_apply(names, values, n);
+    free(names);
+    free(values);
+    return ok;
+}
+
+static void fail_requests(WriteRequest **requests, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        requests[i]->result = WRITE_FAILED;
+        for (size_t j = 0; j < requests[i]->count; j++) requests[i]->ops[j].result = WRITE_FAILED;
+    }
+}
+
+// Apply `count` requests as one read-modify-write of the database file.
+// Requests are evaluated in submission order; each gets its own result.
+static void apply_batch(WriteRequest **requests, size_t count)
+{
+    pthread_mutex_lock(&apply_mutex);
+
+    // One entry per distinct key (written or watched), sorted for lookups while scanning the file
+    size_t name_count = 0;
+    size_t op_count = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        name_count += requests[i]->count + requests[i]->watch_count;
+        op_count += requests[i]->count;
+    }
+    const char **names = malloc((name_count ? name_count : 1) * sizeof(const char *));
+    BatchKey *keys = malloc((name_count ? name_count : 1) * sizeof(BatchKey));
+    if (!names || !keys)
+    {
+        free(names);
+        free(keys);
+        fail_requests(requests, count);
+        pthread_mutex_unlock(&apply_mutex);
+        return;
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        for (size_t j = 0; j < requests[i]->count; j++) names[n++] = requests[i]->ops[j].key;
+        for (size_t j = 0; j < requests[i]->watch_count; j++) names[n++] = requests[i]->watches[j].key;
+    }
+    qsort(names, name_count, sizeof(const char *), compare_key_names);
+    size_t key_count = 0;
+    for (size_t i = 0; i < name_count; i++)
+    {
+        if (key_count == 0 || strcmp(keys[key_count - 1].key, names[i]) != 0)
+        {
+            keys[key_count++] = (BatchKey){names[i], NULL, -1, 0, 0};
+        }
+    }
+    free(names);
+
+    DataItem *items = NULL;
+    size_t size = 0;
+    size_t capacity = 0;
+    BatchKey **item_keys = NULL;
+    int ok = 1;
+    int sorted = 1;
+    int lsm = lsm_selected();
+
+    // Shared: readers keep using the current generation while the next one is
+    // written, and apply_mutex already keeps batches from overlapping
+    io_begin(IO_OP_COMMIT);
+    io_lock_file(0);
+
+    FILE *file = lsm ? NULL : io_fopen(FILENAME, "rb");
+    if (lsm)
+    {
+        ok = load_lsm_values(keys, key_count, &items, &size, &capacity);
+    }
+    else if (file)
+    {
+        if (io_flock(file, LOCK_SH) == -1 || !read_records(file, &items, &size, &capacity, &sorted))
+        {
+            ok = 0;
+        }
+        long bytes_read = ftell(file);
+        if (bytes_read > 0)
+        {
+            metrics_add(METRIC_DISK_BYTES_READ, (uint64_t)bytes_read);
+            io_account(IO_STAT_BYTES_READ, (uint64_t)bytes_read);
+        }
+    }
+
+    if (ok && size > 0 && !lsm)
+    {
+        item_keys = calloc(size, sizeof(BatchKey *));
+        ok = item_keys != NULL;
+    }
+    for (size_t i = 0; ok && !lsm && i < size; i++)
+    {
+        BatchKey *k = find_batch_key(keys, key_count, items[i].key);
+        item_keys[i] = k;
+        if (k && k->disk_index < 0)
+        {
+            k->disk_index = (long)i;
+            k->value = items[i].value;
+        }
+    }
+
+    ComputedValues computed = {NULL, 0};
+    for (size_t i = 0; ok && i < count; i++)
+    {
+        WriteRequest *request = requests[i];
+        if (request->transaction)
+        {
+            ok = apply_transaction(request, keys, key_count, &computed);
+        }
+        else
+        {
+            ok = apply_op(&request->ops[0], find_batch_key(keys, key_count, request->ops[0].key), &computed);
+            request->result = request->ops[0].result;
+        }
+    }
+    int changed = 0;
+    for (size_t i = 0; i < key_count; i++) changed |= keys[i].dirty;
+
+    if (ok && changed)
+    {
+        ok = lsm ? commit_lsm(keys, key_count) : commit_records(items, size, item_keys, sorted, keys, key_count);
+    }
+    if (file)
+    {
+        flock(fileno(file), LOCK_UN);
+        fclose(file);
+    }
+    pthread_rwlock_unlock(&file_lock);
+
+    if (ok)
+    {
+        // Publish to the cache in order, after the batch is durable
+        for (size_t i = 0; i < key_count; i++)
+        {
+            if (!keys[i].dirty) continue;
+            if (keys[i].value) add_to_cache(keys[i].key, keys[i].value);
+            else remove_from_cache(keys[i].key);
+        }
+        metrics_inc(METRIC_WRITER_BATCHES);
+        metrics_add(METRIC_WRITER_OPS, op_count);
+    }
+    else
+    {
+        fail_requests(requests, count);
+    }
+
+    for (size_t i = 0; i < computed.count; i++) free(computed.values[i]);
+    free(computed.values);
+    free(item_keys);
+    free_data_list(&items, &size, &capacity);
+    free(keys);
+    pthread_mutex_unlock(&apply_mutex);
+}
+
+static void complete_request(WriteRequest *request)
+{
+    pthread_mutex_lock(&request->mutex);
+    request->done = 1;
+    pthread_cond_signal(&request->cond);
+    pthread_mutex_unlock(&request->mutex); // The submitter may free the request from here on
+}
+
+// --- Writer thread ---
+
+static void wake_writer(void)
+{
+    atomic_thread_fence(memory_order_seq_cst); // Order the push before the flag check
+    if (atomic_load(&writer_sleeping))
+    {
+        pthread_mutex_lock(&wake_mutex);
+        pthread_cond_signal(&wake_cond);
+        pthread_mutex_unlock(&wake_mutex);
+    }
+}
+
+static void *writer_main(void *arg)
+{
+    (void)arg;
+    WriteRequest *batch[WRITER_BATCH_MAX];
+
+    for (;;)
+    {
+        size_t count = 0;
+        while (count < WRITER_BATCH_MAX && (batch[count] = ring_pop()) != NULL)
+        {
+            count++;
+        }
+        if (count > 0)
+        {
+            apply_batch(batch, count);
+            for (size_t i = 0; i < count; i++)
+            {
+                complete_request(batch[i]);
+            }
+            continue;
+        }
+
+        if (!atomic_load(&writer_running) && atomic_load(&submitters) == 0 && ring_empty())
+        {
+            break;
+        }
+
+        // Announce the sleep before the final emptiness check; a producer that
+        // pushes afterwards is guaranteed to see the flag and signal
+        pthread_mutex_lock(&wake_mutex);
+        atomic_store(&writer_sleeping, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (ring_empty() && atomic_load(&writer_running))
+        {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += 100000000; // Recheck the shutdown flag every 100ms
+            if (deadline.tv_nsec >= 1000000000)
+            {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&wake_cond, &wake_mutex, &deadline);
+        }
+        atomic_store(&writer_sleeping, 0);
+        pthread_mutex_unlock(&wake_mutex);
+    }
+    return NULL;
+}
+
+int writer_start(void)
+{
+    if (atomic_load(&writer_running)) return 1;
+    init_cache();
+    ring_init();
+    atomic_store(&writer_running, 1);
+    if (pthread_create(&writer_thread, NULL, writer_main, NULL) != 0)
+    {
+        perror("Failed to start writer thread");
+        atomic_store(&writer_running, 0);
+        return 0;
+    }
+    return 1;
+}
+
+void writer_stop(void)
+{
+    if (!atomic_exchange(&writer_running, 0)) return;
+    pthread_mutex_lock(&wake_mutex);
+    pthread_cond_signal(&wake_cond);
+    pthread_mutex_unlock(&wake_mutex);
+    pthread_join(writer_thread, NULL);
+}
+
+static int submit_request(WriteRequest *request)
+{
+    WriteRequest *batch[1] = {request};
+
+    atomic_fetch_add(&submitters, 1);
+    if (!atomic_load(&writer_running))
+    {
+        // No writer (tests, shutdown): apply inline through the same batch path
+        atomic_fetch_sub(&submitters, 1);
+        apply_batch(batch, 1);
+    }
+    else
+    {
+        metrics_gauge_add(GAUGE_WRITER_PENDING, 1);
+        while (!ring_push(request))
+        {
+            // Ring full: let the writer catch up
+            wake_writer();
+            sched_yield();
+        }
+        atomic_fetch_sub(&submitters, 1);
+        wake_writer();
+
+        pthread_mutex_lock(&request->mutex);
+        while (!request->done)
+        {
+            pthread_cond_wait(&request->cond, &request->mutex);
+        }
+        pthread_mutex_unlock(&request->mutex);
+        metrics_gauge_add(GAUGE_WRITER_PENDING, -1);
+    }
+
+    pthread_mutex_destroy(&request->mutex);
+    pthread_cond_destroy(&request->cond);
+    return request->result;
+}
+
+int writer_execute(WriteOp *op)
+{
+    WriteRequest request = {op, 1, NULL, 0, 0, 0, 0, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER};
+    return submit_request(&request);
+}
+
+int writer_transaction(WriteOp *ops, size_t count, const WriteWatch *watches, size_t watch_count)
+{
+    WriteRequest request = {ops, count, watches, watch_count, 1, 0, 0,
+                            PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER};
+    return submit_request(&request);
+}
+
+int writer_submit(write_op_t op, const char *key, const char *value)
+{
+    WriteOp write = {op, key, value, NULL, 0, 0, 0};
+    return writer_execute(&write);
+}
@@ -0,0 +1,66 @@
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <stddef.h> // For size_t
+#include <stdint.h>
+
+// All mutations of the database file go through one writer thread. Callers
+// submit a request to a bounded lock-free ring and wait for its result; the
+// writer drains the ring and commits everything it found with a single file
+// rewrite and fsync, then updates the cache in submission order.
+//
+// Because a single thread evaluates every write in order, read-modify-write
+// operations (INCR, APPEND, CAS) are atomic without any per-key locking.
+
+typedef enum {
+    WRITE_SET,
+    WRITE_DELETE,
+    WRITE_INCR,   // Add `delta` to an integer value (a missing key counts as 0)
+    WRITE_APPEND, // Append `value` (a missing key counts as empty)
+    WRITE_CAS     // Replace the value with `value` only if it equals `expected`
+} write_op_t;
+
+// Per-operation results
+#define WRITE_APPLIED 1
+#define WRITE_SKIPPED 0      // Deleted key did not exist, or CAS did not match
+#define WRITE_FAILED -1      // Storage error
+#define WRITE_NOT_INTEGER -2 // INCR on a non-integer value, or overflow
+#define WRITE_ABORTED -3     // Transaction: a watched key changed or a CAS did not match
+
+typedef struct {
+    write_op_t op;
+    const char *key;      // Borrowed until the submit call returns
+    const char *value;    // SET/APPEND/CAS new value
+    const char *expected; // CAS only
+    long long delta;      // INCR only
+    long long number;     // Out: the new value for INCR, the new length for APPEND
+    int result;           // Out: one of the WRITE_* results above
+} WriteOp;
+
+// Optimistic lock for a transaction: the state of `key` when it was watched
+typedef struct {
+    const char *key;
+    int exists;
+    uint64_t content_hash; // hash_content() of the value, if it existed
+} WriteWatch;
+
+// Start/stop the writer thread. Stopping drains every submitted request first.
+// While the writer is not running, submissions are applied by the caller.
+int writer_start(void);
+void writer_stop(void);
+
+// Submit one operation and wait until it is durable. Returns op->result.
+int writer_execute(WriteOp *op);
+
+// Submit a group of operations that is applied all-or-nothing in one commit:
+// either every operation lands in the same file generation or none does.
+// Returns WRITE_APPLIED, WRITE_ABORTED if a watch no longer matches or a CAS in
+// the group fails, WRITE_NOT_INTEGER if an INCR fails, or WRITE_FAILED. Each
+// op->result holds that operation's result; on abort only the failing
+// operation's result is meaningful.
+int writer_transaction(WriteOp *ops, size_t count, const WriteWatch *watches, size_t watch_count);
+
+// Shorthand for SET and DELETE
+int writer_submit(write_op_t op, const char *key, const char *value);
+
+#endif // WRITER_H
@@ -2,6 +2,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
+#include <errno.h>
 #include <time.h>
 #include <readline/readline.h>
 #include <readline/history.h>
@@ -9,18 +11,29 @@
 #include <sys/wait.h> // For waitpid()
 #include <pthread.h> // For threading
 #include <stdbool.h> // If not already included via header
+#ifdef __APPLE__
+#include <mach-o/dyld.h> // For _NSGetExecutablePath()
+#endif
 
 #include "version.h"
 #include "timer.h"
 #include "commands.h"
 #include "cache.h"
 #include "http_server.h"
+#include "resp_server.h"
+#include "writer.h"
 #include "config.h"
+#include "lsm.h"
 
 // Global for thread
 pthread_t server_thread;
+pthread_t resp_server_thread;
 volatile int server_shutdown = 0;
 
+// Writes queued between multi and exec
+static Transaction cli_txn;
+static int cli_in_multi = 0;
+
 
 // Command enum for switch statement
 typedef enum {
@@ -28,11 +41,27 @@ typedef enum {
     CMD_ZGET,
     CMD_ZRM,
     CMD_ZALL,
+    CMD_ZSCAN,
+    CMD_ZRANGE,
+    CMD_ZINCR,
+    CMD_ZAPPEND,
+    CMD_ZCAS,
+    CMD_WATCH,
+    CMD_MULTI,
+    CMD_EXEC,
+    CMD_DISCARD,
     CMD_INIT_DB,
     CMD_CACHE_STATUS,
+    CMD_MEMORY,
+    CMD_LATENCY,
+    CMD_STATS,
+    CMD_SLOWLOG,
+    CMD_TRACE,
+    CMD_HOTKEYS,
     CMD_CLEAR,
     CMD_EXIT,
     CMD_BENCHMARK,
+    CMD_BENCHMARK_MISSES,
     CMD_HELP,
     CMD_UNKNOWN
 } command_type_t;
@@ -43,15 +72,45 @@ command_type_t get_command_type(const char *command) {
     if (strcmp(command, "zget") == 0) return CMD_ZGET;
     if (strcmp(command, "zrm") == 0) return CMD_ZRM;
     if (strcmp(command, "zall") == 0) return CMD_ZALL;
+    if (strcmp(command, "zscan") == 0) return CMD_ZSCAN;
+    if (strcmp(command, "zrange") == 0) return CMD_ZRANGE;
+    if (strcmp(command, "zincr") == 0) return CMD_ZINCR;
+    if (strcmp(command, "zappend") == 0) return CMD_ZAPPEND;
+    if (strcmp(command, "zcas") == 0) return CMD_ZCAS;
+    if (strcmp(command, "watch") == 0) return CMD_WATCH;
+    if (strcmp(command, "multi") == 0) return CMD_MULTI;
+    if (strcmp(command, "exec") == 0) return CMD_EXEC;
+    if (strcmp(command, "discard") == 0) return CMD_DISCARD;
     if (strcmp(command, "init_db") == 0) return CMD_INIT_DB;
     if (strcmp(command, "cache_status") == 0) return CMD_CACHE_STATUS;
+    if (strcmp(command, "memory") == 0) return CMD_MEMORY;
+    if (strcmp(command, "latency") == 0) return CMD_LATENCY;
+    if (strcmp(command, "stats") == 0) return CMD_STATS;
+    if (strcmp(command, "slowlog") == 0) return CMD_SLOWLOG;
+    if (strcmp(command, "trace") == 0) return CMD_TRACE;
+    if (strcmp(command, "hotkeys") == 0) return CMD_HOTKEYS;
     if (strcmp(command, "clear") == 0) return CMD_CLEAR;
     if (strcmp(command, "exit") == 0 || strcmp(command, "quit") == 0) return CMD_EXIT;
     if (strcmp(command, "benchmark") == 0) return CMD_BENCHMARK;
+    if (strcmp(command, "benchmark_misses") == 0) return CMD_BENCHMARK_MISSES;
     if (strcmp(command, "help") == 0) return CMD_HELP;
     return CMD_UNKNOWN;
 }
 
+// Inside multi, writes are queued instead of executed. Returns 1 if queued.
+static int queue_in_multi(write_op_t op, const char *key, const char *value, const char *expected, long long delta) {
+    if (!cli_in_multi) return 0;
+    int result = txn_queue(&cli_txn, op, key, value, expected, delta);
+    if (result == CMD_SUCCESS) {
+        printf("QUEUED\n");
+    } else if (result == CMD_EMPTY) {
+        printf("Error: Key or value cannot be empty.\n");
+    } else {
+        printf("Error: Could not queue command.\n");
+    }
+    return 1;
+}
+
 // Function to handle zset command
 void handle_zset(char *key_token, char *value_token) {
     if (!key_token || !value_token) {
@@ -69,6 +128,8 @@ void handle_zset(char *key_token, char *value_token) {
         return;
     }
 
+    if (queue_in_multi(WRITE_SET, key_token, value_token, NULL, 0)) return;
+
     int result = zset_command(key_token, value_token);
     if (result == CMD_SUCCESS) {
         if (DEBUG_CLI) printf("OK\n");
@@ -107,6 +168,8 @@ void handle_zrm(char *key_token) {
         return;
     }
 
+    if (queue_in_multi(WRITE_DELETE, key_token, NULL, NULL, 0)) return;
+
     int result = zrm_command(key_token);
     if (result == CMD_SUCCESS) {
         printf("OK: Key '%s' removed.\n", key_token);
@@ -117,6 +180,197 @@ void handle_zrm(char *key_token) {
     }
 }
 
+// Function to handle zincr command
+void handle_zincr(char *key_token, char *delta_token) {
+    long long delta = 1;
+    if (delta_token) {
+        char *end;
+        errno = 0;
+        delta = strtoll(delta_token, &end, 10);
+        if (errno != 0 || end == delta_token || *end != '\0') {
+            printf("Usage: zincr <key> [delta]");
+            return;
+        }
+    }
+
+    if (queue_in_multi(WRITE_INCR, key_token, NULL, NULL, delta)) return;
+
+    long long value;
+    int result = zincr_command(key_token, delta, &value);
+    if (result == CMD_SUCCESS) {
+        printf("%lld\n", value);
+    } else if (result == CMD_NOT_INTEGER) {
+        printf("Error: Value is not an integer or would overflow.\n");
+    } else if (result == CMD_EMPTY) {
+        printf("Error: Key cannot be empty.\n");
+    } else {
+        printf("Error: Operation failed.\n");
+    }
+}
+
+// Function to handle zappend command
+void handle_zappend(char *key_token, char *value_token) {
+    while (value_token && *value_token && isspace((unsigned char)*value_token)) {
+        value_token++;
+    }
+    if (!key_token || !value_token || !*value_token) {
+        printf("Usage: zappend <key> <value>");
+        return;
+    }
+
+    if (queue_in_multi(WRITE_APPEND, key_token, value_token, NULL, 0)) return;
+
+    long long length;
+    int result = zappend_command(key_token, value_token, &length);
+    if (result == CMD_SUCCESS) {
+        printf("%lld\n", length);
+    } else if (result == CMD_EMPTY) {
+        printf("Error: Key or value cannot be empty.\n");
+    } else {
+        printf("Error: Operation failed.\n");
+    }
+}
+
+// Function to handle zcas command
+void handle_zcas(char *key_token, char *expected_token, char *value_token) {
+    if (queue_in_multi(WRITE_CAS, key_token, value_token, expected_token, 0)) return;
+
+    int result = zcas_command(key_token, expected_token, value_token);
+    if (result == CMD_SUCCESS) {
+        printf("OK\n");
+    } else if (result == CMD_MISMATCH) {
+        printf("Mismatch: Key '%s' does not hold the expected value.\n", key_token);
+    } else if (result == CMD_EMPTY) {
+        printf("Error: Key or value cannot be empty.\n");
+    } else {
+        printf("Error: Operation failed.\n");
+    }
+}
+
+// Parse an optional record limit; returns 0 if it is not a positive number
+static size_t parse_limit(const char *limit_token) {
+    if (!limit_token) return SCAN_DEFAULT_COUNT;
+    char *end;
+    long limit = strtol(limit_token, &end, 10);
+    return (end == limit_token || *end != '\0' || limit <= 0) ? 0 : (size_t)limit;
+}
+
+static void print_ordered(int result, DataItem *items, size_t size, char *next) {
+    if (result != CMD_SUCCESS) {
+        printf("Error: Could not access data.\n");
+        return;
+    }
+    for (size_t i = 0; i < size; i++) {
+        printf("%s:%s \n", items[i].key, items[i].value);
+    }
+    printf("Total keys: %zu\n", size);
+    if (next) printf("More keys from: %s\n", next);
+}
+
+// Function to handle zscan command
+void handle_zscan(char *prefix_token, char *limit_token) {
+    size_t limit = parse_limit(limit_token);
+    if (!prefix_token || !limit) {
+        printf("Usage: zscan <prefix> [limit]");
+        return;
+    }
+
+    DataItem *items = NULL;
+    size_t size = 0, capacity = 0;
+    char *next = NULL;
+    int result = zscan_command(prefix_token, NULL, limit, 1, &items, &size, &capacity, &next);
+    print_ordered(result, items, size, next);
+    free_data_list(&items, &size, &capacity);
+    free(next);
+}
+
+// Function to handle zrange command; "-" and "+" leave the start or end open
+void handle_zrange(char *start_token, char *end_token, char *limit_token) {
+    size_t limit = parse_limit(limit_token);
+    if (!start_token || !end_token || !limit) {
+        printf("Usage: zrange <start|-> <end|+> [limit]");
+        return;
+    }
+
+    DataItem *items = NULL;
+    size_t size = 0, capacity = 0;
+    char *next = NULL;
+    int result = zrange_command(strcmp(start_token, "-") == 0 ? NULL : start_token,
+                                strcmp(end_token, "+") == 0 ? NULL : end_token,
+                                limit, 1, &items, &size, &capacity, &next);
+    print_ordered(result, items, size, next);
+    free_data_list(&items, &size, &capacity);
+    free(next);
+}
+
+// Function to handle watch command
+void handle_watch(char *key_token) {
+    if (cli_in_multi) {
+        printf("Error: watch inside multi is not allowed.\n");
+        return;
+    }
+    int result = zwatch_command(&cli_txn, key_token);
+    if (result == CMD_SUCCESS) {
+        printf("OK\n");
+    } else if (result == CMD_EMPTY) {
+        printf("Error: Key cannot be empty.\n");
+    } else {
+        printf("Error: Could not access data.\n");
+    }
+}
+
+// Function to handle multi command
+void handle_multi() {
+    if (cli_in_multi) {
+        printf("Error: multi calls can not be nested.\n");
+        return;
+    }
+    cli_in_multi = 1;
+    printf("OK\n");
+}
+
+// Function to handle exec command
+void handle_exec() {
+    if (!cli_in_multi) {
+        printf("Error: exec without multi.\n");
+        return;
+    }
+
+    int result = zexec_command(&cli_txn);
+    if (result == CMD_SUCCESS) {
+        for (size_t i = 0; i < cli_txn.count; i++) {
+            const WriteOp *op = &cli_txn.ops[i];
+            printf("%zu) ", i + 1);
+            if (op->op == WRITE_INCR || op->op == WRITE_APPEND) {
+                printf("%lld\n", op->number);
+            } else if (op->result == WRITE_APPLIED) {
+                printf("OK\n");
+            } else {
+                printf("Key '%s' not found.\n", op->key);
+            }
+        }
+    } else if (result == CMD_MISMATCH) {
+        printf("Aborted: A watched key changed or a zcas did not match.\n");
+    } else if (result == CMD_NOT_INTEGER) {
+        printf("Aborted: Value is not an integer or would overflow.\n");
+    } else {
+        printf("Error: Transaction failed.\n");
+    }
+    txn_reset(&cli_txn);
+    cli_in_multi = 0;
+}
+
+// Function to handle discard command
+void handle_discard() {
+    if (!cli_in_multi) {
+        printf("Error: discard without multi.\n");
+        return;
+    }
+    txn_reset(&cli_txn);
+    cli_in_multi = 0;
+    printf("OK\n");
+}
+
 // Function to handle zall command
 void handle_zall() {
     int result = zall_command();
@@ -136,32 +390,271 @@ void handle_init_db() {
     }
 }
 
-// Function to handle cache_status command
-void handle_cache_status() {
-    pthread_mutex_lock(&cache_mutex);
-    int result = cache_status();
-    if (result == CMD_ERROR) {
+// Function to handle cache_status command: one page of entries from `cursor_token`
+void handle_cache_status(const char *cursor_token, const char *count_token) {
+    char *end = NULL;
+    unsigned long cursor = cursor_token ? strtoul(cursor_token, &end, 10) : 0;
+    size_t count = count_token ? parse_limit(count_token) : CACHE_STATUS_PAGE;
+    if ((cursor_token && (end == cursor_token || *end != '\0' || cursor > UINT_MAX)) || count == 0) {
+        printf("Usage: cache_status [cursor] [count]\n");
+        return;
+    }
+
+    MemoryStats memory;
+    DataItem *items = NULL;
+    size_t size = 0, capacity = 0;
+    unsigned int next = 0;
+    if (cache_page_command((unsigned int)cursor, count, &items, &size, &capacity, &next) != CMD_SUCCESS) {
         printf("Cache is not initialized\n");
-    } else if (result == CMD_SUCCESS && memory_cache != NULL) {
-        printf("Cache status: %d items used\n", memory_cache->size);
-        for (unsigned int i = 0; i < memory_cache->size; i++) {
-            DataItem *item = memory_cache->table[i];
-            while (item) {
-                printf("  Key: %s, Value: %s, Hits: %u, Last accessed: %u\n",
-                       item->key, item->value, item->hit_count, item->last_accessed);
-                item = item->next;
-            }
+        return;
+    }
+    memory_command(&memory);
+    printf("Cache status: %u of %d items used, %u of %u buckets\n", memory.cache_items, CACHE_SIZE,
+           memory.cache_used_buckets, memory.cache_bucket_count);
+    for (size_t i = 0; i < size; i++) {
+        printf("  Key: %s, Value: %s, Hits: %u, Last accessed: %u\n", items[i].key, items[i].value,
+               items[i].hit_count, items[i].last_accessed);
+    }
+    if (next) printf("More entries: cache_status %u %zu\n", next, count);
+    free_data_list(&items, &size, &capacity);
+}
+
+// Function to handle memory command: bytes held by each part of the server
+void handle_memory() {
+    MemoryStats m;
+    memory_command(&m);
+    size_t cache_requested = m.cache_entries + m.cache_keys + m.cache_values;
+    printf("Memory (bytes):\n");
+    printf("  %-14s %12zu  %u items\n", "cache entries", m.cache_entries, m.cache_items);
+    printf("  %-14s %12zu\n", "cache keys", m.cache_keys);
+    printf("  %-14s %12zu\n", "cache values", m.cache_values);
+    printf("  %-14s %12zu  load factor %.2f, %u of %u buckets used, %.2f items per used bucket\n",
+           "cache buckets", m.cache_buckets, m.cache_bucket_count ? (double)m.cache_items / m.cache_bucket_count : 0.0,
+           m.cache_used_buckets, m.cache_bucket_count,
+           m.cache_used_buckets ? (double)m.cache_items / m.cache_used_buckets : 0.0);
+    printf("  %-14s %12zu  %zu of %zu entries, %zu of %zu key bytes used\n", "index", m.index_bytes,
+           m.index_entries, m.index_entry_capacity, m.index_key_bytes, m.index_key_capacity);
+    printf("  %-14s %12zu  %.1f bits per key\n", "bloom filters", m.bloom_bytes,
+           m.bloom_keys ? m.bloom_bytes * 8.0 / m.bloom_keys : 0.0);
+    printf("  %-14s %12zu\n", "lsm memtable", m.memtable_bytes);
+    printf("  %-14s %12zu\n", "http buffers", m.http_buffers);
+    printf("\nFragmentation:\n");
+    printf("  cache allocator overhead: %zu bytes (%.1f%% over the %zu requested)\n",
+           m.cache_allocated - cache_requested,
+           cache_requested ? 100.0 * (m.cache_allocated - cache_requested) / cache_requested : 0.0, cache_requested);
+    if (m.heap_mapped) {
+        printf("  heap: %zu mapped, %zu in use, %zu free in held chunks (%.1f%%)\n", m.heap_mapped, m.heap_in_use,
+               m.heap_free, 100.0 * m.heap_free / m.heap_mapped);
+    }
+}
+
+// Function to handle latency command
+void handle_latency() {
+    LatencyHistogram *histograms = malloc(LATENCY_KIND_COUNT * sizeof(LatencyHistogram));
+    if (!histograms || latency_command(histograms) != CMD_SUCCESS) {
+        printf("Error: Could not read latency histograms.\n");
+        free(histograms);
+        return;
+    }
+    printf("Latency (µs):\n");
+    printf("  %-10s %10s %9s %9s %9s %9s %9s %9s\n", "path", "count", "avg", "p50", "p90", "p99", "p99.9", "max");
+    for (int k = 0; k < LATENCY_KIND_COUNT; k++) {
+        const LatencyHistogram *h = &histograms[k];
+        if (h->count == 0) continue;
+        printf("  %-10s %10llu %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n", metrics_latency_name((latency_kind_t)k),
+               (unsigned long long)h->count, h->sum_ns / 1000.0 / h->count, histogram_percentile(h, 50.0) / 1000.0,
+               histogram_percentile(h, 90.0) / 1000.0, histogram_percentile(h, 99.0) / 1000.0,
+               histogram_percentile(h, 99.9) / 1000.0, h->max_ns / 1000.0);
+    }
+    free(histograms);
+}
+
+// Function to handle stats command: I/O per operation type and cache activity
+void handle_stats(int reset) {
+    StorageStats *stats = malloc(sizeof(StorageStats));
+    if (!stats || stats_command(stats, reset) != CMD_SUCCESS) {
+        printf("Error: Could not read stats.\n");
+        free(stats);
+        return;
+    }
+    uint64_t lookups = stats->cache_hits + stats->cache_misses;
+    printf("Cache: %llu hits, %llu misses (%.1f%% hit rate), %llu evictions, %llu expirations\n",
+           (unsigned long long)stats->cache_hits, (unsigned long long)stats->cache_misses,
+           lookups ? 100.0 * stats->cache_hits / lookups : 0.0, (unsigned long long)stats->cache_evictions,
+           (unsigned long long)stats->cache_expirations);
+    printf("\nStorage I/O (wait times in ms):\n");
+    printf("  %-8s %8s %12s %12s %10s %7s %7s %12s %12s\n", "op", "calls", "read", "written", "records", "opens",
+           "fsyncs", "flock wait", "lock wait");
+    for (int op = 0; op < IO_OP_KIND_COUNT; op++) {
+        const uint64_t *io = stats->io[op];
+        if (io[IO_STAT_CALLS] == 0 && io[IO_STAT_OPENS] == 0) continue;
+        printf("  %-8s %8llu %12llu %12llu %10llu %7llu %7llu %5llu/%-6.1f %5llu/%-6.1f\n",
+               metrics_io_op_name((io_op_t)op), (unsigned long long)io[IO_STAT_CALLS],
+               (unsigned long long)io[IO_STAT_BYTES_READ], (unsigned long long)io[IO_STAT_BYTES_WRITTEN],
+               (unsigned long long)io[IO_STAT_RECORDS], (unsigned long long)io[IO_STAT_OPENS],
+               (unsigned long long)io[IO_STAT_FSYNCS], (unsigned long long)io[IO_STAT_FLOCK_WAITS],
+               io[IO_STAT_FLOCK_WAIT_NS] / 1e6, (unsigned long long)io[IO_STAT_LOCK_WAITS],
+               io[IO_STAT_LOCK_WAIT_NS] / 1e6);
+    }
+    if (reset) printf("\nStats reset.\n");
+    free(stats);
+}
+
+// Function to handle slowlog command: slowlog get [n] | len | reset | threshold [us]
+void handle_slowlog(const char *subcommand, const char *argument) {
+    char *end = NULL;
+    long long number = argument ? strtoll(argument, &end, 10) : -1;
+    if (argument && (end == argument || *end != '\0' || number < 0)) {
+        printf("Error: '%s' is not a non-negative number.\n", argument);
+        return;
+    }
+
+    if (strcmp(subcommand, "len") == 0 && !argument) {
+        size_t len;
+        slowlog_len_command(&len);
+        printf("%zu\n", len);
+    } else if (strcmp(subcommand, "reset") == 0 && !argument) {
+        slowlog_reset_command();
+        printf("OK\n");
+    } else if (strcmp(subcommand, "threshold") == 0) {
+        uint64_t threshold_us;
+        slowlog_threshold_command(number, &threshold_us);
+        printf("Commands slower than %llu µs are logged\n", (unsigned long long)threshold_us);
+    } else if (strcmp(subcommand, "get") == 0) {
+        size_t max = argument ? (size_t)number : 10, count = 0;
+        if (max > SLOWLOG_MAX_LEN) max = SLOWLOG_MAX_LEN;
+        SlowlogEntry *entries = malloc((max ? max : 1) * sizeof(SlowlogEntry));
+        if (!entries) {
+            printf("Error: Memory allocation failed.\n");
+            return;
         }
+        slowlog_get_command(entries, max, &count);
+        if (count > 0) {
+            printf("  %-6s %-23s %10s %-7s %-5s %10s  %s\n", "id", "time", "ms", "command", "path", "bytes", "key");
+        }
+        for (size_t i = 0; i < count; i++) {
+            const SlowlogEntry *e = &entries[i];
+            time_t seconds = (time_t)(e->timestamp_us / 1000000);
+            struct tm local;
+            char when[32];
+            localtime_r(&seconds, &local);
+            strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &local);
+            printf("  %-6llu %s.%03llu %10.3f %-7s %-5s %10llu  %s", (unsigned long long)e->id, when,
+                   (unsigned long long)(e->timestamp_us / 1000 % 1000), e->duration_ns / 1e6, e->command,
+                   slowlog_path_name(e->path), (unsigned long long)e->bytes_read, e->key);
+            if (e->key_length > SLOWLOG_KEY_LEN) printf("... (%zu bytes)", e->key_length);
+            printf("\n");
+        }
+        printf("%zu slow command%s\n", count, count == 1 ? "" : "s");
+        free(entries);
+    } else {
+        printf("Usage: slowlog get [n] | len | reset | threshold [µs]");
+    }
+}
+
+// Function to handle hotkeys command: hotkeys [n] | reset | sample [n] | decay [s]
+void handle_hotkeys(const char *subcommand, const char *argument) {
+    const char *number_token = subcommand && isdigit((unsigned char)subcommand[0]) ? subcommand : argument;
+    char *end = NULL;
+    long long number = number_token ? strtoll(number_token, &end, 10) : -1;
+    if (number_token && (end == number_token || *end != '\0' || number < 0)) {
+        printf("Error: '%s' is not a non-negative number.\n", number_token);
+        return;
+    }
+
+    int sample = subcommand && strcmp(subcommand, "sample") == 0;
+    int decay = subcommand && strcmp(subcommand, "decay") == 0;
+    if (subcommand && strcmp(subcommand, "reset") == 0 && !argument) {
+        hotkeys_reset_command();
+        printf("OK\n");
+    } else if (sample || decay) {
+        unsigned int rate, seconds;
+        if (hotkeys_config_command(sample ? number : -1, decay ? number : -1, &rate, &seconds) != CMD_SUCCESS) {
+            printf("Error: the limit is %d for the sample rate and %d seconds for the decay window.\n",
+                   HOTKEYS_MAX_SAMPLE_RATE, HOTKEYS_MAX_DECAY_SECONDS);
+            return;
+        }
+        if (rate) printf("Counting about 1 in %u requests", rate);
+        else printf("Hot key tracking is off");
+        if (seconds) printf(", halving counts every %u s\n", seconds);
+        else printf(", counts never decay\n");
+    } else if (!subcommand || (number_token == subcommand && !argument)) {
+        size_t max = number_token ? (size_t)number : 10, count = 0;
+        if (max > HOTKEYS_CAPACITY) max = HOTKEYS_CAPACITY;
+        HotKey keys[HOTKEYS_CAPACITY];
+        hotkeys_command(keys, max, &count);
+        if (count > 0) {
+            printf("  %12s %10s %12s %12s  %s\n", "requests", "± error", "reads", "writes", "key");
+        }
+        for (size_t i = 0; i < count; i++) {
+            const HotKey *k = &keys[i];
+            printf("  %12llu %10llu %12llu %12llu  %s", (unsigned long long)k->count, (unsigned long long)k->error,
+                   (unsigned long long)k->reads, (unsigned long long)k->writes, k->key);
+            if (k->key_length > HOTKEYS_KEY_LEN) printf("... (%zu bytes)", k->key_length);
+            printf("\n");
+        }
+        printf("%zu hot key%s\n", count, count == 1 ? "" : "s");
+    } else {
+        printf("Usage: hotkeys [n] | reset | sample [n] | decay [seconds]");
+    }
+}
+
+// Function to handle trace command: trace on | off | clear | dump <file|->
+void handle_trace(const char *subcommand, const char *path) {
+    if (strcmp(subcommand, "on") == 0 || strcmp(subcommand, "off") == 0) {
+        trace_enable_command(strcmp(subcommand, "on") == 0);
+        printf("Tracing %s\n", subcommand);
+    } else if (strcmp(subcommand, "clear") == 0) {
+        trace_clear_command();
+        printf("OK\n");
     } else {
-        printf("Cache is not available\n");
+        FILE *out = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+        long events = 0;
+        if (!out) {
+            printf("Error: Could not open %s: %s\n", path, strerror(errno));
+            return;
+        }
+        int result = trace_dump_command(out, &events);
+        if (out != stdout && fclose(out) != 0) result = CMD_ERROR;
+        if (result == CMD_SUCCESS) {
+            printf("Wrote %ld trace events to %s\n", events, out == stdout ? "stdout" : path);
+        } else {
+            printf("Error: Could not write the trace.\n");
+        }
     }
-    pthread_mutex_unlock(&cache_mutex);
 }
 
-// Function to handle benchmark command
-void handle_benchmark() {
-    printf("Starting benchmark with %d key-value pairs...\n", BENCHMARK_DB_SIZE);
-    int result = benchmark_command();
+// Function to handle benchmark command: benchmark [a-f] [option=value ...]
+void handle_benchmark(char *workload_token) {
+    WorkloadConfig config;
+    char *option = workload_token;
+    if (option && strchr(option, '=') == NULL) {
+        if (!workload_preset(option, &config)) {
+            printf("Error: Unknown workload '%s' (expected a-f)\n", option);
+            return;
+        }
+        option = strtok(NULL, " \t");
+    } else {
+        workload_preset("a", &config);
+    }
+    const char *json_path = NULL;
+    for (; option; option = strtok(NULL, " \t")) {
+        if (strncmp(option, "out=", 4) == 0 && option[4]) {
+            json_path = option + 4;
+            continue;
+        }
+        if (!workload_option(&config, option)) {
+            printf("Error: Invalid benchmark option '%s'\n", option);
+            return;
+        }
+    }
+    if (!workload_valid(&config)) {
+        printf("Error: Operation percentages must add up to 100\n");
+        return;
+    }
+
+    printf("Starting workload %s with %zu records for %.1f s...\n", config.name, config.records, config.seconds);
+    int result = benchmark_command(&config, json_path);
     if (result == CMD_SUCCESS) {
         printf("Benchmark completed successfully.\n");
     } else {
@@ -169,6 +662,122 @@ void handle_benchmark() {
     }
 }
 
+// Function to handle benchmark_misses command
+void handle_benchmark_misses(char *option) {
+    int max_threads = 8;
+    const char *json_path = NULL;
+    for (; option; option = strtok(NULL, " \t")) {
+        if (strncmp(option, "out=", 4) == 0 && option[4]) {
+            json_path = option + 4;
+        } else if ((max_threads = atoi(option)) < 1) {
+            printf("Usage: benchmark_misses [max_threads] [out=file]\n");
+            return;
+        }
+    }
+    if (miss_benchmark_command(max_threads, json_path) != CMD_SUCCESS) {
+        printf("Error: Benchmark failed.\n");
+    }
+}
+
+#define BENCHMARK_WORKER_FLAG "--benchmark-worker"
+#define BENCHMARK_MAX_ARGS 64
+
+static const char *program_name = "zu"; // argv[0]
+
+// Path of the running executable, or 0 where the system cannot tell; the
+// worker is then started by looking argv[0] up in PATH
+static int executable_path(char *path, uint32_t size) {
+#if defined(__APPLE__)
+    return _NSGetExecutablePath(path, &size) == 0;
+#elif defined(__linux__)
+    snprintf(path, size, "/proc/self/exe");
+    return 1;
+#else
+    (void)path;
+    (void)size;
+    return 0;
+#endif
+}
+
+// Benchmarks overwrite their database, and the cache, writer and index belong
+// to the one the servers are using. So a benchmark runs in a fresh zu process
+// of its own, started as `zu --benchmark-worker <scratch> <command> [args]`.
+void spawn_benchmark(const char *scratch, const char *command) {
+    if (strcmp(scratch, FILENAME) == 0) {
+        printf("Error: The benchmark scratch database %s is the open database\n", scratch);
+        return;
+    }
+    char *args[BENCHMARK_MAX_ARGS + 5];
+    int count = 0;
+    args[count++] = (char *)program_name;
+    args[count++] = BENCHMARK_WORKER_FLAG;
+    args[count++] = (char *)scratch;
+    args[count++] = (char *)command;
+    for (char *arg = strtok(NULL, " \t"); arg; arg = strtok(NULL, " \t")) {
+        if (count == BENCHMARK_MAX_ARGS + 4) {
+            printf("Error: Too many benchmark options\n");
+            return;
+        }
+        args[count++] = arg;
+    }
+    args[count] = NULL;
+    char path[4096];
+    int have_path = executable_path(path, sizeof(path));
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return;
+    }
+    if (pid == 0) {
+        // Nothing that takes a lock until exec: other threads may have held them
+        if (have_path) execv(path, args);
+        execvp(program_name, args);
+        static const char message[] = "Error: Could not start the benchmark process\n";
+        write(STDERR_FILENO, message, sizeof(message) - 1);
+        _exit(127);
+    }
+    int status;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+}
+
+// The worker side: run one benchmark against the scratch database, then
+// remove it. Nothing else shares this process.
+int run_benchmark_worker(int argc, char **argv) {
+    if (argc < 4) {
+        fprintf(stderr, "Usage: zu %s <scratch> <command> [args]\n", BENCHMARK_WORKER_FLAG);
+        return 2;
+    }
+    FILENAME = argv[2];
+    workload_remove_scratch(FILENAME);
+    if (!writer_start()) {
+        return 1;
+    }
+    init_cache();
+
+    // The handlers take the rest of the command line from strtok
+    char line[4096] = "";
+    for (int i = 3; i < argc; i++) {
+        if (strlen(line) + strlen(argv[i]) + 2 > sizeof(line)) break;
+        strcat(line, argv[i]);
+        strcat(line, " ");
+    }
+    command_type_t cmd_type = get_command_type(strtok(line, " \t"));
+    if (cmd_type == CMD_BENCHMARK) {
+        handle_benchmark(strtok(NULL, " \t"));
+    } else if (cmd_type == CMD_BENCHMARK_MISSES) {
+        handle_benchmark_misses(strtok(NULL, " \t"));
+    }
+
+    writer_stop();
+    lsm_close();
+    free_cache();
+    workload_remove_scratch(FILENAME);
+    return 0;
+}
+
 // Function to handle help command
 void handle_help() {
     printf("\n");
@@ -176,18 +785,38 @@ void handle_help() {
     printf("\n");
     printf("  zset <key> <value> - Set a key-value pair\n");
     printf("  zget <key>         - Get value for a key\n");
-    printf("  benchmark          - Run performance benchmark\n");
+    printf("  benchmark [a-f] [opt=val ...] - Run a YCSB workload (records, value, threads,\n");
+    printf("                       seconds, scanlen, dist, read/update/insert/delete/scan/rmw %%;\n");
+    printf("                       out=file also writes the results as JSON)\n");
+    printf("  benchmark_misses [n] [out=file] - Concurrent cache-miss lookups on 1..n threads\n");
     printf("  zrm <key>          - Remove a key\n");
+    printf("  zincr <key> [delta] - Atomically add delta (default 1) to an integer\n");
+    printf("  zappend <key> <value> - Atomically append to a value\n");
+    printf("  zcas <key> <expected> <new> - Set only if the current value is <expected>\n");
     printf("  zall               - List all key-value pairs\n");
+    printf("  zscan <prefix> [limit] - List keys under a prefix, in key order\n");
+    printf("  zrange <start|-> <end|+> [limit] - List keys in [start, end), in key order\n");
+    printf("  watch <key>        - Abort the next exec if the key changes first\n");
+    printf("  multi              - Queue the following writes as one transaction\n");
+    printf("  exec / discard     - Commit the queued writes all-or-nothing / drop them\n");
     printf("  init_db            - Init DB with random key-value pairs\n");
-    printf("  cache_status       - Show cache status\n");
+    printf("  cache_status [cursor] [count] - Show a page of cache entries\n");
+    printf("  memory             - Memory held by the cache, index, filters and buffers\n");
+    printf("  latency            - Latency percentiles per command path since startup\n");
+    printf("  stats [reset]      - Storage I/O per operation and cache activity (then reset)\n");
+    printf("  slowlog get [n] | len | reset - Commands slower than the threshold, newest first\n");
+    printf("  slowlog threshold [µs] - Show or set the slowlog threshold\n");
+    printf("  hotkeys [n] | reset - The n (default 10) most requested keys, estimated from samples\n");
+    printf("  hotkeys sample [n] | decay [s] - Show or set the sample rate (0 = off) and decay window\n");
+    printf("  trace on | off | clear - Record tracepoints into per-thread rings\n");
+    printf("  trace dump <file|->  - Write the recorded events as Chrome trace JSON\n");
     printf("\n");
     printf("  clear              - Clear the terminal screen\n");
     printf("  exit/quit          - Exit the program\n");
     printf("  help               - Show this help\n");
 }
 
-int main(void)
+int main(int argc, char **argv)
 {
     char *line;
     char *command_token, *key_token, *value_token;
@@ -195,11 +824,27 @@ int main(void)
     struct timespec command_timer_val; // For the command timer
     struct timespec cache_timer_val;   // For the cache timer
 
+    if (argc > 0) program_name = argv[0];
+    if (argc > 1 && strcmp(argv[1], BENCHMARK_WORKER_FLAG) == 0) {
+        return run_benchmark_worker(argc, argv);
+    }
+
+    // e.g. ZU_DATABASE=data.lsm selects the LSM engine
+    const char *database = getenv("ZU_DATABASE");
+    if (database && *database) FILENAME = (char *)database;
+
+    if (!writer_start()) {
+        return 1;
+    }
+
     // Remove fork, start server in thread
     if (pthread_create(&server_thread, NULL, (void*)start_inhouse_rest_server, NULL) != 0) {
         perror("Failed to start REST server thread");
         // Continue or exit?
     }
+    if (pthread_create(&resp_server_thread, NULL, (void*)start_resp_server, NULL) != 0) {
+        perror("Failed to start RESP server thread");
+    }
 
     // No longer calling waitpid with WNOHANG here.
     // The parent will wait for the child only when exiting.
@@ -273,6 +918,79 @@ int main(void)
                 }
                 break;
 
+            case CMD_ZINCR:
+                key_token = strtok(NULL, " \t");
+                value_token = strtok(NULL, " \t");
+                if (key_token && strtok(NULL, " \t") == NULL) {
+                    handle_zincr(key_token, value_token);
+                } else {
+                    printf("Usage: zincr <key> [delta]");
+                }
+                break;
+
+            case CMD_ZAPPEND:
+                key_token = strtok(NULL, " \t");
+                value_token = strtok(NULL, ""); // The rest is the value
+                handle_zappend(key_token, value_token);
+                break;
+
+            case CMD_ZCAS: {
+                key_token = strtok(NULL, " \t");
+                char *expected_token = strtok(NULL, " \t");
+                value_token = strtok(NULL, " \t");
+                if (value_token && strtok(NULL, " \t") == NULL) {
+                    handle_zcas(key_token, expected_token, value_token);
+                } else {
+                    printf("Usage: zcas <key> <expected> <new>");
+                }
+                break;
+            }
+
+            case CMD_ZSCAN:
+                key_token = strtok(NULL, " \t");
+                value_token = strtok(NULL, " \t");
+                if (strtok(NULL, " \t") == NULL) {
+                    handle_zscan(key_token, value_token);
+                } else {
+                    printf("Usage: zscan <prefix> [limit]");
+                }
+                break;
+
+            case CMD_ZRANGE: {
+                key_token = strtok(NULL, " \t");
+                char *end_token = strtok(NULL, " \t");
+                value_token = strtok(NULL, " \t");
+                if (strtok(NULL, " \t") == NULL) {
+                    handle_zrange(key_token, end_token, value_token);
+                } else {
+                    printf("Usage: zrange <start|-> <end|+> [limit]");
+                }
+                break;
+            }
+
+            case CMD_WATCH:
+                key_token = strtok(NULL, " \t");
+                if (key_token && strtok(NULL, " \t") == NULL) {
+                    handle_watch(key_token);
+                } else {
+                    printf("Usage: watch <key>");
+                }
+                break;
+
+            case CMD_MULTI:
+            case CMD_EXEC:
+            case CMD_DISCARD:
+                if (strtok(NULL, " \t") != NULL) {
+                    printf("Usage: %s", command_token);
+                } else if (cmd_type == CMD_MULTI) {
+                    handle_multi();
+                } else if (cmd_type == CMD_EXEC) {
+                    handle_exec();
+                } else {
+                    handle_discard();
+                }
+                break;
+
             case CMD_ZALL:
                 if (strtok(NULL, " \t") == NULL) { // No extra arguments
                     handle_zall();
@@ -290,13 +1008,74 @@ int main(void)
                 break;
 
             case CMD_CACHE_STATUS:
-                if (strtok(NULL, " \t") == NULL) { // No extra arguments
-                    handle_cache_status();
+                key_token = strtok(NULL, " \t");
+                value_token = strtok(NULL, " \t");
+                if (strtok(NULL, " \t") == NULL) {
+                    handle_cache_status(key_token, value_token);
+                } else {
+                    printf("Usage: cache_status [cursor] [count]");
+                }
+                break;
+
+            case CMD_MEMORY:
+                if (strtok(NULL, " \t") == NULL) {
+                    handle_memory();
                 } else {
-                    printf("Usage: cache_status");
+                    printf("Usage: memory");
                 }
                 break;
 
+            case CMD_LATENCY:
+                if (strtok(NULL, " \t") == NULL) {
+                    handle_latency();
+                } else {
+                    printf("Usage: latency");
+                }
+                break;
+
+            case CMD_STATS:
+                key_token = strtok(NULL, " \t");
+                if (!key_token || (strcmp(key_token, "reset") == 0 && strtok(NULL, " \t") == NULL)) {
+                    handle_stats(key_token != NULL);
+                } else {
+                    printf("Usage: stats [reset]");
+                }
+                break;
+
+            case CMD_SLOWLOG:
+                key_token = strtok(NULL, " \t");
+                value_token = strtok(NULL, " \t");
+                if (key_token && strtok(NULL, " \t") == NULL) {
+                    handle_slowlog(key_token, value_token);
+                } else {
+                    printf("Usage: slowlog get [n] | len | reset | threshold [µs]");
+                }
+                break;
+
+            case CMD_HOTKEYS:
+                key_token = strtok(NULL, " \t");
+                value_token = strtok(NULL, " \t");
+                if (strtok(NULL, " \t") == NULL) {
+                    handle_hotkeys(key_token, value_token);
+                } else {
+                    printf("Usage: hotkeys [n] | reset | sample [n] | decay [seconds]");
+                }
+                break;
+
+            case CMD_TRACE: {
+                key_token = strtok(NULL, " \t");
+                value_token = strtok(NULL, " \t");
+                int dump = key_token && strcmp(key_token, "dump") == 0;
+                int toggle = key_token && (strcmp(key_token, "on") == 0 || strcmp(key_token, "off") == 0 ||
+                                           strcmp(key_token, "clear") == 0);
+                if (((dump && value_token) || (toggle && !value_token)) && strtok(NULL, " \t") == NULL) {
+                    handle_trace(key_token, value_token);
+                } else {
+                    printf("Usage: trace on | off | clear | dump <file|->");
+                }
+                break;
+            }
+
             case CMD_CLEAR:
                 clear();                                           // Clear the terminal screen
                 exec_time = command_timer_end(&command_timer_val); // Stop timer for 'clear'
@@ -310,8 +1089,7 @@ int main(void)
 
                 // Join the server thread
                 printf("Shutting down REST server...\n");
-                // Signal the server thread to stop cleanly
-                extern volatile int server_running;
+                // Signal the server threads to stop cleanly
                 server_running = 0;
 
                 // Wait for the server thread to finish (max 2 seconds)
@@ -324,15 +1102,19 @@ int main(void)
                 if (pthread_join(server_thread, NULL) != 0) {
                     perror("Failed to join server thread");
                 }
+                if (pthread_join(resp_server_thread, NULL) != 0) {
+                    perror("Failed to join RESP server thread");
+                }
                 printf("REST server shut down.\n");
+
                 goto cleanup;
 
             case CMD_BENCHMARK:
-                if (strtok(NULL, " \t") == NULL) {
-                    handle_benchmark();
-                } else {
-                    printf("Usage: benchmark");
-                }
+                spawn_benchmark(lsm_selected() ? "benchmark" LSM_SUFFIX : "benchmark.zdb", command_token);
+                break;
+
+            case CMD_BENCHMARK_MISSES:
+                spawn_benchmark("benchmark.zdb", command_token);
                 break;
 
             case CMD_HELP:
@@ -355,6 +1137,9 @@ int main(void)
     }
 
 cleanup:
+    txn_reset(&cli_txn); // An unfinished multi is discarded
+    writer_stop(); // Commits anything still queued
+    lsm_close();
     free_cache();
     // Clean up readline history
     clear_history(); // Free global cache before terminating
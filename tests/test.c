@@ -9,6 +9,18 @@
 #include "../src/config.h"
 #include "../src/cache.h"
 #include "../src/io.h"
+#include "../src/json.h"
+#include "../src/timer.h"
+#include "../src/metrics.h"
+#include "../src/writer.h"
+#include "../src/lsm.h"
+#include "../src/bloom.h"
+#include "../src/workload.h"
+#include "../src/utils.h"
+#include "../src/bench_report.h"
+#include "../src/trace.h"
+#include <dirent.h>
+#include <pthread.h>
 
 /* The following lines make up our testing "framework" :) */
 static int tests = 0, fails = 0, skips = 0;
@@ -19,7 +31,10 @@ static int tests = 0, fails = 0, skips = 0;
 
 // Helper function to clean up test database
 static void cleanup_test_db(void) {
+    char bloom_path[256];
+    snprintf(bloom_path, sizeof(bloom_path), "%s.bloom", FILENAME);
     unlink(FILENAME);
+    unlink(bloom_path);
 }
 
 // Helper function to initialize test database
@@ -71,7 +86,17 @@ static void test_cache_operations(void) {
     
     // Verify it's in cache
     DataItem *item = get_from_cache("cache_key");
-    test_cond(item != NULL && strcmp(item->value, "cache_value") == 0);
+    int cached = item != NULL && strcmp(item->value, "cache_value") == 0;
+
+    // Filling past CACHE_SIZE evicts, so the cache never holds more than that
+    char key[32];
+    for (int i = 0; i < CACHE_SIZE * 2; i++) {
+        snprintf(key, sizeof(key), "evict_%d", i);
+        add_to_cache(key, "v");
+    }
+    int bounded = memory_cache->count <= CACHE_SIZE && get_from_cache(key) != NULL;
+    clear_cache();
+    test_cond(cached && bounded);
 }
 
 // Test removal operation
@@ -119,7 +144,1045 @@ static void test_list_all(void) {
     test_cond(result == CMD_ERROR);
 }
 
+// Test paginated scans with cursors and prefixes
+static void test_scan_pages(void) {
+    test("Scan pagination\n");
+    cleanup_test_db();
+    init_test_db();
+
+    char key[32];
+    for (int i = 0; i < 25; i++) {
+        snprintf(key, sizeof(key), "%s:%02d", i % 5 == 0 ? "user" : "item", i);
+        assert(zset_command(key, "value") == CMD_SUCCESS);
+    }
+
+    // Walk the whole database three records at a time, writing between pages.
+    // Every key that exists throughout comes back exactly once.
+    char *cursor = NULL;
+    int pages = 0, seen[25] = {0}, repeated = 0, in_order = 1;
+    size_t total = 0;
+    char last[32] = "";
+    do {
+        DataItem *page = NULL;
+        size_t page_size = 0, page_capacity = 0;
+        char *next = NULL;
+        assert(scan_disk_page(cursor, NULL, 3, 1, &page, &page_size, &page_capacity, &next) == 1);
+        assert(page_size <= 3);
+        for (size_t i = 0; i < page_size; i++) {
+            in_order = in_order && strcmp(last, page[i].key) < 0;
+            snprintf(last, sizeof(last), "%s", page[i].key);
+            int n = -1;
+            if (sscanf(page[i].key + 5, "%d", &n) == 1 && n >= 0 && n < 25 && strncmp(page[i].key, "new", 3) != 0) {
+                repeated += seen[n]++;
+            }
+        }
+        total += page_size;
+        pages++;
+        free_data_list(&page, &page_size, &page_capacity);
+        free(cursor);
+        cursor = next;
+        if (pages == 1) {
+            assert(zset_command("aaa:early", "x") == CMD_SUCCESS); // Sorts before the cursor
+            assert(zrm_command("item:01") == CMD_SUCCESS);         // Already returned
+            assert(zset_command("new:late", "x") == CMD_SUCCESS);  // Sorts after it
+        }
+    } while (cursor != NULL);
+    int all_seen = 1;
+    for (int i = 0; i < 25; i++) {
+        all_seen = all_seen && seen[i] == 1;
+    }
+
+    // Only keys under the prefix are returned
+    DataItem *page = NULL;
+    size_t page_size = 0, page_capacity = 0;
+    assert(scan_disk_page(NULL, "user:", 100, 0, &page, &page_size, &page_capacity, &cursor) == 1);
+    int prefix_ok = page_size == 5 && cursor == NULL;
+    for (size_t i = 0; i < page_size; i++) {
+        prefix_ok = prefix_ok && strncmp(page[i].key, "user:", 5) == 0 && page[i].value == NULL;
+    }
+    free_data_list(&page, &page_size, &page_capacity);
+
+    test_cond(all_seen && !repeated && in_order && total == 26 && pages == 9 && prefix_ok);
+}
+
+// Test ordered range and prefix queries over the key index
+static void test_ordered_index(void) {
+    test("Ordered key index\n");
+    cleanup_test_db();
+    init_test_db();
+
+    // A file the writer did not produce is indexed on first use
+    FILE *file = fopen(FILENAME, "wb");
+    assert(file);
+    const char *unsorted[] = {"user:2", "item:9", "user:10", "user:1", "item:1", "user:3"};
+    for (int i = 0; i < 6; i++) {
+        assert(write_item_to_file(file, unsorted[i], "v"));
+    }
+    fclose(file);
+
+    DataItem *items = NULL;
+    size_t size = 0, capacity = 0;
+    char *next = NULL;
+    uint64_t rebuilds = metrics_counter_total(METRIC_INDEX_REBUILDS);
+    assert(zscan_command("user:", NULL, 2, 0, &items, &size, &capacity, &next) == CMD_SUCCESS);
+    int first_page = size == 2 && strcmp(items[0].key, "user:1") == 0 &&
+                     strcmp(items[1].key, "user:10") == 0 && next && strcmp(next, "user:2") == 0;
+    free_data_list(&items, &size, &capacity);
+    char *resume = next;
+    assert(zscan_command("user:", resume, 10, 1, &items, &size, &capacity, &next) == CMD_SUCCESS);
+    free(resume);
+    int second_page = size == 2 && strcmp(items[1].key, "user:3") == 0 &&
+                      strcmp(items[1].value, "v") == 0 && next == NULL;
+    free_data_list(&items, &size, &capacity);
+    int rebuilt = metrics_counter_total(METRIC_INDEX_REBUILDS) - rebuilds == 1;
+
+    // Writes keep the file sorted and replace the index without a rebuild
+    assert(zset_command("item:5", "five") == CMD_SUCCESS);
+    assert(zrm_command("user:2") == CMD_SUCCESS);
+    assert(zrange_command("item:", "user:10", 10, 1, &items, &size, &capacity, &next) == CMD_SUCCESS);
+    int range = size == 4 && strcmp(items[0].key, "item:1") == 0 && strcmp(items[1].key, "item:5") == 0 &&
+                strcmp(items[1].value, "five") == 0 && strcmp(items[3].key, "user:1") == 0 && next == NULL;
+    free_data_list(&items, &size, &capacity);
+
+    char *key = NULL, *value = NULL, *previous = NULL;
+    int sorted = 1;
+    file = fopen(FILENAME, "rb");
+    assert(file);
+    while (read_item_from_file(file, &key, &value) > 0) {
+        sorted = sorted && (!previous || strcmp(previous, key) < 0);
+        free(previous);
+        free(value);
+        previous = key;
+    }
+    free(previous);
+    fclose(file);
+
+    test_cond(first_page && second_page && rebuilt && range && sorted &&
+              metrics_counter_total(METRIC_INDEX_REBUILDS) - rebuilds == 1);
+}
+
+// Parse a single /set body and check the decoded pair
+static int parse_one(const char *body, const char *key, const char *value) {
+    DataItem *items = NULL;
+    size_t count = 0, capacity = 0;
+    int ok = json_parse_set_payload(body, strlen(body), &items, &count, &capacity) == JSON_OK &&
+             count == 1 && strcmp(items[0].key, key) == 0 && strcmp(items[0].value, value) == 0;
+    free_data_list(&items, &count, &capacity);
+    return ok;
+}
+
+// Test the /set JSON tokenizer
+static void test_json_payload(void) {
+    test("JSON payload parsing\n");
+    DataItem *items = NULL;
+    size_t count = 0, capacity = 0;
+
+    int ok = parse_one("{\"key\":\"a\",\"value\":\"b\"}", "a", "b");
+    // Member order, whitespace, unknown members and escapes
+    ok = ok && parse_one(" { \"value\" : \"say \\\"key\\\"\" , \"ttl\": [1, {\"x\": null}], \"key\":\"k\" } ", "k", "say \"key\"");
+    ok = ok && parse_one("{\"key\":\"\\u00e9\\ud83d\\ude00\",\"value\":\"a\\\\b\\/c\\n\"}", "\xc3\xa9\xf0\x9f\x98\x80", "a\\b/c\n");
+
+    // Batch array form
+    const char *batch = "[{\"key\":\"k1\",\"value\":\"v1\"}, {\"value\":\"v2\",\"key\":\"k2\"}]";
+    ok = ok && json_parse_set_payload(batch, strlen(batch), &items, &count, &capacity) == JSON_OK && count == 2 &&
+         strcmp(items[1].key, "k2") == 0 && strcmp(items[1].value, "v2") == 0;
+    free_data_list(&items, &count, &capacity);
+
+    // Malformed input is rejected without leaking partial results
+    const char *invalid[] = {
+        "", "{", "{\"key\":\"a\",\"value\":\"b\"", "{\"key\":\"a\" \"value\":\"b\"}",
+        "{\"key\":\"a\",\"value\":1}", "{\"key\":\"a\\x\",\"value\":\"b\"}",
+        "{\"key\":\"\\ud800\",\"value\":\"b\"}", "{\"key\":\"\\u0000\",\"value\":\"b\"}",
+        "{\"key\":\"a\",\"value\":\"b\"} x", "[{\"key\":\"a\",\"value\":\"b\"},]",
+    };
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        ok = ok && json_parse_set_payload(invalid[i], strlen(invalid[i]), &items, &count, &capacity) == JSON_INVALID && count == 0;
+    }
+    ok = ok && json_parse_set_payload("{\"key\":\"a\"}", 11, &items, &count, &capacity) == JSON_MISSING_FIELD;
+
+    test_cond(ok);
+}
+
+// Fuzz-style round trips over random, escape-heavy and large payloads
+static void test_json_fuzz(void) {
+    test("JSON payload fuzzing and throughput\n");
+    srand(1337);
+    int ok = 1;
+    const char alphabet[] = "abcXYZ019 \"\\/\n\t\x01\x1e\xc3\xa9{}[]:,";
+    size_t sizes[] = {1, 15, 16, 17, 255, 4096, 65536, 1 << 20};
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]) && ok; s++) {
+        for (int round = 0; round < 4 && ok; round++) {
+            size_t len = sizes[s];
+            char *value = malloc(len + 1);
+            for (size_t i = 0; i < len; i++) {
+                // Mostly plain text with bursts of characters that need escaping
+                value[i] = (rand() % 8 == 0) ? alphabet[rand() % (sizeof(alphabet) - 1)] : 'a' + rand() % 26;
+            }
+            value[len] = '\0';
+
+            size_t escaped_len;
+            char *escaped = json_escape(value, len, &escaped_len);
+            char *body = malloc(escaped_len + 64);
+            int body_len = round % 2
+                ? sprintf(body, "{\"value\":\"%s\",\"key\":\"fuzz\"}", escaped)
+                : sprintf(body, "[{\"key\":\"fuzz\",\"value\":\"%s\"}]", escaped);
+
+            DataItem *items = NULL;
+            size_t count = 0, capacity = 0;
+            ok = json_parse_set_payload(body, body_len, &items, &count, &capacity) == JSON_OK &&
+                 count == 1 && strcmp(items[0].value, value) == 0;
+            free_data_list(&items, &count, &capacity);
+
+            // Truncations and byte flips must fail cleanly (or still parse) without crashing
+            for (int m = 0; m < 32; m++) {
+                char *mutated = malloc(body_len);
+                memcpy(mutated, body, body_len);
+                size_t cut = rand() % body_len;
+                mutated[rand() % body_len] ^= (char)(1 << (rand() % 8));
+                json_parse_set_payload(mutated, m % 2 ? cut : (size_t)body_len, &items, &count, &capacity);
+                free_data_list(&items, &count, &capacity);
+                free(mutated);
+            }
+            free(body);
+            free(escaped);
+            free(value);
+        }
+    }
+
+    // Throughput on a large, mostly plain payload
+    size_t big_len = 1 << 20;
+    char *body = malloc(big_len + 64);
+    int body_len = sprintf(body, "{\"key\":\"big\",\"value\":\"");
+    memset(body + body_len, 'x', big_len);
+    body_len += big_len;
+    body_len += sprintf(body + body_len, "\"}");
+    struct timespec start;
+    command_timer_start(&start);
+    for (int i = 0; i < 50; i++) {
+        DataItem *items = NULL;
+        size_t count = 0, capacity = 0;
+        ok = ok && json_parse_set_payload(body, body_len, &items, &count, &capacity) == JSON_OK;
+        free_data_list(&items, &count, &capacity);
+    }
+    double elapsed = command_timer_end(&start);
+    printf("    1MB payload: %.1f MB/s\n", 50.0 * body_len / (1024.0 * 1024.0) / (elapsed / 1000.0));
+    free(body);
+
+    test_cond(ok);
+}
+
+// Test per-thread metrics aggregation and exposition
+static void test_metrics(void) {
+    test("Metrics counters and exposition\n");
+    cleanup_test_db();
+    init_test_db();
+
+    uint64_t gets = metrics_counter_total(METRIC_CMD_GET);
+    uint64_t hits = metrics_counter_total(METRIC_CACHE_HITS);
+    uint64_t written = metrics_counter_total(METRIC_DISK_BYTES_WRITTEN);
+
+    assert(zset_command("metrics_key", "metrics_value") == CMD_SUCCESS);
+    char *value;
+    assert(zget_command("metrics_key", &value) == CMD_SUCCESS);
+    free(value);
+    assert(zget_command("missing_metrics_key", &value) == CMD_NOT_FOUND);
+
+    int64_t depth = metrics_gauge_get(GAUGE_HTTP_QUEUE_DEPTH);
+    assert(metrics_gauge_add(GAUGE_HTTP_QUEUE_DEPTH, 3) == depth + 3);
+
+    size_t len;
+    char *text = metrics_render(&len);
+    metrics_gauge_add(GAUGE_HTTP_QUEUE_DEPTH, -3);
+    char expected_depth[64];
+    snprintf(expected_depth, sizeof(expected_depth), "zu_http_queue_depth %lld\n", (long long)(depth + 3));
+    int ok = metrics_counter_total(METRIC_CMD_GET) == gets + 2 &&
+             metrics_gauge_get(GAUGE_HTTP_QUEUE_DEPTH) == depth &&
+             text && strstr(text, expected_depth) != NULL &&
+             metrics_counter_total(METRIC_CACHE_HITS) == hits + 1 &&
+             metrics_counter_total(METRIC_DISK_BYTES_WRITTEN) > written &&
+             text && strstr(text, "zu_command_latency_seconds_bucket{path=\"miss\",le=\"+Inf\"}") != NULL;
+    free(text);
+    test_cond(ok);
+}
+
+static void *latency_test_recorder(void *arg) {
+    (void)arg;
+    for (uint64_t i = 1; i <= 1000; i++) metrics_record_latency(LATENCY_HTTP, i * 1000);
+    return NULL;
+}
+
+// Test per-thread latency histograms merged into percentiles
+static void test_latency_histograms(void) {
+    test("Latency histograms merge across threads\n");
+    pthread_t threads[4];
+    for (int i = 0; i < 4; i++) assert(pthread_create(&threads[i], NULL, latency_test_recorder, NULL) == 0);
+    for (int i = 0; i < 4; i++) pthread_join(threads[i], NULL);
+
+    // 4 threads x 1..1000µs: every percentile within the ~3% bucket width
+    LatencyHistogram *h = calloc(LATENCY_KIND_COUNT, sizeof(LatencyHistogram));
+    assert(h && latency_command(h) == CMD_SUCCESS);
+    const LatencyHistogram *http = &h[LATENCY_HTTP];
+    uint64_t p50 = histogram_percentile(http, 50.0), p99 = histogram_percentile(http, 99.0);
+    int merged = http->count == 4000 && http->max_ns == 1000000 && http->sum_ns == 4ULL * 500500 * 1000;
+    int accurate = p50 >= 500000 && p50 <= 515000 && p99 >= 990000 && p99 <= 1000000 &&
+                   histogram_percentile(http, 100.0) == 1000000;
+    // 2^19ns = 524.288µs: 524 samples per thread fall below it
+    int buckets = histogram_count_below(http, 1ULL << 19) == 4 * 524 &&
+                  histogram_count_below(http, 1ULL << 30) == 4000;
+    free(h);
+
+    size_t len;
+    char *text = metrics_render(&len);
+    int exposed = text && strstr(text, "zu_command_latency_seconds_count{path=\"http\"} 4000\n") &&
+                  strstr(text, "zu_command_latency_max_seconds{path=\"http\"} 0.001000000\n") &&
+                  strstr(text, "zu_command_latency_quantile_seconds{path=\"http\",quantile=\"0.99\"}");
+    free(text);
+    test_cond(merged && accurate && buckets && exposed);
+}
+
+#define WRITER_TEST_THREADS 8
+#define WRITER_TEST_KEYS 50
+
+static void *writer_test_producer(void *arg) {
+    long id = (long)arg;
+    char key[32], value[32];
+    for (int i = 0; i < WRITER_TEST_KEYS; i++) {
+        snprintf(key, sizeof(key), "w%ld_%d", id, i);
+        snprintf(value, sizeof(value), "v%d", i);
+        if (zset_command(key, value) != CMD_SUCCESS) return (void *)1;
+    }
+    // Deleting every even key interleaves deletes with other threads' sets
+    for (int i = 0; i < WRITER_TEST_KEYS; i += 2) {
+        snprintf(key, sizeof(key), "w%ld_%d", id, i);
+        if (zrm_command(key) != CMD_SUCCESS) return (void *)1;
+    }
+    return NULL;
+}
+
+// Test concurrent writers funnelled through the writer thread's batches
+static void test_writer_batches(void) {
+    test("Writer thread batches concurrent writes\n");
+    cleanup_test_db();
+    init_test_db();
+
+    uint64_t batches = metrics_counter_total(METRIC_WRITER_BATCHES);
+    uint64_t ops = metrics_counter_total(METRIC_WRITER_OPS);
+    assert(writer_start());
+
+    pthread_t threads[WRITER_TEST_THREADS];
+    for (long t = 0; t < WRITER_TEST_THREADS; t++) {
+        pthread_create(&threads[t], NULL, writer_test_producer, (void *)t);
+    }
+    int failed = 0;
+    for (int t = 0; t < WRITER_TEST_THREADS; t++) {
+        void *ret;
+        pthread_join(threads[t], &ret);
+        failed |= ret != NULL;
+    }
+    writer_stop();
+
+    int count = 0;
+    char *value = NULL;
+    assert(zdbsize_command(&count) == CMD_SUCCESS);
+    int odd_kept = find_key_on_disk("w3_7", &value) > 0 && strcmp(value, "v7") == 0;
+    free(value);
+    int even_gone = zget_command("w3_8", &value) == CMD_NOT_FOUND;
+    uint64_t total_ops = WRITER_TEST_THREADS * (WRITER_TEST_KEYS + WRITER_TEST_KEYS / 2);
+
+    test_cond(!failed && count == WRITER_TEST_THREADS * WRITER_TEST_KEYS / 2 && odd_kept && even_gone &&
+              metrics_counter_total(METRIC_WRITER_OPS) - ops == total_ops &&
+              metrics_counter_total(METRIC_WRITER_BATCHES) - batches <= total_ops);
+}
+
+#define INCR_TEST_ROUNDS 50
+
+static void *incr_test_producer(void *arg) {
+    (void)arg;
+    long long value;
+    for (int i = 0; i < INCR_TEST_ROUNDS; i++) {
+        if (zincr_command("counter", 1, &value) != CMD_SUCCESS) return (void *)1;
+    }
+    return NULL;
+}
+
+// Test INCR, APPEND and CAS, including increments racing through the writer
+static void test_atomic_ops(void) {
+    test("Atomic INCR, APPEND and CAS\n");
+    cleanup_test_db();
+    init_test_db();
+
+    long long number = 0, length = 0;
+    int missing_is_zero = zincr_command("counter", 1, &number) == CMD_SUCCESS && number == 1;
+    int negative = zincr_command("counter", -3, &number) == CMD_SUCCESS && number == -2;
+    assert(zset_command("text", "abc") == CMD_SUCCESS);
+    int not_integer = zincr_command("text", 1, &number) == CMD_NOT_INTEGER;
+    assert(zset_command("big", "9223372036854775807") == CMD_SUCCESS);
+    int overflow = zincr_command("big", 1, &number) == CMD_NOT_INTEGER;
+    int appended = zappend_command("text", "def", &length) == CMD_SUCCESS && length == 6;
+    int swapped = zcas_command("text", "abcdef", "xyz") == CMD_SUCCESS;
+    int mismatch = zcas_command("text", "abcdef", "nope") == CMD_MISMATCH;
+    char *value = NULL;
+    int cas_value = zget_command("text", &value) == CMD_SUCCESS && strcmp(value, "xyz") == 0;
+    free(value);
+
+    assert(zset_command("counter", "0") == CMD_SUCCESS);
+    assert(writer_start());
+    pthread_t threads[WRITER_TEST_THREADS];
+    for (long t = 0; t < WRITER_TEST_THREADS; t++) {
+        pthread_create(&threads[t], NULL, incr_test_producer, NULL);
+    }
+    int failed = 0;
+    for (int t = 0; t < WRITER_TEST_THREADS; t++) {
+        void *ret;
+        pthread_join(threads[t], &ret);
+        failed |= ret != NULL;
+    }
+    writer_stop();
+    value = NULL;
+    int total = find_key_on_disk("counter", &value) > 0 &&
+                atoll(value) == WRITER_TEST_THREADS * INCR_TEST_ROUNDS;
+    free(value);
+
+    test_cond(missing_is_zero && negative && not_integer && overflow && appended &&
+              swapped && mismatch && cas_value && !failed && total);
+}
+
+// Moves one unit between two counters per transaction; the sum must hold
+static void *txn_test_producer(void *arg) {
+    long id = (long)arg;
+    for (int i = 0; i < INCR_TEST_ROUNDS; i++) {
+        Transaction txn;
+        txn_init(&txn);
+        txn_queue(&txn, WRITE_INCR, id % 2 ? "left" : "right", NULL, NULL, -1);
+        txn_queue(&txn, WRITE_INCR, id % 2 ? "right" : "left", NULL, NULL, 1);
+        int result = zexec_command(&txn);
+        txn_reset(&txn);
+        if (result != CMD_SUCCESS) return (void *)1;
+    }
+    return NULL;
+}
+
+// Test all-or-nothing transactions, watches, and transactions racing in batches
+static void test_transactions(void) {
+    test("Transactions commit all-or-nothing\n");
+    cleanup_test_db();
+    init_test_db();
+
+    Transaction txn;
+    txn_init(&txn);
+    assert(zset_command("t_text", "abc") == CMD_SUCCESS);
+    txn_queue(&txn, WRITE_SET, "t_a", "1", NULL, 0);
+    txn_queue(&txn, WRITE_INCR, "t_text", NULL, NULL, 1);
+    int rolled_back = zexec_command(&txn) == CMD_NOT_INTEGER &&
+                      txn.ops[1].result == WRITE_NOT_INTEGER && txn.ops[0].result == WRITE_SKIPPED;
+    txn_reset(&txn);
+    char *value = NULL;
+    rolled_back = rolled_back && zget_command("t_a", &value) == CMD_NOT_FOUND;
+
+    // A write between watch and exec aborts the transaction
+    assert(zwatch_command(&txn, "t_text") == CMD_SUCCESS);
+    assert(zset_command("t_text", "changed") == CMD_SUCCESS);
+    txn_queue(&txn, WRITE_SET, "t_a", "1", NULL, 0);
+    int watch_aborted = zexec_command(&txn) == CMD_MISMATCH;
+    txn_reset(&txn);
+
+    assert(zwatch_command(&txn, "t_text") == CMD_SUCCESS);
+    assert(zwatch_command(&txn, "t_missing") == CMD_SUCCESS);
+    txn_queue(&txn, WRITE_SET, "t_a", "1", NULL, 0);
+    txn_queue(&txn, WRITE_APPEND, "t_a", "2", NULL, 0);
+    txn_queue(&txn, WRITE_CAS, "t_text", "done", "changed", 0);
+    int committed = zexec_command(&txn) == CMD_SUCCESS && txn.ops[1].number == 2;
+    txn_reset(&txn);
+    committed = committed && zget_command("t_a", &value) == CMD_SUCCESS && strcmp(value, "12") == 0;
+    free(value);
+
+    assert(zset_command("left", "0") == CMD_SUCCESS);
+    assert(zset_command("right", "0") == CMD_SUCCESS);
+    assert(writer_start());
+    pthread_t threads[WRITER_TEST_THREADS];
+    for (long t = 0; t < WRITER_TEST_THREADS; t++) {
+        pthread_create(&threads[t], NULL, txn_test_producer, (void *)t);
+    }
+    int failed = 0;
+    for (int t = 0; t < WRITER_TEST_THREADS; t++) {
+        void *ret;
+        pthread_join(threads[t], &ret);
+        failed |= ret != NULL;
+    }
+    writer_stop();
+    char *left = NULL, *right = NULL;
+    int balanced = find_key_on_disk("left", &left) > 0 && find_key_on_disk("right", &right) > 0 &&
+                   atoll(left) + atoll(right) == 0;
+    free(left);
+    free(right);
+
+    test_cond(rolled_back && watch_aborted && committed && !failed && balanced);
+}
+
+static volatile int shared_reader_done = 0;
+
+static void *shared_reader(void *arg) {
+    (void)arg;
+    char *value = NULL;
+    if (find_key_on_disk("shared_key", &value) > 0) free(value);
+    shared_reader_done = 1;
+    return NULL;
+}
+
+// Test that disk lookups only take the file lock shared
+static void test_shared_readers(void) {
+    test("Disk readers share the file lock\n");
+    cleanup_test_db();
+    init_test_db();
+    assert(zset_command("shared_key", "shared_value") == CMD_SUCCESS);
+
+    // Another reader holds the lock; a lookup must still complete
+    pthread_rwlock_rdlock(&file_lock);
+    shared_reader_done = 0;
+    pthread_t reader;
+    pthread_create(&reader, NULL, shared_reader, NULL);
+    for (int i = 0; i < 200 && !shared_reader_done; i++) {
+        usleep(10000);
+    }
+    int done = shared_reader_done;
+    pthread_rwlock_unlock(&file_lock);
+    pthread_join(reader, NULL);
+
+    test_cond(done);
+}
+
+static void record_content_hash(const char *value, size_t value_len, uint64_t content_hash, void *ctx) {
+    (void)value;
+    (void)value_len;
+    *(uint64_t *)ctx = content_hash;
+}
+
+// Test that the ETag hash survives cache hits and changes with the value
+static void test_content_hash(void) {
+    test("Content hash for ETags\n");
+    cleanup_test_db();
+    init_test_db();
+
+    uint64_t from_disk = 0, from_cache = 0, updated = 0;
+    assert(zset_command("etag_key", "etag_value") == CMD_SUCCESS);
+    remove_from_cache("etag_key");
+    assert(zget_visit_command("etag_key", record_content_hash, &from_disk) == CMD_SUCCESS);
+    assert(zget_visit_command("etag_key", record_content_hash, &from_cache) == CMD_SUCCESS);
+    assert(zset_command("etag_key", "etag_value_2") == CMD_SUCCESS);
+    assert(zget_visit_command("etag_key", record_content_hash, &updated) == CMD_SUCCESS);
+
+    test_cond(from_disk == hash_content("etag_value", 10) && from_cache == from_disk && updated != from_disk);
+}
+
+// Test Bloom filters and the misses they answer without a file scan
+static void test_bloom_filter(void) {
+    test("Bloom filters skip disk reads for absent keys\n");
+    char key[32];
+    BloomFilter *filter = bloom_new(1000);
+    assert(filter);
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "present:%d", i);
+        bloom_add(filter, key);
+    }
+    int no_false_negatives = 1;
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "present:%d", i);
+        no_false_negatives = no_false_negatives && bloom_may_contain(filter, key);
+    }
+    int false_positives = 0;
+    for (int i = 0; i < 10000; i++) {
+        snprintf(key, sizeof(key), "absent:%d", i);
+        false_positives += bloom_may_contain(filter, key);
+    }
+
+    size_t len = bloom_encoded_size(filter);
+    char *encoded = malloc(len);
+    assert(encoded);
+    bloom_encode(filter, encoded);
+    BloomFilter *decoded = bloom_decode(encoded, len);
+    int round_trip = decoded && bloom_keys(decoded) == 1000 && bloom_bits(decoded) == bloom_bits(filter) &&
+                     bloom_may_contain(decoded, "present:7");
+    int rejects_garbage = bloom_decode(encoded, len - 1) == NULL;
+    free(encoded);
+    bloom_free(decoded);
+    bloom_free(filter);
+
+    // The writer persists a filter with each file generation it commits
+    cleanup_test_db();
+    init_test_db();
+    assert(zset_command("bloom:a", "1") == CMD_SUCCESS);
+    assert(zset_command("bloom:b", "2") == CMD_SUCCESS);
+    char bloom_path[256];
+    snprintf(bloom_path, sizeof(bloom_path), "%s.bloom", FILENAME);
+    int persisted = access(bloom_path, F_OK) == 0;
+
+    uint64_t negatives = metrics_counter_total(METRIC_BLOOM_NEGATIVES);
+    char *value = NULL;
+    int found = find_key_on_disk("bloom:b", &value) == 1 && strcmp(value, "2") == 0;
+    free(value);
+    int skipped = find_key_on_disk("bloom:missing", &value) == 0 &&
+                  metrics_counter_total(METRIC_BLOOM_NEGATIVES) > negatives;
+
+    // A file written outside the writer gets a filter rebuilt by the next
+    // reader, but one built from a file that is no longer current is not kept
+    FILE *file = fopen(FILENAME, "wb");
+    assert(file && write_item_to_file(file, "bloom:x", "1") && write_item_to_file(file, "bloom:y", "2") &&
+           write_item_to_file(file, "bloom:z", "3") && fclose(file) == 0);
+    unlink(bloom_path);
+    struct stat st;
+    file = fopen(FILENAME, "rb");
+    assert(file && fstat(fileno(file), &st) == 0);
+    st.st_size++;
+    int stale = bloom_file_check("bloom:x", file, &st) == 1 && metrics_gauge_get(GAUGE_BLOOM_KEYS) == 2;
+    fclose(file);
+    int rebuilt = find_key_on_disk("bloom:missing", &value) == 0 && metrics_gauge_get(GAUGE_BLOOM_KEYS) == 3;
+
+    test_cond(no_false_negatives && false_positives < 300 && round_trip && rejects_garbage &&
+              persisted && found && skipped && stale && rebuilt);
+}
+
+static void remove_lsm_dir(const char *path) {
+    DIR *dir = opendir(path);
+    if (!dir) return;
+    struct dirent *entry;
+    char file[512];
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+        snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+        unlink(file);
+    }
+    closedir(dir);
+    rmdir(path);
+}
+
+// Test the LSM engine through the regular command layer
+static void *read_lsm_key(void *arg) {
+    int *found = arg;
+    for (int i = 0; i < 2000; i++) {
+        char *value = NULL;
+        if (lsm_get("lsm:wal", &value) == 1 && strcmp(value, "replayed") == 0) (*found)++;
+        free(value);
+    }
+    return NULL;
+}
+
+static void test_lsm_engine(void) {
+    test("LSM engine flush, compaction and recovery\n");
+    char *saved = FILENAME;
+    FILENAME = "test.lsm";
+    remove_lsm_dir(FILENAME);
+
+    char key[32], value[64];
+    for (int i = 0; i < 300; i++) {
+        snprintf(key, sizeof(key), "lsm:%03d", i);
+        snprintf(value, sizeof(value), "value-%03d-padding-padding-padding", i);
+        assert(zset_command(key, value) == CMD_SUCCESS);
+    }
+    assert(lsm_flush());
+    for (int i = 0; i < 300; i += 3) {
+        snprintf(key, sizeof(key), "lsm:%03d", i);
+        assert(zrm_command(key) == CMD_SUCCESS);
+    }
+    assert(zset_command("lsm:001", "updated") == CMD_SUCCESS);
+    assert(lsm_flush());
+    assert(zset_command("lsm:002", "in memtable") == CMD_SUCCESS);
+    int tables = lsm_table_count() == 2;
+    assert(lsm_compact());
+    int compacted = lsm_table_count() == 1;
+
+    // Read past the cache: memtable, then the merged table
+    char *found = NULL;
+    int updated = find_key_on_disk("lsm:001", &found) == 1 && strcmp(found, "updated") == 0;
+    free(found);
+    found = NULL;
+    int memtable = find_key_on_disk("lsm:002", &found) == 1 && strcmp(found, "in memtable") == 0;
+    free(found);
+    found = NULL;
+    int deleted = find_key_on_disk("lsm:150", &found) == 0 && find_key_on_disk("lsm:999", &found) == 0;
+    int counted = count_keys_on_disk() == 200;
+
+    DataItem *items = NULL;
+    size_t size = 0, capacity = 0;
+    char *next = NULL;
+    assert(zrange_command("lsm:100", "lsm:106", 10, 1, &items, &size, &capacity, &next) == CMD_SUCCESS);
+    int range = size == 4 && strcmp(items[0].key, "lsm:100") == 0 && strcmp(items[1].key, "lsm:101") == 0 &&
+                strcmp(items[3].key, "lsm:104") == 0 && strncmp(items[3].value, "value-104", 9) == 0 && next == NULL;
+    free_data_list(&items, &size, &capacity);
+
+    // Cursor pages cover every key once
+    char *cursor = NULL;
+    size_t scanned = 0;
+    do {
+        assert(scan_disk_page(cursor, "lsm:", 64, 1, &items, &size, &capacity, &next) == 1);
+        scanned += size;
+        free_data_list(&items, &size, &capacity);
+        free(cursor);
+        cursor = next;
+    } while (cursor != NULL);
+
+    // Writes only in the log are replayed on reopen
+    assert(zset_command("lsm:wal", "replayed") == CMD_SUCCESS);
+    lsm_close();
+    int recovered = find_key_on_disk("lsm:wal", &found) == 1 && strcmp(found, "replayed") == 0;
+    free(found);
+    recovered = recovered && count_keys_on_disk() == 201;
+
+    // Closing waits for the readers still using the database
+    pthread_t readers[4];
+    int reads[4] = {0};
+    for (int i = 0; i < 4; i++) {
+        assert(pthread_create(&readers[i], NULL, read_lsm_key, &reads[i]) == 0);
+    }
+    for (int i = 0; i < 50; i++) {
+        lsm_close();
+        usleep(200);
+    }
+    int survived = 1;
+    for (int i = 0; i < 4; i++) {
+        pthread_join(readers[i], NULL);
+        survived = survived && reads[i] == 2000;
+    }
+
+    lsm_close();
+    remove_lsm_dir(FILENAME);
+    FILENAME = saved;
+    test_cond(tables && compacted && updated && memtable && deleted && counted && range &&
+              scanned == 200 && recovered && survived);
+}
+
+// Test the YCSB-style workload generator
+static void test_workload(void) {
+    test("Benchmark workloads run on the database they are given\n");
+    cleanup_test_db();
+    init_test_db();
+    assert(zset_command("workload_key", "kept") == CMD_SUCCESS);
+
+    // Rank 0 is the hottest under a zipfian distribution
+    ZipfianGenerator zipfian;
+    uint64_t rng = 42, hits[4] = {0};
+    zipfian_init(&zipfian, 1000, ZIPFIAN_THETA);
+    for (int i = 0; i < 10000; i++) {
+        uint64_t rank = zipfian_next(&zipfian, &rng);
+        if (rank < 4) hits[rank]++;
+    }
+    int skewed = hits[0] > hits[1] && hits[1] > hits[3] && hits[0] > 10000 / 20;
+
+    WorkloadConfig config;
+    WorkloadResult result;
+    int parsed = workload_preset("a", &config) && workload_option(&config, "records=200") &&
+                 workload_option(&config, "threads=2") && workload_option(&config, "seconds=0.2") &&
+                 workload_valid(&config) && !workload_option(&config, "dist=pareto") &&
+                 !workload_preset("g", &config);
+    char *saved = FILENAME;
+    FILENAME = "test_workload.zdb";
+    workload_remove_scratch(FILENAME);
+    clear_cache();
+    assert(workload_run(&config, &result));
+    uint64_t reads = result.operations[WORKLOAD_READ], updates = result.operations[WORKLOAD_UPDATE];
+    const LatencyHistogram *h = &result.overall;
+    int ran = reads > 0 && updates > 0 && result.errors == 0 && h->count == reads + updates &&
+              histogram_percentile(h, 50.0) <= histogram_percentile(h, 99.0) &&
+              histogram_percentile(h, 99.0) <= h->max_ns;
+
+    // Scans and inserts
+    assert(workload_preset("e", &config) && workload_option(&config, "records=200") &&
+           workload_option(&config, "threads=2") && workload_option(&config, "seconds=0.2"));
+    assert(workload_run(&config, &result));
+    int scanned = result.operations[WORKLOAD_SCAN] > 0 && result.errors == 0;
+    int loaded = access(FILENAME, F_OK) == 0;
+
+    // The runs never switched away from their database
+    workload_remove_scratch(FILENAME);
+    FILENAME = saved;
+    clear_cache();
+    char *value = NULL;
+    int restored = loaded && access("test_workload.zdb", F_OK) != 0 &&
+                   zget_command("workload_key", &value) == CMD_SUCCESS && strcmp(value, "kept") == 0;
+    free(value);
+    test_cond(skewed && parsed && ran && scanned && restored);
+}
+
+// Test I/O accounting per operation type and its reset
+static void test_io_stats(void) {
+    test("Storage I/O and cache stats\n");
+    cleanup_test_db();
+    init_test_db();
+    assert(zset_command("io_a", "1") == CMD_SUCCESS);
+
+    StorageStats stats;
+    assert(stats_command(&stats, 1) == CMD_SUCCESS);
+    assert(zset_command("io_b", "2") == CMD_SUCCESS);
+    clear_cache();
+    char *value = NULL;
+    assert(zget_command("io_b", &value) == CMD_SUCCESS);
+    free(value);
+    assert(stats_command(&stats, 1) == CMD_SUCCESS);
+
+    const uint64_t *find = stats.io[IO_OP_FIND], *commit = stats.io[IO_OP_COMMIT];
+    int read = find[IO_STAT_CALLS] == 1 && find[IO_STAT_OPENS] == 1 && find[IO_STAT_RECORDS] >= 1 &&
+               find[IO_STAT_BYTES_READ] >= (uint64_t)item_record_size("io_b", "2") && stats.cache_misses == 1;
+    int written = commit[IO_STAT_CALLS] == 1 && commit[IO_STAT_RECORDS] == 1 &&
+                  commit[IO_STAT_BYTES_WRITTEN] == (uint64_t)(item_record_size("io_a", "1") +
+                                                               item_record_size("io_b", "2")) &&
+                  commit[IO_STAT_FSYNCS] >= (WRITER_FSYNC ? 1 : 0) && stats.io[IO_OP_EXISTS][IO_STAT_CALLS] == 1;
+
+    // The reset restarted every count from zero
+    assert(stats_command(&stats, 0) == CMD_SUCCESS);
+    int reset = stats.io[IO_OP_FIND][IO_STAT_CALLS] == 0 && stats.io[IO_OP_COMMIT][IO_STAT_BYTES_WRITTEN] == 0 &&
+                stats.cache_misses == 0 && metrics_counter_total(METRIC_CACHE_MISSES) > 0;
+    test_cond(read && written && reset);
+}
+
+static void *read_io_key(void *arg) {
+    char *value = NULL;
+    int found = zget_command("io_locked", &value) == CMD_SUCCESS && value && strcmp(value, "1") == 0;
+    free(value);
+    *(int *)arg = found;
+    return NULL;
+}
+
+// A disk read that finds file_lock held must block, then count the wait
+static void test_io_lock_contention(void) {
+    test("Contended file lock blocks the reader and counts the wait\n");
+    cleanup_test_db();
+    init_test_db();
+    assert(zset_command("io_locked", "1") == CMD_SUCCESS);
+    clear_cache();
+    StorageStats stats;
+    assert(stats_command(&stats, 1) == CMD_SUCCESS);
+
+    int found = 0;
+    pthread_t reader;
+    pthread_rwlock_wrlock(&file_lock);
+    assert(pthread_create(&reader, NULL, read_io_key, &found) == 0);
+    usleep(100000); // Let the reader reach the lock
+    int waited_for_lock = found == 0;
+    pthread_rwlock_unlock(&file_lock);
+    pthread_join(reader, NULL);
+
+    assert(stats_command(&stats, 1) == CMD_SUCCESS);
+    test_cond(waited_for_lock && found && stats.io[IO_OP_FIND][IO_STAT_LOCK_WAITS] == 1 &&
+              stats.io[IO_OP_FIND][IO_STAT_LOCK_WAIT_NS] > 0);
+}
+
+// Test the slowlog: threshold, entry fields, truncation, order and reset
+static void test_slowlog(void) {
+    test("Slowlog records slow commands newest first\n");
+    cleanup_test_db();
+    init_test_db();
+    uint64_t threshold_us;
+    assert(slowlog_reset_command() == CMD_SUCCESS);
+    // A threshold no commit reaches, even one that waits on fsync
+    assert(slowlog_threshold_command(60000000, &threshold_us) == CMD_SUCCESS);
+    assert(zset_command("fast", "1") == CMD_SUCCESS);
+    size_t before;
+    assert(slowlog_len_command(&before) == CMD_SUCCESS);
+
+    // With no threshold every command is slow
+    assert(slowlog_threshold_command(0, &threshold_us) == CMD_SUCCESS && threshold_us == 0);
+    char long_key[SLOWLOG_KEY_LEN * 2 + 1];
+    memset(long_key, 'k', sizeof(long_key) - 1);
+    long_key[sizeof(long_key) - 1] = '\0';
+    assert(zset_command(long_key, "v") == CMD_SUCCESS);
+    clear_cache();
+    char *value = NULL;
+    assert(zget_command(long_key, &value) == CMD_SUCCESS);
+    free(value);
+    assert(zget_command("absent", &value) == CMD_NOT_FOUND);
+    slowlog_threshold_command(SLOWLOG_THRESHOLD_US, &threshold_us);
+
+    SlowlogEntry entries[4];
+    size_t count, len;
+    assert(slowlog_get_command(entries, 4, &count) == CMD_SUCCESS);
+    assert(slowlog_len_command(&len) == CMD_SUCCESS);
+    int recorded = before == 0 && count == 3 && len == 3 && entries[0].id > entries[1].id &&
+                   entries[1].id > entries[2].id;
+    int fields = strcmp(entries[0].command, "get") == 0 && entries[0].path == SLOWLOG_MISS &&
+                 entries[1].path == SLOWLOG_DISK && entries[1].bytes_read > 0 && entries[2].path == SLOWLOG_WRITE &&
+                 strcmp(entries[2].command, "set") == 0 && entries[2].key_length == strlen(long_key) &&
+                 strlen(entries[2].key) == SLOWLOG_KEY_LEN && entries[2].timestamp_us > 0;
+
+    assert(slowlog_reset_command() == CMD_SUCCESS);
+    assert(slowlog_len_command(&len) == CMD_SUCCESS);
+    test_cond(recorded && fields && len == 0);
+}
+
+static void test_hotkeys(void) {
+    test("Hot keys stand out from more cold keys than there are counters\n");
+    cleanup_test_db();
+    init_test_db();
+    unsigned int rate, seconds;
+    assert(hotkeys_reset_command() == CMD_SUCCESS);
+    // Count every request, and keep the counts until the decay check below
+    assert(hotkeys_config_command(1, 0, &rate, &seconds) == CMD_SUCCESS && rate == 1 && seconds == 0);
+    assert(hotkeys_config_command(HOTKEYS_MAX_SAMPLE_RATE + 1, -1, &rate, &seconds) == CMD_ERROR);
+
+    char key[32], *value = NULL;
+    for (int i = 0; i < 10; i++) {
+        assert(zset_command("hot", "1") == CMD_SUCCESS);
+    }
+    for (int i = 0; i < 4 * HOTKEYS_CAPACITY; i++) {
+        assert(zget_command("hot", &value) == CMD_SUCCESS);
+        free(value);
+        snprintf(key, sizeof(key), "cold_%d", i);
+        assert(zget_command(key, &value) == CMD_NOT_FOUND);
+    }
+
+    HotKey keys[HOTKEYS_CAPACITY];
+    size_t count;
+    uint64_t hot_requests = 10 + 4 * HOTKEYS_CAPACITY;
+    assert(hotkeys_command(keys, HOTKEYS_CAPACITY, &count) == CMD_SUCCESS);
+    // Space-Saving only overestimates, by at most `error`
+    int found = count == HOTKEYS_CAPACITY && strcmp(keys[0].key, "hot") == 0 && keys[0].count >= hot_requests &&
+                keys[0].count - keys[0].error <= hot_requests && keys[0].writes == 10 &&
+                keys[1].count < keys[0].count / 4;
+
+    // One decay window halves every count
+    assert(hotkeys_config_command(-1, 1, &rate, &seconds) == CMD_SUCCESS && seconds == 1);
+    sleep(1);
+    HotKey decayed;
+    assert(hotkeys_command(&decayed, 1, &count) == CMD_SUCCESS);
+    int halved = count == 1 && strcmp(decayed.key, "hot") == 0 && decayed.count <= keys[0].count / 2;
+
+    hotkeys_config_command(HOTKEYS_SAMPLE_RATE, HOTKEYS_DECAY_SECONDS, &rate, &seconds);
+    assert(hotkeys_reset_command() == CMD_SUCCESS);
+    assert(hotkeys_command(keys, HOTKEYS_CAPACITY, &count) == CMD_SUCCESS);
+    test_cond(found && halved && count == 0);
+}
+
+typedef struct {
+    int events, command_begins, command_ends, cache_hits;
+} TraceCounts;
+
+static int count_trace_event(size_t array, char **values, void *ctx) {
+    TraceCounts *counts = ctx;
+    (void)array;
+    counts->events++;
+    if (values[0] && values[1] && strcmp(values[0], "command") == 0) {
+        if (strcmp(values[1], "B") == 0) counts->command_begins++;
+        if (strcmp(values[1], "E") == 0) counts->command_ends++;
+    }
+    if (values[2] && strcmp(values[2], "cache_hit") == 0) counts->cache_hits++;
+    return 1;
+}
+
+// Test the trace ring and its Chrome trace-event dump
+static void test_trace(void) {
+    test("Trace ring records spans and dumps Chrome trace JSON\n");
+    cleanup_test_db();
+    init_test_db();
+    assert(trace_clear_command() == CMD_SUCCESS);
+    assert(zset_command("traced", "1") == CMD_SUCCESS); // Tracing is off: not recorded
+
+    assert(trace_enable_command(1) == CMD_SUCCESS);
+    char *value = NULL;
+    assert(zget_command("traced", &value) == CMD_SUCCESS);
+    free(value);
+    assert(zset_command("traced", "2") == CMD_SUCCESS);
+    assert(trace_enable_command(0) == CMD_SUCCESS);
+
+    char *body = NULL;
+    size_t len = 0;
+    long events = 0;
+    FILE *out = open_memstream(&body, &len);
+    assert(out && trace_dump_command(out, &events) == CMD_SUCCESS);
+    fclose(out);
+    static const char *const arrays[] = {"traceEvents"};
+    static const char *const names[] = {"cat", "ph", "name"};
+    TraceCounts counts = {0, 0, 0, 0};
+    int parsed = json_parse_object_arrays(body, len, arrays, 1, names, 3, count_trace_event, &counts) == JSON_OK;
+    free(body);
+
+    long cleared = -1;
+    assert(trace_clear_command() == CMD_SUCCESS);
+    out = fopen("/dev/null", "w");
+    assert(out && trace_dump_command(out, &cleared) == CMD_SUCCESS);
+    fclose(out);
+    test_cond(parsed && counts.events == events && counts.command_begins == 2 && counts.command_ends == 2 &&
+              counts.cache_hits == 1 && cleared == 0);
+}
+
+// Test benchmark result files and their comparison
+static void test_bench_report(void) {
+    test("Benchmark results compare with noise and a threshold\n");
+    BenchReport report;
+    assert(bench_report_open(&report, "bench_base.json", "test"));
+    bench_report_metric(&report, "steady", "n=1", "median_ns", 100.0, 1.0, 1);
+    bench_report_metric(&report, "noisy", "n=1", "median_ns", 100.0, 10.0, 1);
+    bench_report_metric(&report, "throughput", "n=\"1\"", "ops_per_sec", 1000.0, 0, 0);
+    bench_report_metric(&report, "dropped", "", "median_ns", 1.0, 0, 1);
+    assert(bench_report_close(&report));
+
+    assert(bench_report_open(&report, "bench_new.json", "test"));
+    bench_report_metric(&report, "steady", "n=1", "median_ns", 120.0, 1.0, 1);     // 20% slower: a regression
+    bench_report_metric(&report, "noisy", "n=1", "median_ns", 130.0, 10.0, 1);     // Within 3 sigma of the noise
+    bench_report_metric(&report, "throughput", "n=\"1\"", "ops_per_sec", 1030.0, 0, 0); // Better
+    assert(bench_report_close(&report));
+
+    FILE *sink = fopen("/dev/null", "w");
+    assert(sink);
+    int regressions = bench_report_compare("bench_base.json", "bench_new.json", 5.0, 3.0, sink);
+    int strict = bench_report_compare("bench_base.json", "bench_new.json", 5.0, 0.0, sink); // Noisy counts too
+    int lenient = bench_report_compare("bench_base.json", "bench_new.json", 25.0, 3.0, sink);
+    int missing = bench_report_compare("bench_base.json", "no_such_file.json", 5.0, 3.0, sink);
+    fclose(sink);
+    unlink("bench_base.json");
+    unlink("bench_new.json");
+    test_cond(regressions == 1 && strict == 2 && lenient == 0 && missing == -1);
+}
+
 // Test cache status
+static void test_memory(void) {
+    test("Memory accounting and cache pages\n");
+
+    // The table's counters follow inserts, updates and removals
+    HashTable *ht = create_hash_table(8);
+    hash_table_insert(ht, "alpha", "1");
+    hash_table_insert(ht, "beta", "22");
+    hash_table_insert(ht, "alpha", "333");
+    assert(ht->count == 2);
+    assert(ht->key_bytes == strlen("alpha") + 1 + strlen("beta") + 1);
+    assert(ht->value_bytes == strlen("333") + 1 + strlen("22") + 1);
+    assert(ht->used_buckets >= 1 && ht->used_buckets <= 2);
+    assert(ht->allocated_bytes >= 2 * sizeof(DataItem) + ht->key_bytes + ht->value_bytes);
+    hash_table_remove(ht, "alpha");
+    hash_table_remove(ht, "beta");
+    int emptied = ht->count == 0 && ht->used_buckets == 0 && ht->key_bytes == 0 && ht->value_bytes == 0 &&
+                  ht->allocated_bytes == 0;
+    free_hash_table(ht);
+
+    // Paging through the server cache visits every entry once
+    cleanup_test_db();
+    init_test_db();
+    char key[32], value[32];
+    for (int i = 0; i < 50; i++) {
+        snprintf(key, sizeof(key), "mem_key_%02d", i);
+        snprintf(value, sizeof(value), "mem_value_%02d", i);
+        assert(zset_command(key, value) == CMD_SUCCESS);
+        char *read;
+        assert(zget_command(key, &read) == CMD_SUCCESS);
+        free(read);
+    }
+    MemoryStats stats;
+    assert(memory_command(&stats) == CMD_SUCCESS);
+    assert(stats.cache_items >= 1 && stats.cache_keys > 0 && stats.cache_values > 0);
+    assert(stats.cache_buckets == stats.cache_bucket_count * sizeof(DataItem *));
+
+    unsigned int cursor = 0, pages = 0;
+    size_t seen = 0;
+    do {
+        DataItem *items = NULL;
+        size_t size = 0, capacity = 0;
+        assert(cache_page_command(cursor, 7, &items, &size, &capacity, &cursor) == CMD_SUCCESS);
+        seen += size;
+        pages++;
+        free_data_list(&items, &size, &capacity);
+    } while (cursor != 0);
+
+    test_cond(emptied && seen == stats.cache_items && pages > 1);
+}
+
 static void test_cache_status(void) {
     test("Cache status operation\n");
     cleanup_test_db();
@@ -168,6 +1231,27 @@ int main(void) {
     test_cache_operations();
     test_remove_operation();
     test_list_all();
+    test_scan_pages();
+    test_ordered_index();
+    test_json_payload();
+    test_json_fuzz();
+    test_metrics();
+    test_latency_histograms();
+    test_content_hash();
+    test_writer_batches();
+    test_atomic_ops();
+    test_transactions();
+    test_shared_readers();
+    test_lsm_engine();
+    test_bloom_filter();
+    test_workload();
+    test_bench_report();
+    test_io_stats();
+    test_io_lock_contention();
+    test_slowlog();
+    test_hotkeys();
+    test_trace();
+    test_memory();
     test_cache_status();
     test_db_init();
     